@@ -0,0 +1,289 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sched.h>
+#include <time.h>
+#include "appendBatch.h"
+
+static uint64_t
+nowNs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void
+wakeFlusher(struct appendBatch *ab, uint64_t wantSeq)
+{
+    pthread_mutex_lock(&ab->mtx);
+    if (ab->wantSeq < wantSeq)
+        ab->wantSeq = wantSeq;
+    pthread_cond_signal(&ab->wake);
+    pthread_mutex_unlock(&ab->mtx);
+}
+
+static void
+setError(struct appendBatch *ab, int err)
+{
+    pthread_mutex_lock(&ab->mtx);
+    if (ab->err == 0)
+        __atomic_store_n(&ab->err, err, __ATOMIC_RELAXED);
+    pthread_cond_broadcast(&ab->done);
+    pthread_mutex_unlock(&ab->mtx);
+}
+
+/* 写出 iov 中的全部数据, 处理部分写入 */
+static int
+writeAll(struct appendBatch *ab, struct iovec *iov, int iovcnt)
+{
+    int dsync = (ab->flags & AB_DSYNC) != 0;
+    ssize_t n;
+
+    while (iovcnt > 0) {
+        ab->writes++;
+        if (dsync && !ab->noPwritev2) {
+            n = pwritev2(ab->fd, iov, iovcnt, ab->off, RWF_DSYNC);
+            if (n == -1 && (errno == ENOSYS || errno == EOPNOTSUPP || errno == EINVAL)) {
+                ab->noPwritev2 = 1;
+                continue;
+            }
+        } else {
+            n = pwritev(ab->fd, iov, iovcnt, ab->off);
+        }
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        ab->off += n;
+        while (iovcnt > 0 && (size_t)n >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+
+    if (dsync && ab->noPwritev2 && fdatasync(ab->fd) == -1)
+        return -1;
+    return 0;
+}
+
+/*
+ * 从队列中取出最多 AB_IOV_MAX 条已经发布的记录并写入, 返回写入的记录数.
+ * 只由后台线程调用, 不持有锁.
+ */
+static int
+flushOnce(struct appendBatch *ab)
+{
+    struct iovec iov[AB_IOV_MAX];
+    struct abSlot *slot;
+    uint64_t bytes = 0;
+    int cnt = 0;
+
+    while (cnt < AB_IOV_MAX) {
+        slot = &ab->ring[ab->head & ab->mask];
+        if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != ab->head + 1)
+            break;
+        iov[cnt].iov_base = (void *)slot->rec;
+        iov[cnt].iov_len = slot->len;
+        bytes += slot->len;
+        cnt++;
+        // 指针已经复制到 iov, 槽位可以给下一圈的生产者使用
+        __atomic_store_n(&slot->seq, ab->head + ab->mask + 1, __ATOMIC_RELEASE);
+        ab->head++;
+    }
+    if (cnt == 0)
+        return 0;
+
+    if (writeAll(ab, iov, cnt) == -1) {
+        setError(ab, errno);
+        return -1;
+    }
+    ab->records += cnt;
+    __atomic_sub_fetch(&ab->pendingBytes, bytes, __ATOMIC_RELAXED);
+    return cnt;
+}
+
+static void *
+flusherMain(void *arg)
+{
+    struct appendBatch *ab = arg;
+    struct timespec ts;
+    uint64_t pending, deadline, now;
+    int n;
+
+    pthread_mutex_lock(&ab->mtx);
+    for (;;) {
+        // 等待刷新的条件: 达到阈值, 有线程在等待, 超过期限, 或者要关闭
+        deadline = 0;
+        for (;;) {
+            pending = __atomic_load_n(&ab->pendingBytes, __ATOMIC_RELAXED);
+            if (ab->stop || ab->err != 0 || ab->wantSeq > ab->flushedSeq ||
+                    pending >= ab->flushBytes)
+                break;
+            if (pending == 0) {
+                deadline = 0;
+                pthread_cond_wait(&ab->wake, &ab->mtx);
+                continue;
+            }
+            now = nowNs();
+            if (deadline == 0)
+                deadline = now + ab->flushUsec * 1000;
+            if (now >= deadline)
+                break;
+            ts.tv_sec = deadline / 1000000000;
+            ts.tv_nsec = deadline % 1000000000;
+            pthread_cond_timedwait(&ab->wake, &ab->mtx, &ts);
+        }
+        if (ab->err != 0 || (ab->stop && pending == 0))
+            break;
+        pthread_mutex_unlock(&ab->mtx);
+
+        // 生产者已经占用位置但还没有发布记录时, 等它完成
+        if ((n = flushOnce(ab)) == 0)
+            sched_yield();
+
+        pthread_mutex_lock(&ab->mtx);
+        if (n > 0) {
+            ab->flushedSeq = ab->head;
+            pthread_cond_broadcast(&ab->done);
+        }
+    }
+    pthread_mutex_unlock(&ab->mtx);
+    return NULL;
+}
+
+int
+abOpen(struct appendBatch *ab, int fd, int flags, size_t flushBytes, long flushUsec,
+        size_t queueSize)
+{
+    pthread_condattr_t attr;
+    uint64_t cap, j;
+
+    memset(ab, 0, sizeof(struct appendBatch));
+    ab->fd = fd;
+    ab->flags = flags;
+    ab->flushBytes = (flushBytes == 0) ? AB_DEFAULT_BYTES : flushBytes;
+    ab->flushUsec = (flushUsec <= 0) ? AB_DEFAULT_USEC : flushUsec;
+    if ((ab->off = lseek(fd, 0, SEEK_END)) == -1)
+        return -1;
+
+    if (queueSize == 0)
+        queueSize = AB_DEFAULT_QUEUE;
+    for (cap = 2; cap < queueSize; cap <<= 1)
+        ;
+    if ((ab->ring = malloc(cap * sizeof(struct abSlot))) == NULL)
+        return -1;
+    // 槽位的序号等于位置时可以写入
+    for (j = 0; j < cap; j++)
+        ab->ring[j].seq = j;
+    ab->mask = cap - 1;
+
+    pthread_mutex_init(&ab->mtx, NULL);
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&ab->wake, &attr);
+    pthread_cond_init(&ab->done, &attr);
+    pthread_condattr_destroy(&attr);
+
+    if ((errno = pthread_create(&ab->flusher, NULL, flusherMain, ab)) != 0) {
+        pthread_cond_destroy(&ab->wake);
+        pthread_cond_destroy(&ab->done);
+        pthread_mutex_destroy(&ab->mtx);
+        free(ab->ring);
+        return -1;
+    }
+    return 0;
+}
+
+int
+abAppend(struct appendBatch *ab, const void *rec, size_t len, uint64_t *seq)
+{
+    struct abSlot *slot;
+    uint64_t pos, s, prev;
+    int err;
+
+    pos = __atomic_load_n(&ab->tail, __ATOMIC_RELAXED);
+    for (;;) {
+        if ((err = __atomic_load_n(&ab->err, __ATOMIC_RELAXED)) != 0) {
+            errno = err;
+            return -1;
+        }
+        slot = &ab->ring[pos & ab->mask];
+        s = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        if (s == pos) {
+            if (__atomic_compare_exchange_n(&ab->tail, &pos, pos + 1, 1,
+                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        } else if ((int64_t)(s - pos) < 0) {
+            // 队列已满, 要求刷新已经在队列中的记录
+            wakeFlusher(ab, pos);
+            sched_yield();
+            pos = __atomic_load_n(&ab->tail, __ATOMIC_RELAXED);
+        } else {
+            pos = __atomic_load_n(&ab->tail, __ATOMIC_RELAXED);
+        }
+    }
+
+    // 先计入未刷新的字节数再发布, 后台线程写完后减去时不会出现负数
+    prev = __atomic_fetch_add(&ab->pendingBytes, len, __ATOMIC_RELAXED);
+    slot->rec = rec;
+    slot->len = len;
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+
+    if (prev == 0 || (prev < ab->flushBytes && prev + len >= ab->flushBytes))
+        wakeFlusher(ab, 0);
+    if (seq != NULL)
+        *seq = pos + 1;
+    return 0;
+}
+
+int
+abWait(struct appendBatch *ab, uint64_t seq)
+{
+    int ret = 0;
+
+    pthread_mutex_lock(&ab->mtx);
+    while (ab->flushedSeq < seq && ab->err == 0) {
+        if (ab->wantSeq < seq) {
+            ab->wantSeq = seq;
+            pthread_cond_signal(&ab->wake);
+        }
+        pthread_cond_wait(&ab->done, &ab->mtx);
+    }
+    if (ab->flushedSeq < seq) {
+        errno = ab->err;
+        ret = -1;
+    }
+    pthread_mutex_unlock(&ab->mtx);
+    return ret;
+}
+
+int
+abClose(struct appendBatch *ab)
+{
+    int ret;
+
+    pthread_mutex_lock(&ab->mtx);
+    ab->stop = 1;
+    pthread_cond_signal(&ab->wake);
+    pthread_mutex_unlock(&ab->mtx);
+    pthread_join(ab->flusher, NULL);
+
+    ret = (ab->err == 0) ? 0 : -1;
+    if (ret == -1)
+        errno = ab->err;
+    pthread_cond_destroy(&ab->wake);
+    pthread_cond_destroy(&ab->done);
+    pthread_mutex_destroy(&ab->mtx);
+    free(ab->ring);
+    return ret;
+}
@@ -0,0 +1,131 @@
+/**
+ * @file appendBatch.h
+ * @author Lock
+ * @date 16 Oct 2026
+ * @brief 把大量小记录的追加合并为 pwritev() 调用
+ *
+ * 每条记录调用一次 write() 时, 系统调用的开销远大于复制几十个字节;
+ * 先复制到暂存缓冲区再 write() 又多了一次复制.
+ * 这里只收集调用者的记录指针, 组成 iovec 数组, 每 @ref AB_IOV_MAX 条记录一次 pwritev():
+ *   - 记录按追加的顺序写在文件末尾, 每条记录有一个从 1 开始递增的序号.
+ *   - 刷新由后台线程完成, 触发条件为: 未刷新的字节数达到阈值,
+ *   第一条未刷新的记录等待超过了期限, 或者有线程在 abWait() 中等待.
+ *   - 使用 @ref AB_DSYNC 时, 用 pwritev2() 的 `RWF_DSYNC` 标志写入,
+ *   每批记录一次系统调用就完成持久化; 内核不支持时改为 pwritev() + fdatasync().
+ *
+ * # 多线程
+ * abAppend() 可以在多个线程中同时调用. 记录指针放入一个有界的无锁环形队列
+ * (每个槽位带一个序号, 生产者用 CAS 抢占位置), 只有在队列由空变为非空,
+ * 或者未刷新的字节数越过阈值时才会加锁唤醒后台线程.
+ * 队列满时, abAppend() 唤醒后台线程并让出 CPU, 直到有空位.
+ *
+ * @warning 记录的内存属于调用者, 在 abWait() 返回该记录已经写入之前不能修改或释放.
+ *
+ * @example appendBatchBench.c
+ */
+#ifndef APPEND_BATCH_H
+#define APPEND_BATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#define AB_IOV_MAX 1024                 //!< 每次 pwritev() 的最大记录数, 不超过 IOV_MAX
+#define AB_DEFAULT_QUEUE 8192           //!< 默认队列长度
+#define AB_DEFAULT_BYTES (256 * 1024)   //!< 默认的刷新阈值
+#define AB_DEFAULT_USEC 1000            //!< 默认的刷新期限
+
+#define AB_DSYNC 01                     //!< 每批记录写入后持久化
+
+/**
+ * @brief 队列中的一个槽位
+ */
+struct abSlot {
+    uint64_t seq;               //!< 等于位置 + 1 时槽位中有记录
+    const void *rec;
+    size_t len;
+};
+
+/**
+ * @brief 追加批处理器
+ */
+struct appendBatch {
+    int fd;
+    int flags;
+    off_t off;                  //!< 下一批记录写入的偏移量, 只由后台线程修改
+    size_t flushBytes;          //!< 刷新阈值
+    long flushUsec;             //!< 刷新期限
+
+    struct abSlot *ring;
+    uint64_t mask;              //!< 队列长度 - 1
+    uint64_t tail __attribute__((aligned(64)));     //!< 下一个生产者位置
+    uint64_t head __attribute__((aligned(64)));     //!< 后台线程下一个读取的位置
+    uint64_t pendingBytes __attribute__((aligned(64)));
+
+    pthread_mutex_t mtx;
+    pthread_cond_t wake;        //!< 唤醒后台线程
+    pthread_cond_t done;        //!< 一批记录写入完成
+    uint64_t flushedSeq;        //!< 序号不大于该值的记录都已写入
+    uint64_t wantSeq;           //!< abWait() 等待的最大序号
+    int err;                    //!< 写入失败时的 errno, 之后的操作都会失败
+    int stop;
+    int noPwritev2;             //!< 内核不支持 pwritev2() 的 RWF_DSYNC
+    pthread_t flusher;
+
+    uint64_t writes;            //!< 系统调用次数
+    uint64_t records;           //!< 写入的记录数
+};
+
+/**
+ * @brief 创建批处理器并启动后台线程, 记录追加到 @p fd 当前的文件末尾
+ *
+ * @param ab 批处理器
+ * @param fd 可写的文件描述符, 由调用者关闭
+ * @param flags 0 或 @ref AB_DSYNC
+ * @param flushBytes 未刷新的字节数达到该值时刷新, 为 0 时使用 @ref AB_DEFAULT_BYTES
+ * @param flushUsec 第一条未刷新的记录最多等待的微秒数, 为 0 时使用 @ref AB_DEFAULT_USEC
+ * @param queueSize 队列长度, 向上取整为 2 的幂, 为 0 时使用 @ref AB_DEFAULT_QUEUE
+ *
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+int
+abOpen(struct appendBatch *ab, int fd, int flags, size_t flushBytes, long flushUsec,
+        size_t queueSize);
+
+/**
+ * @brief 追加一条记录, 不等待写入
+ *
+ * @param ab 批处理器
+ * @param rec 记录, 写入之前必须保持有效
+ * @param len 记录长度
+ * @param seq 不为 NULL 时返回记录的序号
+ *
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+int
+abAppend(struct appendBatch *ab, const void *rec, size_t len, uint64_t *seq);
+
+/**
+ * @brief 立即刷新, 并等待序号不大于 @p seq 的记录全部写入
+ *
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+int
+abWait(struct appendBatch *ab, uint64_t seq);
+
+/**
+ * @brief 刷新所有已经追加的记录, 停止后台线程并释放资源
+ *
+ * @retval 0 成功
+ * @retval -1 有记录写入失败
+ */
+int
+abClose(struct appendBatch *ab);
+
+#endif
@@ -0,0 +1,214 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "appendBatch.h"
+#include "recordStore.h"
+
+/*
+ * 追加小记录的对比
+ *
+ * 若干线程共追加 n 条 60 字节的 itemRecord:
+ *   - 每条记录一次 write()(`O_APPEND`)
+ *   - 加锁复制到 64 KiB 暂存缓冲区, 满了再 write()
+ *   - abAppend()
+ * 持久化模式下每个线程逐条提交(等待每条记录落盘):
+ *   - write() + fdatasync()
+ *   - abAppend() + abWait(), 使用 AB_DSYNC
+ * 最后检查文件大小.
+ *
+ * 编译: gcc -O2 -pthread appendBatchBench.c appendBatch.c -o appendBatchBench
+ * 用法: appendBatchBench [-d dir] [-n records] [-s syncRecords] [-t maxThreads]
+ */
+
+#define STAGE_SIZE (64 * 1024)
+
+void errExit(char *msg)
+{
+    extern int errno;
+    perror(msg);
+    exit(errno);
+}
+
+static double
+nowSec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+enum mode { WRITE_EACH, STAGED, BATCH, SYNC_EACH, SYNC_BATCH };
+
+static const char *modeNames[] = {
+    "write() per record", "mutex + staging buffer", "abAppend",
+    "write + fdatasync", "abAppend + abWait, DSYNC"
+};
+
+struct worker {
+    pthread_t tid;
+    enum mode mode;
+    struct itemRecord *recs;
+    long n;
+};
+
+static char path[PATH_MAX];
+static int fd;
+static struct appendBatch ab;
+static pthread_mutex_t stageMtx = PTHREAD_MUTEX_INITIALIZER;
+static char stage[STAGE_SIZE];
+static size_t stageLen;
+
+static void
+stagedAppend(const void *rec, size_t len)
+{
+    pthread_mutex_lock(&stageMtx);
+    if (stageLen + len > STAGE_SIZE) {
+        if (write(fd, stage, stageLen) != (ssize_t)stageLen)
+            errExit("write");
+        stageLen = 0;
+    }
+    memcpy(stage + stageLen, rec, len);
+    stageLen += len;
+    pthread_mutex_unlock(&stageMtx);
+}
+
+static void *
+workerMain(void *arg)
+{
+    struct worker *w = arg;
+    uint64_t seq;
+    long j;
+
+    for (j = 0; j < w->n; j++) {
+        switch (w->mode) {
+        case WRITE_EACH:
+            if (write(fd, &w->recs[j], sizeof(struct itemRecord)) != sizeof(struct itemRecord))
+                errExit("write");
+            break;
+        case STAGED:
+            stagedAppend(&w->recs[j], sizeof(struct itemRecord));
+            break;
+        case BATCH:
+            if (abAppend(&ab, &w->recs[j], sizeof(struct itemRecord), NULL) == -1)
+                errExit("abAppend");
+            break;
+        case SYNC_EACH:
+            if (write(fd, &w->recs[j], sizeof(struct itemRecord)) != sizeof(struct itemRecord))
+                errExit("write");
+            if (fdatasync(fd) == -1)
+                errExit("fdatasync");
+            break;
+        case SYNC_BATCH:
+            if (abAppend(&ab, &w->recs[j], sizeof(struct itemRecord), &seq) == -1)
+                errExit("abAppend");
+            if (abWait(&ab, seq) == -1)
+                errExit("abWait");
+            break;
+        }
+    }
+    return NULL;
+}
+
+static void
+run(enum mode mode, int nthreads, long n, struct itemRecord *recs)
+{
+    struct worker w[64];
+    struct stat sb;
+    double start, elapsed;
+    int k;
+
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, S_IRUSR | S_IWUSR);
+    if (fd == -1)
+        errExit("open");
+    if ((mode == BATCH || mode == SYNC_BATCH) &&
+            abOpen(&ab, fd, (mode == SYNC_BATCH) ? AB_DSYNC : 0, 0, 0, 0) == -1)
+        errExit("abOpen");
+
+    start = nowSec();
+    for (k = 0; k < nthreads; k++) {
+        w[k].mode = mode;
+        w[k].n = n / nthreads;
+        w[k].recs = recs + k * (n / nthreads);
+        if ((errno = pthread_create(&w[k].tid, NULL, workerMain, &w[k])) != 0)
+            errExit("pthread_create");
+    }
+    for (k = 0; k < nthreads; k++)
+        pthread_join(w[k].tid, NULL);
+    if (mode == STAGED && stageLen > 0) {
+        if (write(fd, stage, stageLen) != (ssize_t)stageLen)
+            errExit("write");
+        stageLen = 0;
+    }
+    if ((mode == BATCH || mode == SYNC_BATCH) && abClose(&ab) == -1)
+        errExit("abClose");
+    elapsed = nowSec() - start;
+
+    if (fstat(fd, &sb) == -1)
+        errExit("fstat");
+    n = n / nthreads * nthreads;
+    printf("%-26s %2d thr %9.0f rec/s", modeNames[mode], nthreads, n / elapsed);
+    if (mode == BATCH || mode == SYNC_BATCH)
+        printf("  %6.1f rec/syscall", (double)ab.records / ab.writes);
+    if ((size_t)sb.st_size != n * sizeof(struct itemRecord))
+        printf("  SIZE MISMATCH");
+    printf("\n");
+    close(fd);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const char *dir = "/var/tmp";
+    long n = 2000000, nsync = 2000, j;
+    int maxThreads = 8, opt, t;
+    struct itemRecord *recs;
+
+    while ((opt = getopt(argc, argv, "d:n:s:t:")) != -1) {
+        switch (opt) {
+        case 'd': dir = optarg; break;
+        case 'n': n = atol(optarg); break;
+        case 's': nsync = atol(optarg); break;
+        case 't': maxThreads = atoi(optarg); break;
+        default:
+            fprintf(stderr, "Usage: %s [-d dir] [-n records] [-s syncRecords] [-t maxThreads]\n",
+                    argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (n <= 0 || nsync <= 0 || maxThreads < 1 || maxThreads > 64) {
+        fprintf(stderr, "records must be > 0, maxThreads in [1, 64]\n");
+        exit(EXIT_FAILURE);
+    }
+    snprintf(path, sizeof(path), "%s/appendBatch.dat", dir);
+
+    // 记录属于调用者, 在整个测试期间保持不变
+    if ((recs = calloc(n, sizeof(struct itemRecord))) == NULL)
+        errExit("calloc");
+    for (j = 0; j < n; j++) {
+        recs[j].count = j;
+        recs[j].total = j * 100;
+        snprintf(recs[j].name, RS_NAMESIZE, "item-%ld", j);
+    }
+
+    for (t = 1; t <= maxThreads; t *= 2) {
+        run(WRITE_EACH, t, n, recs);
+        run(STAGED, t, n, recs);
+        run(BATCH, t, n, recs);
+    }
+    for (t = 1; t <= maxThreads; t *= 2) {
+        run(SYNC_EACH, t, nsync, recs);
+        run(SYNC_BATCH, t, nsync, recs);
+    }
+
+    unlink(path);
+    free(recs);
+    exit(EXIT_SUCCESS);
+}
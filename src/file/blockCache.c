@@ -0,0 +1,418 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "blockCache.h"
+
+/* 队列 */
+#define L_FREE  0               // 空闲的缓存帧
+#define L_A1IN  1
+#define L_AM    2
+#define L_A1OUT 3
+#define L_GFREE 4               // 空闲的 A1out 节点
+
+static pthread_key_t scratchKey;
+static pthread_once_t scratchOnce = PTHREAD_ONCE_INIT;
+static __thread char *scratch;  // 线程私有的对齐读缓冲区
+
+void *
+bcAlloc(size_t size)
+{
+    void *p;
+
+    if ((errno = posix_memalign(&p, BC_ALIGN, size)) != 0)
+        return NULL;
+    return p;
+}
+
+void
+bcFree(void *p)
+{
+    free(p);
+}
+
+static void
+makeScratchKey(void)
+{
+    pthread_key_create(&scratchKey, bcFree);
+}
+
+static char *
+getScratch(void)
+{
+    if (scratch == NULL) {
+        pthread_once(&scratchOnce, makeScratchKey);
+        if ((scratch = bcAlloc((size_t)BC_READAHEAD * BC_BLOCK_SIZE)) == NULL)
+            return NULL;
+        pthread_setspecific(scratchKey, scratch);
+    }
+    return scratch;
+}
+
+/*
+ * 双向链表, 用节点下标表示, -1 表示空
+ */
+static void
+listRemove(struct bcShard *sh, int32_t i)
+{
+    struct bcNode *n = &sh->nodes[i];
+
+    if (n->prev != -1)
+        sh->nodes[n->prev].next = n->next;
+    else
+        sh->head[n->list] = n->next;
+    if (n->next != -1)
+        sh->nodes[n->next].prev = n->prev;
+    else
+        sh->tail[n->list] = n->prev;
+    sh->count[n->list]--;
+}
+
+static void
+listPush(struct bcShard *sh, int list, int32_t i)
+{
+    struct bcNode *n = &sh->nodes[i];
+
+    n->list = list;
+    n->prev = -1;
+    n->next = sh->head[list];
+    if (n->next != -1)
+        sh->nodes[n->next].prev = i;
+    else
+        sh->tail[list] = i;
+    sh->head[list] = i;
+    sh->count[list]++;
+}
+
+static int32_t
+listPopTail(struct bcShard *sh, int list)
+{
+    int32_t i = sh->tail[list];
+
+    if (i != -1)
+        listRemove(sh, i);
+    return i;
+}
+
+/*
+ * 哈希表: 块号到节点下标, 同时包含缓存帧和 A1out 节点
+ */
+static inline uint32_t
+bucketOf(const struct bcShard *sh, uint64_t block)
+{
+    return (uint32_t)((block * 0x9e3779b97f4a7c15ULL) >> 32) & (sh->nbuckets - 1);
+}
+
+static int32_t
+hashFind(const struct bcShard *sh, uint64_t block)
+{
+    int32_t i;
+
+    for (i = sh->buckets[bucketOf(sh, block)]; i != -1; i = sh->nodes[i].hnext)
+        if (sh->nodes[i].block == block)
+            return i;
+    return -1;
+}
+
+static void
+hashInsert(struct bcShard *sh, int32_t i)
+{
+    uint32_t b = bucketOf(sh, sh->nodes[i].block);
+
+    sh->nodes[i].hnext = sh->buckets[b];
+    sh->buckets[b] = i;
+}
+
+static void
+hashRemove(struct bcShard *sh, int32_t i)
+{
+    int32_t *p = &sh->buckets[bucketOf(sh, sh->nodes[i].block)];
+
+    while (*p != i)
+        p = &sh->nodes[*p].hnext;
+    *p = sh->nodes[i].hnext;
+}
+
+/* 记住从 A1in 淘汰的块号 */
+static void
+addGhost(struct bcShard *sh, uint64_t block)
+{
+    int32_t g;
+
+    if ((g = listPopTail(sh, L_GFREE)) == -1) {
+        g = listPopTail(sh, L_A1OUT);
+        hashRemove(sh, g);
+    }
+    sh->nodes[g].block = block;
+    hashInsert(sh, g);
+    listPush(sh, L_A1OUT, g);
+}
+
+/* 取得一个空闲的缓存帧, 必要时按 2Q 淘汰 */
+static int32_t
+reclaim(struct bcShard *sh)
+{
+    int32_t f;
+
+    if ((f = listPopTail(sh, L_FREE)) != -1)
+        return f;
+
+    if (sh->count[L_A1IN] > sh->kin || sh->count[L_AM] == 0) {
+        f = listPopTail(sh, L_A1IN);
+        hashRemove(sh, f);
+        addGhost(sh, sh->nodes[f].block);
+    } else {
+        f = listPopTail(sh, L_AM);
+        hashRemove(sh, f);
+    }
+    return f;
+}
+
+/* 命中时复制数据并返回复制的字节数, 未命中时返回 -1. 调用时持有锁 */
+static ssize_t
+lookupLocked(struct bcShard *sh, uint64_t block, size_t boff, char *dst, size_t len)
+{
+    struct bcNode *n;
+    int32_t i;
+
+    i = hashFind(sh, block);
+    if (i == -1 || sh->nodes[i].list == L_A1OUT) {
+        sh->misses++;
+        return -1;
+    }
+
+    n = &sh->nodes[i];
+    if (n->list == L_AM) {
+        listRemove(sh, i);
+        listPush(sh, L_AM, i);
+    }
+    sh->hits++;
+
+    if (boff >= n->len)
+        return 0;
+    if (len > n->len - boff)
+        len = n->len - boff;
+    memcpy(dst, sh->data + (size_t)i * BC_BLOCK_SIZE + boff, len);
+    return len;
+}
+
+/* 把读入的块放入缓存. 调用时持有锁 */
+static void
+insertLocked(struct bcShard *sh, uint64_t block, const char *src, size_t len)
+{
+    int32_t i = hashFind(sh, block), f;
+    int ghost = 0;
+
+    if (i != -1) {
+        if (sh->nodes[i].list != L_A1OUT)
+            return;             // 其他线程已经读入
+        hashRemove(sh, i);
+        listRemove(sh, i);
+        listPush(sh, L_GFREE, i);
+        ghost = 1;
+    }
+
+    f = reclaim(sh);
+    memcpy(sh->data + (size_t)f * BC_BLOCK_SIZE, src, len);
+    sh->nodes[f].block = block;
+    sh->nodes[f].len = len;
+    hashInsert(sh, f);
+    listPush(sh, ghost ? L_AM : L_A1IN, f);
+}
+
+static inline struct bcShard *
+shardOf(struct blockCache *bc, uint64_t block)
+{
+    return &bc->shards[block % BC_SHARDS];
+}
+
+int
+bcInit(struct blockCache *bc, int fd, size_t cacheBytes)
+{
+    struct bcShard *sh;
+    uint32_t nframes, nghosts, j;
+    int s, l;
+
+    memset(bc, 0, sizeof(struct blockCache));
+    bc->fd = fd;
+    bc->lastBlock = UINT64_MAX - 1;
+
+    nframes = cacheBytes / BC_BLOCK_SIZE / BC_SHARDS;
+    if (nframes < 4)
+        nframes = 4;
+    nghosts = nframes / 2;
+
+    bc->framesSize = (size_t)nframes * BC_SHARDS * BC_BLOCK_SIZE;
+    bc->frames = mmap(NULL, bc->framesSize, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (bc->frames == MAP_FAILED)
+        return -1;
+
+    for (s = 0; s < BC_SHARDS; s++) {
+        sh = &bc->shards[s];
+        pthread_mutex_init(&sh->mtx, NULL);
+        sh->nframes = nframes;
+        sh->nghosts = nghosts;
+        sh->kin = nframes / 4 > 0 ? nframes / 4 : 1;
+        sh->data = bc->frames + (size_t)s * nframes * BC_BLOCK_SIZE;
+        for (sh->nbuckets = 1; sh->nbuckets < nframes + nghosts; sh->nbuckets <<= 1)
+            ;
+        sh->nodes = calloc(nframes + nghosts, sizeof(struct bcNode));
+        sh->buckets = malloc(sh->nbuckets * sizeof(int32_t));
+        if (sh->nodes == NULL || sh->buckets == NULL) {
+            bcDestroy(bc);
+            errno = ENOMEM;
+            return -1;
+        }
+        memset(sh->buckets, 0xff, sh->nbuckets * sizeof(int32_t));
+        for (l = 0; l < 5; l++)
+            sh->head[l] = sh->tail[l] = -1;
+        for (j = 0; j < nframes; j++)
+            listPush(sh, L_FREE, j);
+        for (j = nframes; j < nframes + nghosts; j++)
+            listPush(sh, L_GFREE, j);
+    }
+    return 0;
+}
+
+/*
+ * 未命中: 不持有锁读入一个块, 顺序访问时读入 BC_READAHEAD 个块, 然后逐块放入缓存.
+ * 返回从块 block 的 boff 处复制到 dst 的字节数.
+ */
+static ssize_t
+fill(struct blockCache *bc, uint64_t block, size_t boff, char *dst, size_t len)
+{
+    struct bcShard *sh;
+    size_t nblocks = 1, k, n;
+    char *buf;
+    ssize_t r;
+
+    if ((buf = getScratch()) == NULL)
+        return -1;
+
+    if (__atomic_load_n(&bc->seqRun, __ATOMIC_RELAXED) >= BC_SEQ_THRESHOLD &&
+            block == __atomic_load_n(&bc->lastBlock, __ATOMIC_RELAXED) + 1) {
+        nblocks = BC_READAHEAD;
+        __atomic_fetch_add(&bc->readaheads, 1, __ATOMIC_RELAXED);
+    }
+
+    while ((r = pread(bc->fd, buf, nblocks * BC_BLOCK_SIZE, block * BC_BLOCK_SIZE)) == -1 &&
+            errno == EINTR)
+        ;
+    if (r == -1)
+        return -1;
+
+    for (k = 0; k * BC_BLOCK_SIZE < (size_t)r; k++) {
+        n = r - k * BC_BLOCK_SIZE;
+        sh = shardOf(bc, block + k);
+        pthread_mutex_lock(&sh->mtx);
+        insertLocked(sh, block + k, buf + k * BC_BLOCK_SIZE, n < BC_BLOCK_SIZE ? n : BC_BLOCK_SIZE);
+        pthread_mutex_unlock(&sh->mtx);
+    }
+
+    if ((size_t)r <= boff)
+        return 0;
+    if (len > r - boff)
+        len = r - boff;
+    if (len > BC_BLOCK_SIZE - boff)
+        len = BC_BLOCK_SIZE - boff;
+    memcpy(dst, buf + boff, len);
+    return len;
+}
+
+/* 记录访问的块, 连续访问相邻块的次数保存在 seqRun 中. 多线程时只是近似值 */
+static inline void
+noteAccess(struct blockCache *bc, uint64_t block)
+{
+    uint64_t last = __atomic_load_n(&bc->lastBlock, __ATOMIC_RELAXED);
+
+    if (block == last)
+        return;
+    if (block == last + 1)
+        __atomic_store_n(&bc->seqRun, bc->seqRun + 1, __ATOMIC_RELAXED);
+    else
+        __atomic_store_n(&bc->seqRun, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&bc->lastBlock, block, __ATOMIC_RELAXED);
+}
+
+ssize_t
+bcPread(struct blockCache *bc, void *buf, size_t len, uint64_t off)
+{
+    struct bcShard *sh;
+    uint64_t block;
+    size_t done = 0, boff, want;
+    ssize_t n;
+
+    while (done < len) {
+        block = (off + done) / BC_BLOCK_SIZE;
+        boff = (off + done) % BC_BLOCK_SIZE;
+        want = len - done < BC_BLOCK_SIZE - boff ? len - done : BC_BLOCK_SIZE - boff;
+
+        sh = shardOf(bc, block);
+        pthread_mutex_lock(&sh->mtx);
+        n = lookupLocked(sh, block, boff, (char *)buf + done, want);
+        pthread_mutex_unlock(&sh->mtx);
+
+        if (n == -1 && (n = fill(bc, block, boff, (char *)buf + done, want)) == -1)
+            return done > 0 ? (ssize_t)done : -1;
+        noteAccess(bc, block);
+
+        done += n;
+        if ((size_t)n < want)   // 文件末尾
+            break;
+    }
+    return done;
+}
+
+void
+bcInvalidate(struct blockCache *bc, uint64_t off, size_t len)
+{
+    struct bcShard *sh;
+    uint64_t block;
+    int32_t i;
+
+    if (len == 0)
+        return;
+    for (block = off / BC_BLOCK_SIZE; block <= (off + len - 1) / BC_BLOCK_SIZE; block++) {
+        sh = shardOf(bc, block);
+        pthread_mutex_lock(&sh->mtx);
+        i = hashFind(sh, block);
+        if (i != -1 && sh->nodes[i].list != L_A1OUT) {
+            hashRemove(sh, i);
+            listRemove(sh, i);
+            listPush(sh, L_FREE, i);
+        }
+        pthread_mutex_unlock(&sh->mtx);
+    }
+}
+
+void
+bcGetStats(struct blockCache *bc, struct bcStats *st)
+{
+    int s;
+
+    memset(st, 0, sizeof(struct bcStats));
+    for (s = 0; s < BC_SHARDS; s++) {
+        pthread_mutex_lock(&bc->shards[s].mtx);
+        st->hits += bc->shards[s].hits;
+        st->misses += bc->shards[s].misses;
+        pthread_mutex_unlock(&bc->shards[s].mtx);
+    }
+    st->readaheads = __atomic_load_n(&bc->readaheads, __ATOMIC_RELAXED);
+}
+
+void
+bcDestroy(struct blockCache *bc)
+{
+    int s;
+
+    for (s = 0; s < BC_SHARDS; s++) {
+        free(bc->shards[s].nodes);
+        free(bc->shards[s].buckets);
+        pthread_mutex_destroy(&bc->shards[s].mtx);
+    }
+    munmap(bc->frames, bc->framesSize);
+}
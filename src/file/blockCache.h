@@ -0,0 +1,140 @@
+/**
+ * @file blockCache.h
+ * @author Lock
+ * @date 16 Oct 2026
+ * @brief 用户空间块缓存, 用于 O_DIRECT 读取
+ *
+ * 普通读写经过内核页缓存: 数据在页缓存和用户缓冲区中各有一份,
+ * 扫描一个大文件会把页缓存中的热点数据挤出去. 使用 `O_DIRECT` 打开文件时,
+ * 读写直接在用户缓冲区和设备之间进行, 缓存策略完全由应用程序决定.
+ *
+ * `O_DIRECT` 要求缓冲区地址, 文件偏移量和长度都按逻辑块大小对齐,
+ * bcAlloc() 按 @ref BC_ALIGN 分配内存. 缓存帧全部来自一次 mmap(), 天然按页对齐.
+ *
+ * 缓存按块号分成若干个分片, 每个分片有自己的锁, 使用 2Q 替换算法:
+ *   - A1in: 先进先出队列, 第一次访问的块放在这里, 占容量的 1/4.
+ *   再次访问不改变位置, 只被访问一次的块(例如扫描)很快被淘汰, 不会污染 Am.
+ *   - A1out: 只记录从 A1in 淘汰的块号, 不占缓存帧, 个数为容量的 1/2.
+ *   - Am: LRU 队列. 在 A1out 中的块再次被访问时说明它是热点, 加载后放入 Am.
+ *
+ * 未命中时, 在不持有锁的情况下读入线程私有的对齐缓冲区, 再复制到缓存帧中.
+ * 检测到顺序访问时(连续访问了 @ref BC_SEQ_THRESHOLD 个相邻的块), 一次读取 @ref BC_READAHEAD 个块.
+ *
+ * @example blockCacheBench.c
+ */
+#ifndef BLOCK_CACHE_H
+#define BLOCK_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#define BC_ALIGN 4096
+#define BC_BLOCK_SIZE 4096      //!< 缓存块大小
+#define BC_SHARDS 16
+#define BC_READAHEAD 32         //!< 顺序读时一次读取的块数
+#define BC_SEQ_THRESHOLD 2      //!< 连续访问多少个相邻块之后开始预读
+
+/**
+ * @brief 缓存帧或 A1out 中的块号
+ */
+struct bcNode {
+    uint64_t block;
+    int32_t prev, next;         //!< 所在队列中的前后节点
+    int32_t hnext;              //!< 哈希链
+    uint32_t len;               //!< 帧中有效数据的长度, 文件末尾的块可能不满
+    uint8_t list;
+};
+
+/**
+ * @brief 分片
+ */
+struct bcShard {
+    pthread_mutex_t mtx;
+    struct bcNode *nodes;       //!< 前 nframes 个是缓存帧, 后 nghosts 个是 A1out 节点
+    char *data;                 //!< 缓存帧数据
+    int32_t *buckets;
+    uint32_t nbuckets;
+    uint32_t nframes, nghosts;
+    uint32_t kin;               //!< A1in 的目标长度
+    int32_t head[5], tail[5];   //!< 各队列的头尾
+    uint32_t count[5];          //!< 各队列的长度
+    uint64_t hits, misses;
+};
+
+/**
+ * @brief 块缓存
+ */
+struct blockCache {
+    int fd;
+    struct bcShard shards[BC_SHARDS];
+    char *frames;               //!< 所有缓存帧
+    size_t framesSize;
+    uint64_t lastBlock;         //!< 上一次访问的块, 用于检测顺序访问
+    uint64_t seqRun;            //!< 连续访问相邻块的次数
+    uint64_t readaheads;
+};
+
+/**
+ * @brief 统计
+ */
+struct bcStats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t readaheads;        //!< 预读的次数
+};
+
+/**
+ * @brief 分配按 @ref BC_ALIGN 对齐的内存, 失败时返回 NULL
+ */
+void *
+bcAlloc(size_t size);
+
+/**
+ * @brief 释放 bcAlloc() 分配的内存
+ */
+void
+bcFree(void *p);
+
+/**
+ * @brief 创建块缓存
+ *
+ * @param bc 缓存
+ * @param fd 文件描述符, 可以使用 `O_DIRECT` 打开
+ * @param cacheBytes 缓存大小
+ *
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+int
+bcInit(struct blockCache *bc, int fd, size_t cacheBytes);
+
+/**
+ * @brief 经过缓存读取, 语义与 pread() 相同, 对 @p buf 没有对齐要求
+ *
+ * @return 返回读取到的字节数, 到达文件末尾时可能少于 @p len
+ * @retval -1 失败
+ */
+ssize_t
+bcPread(struct blockCache *bc, void *buf, size_t len, uint64_t off);
+
+/**
+ * @brief 使 [off, off + len) 所在的块失效, 写入文件后调用
+ */
+void
+bcInvalidate(struct blockCache *bc, uint64_t off, size_t len);
+
+/**
+ * @brief 获取统计信息
+ */
+void
+bcGetStats(struct blockCache *bc, struct bcStats *st);
+
+/**
+ * @brief 销毁块缓存, 不关闭文件描述符
+ */
+void
+bcDestroy(struct blockCache *bc);
+
+#endif
@@ -0,0 +1,181 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <math.h>
+#include <time.h>
+#include "recordStore.h"
+#include "recordReader.h"
+
+/*
+ * 偏斜负载下的 O_DIRECT + 块缓存与页缓存对比
+ *
+ * 生成一个记录文件, 按 Zipf 分布(s = 0.99)随机读取记录, 中间插入一次全表扫描,
+ * 扫描之后再做一轮随机读, 观察扫描是否把热点数据挤出缓存.
+ * 分别测试普通 pread()(页缓存)和 O_DIRECT + 2Q 块缓存, 每种方式开始前都把文件逐出页缓存.
+ *
+ * 编译: gcc -O2 -pthread blockCacheBench.c recordReader.c blockCache.c ioHint.c recordStore.c -lm -o blockCacheBench
+ * 用法: blockCacheBench [-n records] [-c cacheMiB] [-o ops]
+ */
+
+#define PATH "/tmp/bc.rec"
+#define ZIPF_S 0.99
+
+static double *cdf;
+static uint64_t nrec;
+
+void errExit(char *msg)
+{
+    extern int errno;
+    perror(msg);
+    exit(errno);
+}
+
+static double
+nowSec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t
+xorshift(uint64_t *s)
+{
+    *s ^= *s << 13;
+    *s ^= *s >> 7;
+    *s ^= *s << 17;
+    return *s;
+}
+
+/* 按 Zipf 分布取一个排名, 再打散到整个文件 */
+static uint64_t
+zipf(uint64_t *seed)
+{
+    double u = (xorshift(seed) >> 11) * (1.0 / 9007199254740992.0);
+    uint64_t lo = 0, hi = nrec - 1, mid;
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (cdf[mid] < u)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return (lo * 0x9e3779b97f4a7c15ULL) % nrec;
+}
+
+static void
+dropCache(void)
+{
+    int fd;
+
+    if ((fd = open(PATH, O_RDONLY)) == -1)
+        errExit("open");
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
+
+static void
+phase(struct recordReader *rr, const char *mode, const char *name, uint64_t ops, int scan)
+{
+    struct itemRecord rec;
+    struct bcStats before, after;
+    uint64_t j, seed = 0x2545f4914f6cdd1dULL, sum = 0;
+    double start, elapsed;
+
+    if (rr->cache != NULL)
+        bcGetStats(rr->cache, &before);
+
+    start = nowSec();
+    for (j = 0; j < ops; j++) {
+        if (rrGet(rr, scan ? j : zipf(&seed), &rec) == -1)
+            errExit("rrGet");
+        sum += rec.total;
+    }
+    elapsed = nowSec() - start;
+
+    printf("%-14s %-8s %10.0f rec/s", mode, name, ops / elapsed);
+    if (rr->cache != NULL) {
+        bcGetStats(rr->cache, &after);
+        printf("  hit %5.1f%%  readahead %llu",
+                100.0 * (after.hits - before.hits) /
+                (after.hits - before.hits + after.misses - before.misses),
+                (unsigned long long)(after.readaheads - before.readaheads));
+    }
+    printf("  (%llu)\n", (unsigned long long)(sum & 0xff));
+    fflush(stdout);
+}
+
+int
+main(int argc, char *argv[])
+{
+    struct recordStore rs;
+    struct recordReader rr;
+    struct itemRecord rec;
+    uint64_t ops = 2000000, j;
+    size_t cacheBytes = 32;
+    double h = 0;
+    int ch, m;
+
+    nrec = 4000000;
+    while ((ch = getopt(argc, argv, "n:c:o:")) != -1) {
+        switch (ch) {
+        case 'n': nrec = strtoull(optarg, NULL, 10); break;
+        case 'c': cacheBytes = strtoul(optarg, NULL, 10); break;
+        case 'o': ops = strtoull(optarg, NULL, 10); break;
+        default:
+            fprintf(stderr, "Usage: %s [-n records] [-c cacheMiB] [-o ops]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (nrec == 0 || cacheBytes == 0) {
+        fprintf(stderr, "bad arguments\n");
+        exit(EXIT_FAILURE);
+    }
+    cacheBytes <<= 20;
+
+    unlink(PATH);
+    if (rsOpen(&rs, PATH, RS_CREATE) == -1)
+        errExit("rsOpen");
+    memset(&rec, 0, sizeof(rec));
+    for (j = 0; j < nrec; j++) {
+        rec.total = j;
+        snprintf(rec.name, RS_NAMESIZE, "item-%llu", (unsigned long long)j);
+        if (rsAppend(&rs, &rec) == -1)
+            errExit("rsAppend");
+    }
+    if (rsClose(&rs) == -1)
+        errExit("rsClose");
+
+    if ((cdf = malloc(nrec * sizeof(double))) == NULL)
+        errExit("malloc");
+    for (j = 0; j < nrec; j++)
+        cdf[j] = (h += 1.0 / pow(j + 1, ZIPF_S));
+    for (j = 0; j < nrec; j++)
+        cdf[j] /= h;
+
+    printf("%llu records (%.0f MiB), cache %zu MiB\n", (unsigned long long)nrec,
+            nrec * sizeof(struct itemRecord) / 1048576.0, cacheBytes >> 20);
+
+    for (m = 0; m < 2; m++) {
+        dropCache();
+        if (rrOpen(&rr, PATH, cacheBytes, m ? RR_DIRECT : 0) == -1)
+            errExit("rrOpen");
+        const char *mode = m ? (rr.direct ? "O_DIRECT+2Q" : "2Q (no O_DIRECT)") : "page cache";
+
+        phase(&rr, mode, "zipf", ops, 0);
+        phase(&rr, mode, "scan", nrec, 1);
+        phase(&rr, mode, "zipf", ops, 0);
+        rrClose(&rr);
+    }
+
+    free(cdf);
+    unlink(PATH);
+    exit(EXIT_SUCCESS);
+}
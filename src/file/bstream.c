@@ -0,0 +1,228 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include "bstream.h"
+
+int
+bsOpen(struct bstream *bs, int fd, int mode, char *buf, size_t size)
+{
+    memset(bs, 0, sizeof(struct bstream));
+    if (mode != BS_READ && mode != BS_WRITE) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (size == 0)
+        size = BS_DEFAULT_SIZE;
+    if (buf == NULL) {
+        if ((buf = malloc(size)) == NULL)
+            return -1;
+        bs->ownBuf = 1;
+    }
+    bs->fd = fd;
+    bs->mode = mode;
+    bs->buf = buf;
+    bs->size = size;
+    bs->owner = pthread_self();
+    bs->owned = 1;
+    return 0;
+}
+
+int
+bsAcquire(struct bstream *bs)
+{
+    int expected = 0;
+
+    if (!__atomic_compare_exchange_n(&bs->owned, &expected, 1, 0,
+                __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        errno = EBUSY;
+        return -1;
+    }
+    bs->owner = pthread_self();
+    return 0;
+}
+
+void
+bsRelease(struct bstream *bs)
+{
+    BS_ASSERT_OWNER(bs);
+    // 之前对流的修改对下一个所有者可见
+    __atomic_store_n(&bs->owned, 0, __ATOMIC_RELEASE);
+}
+
+/* 写出 iov 中的全部数据, 处理部分写入 */
+static int
+writeAll(struct bstream *bs, struct iovec *iov, int iovcnt)
+{
+    ssize_t n;
+
+    while (iovcnt > 0) {
+        bs->syscalls++;
+        if ((n = writev(bs->fd, iov, iovcnt)) == -1) {
+            if (errno == EINTR)
+                continue;
+            bs->err = errno;
+            return -1;
+        }
+        while (iovcnt > 0 && (size_t)n >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return 0;
+}
+
+int
+bsFlush(struct bstream *bs)
+{
+    struct iovec iov;
+
+    BS_ASSERT_OWNER(bs);
+    if (bs->err != 0) {
+        errno = bs->err;
+        return -1;
+    }
+    if (bs->mode != BS_WRITE || bs->pos == 0)
+        return 0;
+
+    iov.iov_base = bs->buf;
+    iov.iov_len = bs->pos;
+    bs->pos = 0;
+    return writeAll(bs, &iov, 1);
+}
+
+int
+bsPutBytes(struct bstream *bs, const void *p, size_t n)
+{
+    struct iovec iov[2];
+    size_t room;
+
+    BS_ASSERT_OWNER(bs);
+    if (bs->err != 0) {
+        errno = bs->err;
+        return -1;
+    }
+
+    if (n <= bs->size - bs->pos) {
+        memcpy(bs->buf + bs->pos, p, n);
+        bs->pos += n;
+        return 0;
+    }
+
+    // 大块数据: 缓冲区中的数据和新数据一起写出
+    if (n >= bs->size) {
+        iov[0].iov_base = bs->buf;
+        iov[0].iov_len = bs->pos;
+        iov[1].iov_base = (void *)p;
+        iov[1].iov_len = n;
+        bs->pos = 0;
+        return iov[0].iov_len > 0 ? writeAll(bs, iov, 2) : writeAll(bs, iov + 1, 1);
+    }
+
+    // 填满缓冲区, 写出, 剩余部分放入缓冲区
+    room = bs->size - bs->pos;
+    memcpy(bs->buf + bs->pos, p, room);
+    bs->pos = bs->size;
+    if (bsFlush(bs) == -1)
+        return -1;
+    memcpy(bs->buf, (const char *)p + room, n - room);
+    bs->pos = n - room;
+    return 0;
+}
+
+/* 调用一次 read(), 返回读取到的字节数 */
+static ssize_t
+readOnce(struct bstream *bs, void *p, size_t n)
+{
+    ssize_t r;
+
+    do {
+        bs->syscalls++;
+        r = read(bs->fd, p, n);
+    } while (r == -1 && errno == EINTR);
+
+    if (r == -1)
+        bs->err = errno;
+    else if (r == 0)
+        bs->eof = 1;
+    return r;
+}
+
+int
+bsFill(struct bstream *bs)
+{
+    ssize_t r;
+
+    BS_ASSERT_OWNER(bs);
+    if (bs->pos < bs->len)
+        return (unsigned char)bs->buf[bs->pos++];
+    if (bs->err != 0 || bs->eof)
+        return -1;
+
+    if ((r = readOnce(bs, bs->buf, bs->size)) <= 0)
+        return -1;
+    bs->len = r;
+    bs->pos = 1;
+    return (unsigned char)bs->buf[0];
+}
+
+ssize_t
+bsGetBytes(struct bstream *bs, void *p, size_t n)
+{
+    char *dst = p;
+    size_t done = 0, avail;
+    ssize_t r;
+
+    BS_ASSERT_OWNER(bs);
+    while (done < n) {
+        avail = bs->len - bs->pos;
+        if (avail > 0) {
+            if (avail > n - done)
+                avail = n - done;
+            memcpy(dst + done, bs->buf + bs->pos, avail);
+            bs->pos += avail;
+            done += avail;
+            continue;
+        }
+        if (bs->err != 0 || bs->eof)
+            break;
+
+        // 剩余部分不小于缓冲区时直接读入调用者的缓冲区
+        if (n - done >= bs->size) {
+            if ((r = readOnce(bs, dst + done, n - done)) <= 0)
+                break;
+            done += r;
+        } else {
+            if ((r = readOnce(bs, bs->buf, bs->size)) <= 0)
+                break;
+            bs->pos = 0;
+            bs->len = r;
+        }
+    }
+
+    if (done == 0 && bs->err != 0) {
+        errno = bs->err;
+        return -1;
+    }
+    return done;
+}
+
+int
+bsClose(struct bstream *bs)
+{
+    int ret = 0;
+
+    if (bs->mode == BS_WRITE)
+        ret = bsFlush(bs);
+    if (bs->ownBuf)
+        free(bs->buf);
+    bs->buf = NULL;
+    return ret;
+}
@@ -0,0 +1,162 @@
+/**
+ * @file bstream.h
+ * @author Lock
+ * @date 16 Oct 2026
+ * @brief 不加锁的缓冲流, 用于替换热点路径上的 stdio
+ *
+ * stdio 的每个函数(fwrite(), putc(), printf() ...)都要对 FILE 加锁,
+ * 写入很多条小记录时, 加锁解锁的开销比复制数据还大. 缓冲区大小默认为 BUFSIZ,
+ * 大块写入也要先复制到缓冲区.
+ *
+ * bstream 是一个最简单的缓冲流:
+ *   - 不加锁. 一个流同一时间只属于一个线程, 通过 bsAcquire()/bsRelease()
+ *   显式转移所有权, 定义了 `BS_CHECK_OWNER` 时每次操作都检查调用者是否是所有者.
+ *   - 缓冲区由调用者提供或指定大小.
+ *   - bsPutc()/bsGetc() 是内联函数, 缓冲区有空间(数据)时不调用任何函数.
+ *   - 写入不小于缓冲区大小的数据时, 用一次 writev() 同时写出缓冲区中已有的数据和新数据,
+ *   不经过缓冲区; 读取大块数据时直接读入调用者的缓冲区.
+ *
+ * @example bstreamBench.c
+ */
+#ifndef BSTREAM_H
+#define BSTREAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#define BS_READ  1
+#define BS_WRITE 2
+
+#define BS_DEFAULT_SIZE (256 * 1024)
+
+/**
+ * @brief 缓冲流
+ */
+struct bstream {
+    int fd;
+    int mode;                   //!< @ref BS_READ 或 @ref BS_WRITE
+    char *buf;
+    size_t size;                //!< 缓冲区大小
+    size_t pos;                 //!< 写: 缓冲区中的字节数; 读: 下一个要返回的字节
+    size_t len;                 //!< 读: 缓冲区中有效的字节数
+    int ownBuf;                 //!< 缓冲区是否由 bsOpen() 分配
+    int err;                    //!< 出错时的 errno
+    int eof;
+    pthread_t owner;            //!< 所有者线程
+    int owned;
+    uint64_t syscalls;          //!< read()/write()/writev() 调用次数
+};
+
+#ifdef BS_CHECK_OWNER
+#include <assert.h>
+#define BS_ASSERT_OWNER(bs) assert((bs)->owned && pthread_equal((bs)->owner, pthread_self()))
+#else
+#define BS_ASSERT_OWNER(bs) ((void)0)
+#endif
+
+/**
+ * @brief 在文件描述符上创建流, 调用线程成为所有者
+ *
+ * @param bs 流
+ * @param fd 文件描述符
+ * @param mode @ref BS_READ 或 @ref BS_WRITE
+ * @param buf 缓冲区, 为 NULL 时分配一个
+ * @param size 缓冲区大小, 为 0 时使用 @ref BS_DEFAULT_SIZE
+ *
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+int
+bsOpen(struct bstream *bs, int fd, int mode, char *buf, size_t size);
+
+/**
+ * @brief 调用线程成为流的所有者
+ *
+ * @retval 0 成功
+ * @retval -1 流属于其他线程, errno 为 `EBUSY`
+ */
+int
+bsAcquire(struct bstream *bs);
+
+/**
+ * @brief 放弃所有权, 之后其他线程可以调用 bsAcquire()
+ */
+void
+bsRelease(struct bstream *bs);
+
+/**
+ * @brief 写入 @p n 个字节
+ *
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+int
+bsPutBytes(struct bstream *bs, const void *p, size_t n);
+
+/**
+ * @brief 读取最多 @p n 个字节, 只有到达文件末尾时才会少于 @p n
+ *
+ * @return 返回读取到的字节数, 0 表示文件末尾
+ * @retval -1 失败
+ */
+ssize_t
+bsGetBytes(struct bstream *bs, void *p, size_t n);
+
+/**
+ * @brief 把缓冲区写出, 供 bsPutc() 使用, 也可以直接调用
+ *
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+int
+bsFlush(struct bstream *bs);
+
+/**
+ * @brief 重新填充读缓冲区, 供 bsGetc() 使用
+ *
+ * @return 返回下一个字节
+ * @retval -1 文件末尾或出错
+ */
+int
+bsFill(struct bstream *bs);
+
+/**
+ * @brief 写出缓冲区并释放资源, 不关闭文件描述符
+ */
+int
+bsClose(struct bstream *bs);
+
+/**
+ * @brief 写入一个字节
+ *
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+static inline int
+bsPutc(struct bstream *bs, int c)
+{
+    BS_ASSERT_OWNER(bs);
+    if (bs->pos == bs->size && bsFlush(bs) == -1)
+        return -1;
+    bs->buf[bs->pos++] = (char)c;
+    return 0;
+}
+
+/**
+ * @brief 读取一个字节
+ *
+ * @return 返回读取到的字节
+ * @retval -1 文件末尾或出错
+ */
+static inline int
+bsGetc(struct bstream *bs)
+{
+    BS_ASSERT_OWNER(bs);
+    if (bs->pos < bs->len)
+        return (unsigned char)bs->buf[bs->pos++];
+    return bsFill(bs);
+}
+
+#endif
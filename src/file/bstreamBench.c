@@ -0,0 +1,196 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include "bstream.h"
+#include "recordStore.h"
+
+/*
+ * bstream 与 stdio 写入小记录的对比
+ *
+ * 把 n 条 60 字节的 itemRecord 写入文件:
+ *   - fwrite(), 每次调用加锁
+ *   - fwrite_unlocked()
+ *   - fwrite() + setvbuf() 使用与 bstream 相同大小的缓冲区
+ *   - bsPutBytes()
+ *   - 逐字节 putc() 与 bsPutc()
+ * 然后用 fread() 和 bsGetBytes() 读回.
+ *
+ * 编译: gcc -O2 -pthread bstreamBench.c bstream.c -o bstreamBench
+ * 用法: bstreamBench [records]
+ */
+
+#define PATH "/tmp/bstream.dat"
+
+void errExit(char *msg)
+{
+    extern int errno;
+    perror(msg);
+    exit(errno);
+}
+
+static double
+nowSec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+report(const char *name, double elapsed, uint64_t n)
+{
+    printf("%-28s %8.2f ns/rec %8.0f MB/s\n", name, elapsed * 1e9 / n,
+            n * sizeof(struct itemRecord) / elapsed / 1e6);
+}
+
+static FILE *
+openStdio(const char *mode, char *buf, size_t size)
+{
+    FILE *fp;
+
+    if ((fp = fopen(PATH, mode)) == NULL)
+        errExit("fopen");
+    if (buf != NULL && setvbuf(fp, buf, _IOFBF, size) != 0)
+        errExit("setvbuf");
+    return fp;
+}
+
+static int
+openFd(int write)
+{
+    int fd;
+
+    fd = write ? open(PATH, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR)
+        : open(PATH, O_RDONLY);
+    if (fd == -1)
+        errExit("open");
+    return fd;
+}
+
+int
+main(int argc, char *argv[])
+{
+    struct itemRecord *recs, rec;
+    struct bstream bs;
+    const char *p;
+    uint64_t n, j, sum;
+    size_t k;
+    char *vbuf;
+    FILE *fp;
+    double start;
+    int fd, c;
+
+    n = (argc > 1) ? strtoull(argv[1], NULL, 10) : 10000000;
+    if (n == 0) {
+        fprintf(stderr, "records must be > 0\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // 预先准备 1024 条记录循环写出, 避免格式化的开销
+    if ((recs = calloc(1024, sizeof(struct itemRecord))) == NULL)
+        errExit("calloc");
+    for (j = 0; j < 1024; j++) {
+        recs[j].count = j;
+        recs[j].total = j * 100;
+        snprintf(recs[j].name, RS_NAMESIZE, "item-%llu", (unsigned long long)j);
+    }
+    if ((vbuf = malloc(BS_DEFAULT_SIZE)) == NULL)
+        errExit("malloc");
+
+    fp = openStdio("w", NULL, 0);
+    start = nowSec();
+    for (j = 0; j < n; j++)
+        if (fwrite(&recs[j & 1023], sizeof(rec), 1, fp) != 1)
+            errExit("fwrite");
+    fclose(fp);
+    report("fwrite", nowSec() - start, n);
+
+    fp = openStdio("w", NULL, 0);
+    start = nowSec();
+    for (j = 0; j < n; j++)
+        if (fwrite_unlocked(&recs[j & 1023], sizeof(rec), 1, fp) != 1)
+            errExit("fwrite_unlocked");
+    fclose(fp);
+    report("fwrite_unlocked", nowSec() - start, n);
+
+    fp = openStdio("w", vbuf, BS_DEFAULT_SIZE);
+    start = nowSec();
+    for (j = 0; j < n; j++)
+        if (fwrite(&recs[j & 1023], sizeof(rec), 1, fp) != 1)
+            errExit("fwrite");
+    fclose(fp);
+    report("fwrite + setvbuf(256K)", nowSec() - start, n);
+
+    fd = openFd(1);
+    if (bsOpen(&bs, fd, BS_WRITE, NULL, 0) == -1)
+        errExit("bsOpen");
+    start = nowSec();
+    for (j = 0; j < n; j++)
+        if (bsPutBytes(&bs, &recs[j & 1023], sizeof(rec)) == -1)
+            errExit("bsPutBytes");
+    if (bsClose(&bs) == -1)
+        errExit("bsClose");
+    close(fd);
+    report("bsPutBytes", nowSec() - start, n);
+    printf("%-28s %8llu write calls\n", "", (unsigned long long)bs.syscalls);
+
+    fp = openStdio("w", vbuf, BS_DEFAULT_SIZE);
+    start = nowSec();
+    for (j = 0; j < n; j++)
+        for (p = (const char *)&recs[j & 1023], k = 0; k < sizeof(rec); k++)
+            putc(p[k], fp);
+    fclose(fp);
+    report("putc", nowSec() - start, n);
+
+    fd = openFd(1);
+    if (bsOpen(&bs, fd, BS_WRITE, NULL, 0) == -1)
+        errExit("bsOpen");
+    start = nowSec();
+    for (j = 0; j < n; j++)
+        for (p = (const char *)&recs[j & 1023], k = 0; k < sizeof(rec); k++)
+            bsPutc(&bs, p[k]);
+    bsClose(&bs);
+    close(fd);
+    report("bsPutc", nowSec() - start, n);
+
+    fp = openStdio("r", vbuf, BS_DEFAULT_SIZE);
+    sum = 0;
+    start = nowSec();
+    while (fread(&rec, sizeof(rec), 1, fp) == 1)
+        sum += rec.total;
+    fclose(fp);
+    report("fread", nowSec() - start, n);
+
+    fd = openFd(0);
+    if (bsOpen(&bs, fd, BS_READ, NULL, 0) == -1)
+        errExit("bsOpen");
+    j = sum;
+    sum = 0;
+    start = nowSec();
+    while (bsGetBytes(&bs, &rec, sizeof(rec)) == sizeof(rec))
+        sum += rec.total;
+    report("bsGetBytes", nowSec() - start, n);
+    bsClose(&bs);
+    close(fd);
+
+    fd = openFd(0);
+    bsOpen(&bs, fd, BS_READ, NULL, 0);
+    start = nowSec();
+    for (k = 0; (c = bsGetc(&bs)) != -1; k++)
+        ;
+    report("bsGetc", nowSec() - start, n);
+    bsClose(&bs);
+    close(fd);
+    printf("check: %s, %zu bytes\n", sum == j ? "ok" : "MISMATCH", k);
+
+    free(vbuf);
+    free(recs);
+    unlink(PATH);
+    exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,468 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <sys/resource.h>
+
+/*
+ * 缓冲区大小扫描: 对每个目录, 每种 I/O 方式, 缓冲区大小从 1 字节到 4 MiB(2 的幂),
+ * 测量吞吐量和系统调用次数.
+ *
+ * I/O 方式:
+ *   - write/read, pwrite/pread: 每次调用传输 bufsize 字节
+ *   - mmap-write/mmap-read: 映射整个文件, 每次 memcpy() bufsize 字节
+ *   - fwrite/fread + _IONBF: 每次 fwrite()/fread() bufsize 字节
+ *   - fwrite/fread + _IOLBF, _IOFBF: setvbuf() 设置大小为 bufsize 的缓冲区,
+ *   每次 fwrite()/fread() 一行(64 字节, 以换行符结尾)
+ *
+ * 系统调用次数取自 /proc/self/io 的 syscr/syscw(read/write 类系统调用的次数),
+ * mmap 方式没有 read/write 调用, 同时报告 getrusage() 的缺页次数.
+ *
+ * 小缓冲区的每次测量最多执行 maxOps 次操作, 实际传输的字节数在 bytes 列中.
+ * 默认测量 /dev/shm(tmpfs) 和 /var/tmp(通常是磁盘, /tmp 在很多系统上也是 tmpfs).
+ * 读测试默认读的是页缓存, -c 在每次读测试之前把文件从页缓存中丢弃.
+ *
+ * 编译: gcc -O2 bufSweepBench.c -o bufSweepBench
+ * 用法: bufSweepBench [-j] [-c] [-s] [-f fileMB] [-n maxOps] [dir...]
+ *   -j 输出 JSON, 默认输出 CSV
+ *   -c 读测试前丢弃页缓存
+ *   -s 写测试计入 fsync() 的时间
+ */
+
+#define MIN_SHIFT 0
+#define MAX_SHIFT 22            // 4 MiB
+#define MAX_BUF (1 << MAX_SHIFT)
+#define LINE 64
+
+enum { M_RAW, M_POS, M_MMAP, M_STDIO };
+
+struct method {
+    const char *name;
+    int write;
+    int kind;
+    int vbufMode;               // M_STDIO 的缓冲类型
+};
+
+static const struct method methods[] = {
+    { "write",          1, M_RAW,   0 },
+    { "read",           0, M_RAW,   0 },
+    { "pwrite",         1, M_POS,   0 },
+    { "pread",          0, M_POS,   0 },
+    { "mmap-write",     1, M_MMAP,  0 },
+    { "mmap-read",      0, M_MMAP,  0 },
+    { "fwrite-IONBF",   1, M_STDIO, _IONBF },
+    { "fread-IONBF",    0, M_STDIO, _IONBF },
+    { "fwrite-IOLBF",   1, M_STDIO, _IOLBF },
+    { "fread-IOLBF",    0, M_STDIO, _IOLBF },
+    { "fwrite-IOFBF",   1, M_STDIO, _IOFBF },
+    { "fread-IOFBF",    0, M_STDIO, _IOFBF },
+};
+
+struct counters {
+    uint64_t syscr, syscw;
+    long minflt, majflt;
+};
+
+struct result {
+    double seconds;
+    uint64_t bytes;
+    struct counters c;
+};
+
+static char *data;              // 写入的数据: 每 64 字节一行
+static char *rbuf;              // 读缓冲区
+static char *vbuf;              // setvbuf() 使用的缓冲区
+static int dropCache, syncWrites, json;
+static struct counters overhead;    // readCounters() 本身的系统调用
+
+void errExit(char *msg)
+{
+    extern int errno;
+    perror(msg);
+    exit(errno);
+}
+
+static double
+nowSec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+readCounters(struct counters *c)
+{
+    char buf[512], *p;
+    struct rusage ru;
+    ssize_t n;
+    int fd;
+
+    if ((fd = open("/proc/self/io", O_RDONLY)) == -1)
+        errExit("open /proc/self/io");
+    if ((n = read(fd, buf, sizeof(buf) - 1)) == -1)
+        errExit("read /proc/self/io");
+    close(fd);
+    buf[n] = '\0';
+
+    c->syscr = c->syscw = 0;
+    if ((p = strstr(buf, "syscr:")) != NULL)
+        c->syscr = strtoull(p + 6, NULL, 10);
+    if ((p = strstr(buf, "syscw:")) != NULL)
+        c->syscw = strtoull(p + 6, NULL, 10);
+
+    getrusage(RUSAGE_SELF, &ru);
+    c->minflt = ru.ru_minflt;
+    c->majflt = ru.ru_majflt;
+}
+
+static void
+diffCounters(struct counters *d, const struct counters *a, const struct counters *b)
+{
+    d->syscr = b->syscr - a->syscr - overhead.syscr;
+    d->syscw = b->syscw - a->syscw - overhead.syscw;
+    d->minflt = b->minflt - a->minflt;
+    d->majflt = b->majflt - a->majflt;
+}
+
+static const char *
+fsName(const char *dir)
+{
+    static char buf[32];
+    struct statfs sfs;
+
+    if (statfs(dir, &sfs) == -1)
+        errExit("statfs");
+    switch ((unsigned long)sfs.f_type) {
+    case 0x01021994: return "tmpfs";
+    case 0xEF53:     return "ext4";
+    case 0x58465342: return "xfs";
+    case 0x9123683E: return "btrfs";
+    case 0x794c7630: return "overlay";
+    }
+    snprintf(buf, sizeof(buf), "0x%lx", (unsigned long)sfs.f_type);
+    return buf;
+}
+
+static void
+writeAll(int fd, const char *p, size_t n, off_t off, int positional)
+{
+    ssize_t w;
+
+    while (n > 0) {
+        w = positional ? pwrite(fd, p, n, off) : write(fd, p, n);
+        if (w == -1) {
+            if (errno == EINTR)
+                continue;
+            errExit("write");
+        }
+        p += w;
+        n -= w;
+        off += w;
+    }
+}
+
+/* 创建读测试使用的文件 */
+static void
+createInput(const char *path, uint64_t size)
+{
+    uint64_t done;
+    size_t n;
+    int fd;
+
+    if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR)) == -1)
+        errExit("open input");
+    for (done = 0; done < size; done += n) {
+        n = (size - done < MAX_BUF) ? size - done : MAX_BUF;
+        writeAll(fd, data, n, 0, 0);
+    }
+    if (fsync(fd) == -1)
+        errExit("fsync");
+    close(fd);
+}
+
+static void
+evict(const char *path)
+{
+    int fd;
+
+    if ((fd = open(path, O_RDONLY)) == -1)
+        errExit("open");
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
+
+static void
+finishWrite(int fd)
+{
+    if (syncWrites && fsync(fd) == -1)
+        errExit("fsync");
+    if (close(fd) == -1)
+        errExit("close");
+}
+
+static void
+runRaw(const struct method *m, int fd, size_t size, uint64_t bytes)
+{
+    uint64_t off;
+    ssize_t r;
+
+    for (off = 0; off < bytes; off += size) {
+        if (m->write) {
+            writeAll(fd, data, size, off, m->kind == M_POS);
+            continue;
+        }
+        r = (m->kind == M_POS) ? pread(fd, rbuf, size, off) : read(fd, rbuf, size);
+        if (r == -1)
+            errExit("read");
+        if ((size_t)r != size) {
+            fprintf(stderr, "short read at %llu\n", (unsigned long long)off);
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+static void
+runMmap(const struct method *m, int fd, size_t size, uint64_t bytes)
+{
+    uint64_t off;
+    char *map;
+
+    if (m->write && ftruncate(fd, bytes) == -1)
+        errExit("ftruncate");
+    map = mmap(NULL, bytes, m->write ? PROT_READ | PROT_WRITE : PROT_READ,
+            MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+        errExit("mmap");
+
+    for (off = 0; off < bytes; off += size) {
+        if (m->write)
+            memcpy(map + off, data, size);
+        else
+            memcpy(rbuf, map + off, size);
+    }
+
+    if (m->write && syncWrites && msync(map, bytes, MS_SYNC) == -1)
+        errExit("msync");
+    munmap(map, bytes);
+}
+
+static void
+runStdio(const struct method *m, int fd, size_t size, uint64_t bytes)
+{
+    uint64_t off;
+    size_t op;
+    FILE *fp;
+
+    if ((fp = fdopen(fd, m->write ? "w" : "r")) == NULL)
+        errExit("fdopen");
+    if (m->vbufMode == _IONBF) {
+        if (setvbuf(fp, NULL, _IONBF, 0) != 0)
+            errExit("setvbuf");
+        op = size;
+    } else {
+        if (setvbuf(fp, vbuf, m->vbufMode, size) != 0)
+            errExit("setvbuf");
+        op = LINE;
+    }
+
+    for (off = 0; off < bytes; off += op) {
+        if (m->write) {
+            if (fwrite(data, op, 1, fp) != 1)
+                errExit("fwrite");
+        } else if (fread(rbuf, op, 1, fp) != 1) {
+            errExit("fread");
+        }
+    }
+
+    if (m->write) {
+        if (fflush(fp) == EOF)
+            errExit("fflush");
+        if (syncWrites && fsync(fd) == -1)
+            errExit("fsync");
+    }
+    if (fclose(fp) == EOF)
+        errExit("fclose");
+}
+
+/* 每次操作传输的字节数, 用于限制小缓冲区的测量时间 */
+static size_t
+opSize(const struct method *m, size_t size)
+{
+    return (m->kind == M_STDIO && m->vbufMode != _IONBF) ? LINE : size;
+}
+
+static void
+runOne(const struct method *m, const char *in, const char *out,
+        size_t size, uint64_t fileSize, uint64_t maxOps, struct result *res)
+{
+    struct counters before, after;
+    uint64_t bytes;
+    size_t op;
+    double start;
+    int fd;
+
+    op = opSize(m, size);
+    bytes = (fileSize / op < maxOps) ? fileSize / op * op : maxOps * op;
+    // mmap 和 stdio 行模式按行或整块处理, 保证是 size 和 LINE 的整数倍
+    bytes -= bytes % (size > LINE ? size : LINE);
+    if (bytes == 0)
+        bytes = size;
+
+    if (!m->write && dropCache)
+        evict(in);
+
+    readCounters(&before);
+    start = nowSec();
+
+    if (m->write)
+        fd = open(out, (m->kind == M_MMAP ? O_RDWR : O_WRONLY) | O_CREAT | O_TRUNC,
+                S_IRUSR | S_IWUSR);
+    else
+        fd = open(in, O_RDONLY);
+    if (fd == -1)
+        errExit("open");
+
+    switch (m->kind) {
+    case M_RAW:
+    case M_POS:
+        runRaw(m, fd, size, bytes);
+        break;
+    case M_MMAP:
+        runMmap(m, fd, size, bytes);
+        break;
+    case M_STDIO:
+        runStdio(m, fd, size, bytes);
+        fd = -1;                // fclose() 已经关闭
+        break;
+    }
+    if (fd != -1) {
+        if (m->write && m->kind != M_MMAP)
+            finishWrite(fd);
+        else
+            close(fd);
+    }
+
+    res->seconds = nowSec() - start;
+    readCounters(&after);
+    res->bytes = bytes;
+    diffCounters(&res->c, &before, &after);
+}
+
+static void
+printResult(const char *fs, const char *dir, const struct method *m,
+        size_t size, const struct result *r, int first)
+{
+    double mbps = r->bytes / r->seconds / 1e6;
+
+    if (json) {
+        printf("%s  {\"fs\": \"%s\", \"dir\": \"%s\", \"method\": \"%s\", "
+                "\"bufsize\": %zu, \"bytes\": %llu, \"seconds\": %.6f, "
+                "\"mb_per_s\": %.1f, \"syscr\": %llu, \"syscw\": %llu, "
+                "\"minflt\": %ld, \"majflt\": %ld}",
+                first ? "" : ",\n", fs, dir, m->name, size,
+                (unsigned long long)r->bytes, r->seconds, mbps,
+                (unsigned long long)r->c.syscr, (unsigned long long)r->c.syscw,
+                r->c.minflt, r->c.majflt);
+    } else {
+        printf("%s,%s,%s,%zu,%llu,%.6f,%.1f,%llu,%llu,%ld,%ld\n",
+                fs, dir, m->name, size, (unsigned long long)r->bytes,
+                r->seconds, mbps, (unsigned long long)r->c.syscr,
+                (unsigned long long)r->c.syscw, r->c.minflt, r->c.majflt);
+    }
+    fflush(stdout);
+}
+
+int
+main(int argc, char *argv[])
+{
+    static const char *defaultDirs[] = { "/dev/shm", "/var/tmp" };
+    const char **dirs, *fs;
+    char in[4096], out[4096];
+    struct counters a, b;
+    struct result res;
+    uint64_t fileSize, maxOps;
+    size_t j, m, ndirs;
+    int opt, shift, first;
+
+    fileSize = 64ULL << 20;
+    maxOps = 1 << 18;
+    while ((opt = getopt(argc, argv, "jcsf:n:")) != -1) {
+        switch (opt) {
+        case 'j': json = 1; break;
+        case 'c': dropCache = 1; break;
+        case 's': syncWrites = 1; break;
+        case 'f': fileSize = strtoull(optarg, NULL, 10) << 20; break;
+        case 'n': maxOps = strtoull(optarg, NULL, 10); break;
+        default:
+            fprintf(stderr, "Usage: %s [-j] [-c] [-s] [-f fileMB] [-n maxOps] [dir...]\n",
+                    argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (fileSize < MAX_BUF || maxOps == 0) {
+        fprintf(stderr, "file must be >= 4 MiB and maxOps > 0\n");
+        exit(EXIT_FAILURE);
+    }
+    if (optind < argc) {
+        dirs = (const char **)argv + optind;
+        ndirs = argc - optind;
+    } else {
+        dirs = defaultDirs;
+        ndirs = 2;
+    }
+
+    if ((data = malloc(MAX_BUF)) == NULL || (rbuf = malloc(MAX_BUF)) == NULL ||
+            (vbuf = malloc(MAX_BUF)) == NULL)
+        errExit("malloc");
+    for (j = 0; j < MAX_BUF; j++)
+        data[j] = (j % LINE == LINE - 1) ? '\n' : 'a' + j % 26;
+    // 触发 rbuf 的缺页, 避免计入第一次读测试
+    memset(rbuf, 0, MAX_BUF);
+    memset(vbuf, 0, MAX_BUF);
+
+    readCounters(&a);
+    readCounters(&b);
+    overhead.syscr = b.syscr - a.syscr;
+    overhead.syscw = b.syscw - a.syscw;
+
+    if (json)
+        printf("[\n");
+    else
+        printf("fs,dir,method,bufsize,bytes,seconds,mb_per_s,syscr,syscw,minflt,majflt\n");
+
+    first = 1;
+    for (j = 0; j < ndirs; j++) {
+        fs = fsName(dirs[j]);
+        snprintf(in, sizeof(in), "%s/bufsweep.in", dirs[j]);
+        snprintf(out, sizeof(out), "%s/bufsweep.out", dirs[j]);
+        createInput(in, fileSize);
+
+        for (m = 0; m < sizeof(methods) / sizeof(methods[0]); m++) {
+            for (shift = MIN_SHIFT; shift <= MAX_SHIFT; shift++) {
+                runOne(&methods[m], in, out, (size_t)1 << shift, fileSize, maxOps, &res);
+                printResult(fs, dirs[j], &methods[m], (size_t)1 << shift, &res, first);
+                first = 0;
+            }
+        }
+        unlink(in);
+        unlink(out);
+    }
+
+    if (json)
+        printf("\n]\n");
+    free(data);
+    free(rbuf);
+    free(vbuf);
+    exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include "recordStore.h"
+#include "columnStore.h"
+
+/*
+ * 行式与列式布局的扫描对比
+ *
+ * 先生成一个行式记录文件, 转换成列式文件, 然后分别在两种布局上计算
+ * sum(total), sum(count), min/max(total) 以及 total 的范围过滤.
+ *
+ * 编译: gcc -O2 columnScanBench.c columnStore.c recordStore.c -o columnScanBench
+ * 用法: columnScanBench [records]
+ */
+
+#define ROW_PATH "/tmp/test.rec"
+#define COL_PATH "/tmp/test.col"
+#define ROUNDS 5
+
+void errExit(char *msg)
+{
+    extern int errno;
+    perror(msg);
+    exit(errno);
+}
+
+static double
+nowSec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+report(const char *name, double elapsed, uint64_t n, long long check)
+{
+    printf("%-28s %8.2f ns/rec %10.1f Mrec/s  (%lld)\n", name,
+            elapsed * 1e9 / n / ROUNDS, n * ROUNDS / elapsed / 1e6, check);
+}
+
+int
+main(int argc, char *argv[])
+{
+    struct recordStore rs;
+    struct columnStore cs;
+    struct itemRecord rec;
+    const struct itemRecord *rp;
+    uint64_t n, j, seed = 0x9e3779b97f4a7c15ULL;
+    uint32_t *sel;
+    int64_t sum, lo, hi, tmin, tmax;
+    size_t matched;
+    double start;
+    int r, scalar;
+
+    n = (argc > 1) ? strtoull(argv[1], NULL, 10) : 20000000;
+    if (n == 0) {
+        fprintf(stderr, "records must be > 0\n");
+        exit(EXIT_FAILURE);
+    }
+
+    unlink(ROW_PATH);
+    if (rsOpen(&rs, ROW_PATH, RS_CREATE) == -1)
+        errExit("rsOpen");
+    memset(&rec, 0, sizeof(rec));
+    for (j = 0; j < n; j++) {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        rec.count = (int16_t)(seed & 0x7fff);
+        rec.total = (int64_t)(seed >> 24) % 1000000;
+        snprintf(rec.name, RS_NAMESIZE, "item-%llu", (unsigned long long)j);
+        if (rsAppend(&rs, &rec) == -1)
+            errExit("rsAppend");
+    }
+
+    start = nowSec();
+    if (csConvert(&rs, COL_PATH) == -1)
+        errExit("csConvert");
+    printf("convert: %.2f ns/rec\n", (nowSec() - start) * 1e9 / n);
+
+    if (csOpen(&cs, COL_PATH) == -1)
+        errExit("csOpen");
+    if ((sel = malloc(n * sizeof(uint32_t))) == NULL)
+        errExit("malloc");
+
+    lo = 100000;
+    hi = 200000;
+
+    // 行式布局: 每条记录 60 字节都要经过缓存
+    start = nowSec();
+    for (r = 0; r < ROUNDS; r++)
+        for (sum = 0, j = 0; j < n; j++)
+            sum += rsGet(&rs, j)->total;
+    report("row sum(total)", nowSec() - start, n, sum);
+
+    start = nowSec();
+    for (r = 0; r < ROUNDS; r++)
+        for (sum = 0, j = 0; j < n; j++)
+            sum += rsGet(&rs, j)->count;
+    report("row sum(count)", nowSec() - start, n, sum);
+
+    start = nowSec();
+    for (r = 0; r < ROUNDS; r++) {
+        tmin = tmax = rsGet(&rs, 0)->total;
+        for (j = 1; j < n; j++) {
+            rp = rsGet(&rs, j);
+            if (rp->total < tmin)
+                tmin = rp->total;
+            if (rp->total > tmax)
+                tmax = rp->total;
+        }
+    }
+    report("row min/max(total)", nowSec() - start, n, tmax - tmin);
+
+    start = nowSec();
+    for (r = 0; r < ROUNDS; r++)
+        for (matched = 0, j = 0; j < n; j++) {
+            rp = rsGet(&rs, j);
+            if (rp->total >= lo && rp->total <= hi)
+                sel[matched++] = j;
+        }
+    report("row filter(total)", nowSec() - start, n, (long long)matched);
+
+    for (scalar = 1; scalar >= 0; scalar--) {
+        const char *tag = scalar ? "scalar" : "avx2";
+        char name[64];
+        int16_t cmin, cmax;
+
+        csForceScalar(scalar);
+
+        start = nowSec();
+        for (r = 0; r < ROUNDS; r++)
+            sum = csSumTotal(cs.totals, cs.count);
+        snprintf(name, sizeof(name), "col %s sum(total)", tag);
+        report(name, nowSec() - start, n, sum);
+
+        start = nowSec();
+        for (r = 0; r < ROUNDS; r++)
+            sum = csSumCount(cs.counts, cs.count);
+        snprintf(name, sizeof(name), "col %s sum(count)", tag);
+        report(name, nowSec() - start, n, sum);
+
+        start = nowSec();
+        for (r = 0; r < ROUNDS; r++)
+            csMinMaxTotal(cs.totals, cs.count, &tmin, &tmax);
+        snprintf(name, sizeof(name), "col %s min/max(total)", tag);
+        report(name, nowSec() - start, n, tmax - tmin);
+
+        start = nowSec();
+        for (r = 0; r < ROUNDS; r++)
+            csMinMaxCount(cs.counts, cs.count, &cmin, &cmax);
+        snprintf(name, sizeof(name), "col %s min/max(count)", tag);
+        report(name, nowSec() - start, n, cmax - cmin);
+
+        start = nowSec();
+        for (r = 0; r < ROUNDS; r++)
+            matched = csFilterTotal(cs.totals, cs.count, lo, hi, sel);
+        snprintf(name, sizeof(name), "col %s filter(total)", tag);
+        report(name, nowSec() - start, n, (long long)matched);
+
+        start = nowSec();
+        for (r = 0; r < ROUNDS; r++)
+            matched = csFilterCount(cs.counts, cs.count, 1000, 2000, sel);
+        snprintf(name, sizeof(name), "col %s filter(count)", tag);
+        report(name, nowSec() - start, n, (long long)matched);
+    }
+
+    free(sel);
+    csClose(&cs);
+    rsClose(&rs);
+    unlink(ROW_PATH);
+    unlink(COL_PATH);
+    exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,514 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <immintrin.h>
+#include "columnStore.h"
+
+_Static_assert(sizeof(struct csHeader) <= CS_HEADER_SIZE, "csHeader size");
+
+static uint64_t
+alignUp(uint64_t n)
+{
+    return (n + CS_ALIGN - 1) & ~(uint64_t)(CS_ALIGN - 1);
+}
+
+int
+csConvert(const struct recordStore *rs, const char *path)
+{
+    static const uint32_t widths[CS_NCOLS] = {
+        sizeof(int16_t), sizeof(int64_t), RS_NAMESIZE
+    };
+    struct csHeader hdr;
+    const struct itemRecord *rec;
+    uint64_t n = rsCount(rs), off, j;
+    int16_t *counts;
+    int64_t *totals;
+    char *base, *names;
+    int fd, c, savedErrno;
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, CS_MAGIC, sizeof(hdr.magic));
+    hdr.version = CS_VERSION;
+    hdr.ncols = CS_NCOLS;
+    hdr.count = n;
+
+    off = CS_HEADER_SIZE;
+    for (c = 0; c < CS_NCOLS; c++) {
+        hdr.cols[c].offset = off;
+        hdr.cols[c].width = widths[c];
+        hdr.cols[c].length = n * widths[c];
+        off = alignUp(off + hdr.cols[c].length);
+    }
+
+    if ((fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC,
+                    S_IRUSR | S_IWUSR | S_IRGRP)) == -1)
+        return -1;
+
+    if (ftruncate(fd, off) == -1)
+        goto fail;
+
+    base = mmap(NULL, off, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED)
+        goto fail;
+
+    counts = (int16_t *)(base + hdr.cols[CS_COL_COUNT].offset);
+    totals = (int64_t *)(base + hdr.cols[CS_COL_TOTAL].offset);
+    names = base + hdr.cols[CS_COL_NAME].offset;
+
+    // 一次遍历行式文件, 同时向三个列段顺序写入
+    for (j = 0; j < n; j++) {
+        rec = rsGet(rs, j);
+        counts[j] = rec->count;
+        totals[j] = rec->total;
+        memcpy(names + j * RS_NAMESIZE, rec->name, RS_NAMESIZE);
+    }
+
+    // 头部最后写入, 转换中途失败的文件没有合法的魔数
+    if (msync(base, off, MS_SYNC) == -1) {
+        savedErrno = errno;
+        munmap(base, off);
+        errno = savedErrno;
+        goto fail;
+    }
+    memcpy(base, &hdr, sizeof(hdr));
+    munmap(base, off);
+
+    if (fdatasync(fd) == -1)
+        goto fail;
+    return close(fd);
+
+fail:
+    savedErrno = errno;
+    close(fd);
+    unlink(path);
+    errno = savedErrno;
+    return -1;
+}
+
+int
+csOpen(struct columnStore *cs, const char *path)
+{
+    struct csHeader hdr;
+    struct stat sb;
+    int c, savedErrno;
+
+    memset(cs, 0, sizeof(struct columnStore));
+
+    if ((cs->fd = open(path, O_RDONLY | O_CLOEXEC)) == -1)
+        return -1;
+
+    if (fstat(cs->fd, &sb) == -1)
+        goto fail;
+
+    if (pread(cs->fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) ||
+            memcmp(hdr.magic, CS_MAGIC, sizeof(hdr.magic)) != 0 ||
+            hdr.version != CS_VERSION || hdr.ncols != CS_NCOLS) {
+        errno = EBADMSG;
+        goto fail;
+    }
+    for (c = 0; c < CS_NCOLS; c++) {
+        if (hdr.cols[c].offset % CS_ALIGN != 0 ||
+                hdr.cols[c].length != hdr.count * hdr.cols[c].width ||
+                hdr.cols[c].offset + hdr.cols[c].length > (uint64_t)sb.st_size) {
+            errno = EBADMSG;
+            goto fail;
+        }
+    }
+
+    cs->size = sb.st_size;
+    cs->base = mmap(NULL, cs->size, PROT_READ, MAP_SHARED, cs->fd, 0);
+    if (cs->base == MAP_FAILED)
+        goto fail;
+
+    cs->count = hdr.count;
+    cs->counts = (const int16_t *)(cs->base + hdr.cols[CS_COL_COUNT].offset);
+    cs->totals = (const int64_t *)(cs->base + hdr.cols[CS_COL_TOTAL].offset);
+    cs->names = cs->base + hdr.cols[CS_COL_NAME].offset;
+
+    // 聚合都是顺序扫描
+    madvise(cs->base, cs->size, MADV_SEQUENTIAL);
+    return 0;
+
+fail:
+    savedErrno = errno;
+    close(cs->fd);
+    errno = savedErrno;
+    return -1;
+}
+
+void
+csClose(struct columnStore *cs)
+{
+    munmap(cs->base, cs->size);
+    close(cs->fd);
+}
+
+/*
+ * 标量实现
+ */
+
+static int64_t
+sumTotalScalar(const int64_t *v, size_t n)
+{
+    int64_t s = 0;
+    size_t j;
+
+    for (j = 0; j < n; j++)
+        s += v[j];
+    return s;
+}
+
+static int64_t
+sumCountScalar(const int16_t *v, size_t n)
+{
+    int64_t s = 0;
+    size_t j;
+
+    for (j = 0; j < n; j++)
+        s += v[j];
+    return s;
+}
+
+static void
+minMaxTotalScalar(const int64_t *v, size_t n, int64_t *min, int64_t *max)
+{
+    int64_t lo = v[0], hi = v[0];
+    size_t j;
+
+    for (j = 1; j < n; j++) {
+        if (v[j] < lo)
+            lo = v[j];
+        if (v[j] > hi)
+            hi = v[j];
+    }
+    *min = lo;
+    *max = hi;
+}
+
+static void
+minMaxCountScalar(const int16_t *v, size_t n, int16_t *min, int16_t *max)
+{
+    int16_t lo = v[0], hi = v[0];
+    size_t j;
+
+    for (j = 1; j < n; j++) {
+        if (v[j] < lo)
+            lo = v[j];
+        if (v[j] > hi)
+            hi = v[j];
+    }
+    *min = lo;
+    *max = hi;
+}
+
+static size_t
+filterTotalScalar(const int64_t *v, size_t n, int64_t lo, int64_t hi, uint32_t *sel)
+{
+    size_t j, k = 0;
+
+    // 无分支写法: 总是写入, 只在满足条件时前进
+    for (j = 0; j < n; j++) {
+        sel[k] = j;
+        k += (v[j] >= lo) & (v[j] <= hi);
+    }
+    return k;
+}
+
+static size_t
+filterCountScalar(const int16_t *v, size_t n, int16_t lo, int16_t hi, uint32_t *sel)
+{
+    size_t j, k = 0;
+
+    for (j = 0; j < n; j++) {
+        sel[k] = j;
+        k += (v[j] >= lo) & (v[j] <= hi);
+    }
+    return k;
+}
+
+/*
+ * AVX2 实现(过滤还用到了 BMI2 的 pext). 主循环之后剩余的不足一个向量的部分逐个处理.
+ */
+
+__attribute__((target("avx2")))
+static int64_t
+sumTotalAvx2(const int64_t *v, size_t n)
+{
+    __m256i a0 = _mm256_setzero_si256(), a1 = _mm256_setzero_si256();
+    int64_t lanes[4];
+    size_t j;
+
+    for (j = 0; j + 8 <= n; j += 8) {
+        a0 = _mm256_add_epi64(a0, _mm256_loadu_si256((const __m256i *)(v + j)));
+        a1 = _mm256_add_epi64(a1, _mm256_loadu_si256((const __m256i *)(v + j + 4)));
+    }
+    _mm256_storeu_si256((__m256i *)lanes, _mm256_add_epi64(a0, a1));
+
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + sumTotalScalar(v + j, n - j);
+}
+
+__attribute__((target("avx2")))
+static int64_t
+sumCountAvx2(const int16_t *v, size_t n)
+{
+    const __m256i ones = _mm256_set1_epi16(1);
+    __m256i acc32, acc64 = _mm256_setzero_si256();
+    int64_t lanes[4];
+    size_t j = 0, block;
+
+    /*
+     * madd 把相邻两个 int16 相加得到 int32, 每次最多增加 65536,
+     * 累加 16384 次后再展开到 int64, 保证 int32 不会溢出
+     */
+    while (j + 16 <= n) {
+        acc32 = _mm256_setzero_si256();
+        for (block = 0; block < 16384 && j + 16 <= n; block++, j += 16)
+            acc32 = _mm256_add_epi32(acc32, _mm256_madd_epi16(
+                        _mm256_loadu_si256((const __m256i *)(v + j)), ones));
+        acc64 = _mm256_add_epi64(acc64,
+                _mm256_cvtepi32_epi64(_mm256_castsi256_si128(acc32)));
+        acc64 = _mm256_add_epi64(acc64,
+                _mm256_cvtepi32_epi64(_mm256_extracti128_si256(acc32, 1)));
+    }
+    _mm256_storeu_si256((__m256i *)lanes, acc64);
+
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + sumCountScalar(v + j, n - j);
+}
+
+__attribute__((target("avx2")))
+static void
+minMaxTotalAvx2(const int64_t *v, size_t n, int64_t *min, int64_t *max)
+{
+    __m256i lo, hi, x;
+    int64_t l[4], h[4], tmin, tmax;
+    size_t j;
+    int k;
+
+    if (n < 4) {
+        minMaxTotalScalar(v, n, min, max);
+        return;
+    }
+
+    // AVX2 没有 64 位整数的 min/max, 用比较加混合代替
+    lo = hi = _mm256_loadu_si256((const __m256i *)v);
+    for (j = 4; j + 4 <= n; j += 4) {
+        x = _mm256_loadu_si256((const __m256i *)(v + j));
+        lo = _mm256_blendv_epi8(lo, x, _mm256_cmpgt_epi64(lo, x));
+        hi = _mm256_blendv_epi8(hi, x, _mm256_cmpgt_epi64(x, hi));
+    }
+    _mm256_storeu_si256((__m256i *)l, lo);
+    _mm256_storeu_si256((__m256i *)h, hi);
+
+    tmin = l[0];
+    tmax = h[0];
+    for (k = 1; k < 4; k++) {
+        if (l[k] < tmin)
+            tmin = l[k];
+        if (h[k] > tmax)
+            tmax = h[k];
+    }
+    for (; j < n; j++) {
+        if (v[j] < tmin)
+            tmin = v[j];
+        if (v[j] > tmax)
+            tmax = v[j];
+    }
+    *min = tmin;
+    *max = tmax;
+}
+
+__attribute__((target("avx2")))
+static void
+minMaxCountAvx2(const int16_t *v, size_t n, int16_t *min, int16_t *max)
+{
+    __m256i lo, hi, x;
+    int16_t l[16], h[16], tmin, tmax;
+    size_t j;
+    int k;
+
+    if (n < 16) {
+        minMaxCountScalar(v, n, min, max);
+        return;
+    }
+
+    lo = hi = _mm256_loadu_si256((const __m256i *)v);
+    for (j = 16; j + 16 <= n; j += 16) {
+        x = _mm256_loadu_si256((const __m256i *)(v + j));
+        lo = _mm256_min_epi16(lo, x);
+        hi = _mm256_max_epi16(hi, x);
+    }
+    _mm256_storeu_si256((__m256i *)l, lo);
+    _mm256_storeu_si256((__m256i *)h, hi);
+
+    tmin = l[0];
+    tmax = h[0];
+    for (k = 1; k < 16; k++) {
+        if (l[k] < tmin)
+            tmin = l[k];
+        if (h[k] > tmax)
+            tmax = h[k];
+    }
+    for (; j < n; j++) {
+        if (v[j] < tmin)
+            tmin = v[j];
+        if (v[j] > tmax)
+            tmax = v[j];
+    }
+    *min = tmin;
+    *max = tmax;
+}
+
+/*
+ * 过滤结果的压缩写出: 按 4 位掩码从表中取出 pshufb 的控制字,
+ * 把满足条件的 32 位记录编号挪到向量的低端后整体写出, 没有分支.
+ * 每次写 4 个元素, 多写的部分会被之后的结果覆盖.
+ */
+static const uint8_t compressLut[16][16] __attribute__((aligned(16))) = {
+    { 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x02, 0x03, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x04, 0x05, 0x06, 0x07, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x08, 0x09, 0x0a, 0x0b, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x02, 0x03, 0x08, 0x09, 0x0a, 0x0b, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x80, 0x80, 0x80, 0x80 },
+    { 0x0c, 0x0d, 0x0e, 0x0f, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x02, 0x03, 0x0c, 0x0d, 0x0e, 0x0f, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x04, 0x05, 0x06, 0x07, 0x0c, 0x0d, 0x0e, 0x0f, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x0c, 0x0d, 0x0e, 0x0f, 0x80, 0x80, 0x80, 0x80 },
+    { 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x02, 0x03, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x80, 0x80, 0x80, 0x80 },
+    { 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x80, 0x80, 0x80, 0x80 },
+    { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f },
+};
+
+__attribute__((target("avx2")))
+static inline size_t
+compressStore4(uint32_t *sel, size_t k, uint32_t base, unsigned nibble)
+{
+    __m128i idx = _mm_add_epi32(_mm_set1_epi32(base), _mm_setr_epi32(0, 1, 2, 3));
+
+    _mm_storeu_si128((__m128i *)(sel + k), _mm_shuffle_epi8(idx,
+                _mm_load_si128((const __m128i *)compressLut[nibble])));
+    return k + __builtin_popcount(nibble);
+}
+
+__attribute__((target("avx2")))
+static size_t
+filterTotalAvx2(const int64_t *v, size_t n, int64_t lo, int64_t hi, uint32_t *sel)
+{
+    const __m256i vlo = _mm256_set1_epi64x(lo), vhi = _mm256_set1_epi64x(hi);
+    __m256i x, out;
+    unsigned mask;
+    size_t j, k = 0;
+
+    for (j = 0; j + 4 <= n; j += 4) {
+        x = _mm256_loadu_si256((const __m256i *)(v + j));
+        // lo <= x <= hi 等价于 !(lo > x) && !(x > hi)
+        out = _mm256_or_si256(_mm256_cmpgt_epi64(vlo, x), _mm256_cmpgt_epi64(x, vhi));
+        mask = ~_mm256_movemask_pd(_mm256_castsi256_pd(out)) & 0xf;
+        k = compressStore4(sel, k, j, mask);
+    }
+
+    for (; j < n; j++)
+        if (v[j] >= lo && v[j] <= hi)
+            sel[k++] = j;
+
+    return k;
+}
+
+__attribute__((target("avx2,bmi2")))
+static size_t
+filterCountAvx2(const int16_t *v, size_t n, int16_t lo, int16_t hi, uint32_t *sel)
+{
+    const __m256i vlo = _mm256_set1_epi16(lo), vhi = _mm256_set1_epi16(hi);
+    __m256i x, out;
+    unsigned mask;
+    size_t j, k = 0;
+    int g;
+
+    for (j = 0; j + 16 <= n; j += 16) {
+        x = _mm256_loadu_si256((const __m256i *)(v + j));
+        out = _mm256_or_si256(_mm256_cmpgt_epi16(vlo, x), _mm256_cmpgt_epi16(x, vhi));
+        // 每个 16 位元素对应掩码中的 2 位, 用 pext 取出偶数位得到 16 位掩码
+        mask = ~(unsigned)_mm256_movemask_epi8(out);
+        mask = _pext_u32(mask, 0x55555555u);
+        for (g = 0; g < 4; g++)
+            k = compressStore4(sel, k, j + g * 4, (mask >> (g * 4)) & 0xf);
+    }
+    for (; j < n; j++)
+        if (v[j] >= lo && v[j] <= hi)
+            sel[k++] = j;
+
+    return k;
+}
+
+/*
+ * 运行时选择实现
+ */
+
+static int useAvx2 = -1;
+
+static inline int
+haveAvx2(void)
+{
+    if (useAvx2 == -1)
+        csForceScalar(0);
+    return useAvx2;
+}
+
+void
+csForceScalar(int scalar)
+{
+    useAvx2 = !scalar && __builtin_cpu_supports("avx2") &&
+        __builtin_cpu_supports("bmi2");
+}
+
+int64_t
+csSumTotal(const int64_t *v, size_t n)
+{
+    return haveAvx2() ? sumTotalAvx2(v, n) : sumTotalScalar(v, n);
+}
+
+int64_t
+csSumCount(const int16_t *v, size_t n)
+{
+    return haveAvx2() ? sumCountAvx2(v, n) : sumCountScalar(v, n);
+}
+
+void
+csMinMaxTotal(const int64_t *v, size_t n, int64_t *min, int64_t *max)
+{
+    if (haveAvx2())
+        minMaxTotalAvx2(v, n, min, max);
+    else
+        minMaxTotalScalar(v, n, min, max);
+}
+
+void
+csMinMaxCount(const int16_t *v, size_t n, int16_t *min, int16_t *max)
+{
+    if (haveAvx2())
+        minMaxCountAvx2(v, n, min, max);
+    else
+        minMaxCountScalar(v, n, min, max);
+}
+
+size_t
+csFilterTotal(const int64_t *v, size_t n, int64_t lo, int64_t hi, uint32_t *sel)
+{
+    return haveAvx2() ? filterTotalAvx2(v, n, lo, hi, sel)
+        : filterTotalScalar(v, n, lo, hi, sel);
+}
+
+size_t
+csFilterCount(const int16_t *v, size_t n, int16_t lo, int16_t hi, uint32_t *sel)
+{
+    return haveAvx2() ? filterCountAvx2(v, n, lo, hi, sel)
+        : filterCountScalar(v, n, lo, hi, sel);
+}
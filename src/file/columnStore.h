@@ -0,0 +1,149 @@
+/**
+ * @file columnStore.h
+ * @author Lock
+ * @date 16 Oct 2026
+ * @brief 列式(structure-of-arrays)记录文件与向量化聚合
+ *
+ * recordStore.h 中的记录按行存放, 每条 60 字节, 其中 `name` 占 50 字节.
+ * 只统计 `total` 或 `count` 时, 每读取 10 个字节的有用数据, 也要把整条记录读入缓存,
+ * 内存带宽的大部分浪费在了 `name` 上.
+ *
+ * 列式文件把每个字段单独存放为一个连续的列段:
+ *   - 文件头部(@ref csHeader)记录每一列的偏移量和长度.
+ *   - 每个列段按 @ref CS_ALIGN 对齐, 映射后的地址满足 SIMD 对齐加载的要求,
+ *   也便于以后使用 O_DIRECT 读取.
+ *
+ * 聚合函数提供 AVX2 实现和标量实现, 第一次调用时通过 `__builtin_cpu_supports()`
+ * 在运行时选择, 同一个程序可以在不支持 AVX2 的机器上运行.
+ *
+ * @example columnScanBench.c
+ */
+#ifndef COLUMN_STORE_H
+#define COLUMN_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "recordStore.h"
+
+#define CS_MAGIC "ITEMCOLS"
+#define CS_VERSION 1
+#define CS_ALIGN 4096
+#define CS_HEADER_SIZE 4096
+
+#define CS_COL_COUNT 0          //!< int16_t
+#define CS_COL_TOTAL 1          //!< int64_t
+#define CS_COL_NAME  2          //!< char[RS_NAMESIZE]
+#define CS_NCOLS 3
+
+/**
+ * @brief 列段描述
+ */
+struct csColumn {
+    uint64_t offset;            //!< 列段在文件中的偏移量, 按 @ref CS_ALIGN 对齐
+    uint64_t length;            //!< 列段的字节数
+    uint32_t width;             //!< 每个值的字节数
+    uint32_t reserved;
+} __attribute__((packed));
+
+/**
+ * @brief 磁盘上的文件头部
+ */
+struct csHeader {
+    char magic[8];              //!< @ref CS_MAGIC
+    uint32_t version;           //!< @ref CS_VERSION
+    uint32_t ncols;             //!< @ref CS_NCOLS
+    uint64_t count;             //!< 记录个数
+    struct csColumn cols[CS_NCOLS];
+} __attribute__((packed));
+
+/**
+ * @brief 打开的列式文件
+ */
+struct columnStore {
+    int fd;
+    char *base;
+    size_t size;
+    uint64_t count;
+    const int16_t *counts;      //!< count 列
+    const int64_t *totals;      //!< total 列
+    const char *names;          //!< name 列, 第 i 个名字位于 names + i * RS_NAMESIZE
+};
+
+/**
+ * @brief 把行式记录文件转换为列式文件
+ *
+ * @param rs 已打开的记录文件
+ * @param path 列式文件路径, 已存在时被覆盖
+ *
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+int
+csConvert(const struct recordStore *rs, const char *path);
+
+/**
+ * @brief 以只读方式打开列式文件
+ *
+ * @retval 0 成功
+ * @retval -1 失败, 格式不正确时 errno 为 `EBADMSG`
+ */
+int
+csOpen(struct columnStore *cs, const char *path);
+
+/**
+ * @brief 关闭列式文件
+ */
+void
+csClose(struct columnStore *cs);
+
+/**
+ * @brief 求和
+ */
+int64_t
+csSumTotal(const int64_t *v, size_t n);
+
+/**
+ * @brief 求和, 结果不会溢出
+ */
+int64_t
+csSumCount(const int16_t *v, size_t n);
+
+/**
+ * @brief 求最小值和最大值, @p n 必须大于 0
+ */
+void
+csMinMaxTotal(const int64_t *v, size_t n, int64_t *min, int64_t *max);
+
+/**
+ * @brief 求最小值和最大值, @p n 必须大于 0
+ */
+void
+csMinMaxCount(const int16_t *v, size_t n, int16_t *min, int16_t *max);
+
+/**
+ * @brief 过滤出 lo <= v[i] <= hi 的记录
+ *
+ * @param v 列数据
+ * @param n 值的个数
+ * @param lo 下界(包含)
+ * @param hi 上界(包含)
+ * @param sel 用于保存满足条件的记录编号, 至少能容纳 @p n 个元素
+ *
+ * @return 返回满足条件的记录个数
+ */
+size_t
+csFilterTotal(const int64_t *v, size_t n, int64_t lo, int64_t hi, uint32_t *sel);
+
+/**
+ * @brief 过滤出 lo <= v[i] <= hi 的记录, 参数与 csFilterTotal() 相同
+ */
+size_t
+csFilterCount(const int16_t *v, size_t n, int16_t lo, int16_t hi, uint32_t *sel);
+
+/**
+ * @brief 禁用 AVX2 实现, 用于对比测试
+ */
+void
+csForceScalar(int scalar);
+
+#endif
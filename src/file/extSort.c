@@ -0,0 +1,771 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "extSort.h"
+#include "ioQueue.h"
+
+#define REC_SIZE sizeof(struct itemRecord)
+#define OUT_TAG (1ULL << 63)    //!< 输出缓冲区的写请求
+
+/**
+ * @brief 键数组的元素
+ */
+struct sortKey {
+    uint64_t key;
+    uint32_t idx;               //!< 记录在段中的编号
+    uint32_t pad;
+};
+
+/**
+ * @brief 临时文件中的有序段
+ */
+struct runFile {
+    int fd;
+    uint64_t size;              //!< 字节数
+};
+
+static double
+nowSec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* 排序键: 无符号比较的顺序与按 key 比较记录的顺序一致 */
+static uint64_t
+recKey(const struct itemRecord *r, int key)
+{
+    uint64_t k = 0;
+    int j;
+
+    if (key == ES_BY_TOTAL)
+        return (uint64_t)r->total ^ (1ULL << 63);
+    for (j = 0; j < 8 && r->name[j] != '\0'; j++)
+        k |= (uint64_t)(unsigned char)r->name[j] << (56 - 8 * j);
+    return k;
+}
+
+static int
+recCmp(const struct itemRecord *a, uint64_t ka, const struct itemRecord *b, uint64_t kb,
+        int key)
+{
+    if (ka != kb)
+        return (ka < kb) ? -1 : 1;
+    if (key == ES_BY_NAME)
+        return strncmp(a->name, b->name, RS_NAMESIZE);
+    return 0;
+}
+
+static int
+cmpName(const void *x, const void *y, void *arg)
+{
+    const struct sortKey *a = x, *b = y;
+    const char *recs = arg;
+    int c;
+
+    c = strncmp(((const struct itemRecord *)(recs + (size_t)a->idx * REC_SIZE))->name,
+            ((const struct itemRecord *)(recs + (size_t)b->idx * REC_SIZE))->name, RS_NAMESIZE);
+    if (c != 0)
+        return c;
+    return (a->idx < b->idx) ? -1 : (a->idx > b->idx);
+}
+
+/* LSD 基数排序, 返回排好序的数组(a 或 tmp) */
+static struct sortKey *
+radixSort(struct sortKey *a, struct sortKey *tmp, size_t n)
+{
+    size_t count[8][256];
+    struct sortKey *t;
+    size_t j, sum, c;
+    uint64_t k;
+    int pass, b;
+
+    if (n < 2)
+        return a;
+    memset(count, 0, sizeof(count));
+    for (j = 0; j < n; j++) {
+        k = a[j].key;
+        for (pass = 0; pass < 8; pass++)
+            count[pass][(k >> (8 * pass)) & 0xff]++;
+    }
+
+    for (pass = 0; pass < 8; pass++) {
+        // 所有键在这个字节上都相同, 这一趟不改变顺序
+        if (count[pass][(a[0].key >> (8 * pass)) & 0xff] == n)
+            continue;
+        for (sum = 0, b = 0; b < 256; b++) {
+            c = count[pass][b];
+            count[pass][b] = sum;
+            sum += c;
+        }
+        for (j = 0; j < n; j++)
+            tmp[count[pass][(a[j].key >> (8 * pass)) & 0xff]++] = a[j];
+        t = a;
+        a = tmp;
+        tmp = t;
+    }
+    return a;
+}
+
+/* 在 dir 中创建一个没有名字的临时文件 */
+static int
+tmpFile(const char *dir)
+{
+    char path[PATH_MAX];
+    int fd;
+
+    if ((fd = open(dir, O_TMPFILE | O_RDWR | O_CLOEXEC, S_IRUSR | S_IWUSR)) != -1)
+        return fd;
+    if (snprintf(path, sizeof(path), "%s/.esort-XXXXXX", dir) >= (int)sizeof(path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    if ((fd = mkostemp(path, O_CLOEXEC)) == -1)
+        return -1;
+    unlink(path);
+    return fd;
+}
+
+static int
+preadAll(int fd, void *buf, size_t len, off_t off)
+{
+    ssize_t n;
+
+    while (len > 0) {
+        if ((n = pread(fd, buf, len, off)) == -1) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        if (n == 0) {
+            errno = EBADMSG;
+            return -1;
+        }
+        buf = (char *)buf + n;
+        len -= n;
+        off += n;
+    }
+    return 0;
+}
+
+static int
+writeAll(int fd, const void *buf, size_t len)
+{
+    ssize_t n;
+
+    while (len > 0) {
+        if ((n = write(fd, buf, len)) == -1) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        buf = (const char *)buf + n;
+        len -= n;
+    }
+    return 0;
+}
+
+/*
+ * 生成有序段
+ */
+
+struct formJob {
+    int key;
+    int inFd;
+    const char *tmpDir;
+    uint64_t count;             //!< 输入的记录个数
+    uint64_t runRecs;           //!< 每段的记录个数
+    uint64_t nruns;
+    uint64_t next;              //!< 下一个要领取的段
+    struct runFile *runs;
+    int err;                    //!< 第一个错误的 errno
+};
+
+struct formWorker {
+    pthread_t tid;
+    struct formJob *job;
+};
+
+static void
+setErr(int *err, int e)
+{
+    int zero = 0;
+
+    __atomic_compare_exchange_n(err, &zero, e, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+}
+
+static int
+formRun(struct formJob *job, uint64_t r, char *recs, struct sortKey *keys,
+        struct sortKey *tmp, char *stage)
+{
+    const struct itemRecord *rec;
+    struct sortKey *sorted;
+    uint64_t first = r * job->runRecs, n, j, g;
+    size_t stageRecs = ES_STAGE / REC_SIZE, len;
+    off_t off = RS_HEADER_SIZE + first * REC_SIZE;
+    int fd;
+
+    n = (job->count - first < job->runRecs) ? job->count - first : job->runRecs;
+    if (preadAll(job->inFd, recs, n * REC_SIZE, off) == -1)
+        return -1;
+    // 输入只读一次, 不让它占用页缓存
+    posix_fadvise(job->inFd, off, n * REC_SIZE, POSIX_FADV_DONTNEED);
+
+    for (j = 0; j < n; j++) {
+        keys[j].key = recKey((const struct itemRecord *)(recs + j * REC_SIZE), job->key);
+        keys[j].idx = j;
+    }
+    sorted = radixSort(keys, tmp, n);
+    if (job->key == ES_BY_NAME) {
+        // 前 8 个字节相同的记录按完整的名字排序
+        for (j = 0; j < n; j = g) {
+            for (g = j + 1; g < n && sorted[g].key == sorted[j].key; g++)
+                ;
+            if (g - j > 1)
+                qsort_r(sorted + j, g - j, sizeof(struct sortKey), cmpName, recs);
+        }
+    }
+
+    if ((fd = tmpFile(job->tmpDir)) == -1)
+        return -1;
+    for (j = 0; j < n; j += stageRecs) {
+        len = (n - j < stageRecs) ? n - j : stageRecs;
+        for (g = 0; g < len; g++) {
+            rec = (const struct itemRecord *)(recs + (size_t)sorted[j + g].idx * REC_SIZE);
+            memcpy(stage + g * REC_SIZE, rec, REC_SIZE);
+        }
+        if (writeAll(fd, stage, len * REC_SIZE) == -1) {
+            close(fd);
+            return -1;
+        }
+    }
+    job->runs[r].fd = fd;
+    job->runs[r].size = n * REC_SIZE;
+    return 0;
+}
+
+static void *
+formMain(void *arg)
+{
+    struct formWorker *w = arg;
+    struct formJob *job = w->job;
+    struct sortKey *keys, *tmp;
+    char *recs, *stage;
+    uint64_t r;
+
+    recs = malloc(job->runRecs * REC_SIZE);
+    keys = malloc(job->runRecs * sizeof(struct sortKey));
+    tmp = malloc(job->runRecs * sizeof(struct sortKey));
+    stage = malloc(ES_STAGE);
+    if (recs == NULL || keys == NULL || tmp == NULL || stage == NULL) {
+        setErr(&job->err, ENOMEM);
+        goto out;
+    }
+
+    while (__atomic_load_n(&job->err, __ATOMIC_RELAXED) == 0) {
+        r = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED);
+        if (r >= job->nruns)
+            break;
+        if (formRun(job, r, recs, keys, tmp, stage) == -1)
+            setErr(&job->err, errno);
+    }
+
+out:
+    free(recs);
+    free(keys);
+    free(tmp);
+    free(stage);
+    return NULL;
+}
+
+/*
+ * 归并
+ */
+
+struct mergeRun {
+    int fd;
+    uint64_t off;               //!< 下一次读取的偏移量
+    uint64_t size;
+    char *buf[2];
+    size_t len[2];              //!< 缓冲区中(或者正在读入)的字节数, 0 表示已经到达段尾
+    int ready[2];
+    int cur;                    //!< 正在消费的缓冲区
+    size_t pos;
+    const struct itemRecord *rec;   //!< 当前记录
+    uint64_t key;
+    int done;
+};
+
+struct merger {
+    struct ioQueue q;
+    int key;
+    int k;                      //!< 有序段个数
+    int K;                      //!< 败者树的叶子个数, 不小于 k 的 2 的幂
+    struct mergeRun *runs;      //!< K 个, 多出来的是空段
+    int *tree;                  //!< tree[0] 是胜者, 其余是败者
+    size_t block;
+    char *mem;
+
+    int outFd;
+    uint64_t outOff;
+    char *obuf[2];
+    size_t olen[2];             //!< 正在写入的字节数
+    int obusy[2];
+    int ocur;
+    size_t ofill;
+    uint64_t written;           //!< 输出的记录个数
+    int err;
+};
+
+static void
+complete(struct merger *m, const struct ioqCompletion *c)
+{
+    struct mergeRun *run;
+    size_t want;
+    int b = c->user & 1;
+
+    if (c->user & OUT_TAG) {
+        want = m->olen[b];
+        m->obusy[b] = 0;
+    } else {
+        run = &m->runs[c->user >> 1];
+        want = run->len[b];
+        run->ready[b] = 1;
+    }
+    if (c->res < 0 && m->err == 0)
+        m->err = -c->res;
+    else if ((size_t)c->res != want && m->err == 0)
+        m->err = EIO;
+}
+
+/* 提交已准备的请求, 至少等待一个完成 */
+static int
+pump(struct merger *m)
+{
+    struct ioqCompletion cqes[64];
+    int n, j;
+
+    if (ioqSubmit(&m->q) == -1 || (n = ioqWait(&m->q, cqes, 64, 1)) == -1)
+        return -1;
+    for (j = 0; j < n; j++)
+        complete(m, &cqes[j]);
+    if (m->err != 0) {
+        errno = m->err;
+        return -1;
+    }
+    return 0;
+}
+
+static int
+issueRead(struct merger *m, int r, int b)
+{
+    struct mergeRun *run = &m->runs[r];
+    struct ioqRequest req;
+
+    if (run->off >= run->size) {
+        run->len[b] = 0;
+        run->ready[b] = 1;
+        return 0;
+    }
+    run->len[b] = (run->size - run->off < m->block) ? run->size - run->off : m->block;
+    run->ready[b] = 0;
+    memset(&req, 0, sizeof(req));
+    req.op = IOQ_READ;
+    req.fd = run->fd;
+    req.bufIndex = -1;
+    req.buf = run->buf[b];
+    req.len = run->len[b];
+    req.off = run->off;
+    req.user = ((uint64_t)r << 1) | b;
+    run->off += run->len[b];
+    return (ioqPrep(&m->q, &req) == -1 || ioqSubmit(&m->q) == -1) ? -1 : 0;
+}
+
+/* 切换到另一个缓冲区: 先为读完的缓冲区提交下一块, 再等待另一个缓冲区 */
+static int
+nextBlock(struct merger *m, int r)
+{
+    struct mergeRun *run = &m->runs[r];
+    int old = run->cur;
+
+    run->cur ^= 1;
+    if (issueRead(m, r, old) == -1)
+        return -1;
+    while (!run->ready[run->cur])
+        if (pump(m) == -1)
+            return -1;
+    run->pos = 0;
+    if (run->len[run->cur] == 0) {
+        run->done = 1;
+        return 0;
+    }
+    run->rec = (const struct itemRecord *)run->buf[run->cur];
+    run->key = recKey(run->rec, m->key);
+    return 0;
+}
+
+static int
+advance(struct merger *m, int r)
+{
+    struct mergeRun *run = &m->runs[r];
+
+    run->pos += REC_SIZE;
+    if (run->pos < run->len[run->cur]) {
+        run->rec = (const struct itemRecord *)(run->buf[run->cur] + run->pos);
+        run->key = recKey(run->rec, m->key);
+        return 0;
+    }
+    return nextBlock(m, r);
+}
+
+static int
+less(struct merger *m, int a, int b)
+{
+    struct mergeRun *x = &m->runs[a], *y = &m->runs[b];
+    int c;
+
+    if (x->done)
+        return 0;
+    if (y->done)
+        return 1;
+    c = recCmp(x->rec, x->key, y->rec, y->key, m->key);
+    return c < 0 || (c == 0 && a < b);
+}
+
+/* 建立以 node 为根的子树, 返回子树的胜者 */
+static int
+buildTree(struct merger *m, int node)
+{
+    int l, r;
+
+    if (node >= m->K)
+        return node - m->K;
+    l = buildTree(m, 2 * node);
+    r = buildTree(m, 2 * node + 1);
+    if (less(m, r, l)) {
+        m->tree[node] = l;
+        return r;
+    }
+    m->tree[node] = r;
+    return l;
+}
+
+/* 胜者前进之后, 沿着它到根的路径重新比赛 */
+static void
+replay(struct merger *m, int w)
+{
+    int node, t;
+
+    for (node = (w + m->K) / 2; node >= 1; node /= 2) {
+        if (less(m, m->tree[node], w)) {
+            t = m->tree[node];
+            m->tree[node] = w;
+            w = t;
+        }
+    }
+    m->tree[0] = w;
+}
+
+static int
+flushOut(struct merger *m)
+{
+    struct ioqRequest req;
+    int b = m->ocur;
+
+    if (m->ofill == 0)
+        return 0;
+    memset(&req, 0, sizeof(req));
+    req.op = IOQ_WRITE;
+    req.fd = m->outFd;
+    req.bufIndex = -1;
+    req.buf = m->obuf[b];
+    req.len = m->ofill;
+    req.off = m->outOff;
+    req.user = OUT_TAG | b;
+    m->olen[b] = m->ofill;
+    m->obusy[b] = 1;
+    m->outOff += m->ofill;
+    m->ofill = 0;
+    m->ocur ^= 1;
+    if (ioqPrep(&m->q, &req) == -1 || ioqSubmit(&m->q) == -1)
+        return -1;
+    // 等待另一个缓冲区的写入完成
+    while (m->obusy[m->ocur])
+        if (pump(m) == -1)
+            return -1;
+    return 0;
+}
+
+/*
+ * 把 k 个有序段归并后写入 outFd 的 outOff 处, block 为每个缓冲区的大小(记录大小的整数倍).
+ * 返回输出的记录个数.
+ */
+static int64_t
+mergeRuns(const struct runFile *files, int k, int outFd, uint64_t outOff, size_t block,
+        int key)
+{
+    struct merger m;
+    struct mergeRun *run;
+    int r, w, savedErrno;
+    int64_t ret = -1;
+
+    memset(&m, 0, sizeof(m));
+    m.key = key;
+    m.k = k;
+    m.block = block;
+    m.outFd = outFd;
+    m.outOff = outOff;
+    for (m.K = 1; m.K < k; m.K <<= 1)
+        ;
+    if (ioqInit(&m.q, 2 * k + 4, 0) == -1)
+        return -1;
+    m.runs = calloc(m.K, sizeof(struct mergeRun));
+    m.tree = calloc(m.K, sizeof(int));
+    m.mem = malloc((2 * (size_t)k + 2) * block);
+    if (m.runs == NULL || m.tree == NULL || m.mem == NULL)
+        goto out;
+    m.obuf[0] = m.mem + 2 * (size_t)k * block;
+    m.obuf[1] = m.obuf[0] + block;
+
+    for (r = 0; r < m.K; r++) {
+        run = &m.runs[r];
+        if (r >= k) {
+            run->done = 1;
+            continue;
+        }
+        run->fd = files[r].fd;
+        run->size = files[r].size;
+        run->buf[0] = m.mem + 2 * (size_t)r * block;
+        run->buf[1] = run->buf[0] + block;
+        if (issueRead(&m, r, 0) == -1 || issueRead(&m, r, 1) == -1)
+            goto out;
+    }
+    for (r = 0; r < k; r++) {
+        // 等待每段的第一块
+        run = &m.runs[r];
+        while (!run->ready[0])
+            if (pump(&m) == -1)
+                goto out;
+        if (run->len[0] == 0) {
+            run->done = 1;
+            continue;
+        }
+        run->rec = (const struct itemRecord *)run->buf[0];
+        run->key = recKey(run->rec, key);
+    }
+    m.tree[0] = buildTree(&m, 1);
+
+    for (;;) {
+        w = m.tree[0];
+        run = &m.runs[w];
+        if (run->done)
+            break;
+        if (m.ofill + REC_SIZE > block && flushOut(&m) == -1)
+            goto out;
+        memcpy(m.obuf[m.ocur] + m.ofill, run->rec, REC_SIZE);
+        m.ofill += REC_SIZE;
+        m.written++;
+        if (advance(&m, w) == -1)
+            goto out;
+        replay(&m, w);
+    }
+    if (flushOut(&m) == -1)
+        goto out;
+    while (m.obusy[0] || m.obusy[1])
+        if (pump(&m) == -1)
+            goto out;
+    ret = m.written;
+
+out:
+    savedErrno = errno;
+    // 出错时取回所有未完成的请求, 之后才能释放缓冲区
+    while (m.q.inflight > 0 || m.q.prepared > 0) {
+        struct ioqCompletion cqes[64];
+
+        if (ioqSubmit(&m.q) == -1 || ioqWait(&m.q, cqes, 64, 1) == -1)
+            break;
+    }
+    ioqDestroy(&m.q);
+    free(m.runs);
+    free(m.tree);
+    free(m.mem);
+    errno = savedErrno;
+    return ret;
+}
+
+static void
+closeRuns(struct runFile *runs, uint64_t n)
+{
+    uint64_t j;
+
+    for (j = 0; j < n; j++) {
+        if (runs[j].fd != -1)
+            close(runs[j].fd);
+        runs[j].fd = -1;
+    }
+}
+
+/* 归并时每个块的大小, 记录大小的整数倍 */
+static size_t
+blockSize(size_t memBytes, uint64_t k)
+{
+    size_t block = memBytes / (2 * k + 2);
+
+    if (block > ES_BLOCK)
+        block = ES_BLOCK;
+    return block / REC_SIZE * REC_SIZE;
+}
+
+int
+esSort(const char *in, const char *out, const struct esOptions *opt, struct esStats *st)
+{
+    struct formWorker workers[ES_MAX_THREADS];
+    struct formJob job;
+    struct rsHeader hdr;
+    struct runFile *runs = NULL;
+    struct esStats stats;
+    char dir[PATH_MAX], *slash;
+    uint64_t fanIn, nruns, g, j, n;
+    size_t perThread;
+    double start;
+    int nthreads, k, fd, outFd = -1, savedErrno;
+    int64_t written;
+
+    memset(&stats, 0, sizeof(stats));
+    memset(&job, 0, sizeof(job));
+    nthreads = (opt->nthreads < 1) ? 1 : (opt->nthreads > ES_MAX_THREADS) ?
+            ES_MAX_THREADS : opt->nthreads;
+    perThread = opt->memBytes / nthreads;
+    fanIn = opt->memBytes / (2 * ES_MIN_BLOCK) - 1;
+    if (perThread < ES_STAGE + 1024 * (REC_SIZE + 2 * sizeof(struct sortKey)) || fanIn < 2 ||
+            (opt->key != ES_BY_TOTAL && opt->key != ES_BY_NAME)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (opt->tmpDir != NULL) {
+        snprintf(dir, sizeof(dir), "%s", opt->tmpDir);
+    } else {
+        snprintf(dir, sizeof(dir), "%s", out);
+        if ((slash = strrchr(dir, '/')) == NULL)
+            strcpy(dir, ".");
+        else if (slash == dir)
+            dir[1] = '\0';
+        else
+            *slash = '\0';
+    }
+
+    // 读取输入的头部
+    if ((job.inFd = open(in, O_RDONLY | O_CLOEXEC)) == -1)
+        return -1;
+    if (preadAll(job.inFd, &hdr, sizeof(hdr), 0) == -1 ||
+            memcmp(hdr.magic, RS_MAGIC, sizeof(hdr.magic)) != 0 ||
+            hdr.version != RS_VERSION || hdr.recordSize != REC_SIZE) {
+        close(job.inFd);
+        errno = EBADMSG;
+        return -1;
+    }
+
+    // 并行生成有序段
+    start = nowSec();
+    job.key = opt->key;
+    job.tmpDir = dir;
+    job.count = hdr.count;
+    job.runRecs = (perThread - ES_STAGE) / (REC_SIZE + 2 * sizeof(struct sortKey));
+    if (job.runRecs > UINT32_MAX)
+        job.runRecs = UINT32_MAX;
+    if (job.count > 0 && job.runRecs > job.count)
+        job.runRecs = job.count;
+    job.nruns = (job.count + job.runRecs - 1) / job.runRecs;
+    if ((runs = malloc((job.nruns + 1) * sizeof(struct runFile))) == NULL) {
+        close(job.inFd);
+        return -1;
+    }
+    for (j = 0; j < job.nruns; j++)
+        runs[j].fd = -1;
+    job.runs = runs;
+    if ((uint64_t)nthreads > job.nruns)
+        nthreads = (job.nruns == 0) ? 1 : job.nruns;
+    for (k = 0; k < nthreads; k++) {
+        workers[k].job = &job;
+        if ((errno = pthread_create(&workers[k].tid, NULL, formMain, &workers[k])) != 0) {
+            setErr(&job.err, errno);
+            break;
+        }
+    }
+    while (--k >= 0)
+        pthread_join(workers[k].tid, NULL);
+    close(job.inFd);
+    if (job.err != 0) {
+        errno = job.err;
+        goto fail;
+    }
+    nruns = job.nruns;
+    stats.records = job.count;
+    stats.runs = nruns;
+    stats.formSec = nowSec() - start;
+
+    // 有序段太多时分组归并
+    start = nowSec();
+    while (nruns > fanIn) {
+        for (g = 0, j = 0; j < nruns; g++, j += n) {
+            n = (nruns - j < fanIn) ? nruns - j : fanIn;
+            if ((fd = tmpFile(dir)) == -1)
+                goto fail;
+            if ((written = mergeRuns(runs + j, n, fd, 0, blockSize(opt->memBytes, n),
+                            opt->key)) == -1) {
+                close(fd);
+                goto fail;
+            }
+            // 新段放在已经归并完的旧段之前的位置
+            closeRuns(runs + j, n);
+            runs[g].fd = fd;
+            runs[g].size = written * REC_SIZE;
+        }
+        nruns = g;
+        stats.passes++;
+    }
+
+    // 最后一趟归并到输出文件
+    if ((outFd = open(out, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                    S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH)) == -1)
+        goto fail;
+    if (job.count > 0)
+        fallocate(outFd, 0, 0, RS_HEADER_SIZE + job.count * REC_SIZE);
+    if (nruns > 0 && (written = mergeRuns(runs, nruns, outFd, RS_HEADER_SIZE,
+                    blockSize(opt->memBytes, nruns), opt->key)) == -1)
+        goto fail;
+    hdr.count = job.count;
+    if (pwrite(outFd, &hdr, sizeof(hdr), 0) != sizeof(hdr))
+        goto fail;
+    if (close(outFd) == -1) {
+        outFd = -1;
+        goto fail;
+    }
+    stats.passes++;
+    stats.mergeSec = nowSec() - start;
+    closeRuns(runs, nruns);
+    free(runs);
+    if (st != NULL)
+        *st = stats;
+    return 0;
+
+fail:
+    savedErrno = errno;
+    if (outFd != -1)
+        close(outFd);
+    closeRuns(runs, job.nruns);
+    free(runs);
+    errno = savedErrno;
+    return -1;
+}
@@ -0,0 +1,80 @@
+/**
+ * @file extSort.h
+ * @author Lock
+ * @date 16 Oct 2026
+ * @brief 记录文件的外部归并排序
+ *
+ * 把 recordStore.h 格式的记录文件按 `total` 或 `name` 排序, 文件可以远大于内存,
+ * 使用的内存不超过调用者给定的预算.
+ *
+ * # 生成有序段
+ * 每个线程轮流领取输入中的一段记录(段的大小由内存预算和线程数决定), 一次读入内存:
+ *   - 每条记录生成一个 64 位的排序键: `total` 翻转符号位; `name` 取前 8 个字节,
+ *   按大端序组成整数(字符串结束之后的字节为 0), 和记录编号一起放入键数组.
+ *   - 对键数组做 LSD 基数排序, 每趟 8 位, 所有键在某个字节上都相同时跳过这一趟.
+ *   按 `name` 排序时, 前 8 个字节相同的记录再用 strncmp() 比较.
+ *   - 按排好的顺序把记录复制到暂存缓冲区, 以 @ref ES_STAGE 字节为单位顺序写入临时文件.
+ *
+ * # 归并
+ * 用败者树做 k 路归并, 每次取出最小的记录只需要 log2(k) 次比较.
+ * 每个有序段有两个块缓冲区, 消费一个块时另一个块的读取已经通过 ioQueue.h 提交,
+ * 输出同样使用两个缓冲区异步写入, 归并线程很少等待 I/O.
+ * 有序段太多, 每段两个块(不小于 @ref ES_MIN_BLOCK)放不进内存预算时,
+ * 先把它们分组归并为较少的有序段, 再做最后一趟归并.
+ *
+ * 临时文件在 @ref esOptions 的 `tmpDir` 中创建, 创建后立即删除(或者使用 `O_TMPFILE`),
+ * 进程退出时自动释放空间.
+ *
+ * @example extSortBench.c
+ */
+#ifndef EXT_SORT_H
+#define EXT_SORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "recordStore.h"
+
+#define ES_BY_TOTAL 0           //!< 按 total 升序
+#define ES_BY_NAME 1            //!< 按 name 升序(strncmp)
+
+#define ES_STAGE (1024 * 1024)          //!< 写有序段时的暂存缓冲区大小
+#define ES_BLOCK (1024 * 1024)          //!< 归并时每个块的最大字节数
+#define ES_MIN_BLOCK (64 * 1024)        //!< 归并时每个块的最小字节数
+#define ES_MAX_THREADS 64
+
+/**
+ * @brief 排序选项
+ */
+struct esOptions {
+    int key;                    //!< @ref ES_BY_TOTAL 或 @ref ES_BY_NAME
+    size_t memBytes;            //!< 内存预算
+    int nthreads;               //!< 生成有序段的线程数
+    const char *tmpDir;         //!< 临时文件目录, 为 NULL 时使用输出文件所在的目录
+};
+
+/**
+ * @brief 排序的统计信息
+ */
+struct esStats {
+    uint64_t records;
+    uint64_t runs;              //!< 有序段个数
+    int passes;                 //!< 归并的趟数, 包括最后一趟
+    double formSec;             //!< 生成有序段的时间
+    double mergeSec;            //!< 归并的时间
+};
+
+/**
+ * @brief 排序记录文件
+ *
+ * @param in 输入文件
+ * @param out 输出文件, 可以与输入文件相同(所有记录读入之后才创建输出文件)
+ * @param opt 选项
+ * @param st 不为 NULL 时返回统计信息
+ *
+ * @retval 0 成功
+ * @retval -1 失败, 内存预算太小时 errno 为 `EINVAL`, 输入格式不正确时为 `EBADMSG`
+ */
+int
+esSort(const char *in, const char *out, const struct esOptions *opt, struct esStats *st);
+
+#endif
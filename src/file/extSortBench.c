@@ -0,0 +1,226 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "extSort.h"
+
+/*
+ * 外部排序的吞吐量
+ *
+ * 生成一个 sizeMiB 大小的记录文件(total 为随机的 64 位整数, name 为 4 ~ 20 个随机小写字母),
+ * 在 memMiB 的内存预算下分别按 total 和 name 排序, 报告生成有序段, 归并和总的 GB/min,
+ * 然后顺序读取输出文件, 检查记录有序, 个数和内容的校验和与输入相同.
+ * 默认数据量是内存预算的 10 倍.
+ *
+ * 指定 -i 和 -o 时不生成数据, 只排序已有的文件.
+ *
+ * 编译: gcc -O2 -pthread extSortBench.c extSort.c ioQueue.c -o extSortBench
+ * 用法: extSortBench [-d dir] [-s sizeMiB] [-m memMiB] [-t threads] [-k total|name] [-i in -o out]
+ */
+
+#define CHUNK_RECS 16384
+
+void errExit(char *msg)
+{
+    extern int errno;
+    perror(msg);
+    exit(errno);
+}
+
+static double
+nowSec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t
+xorshift(uint64_t *s)
+{
+    *s ^= *s << 13;
+    *s ^= *s >> 7;
+    *s ^= *s << 17;
+    return *s;
+}
+
+/* 与顺序无关的校验和 */
+static uint64_t
+recSum(const struct itemRecord *r)
+{
+    uint64_t h = (uint64_t)r->total * 0x9e3779b97f4a7c15ULL + r->count;
+    int j;
+
+    for (j = 0; j < RS_NAMESIZE && r->name[j] != '\0'; j++)
+        h = (h ^ (unsigned char)r->name[j]) * 0x100000001b3ULL;
+    return h;
+}
+
+static uint64_t
+generate(const char *path, uint64_t n)
+{
+    struct itemRecord *chunk;
+    struct rsHeader hdr;
+    uint64_t seed = 88172645463325252ULL, sum = 0, j, k, len, c;
+    int fd;
+
+    if ((chunk = calloc(CHUNK_RECS, sizeof(struct itemRecord))) == NULL)
+        errExit("calloc");
+    if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR)) == -1)
+        errExit("open");
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, RS_MAGIC, sizeof(hdr.magic));
+    hdr.version = RS_VERSION;
+    hdr.recordSize = sizeof(struct itemRecord);
+    hdr.count = n;
+    if (write(fd, &hdr, sizeof(hdr)) != sizeof(hdr))
+        errExit("write");
+
+    for (j = 0; j < n; j += c) {
+        c = (n - j < CHUNK_RECS) ? n - j : CHUNK_RECS;
+        for (k = 0; k < c; k++) {
+            memset(&chunk[k], 0, sizeof(struct itemRecord));
+            chunk[k].total = xorshift(&seed);
+            chunk[k].count = (j + k) & 0x7fff;
+            for (len = 4 + xorshift(&seed) % 17; len > 0; len--)
+                chunk[k].name[len - 1] = 'a' + xorshift(&seed) % 26;
+            sum += recSum(&chunk[k]);
+        }
+        if (write(fd, chunk, c * sizeof(struct itemRecord)) != (ssize_t)(c * sizeof(struct itemRecord)))
+            errExit("write");
+    }
+    if (fsync(fd) == -1)
+        errExit("fsync");
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+    free(chunk);
+    return sum;
+}
+
+/* 检查输出有序, 返回校验和 */
+static uint64_t
+verify(const char *path, int key, uint64_t n)
+{
+    struct itemRecord *chunk, prev;
+    struct rsHeader hdr;
+    uint64_t sum = 0, j, k, c;
+    int fd, bad = 0;
+
+    if ((chunk = malloc(CHUNK_RECS * sizeof(struct itemRecord))) == NULL)
+        errExit("malloc");
+    if ((fd = open(path, O_RDONLY)) == -1)
+        errExit("open");
+    if (read(fd, &hdr, sizeof(hdr)) != sizeof(hdr))
+        errExit("read");
+    if (hdr.count != n || memcmp(hdr.magic, RS_MAGIC, sizeof(hdr.magic)) != 0)
+        printf("  BAD HEADER (count %lu)\n", (unsigned long)hdr.count);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    for (j = 0; j < n; j += c) {
+        c = (n - j < CHUNK_RECS) ? n - j : CHUNK_RECS;
+        if (read(fd, chunk, c * sizeof(struct itemRecord)) != (ssize_t)(c * sizeof(struct itemRecord)))
+            errExit("read");
+        for (k = 0; k < c; k++) {
+            if (j + k > 0 && !bad &&
+                    ((key == ES_BY_TOTAL && prev.total > chunk[k].total) ||
+                     (key == ES_BY_NAME && strncmp(prev.name, chunk[k].name, RS_NAMESIZE) > 0))) {
+                printf("  NOT SORTED at record %lu\n", (unsigned long)(j + k));
+                bad = 1;
+            }
+            prev = chunk[k];
+            sum += recSum(&chunk[k]);
+        }
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+    free(chunk);
+    return sum;
+}
+
+static void
+report(const char *name, uint64_t bytes, const struct esStats *st)
+{
+    double gb = bytes / 1e9;
+
+    printf("%-6s %6.2f GB  %lu runs  %d pass  form %6.2f GB/min  merge %6.2f GB/min  "
+            "total %6.2f GB/min\n", name, gb, (unsigned long)st->runs, st->passes,
+            gb / st->formSec * 60, gb / st->mergeSec * 60,
+            gb / (st->formSec + st->mergeSec) * 60);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const char *dir = "/var/tmp", *in = NULL, *out = NULL;
+    char inPath[PATH_MAX], outPath[PATH_MAX];
+    struct esOptions opt;
+    struct esStats st;
+    long sizeMiB = 2048, memMiB = 0;
+    uint64_t n, sum;
+    double start;
+    int opt2, keys = 3, k;
+
+    memset(&opt, 0, sizeof(opt));
+    opt.nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    while ((opt2 = getopt(argc, argv, "d:s:m:t:k:i:o:")) != -1) {
+        switch (opt2) {
+        case 'd': dir = optarg; break;
+        case 's': sizeMiB = atol(optarg); break;
+        case 'm': memMiB = atol(optarg); break;
+        case 't': opt.nthreads = atoi(optarg); break;
+        case 'k': keys = (strcmp(optarg, "name") == 0) ? 2 : 1; break;
+        case 'i': in = optarg; break;
+        case 'o': out = optarg; break;
+        default:
+            fprintf(stderr, "Usage: %s [-d dir] [-s sizeMiB] [-m memMiB] [-t threads] "
+                    "[-k total|name] [-i in -o out]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (memMiB == 0)
+        memMiB = (sizeMiB / 10 > 16) ? sizeMiB / 10 : 16;
+    if (sizeMiB <= 0 || (in == NULL) != (out == NULL)) {
+        fprintf(stderr, "sizeMiB must be > 0, -i and -o go together\n");
+        exit(EXIT_FAILURE);
+    }
+    opt.memBytes = (size_t)memMiB << 20;
+    opt.tmpDir = (in == NULL) ? dir : NULL;
+
+    if (in != NULL) {
+        opt.key = (keys == 2) ? ES_BY_NAME : ES_BY_TOTAL;
+        if (esSort(in, out, &opt, &st) == -1)
+            errExit("esSort");
+        report((keys == 2) ? "name" : "total", st.records * sizeof(struct itemRecord), &st);
+        exit(EXIT_SUCCESS);
+    }
+
+    snprintf(inPath, sizeof(inPath), "%s/extSort.in", dir);
+    snprintf(outPath, sizeof(outPath), "%s/extSort.out", dir);
+    n = ((uint64_t)sizeMiB << 20) / sizeof(struct itemRecord);
+    printf("%lu records, memory %ld MiB, %d threads\n", (unsigned long)n, memMiB, opt.nthreads);
+    start = nowSec();
+    sum = generate(inPath, n);
+    printf("generate %.1f s\n", nowSec() - start);
+
+    for (k = 0; k < 2; k++) {
+        if (!(keys & (1 << k)))
+            continue;
+        opt.key = (k == 0) ? ES_BY_TOTAL : ES_BY_NAME;
+        if (esSort(inPath, outPath, &opt, &st) == -1)
+            errExit("esSort");
+        report((k == 0) ? "total" : "name", n * sizeof(struct itemRecord), &st);
+        if (verify(outPath, opt.key, n) != sum)
+            printf("  CHECKSUM MISMATCH\n");
+    }
+
+    unlink(inPath);
+    unlink(outPath);
+    exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,677 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/inotify.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include "fdCache.h"
+
+/* 目录中的目录项被创建, 删除或移走, 以及文件系统被卸载 */
+#define DIR_MASK (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_UNMOUNT | IN_ONLYDIR)
+
+#define MAX_SYMLINKS 40                 // 与内核解析路径时的限制相同
+
+/* O_CREAT 只影响文件不存在时的行为, O_CLOEXEC 总是加上 */
+#define KEY_FLAGS(f) ((f) & ~(O_CREAT | O_CLOEXEC))
+
+static uint64_t
+hashKey(const char *path, int flags)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    while (*path != '\0')
+        h = (h ^ (unsigned char)*path++) * 0x100000001b3ULL;
+    h ^= (uint64_t)(unsigned)flags * 0x9e3779b97f4a7c15ULL;
+    return h ^ (h >> 29);
+}
+
+static uint64_t
+hashDep(int wd, const char *name)
+{
+    return hashKey(name, wd);
+}
+
+static uint64_t
+hashDir(const char *path, size_t len)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    while (len-- > 0)
+        h = (h ^ (unsigned char)*path++) * 0x100000001b3ULL;
+    return h ^ (h >> 29);
+}
+
+/* path 的目录部分的长度, 包括最后的 '/' */
+static size_t
+dirLength(const char *path)
+{
+    const char *slash = strrchr(path, '/');
+
+    return (slash == NULL) ? 0 : slash - path + 1;
+}
+
+static void
+lruRemove(struct fdCache *fc, struct fcEntry *e)
+{
+    if (e->prev != NULL)
+        e->prev->next = e->next;
+    else
+        fc->lruHead = e->next;
+    if (e->next != NULL)
+        e->next->prev = e->prev;
+    else
+        fc->lruTail = e->prev;
+    e->prev = e->next = NULL;
+}
+
+static void
+lruPush(struct fdCache *fc, struct fcEntry *e)
+{
+    e->prev = NULL;
+    e->next = fc->lruHead;
+    if (fc->lruHead != NULL)
+        fc->lruHead->prev = e;
+    else
+        fc->lruTail = e;
+    fc->lruHead = e;
+}
+
+static struct fcWatch **
+watchBucket(struct fdCache *fc, int wd)
+{
+    return &fc->watches[((uint32_t)wd * 0x9e3779b1u) & (fc->nbuckets - 1)];
+}
+
+static struct fcWatch *
+watchFind(struct fdCache *fc, int wd)
+{
+    struct fcWatch *w;
+
+    for (w = *watchBucket(fc, wd); w != NULL && w->wd != wd; w = w->next)
+        ;
+    return w;
+}
+
+/* 监视目录 dir, 增加引用计数. 调用时持有锁 */
+static int
+watchGet(struct fdCache *fc, const char *dir)
+{
+    struct fcWatch *w;
+    int wd;
+
+    if ((wd = inotify_add_watch(fc->inotifyFd, dir, DIR_MASK)) == -1)
+        return -1;
+    if ((w = watchFind(fc, wd)) == NULL) {
+        if ((w = malloc(sizeof(struct fcWatch))) == NULL) {
+            inotify_rm_watch(fc->inotifyFd, wd);
+            return -1;
+        }
+        w->wd = wd;
+        w->refs = 0;
+        w->next = *watchBucket(fc, wd);
+        *watchBucket(fc, wd) = w;
+    }
+    w->refs++;
+    return wd;
+}
+
+/* 减少引用计数, 没有目录项使用时删除监视. 调用时持有锁 */
+static void
+watchPut(struct fdCache *fc, int wd)
+{
+    struct fcWatch **pp, *w;
+
+    for (pp = watchBucket(fc, wd); (w = *pp) != NULL && w->wd != wd; pp = &w->next)
+        ;
+    if (w == NULL || --w->refs > 0)
+        return;
+    *pp = w->next;
+    inotify_rm_watch(fc->inotifyFd, wd);
+    free(w);
+}
+
+/* 记录 dir 中的目录项 name, 不持有锁调用 */
+static int
+addDep(struct fdCache *fc, struct fcEntry *e, const char *dir, const char *name, size_t len)
+{
+    struct fcDep *deps, *d;
+    int wd;
+
+    if (e->ndeps % 8 == 0) {
+        if ((deps = realloc(e->deps, (e->ndeps + 8) * sizeof(struct fcDep))) == NULL)
+            return -1;
+        e->deps = deps;
+    }
+    d = &e->deps[e->ndeps];
+    if ((d->name = strndup(name, len)) == NULL)
+        return -1;
+    pthread_mutex_lock(&fc->mtx);
+    wd = watchGet(fc, dir);
+    pthread_mutex_unlock(&fc->mtx);
+    if (wd == -1) {
+        free(d->name);
+        return -1;
+    }
+    d->wd = wd;
+    d->hash = hashDep(wd, d->name);
+    d->entry = e;
+    d->next = NULL;
+    d->pprev = NULL;
+    e->ndeps++;
+    return 0;
+}
+
+/* 把目录项加入 (wd, name) 哈希链. 调用时持有锁 */
+static void
+linkDeps(struct fdCache *fc, struct fcEntry *e)
+{
+    struct fcDep **pp, *d;
+    int j;
+
+    for (j = 0; j < e->ndeps; j++) {
+        d = &e->deps[j];
+        pp = &fc->depBuckets[d->hash & (fc->ndepBuckets - 1)];
+        d->next = *pp;
+        if (d->next != NULL)
+            d->next->pprev = &d->next;
+        d->pprev = pp;
+        *pp = d;
+    }
+}
+
+/* 从哈希链中移除目录项并释放它们的监视. 调用时持有锁 */
+static void
+releaseDeps(struct fdCache *fc, struct fcEntry *e)
+{
+    struct fcDep *d;
+    int j;
+
+    for (j = 0; j < e->ndeps; j++) {
+        d = &e->deps[j];
+        if (d->pprev != NULL) {
+            *d->pprev = d->next;
+            if (d->next != NULL)
+                d->next->pprev = d->pprev;
+        }
+        watchPut(fc, d->wd);
+        free(d->name);
+    }
+    free(e->deps);
+    e->deps = NULL;
+    e->ndeps = 0;
+}
+
+/*
+ * 逐级解析 path, 记录经过的每一个目录项. 遇到符号链接时把它指向的路径拼到剩余部分前面,
+ * 继续解析, 所以符号链接本身和它指向的路径都被记录.
+ * 每一级先监视目录再 lstat() 其中的目录项, 监视之后的改变都会产生事件.
+ */
+static int
+watchPath(struct fdCache *fc, struct fcEntry *e, const char *path)
+{
+    char dir[PATH_MAX], rest[PATH_MAX], next[PATH_MAX], target[PATH_MAX];
+    const char *comp, *p, *q;
+    size_t len, dirLen, n;
+    struct stat sb;
+    ssize_t linkLen;
+    int links = 0;
+
+    if (strlen(path) >= sizeof(rest)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(rest, path);
+    strcpy(dir, (path[0] == '/') ? "/" : ".");
+
+    for (p = rest; ; ) {
+        while (*p == '/')
+            p++;
+        if (*p == '\0')
+            return 0;
+        for (comp = p, len = 0; comp[len] != '\0' && comp[len] != '/'; len++)
+            ;
+        p += len;
+        if (len == 1 && comp[0] == '.')
+            continue;
+
+        dirLen = strlen(dir);
+        if (dirLen + 1 + len >= sizeof(next))
+            goto tooLong;
+        memcpy(next, dir, dirLen);
+        n = dirLen;
+        if (dir[dirLen - 1] != '/')
+            next[n++] = '/';
+        memcpy(next + n, comp, len);
+        next[n + len] = '\0';
+
+        // ".." 随所在目录移动, 目录本身的移动由它在上一级目录中的目录项监视
+        if (len == 2 && comp[0] == '.' && comp[1] == '.') {
+            strcpy(dir, next);
+            continue;
+        }
+
+        // 第一次到达最后一级时, 之前的目录项都是解析 path 的目录部分得到的
+        for (q = p; *q == '/'; q++)
+            ;
+        if (*q == '\0' && e->dirDeps == -1)
+            e->dirDeps = e->ndeps;
+        if (addDep(fc, e, dir, comp, len) == -1)
+            return -1;
+        if (lstat(next, &sb) == -1) {
+            // 最后一级不存在时可能由 O_CREAT 创建, 创建会产生事件
+            return (errno == ENOENT && *q == '\0') ? 0 : -1;
+        }
+
+        if (S_ISLNK(sb.st_mode)) {
+            if (++links > MAX_SYMLINKS) {
+                errno = ELOOP;
+                return -1;
+            }
+            if ((linkLen = readlink(next, target, sizeof(target))) == -1)
+                return -1;
+            if ((size_t)linkLen + strlen(p) >= sizeof(target))
+                goto tooLong;
+            strcpy(target + linkLen, p);
+            strcpy(rest, target);
+            p = rest;
+            if (rest[0] == '/')
+                strcpy(dir, "/");
+            continue;
+        }
+        strcpy(dir, next);
+    }
+
+tooLong:
+    errno = ENAMETOOLONG;
+    return -1;
+}
+
+static struct fcEntry *
+dirLookup(struct fdCache *fc, const char *path, size_t dirLen, uint64_t hash)
+{
+    struct fcEntry *e;
+
+    for (e = fc->dirBuckets[hash & (fc->nbuckets - 1)]; e != NULL; e = e->dnext)
+        if (e->dirHash == hash && e->dirLen == dirLen && memcmp(e->path, path, dirLen) == 0)
+            return e;
+    return NULL;
+}
+
+/* 复制 sib 解析目录部分的目录项, 再加上目录中的 name. 调用时持有锁 */
+static int
+copyDirDeps(struct fdCache *fc, struct fcEntry *e, const struct fcEntry *sib, const char *name)
+{
+    const struct fcDep *from;
+    struct fcDep *d;
+    int j, n = sib->dirDeps + 1;
+
+    // 与 addDep() 一样按 8 个一组分配
+    if ((e->deps = malloc((n + 7) / 8 * 8 * sizeof(struct fcDep))) == NULL)
+        return -1;
+    for (j = 0; j < n; j++) {
+        from = &sib->deps[j];
+        d = &e->deps[j];
+        if ((d->name = strdup((j < sib->dirDeps) ? from->name : name)) == NULL)
+            return -1;
+        d->wd = from->wd;
+        d->hash = (j < sib->dirDeps) ? from->hash : hashDep(d->wd, d->name);
+        d->entry = e;
+        d->next = NULL;
+        d->pprev = NULL;
+        watchFind(fc, d->wd)->refs++;
+        e->ndeps++;
+    }
+    e->dirDeps = sib->dirDeps;
+    return 0;
+}
+
+/*
+ * 监视 path 经过的目录项. 同一目录中已经有缓存的文件时复用它的目录部分,
+ * 最后一级是符号链接时仍然完整地解析
+ */
+static int
+watchFile(struct fdCache *fc, struct fcEntry *e, const char *path)
+{
+    const char *base = path + e->dirLen;
+    struct fcEntry *sib;
+    struct stat sb;
+    int reused = 0;
+
+    if (e->dirHash != 0) {
+        pthread_mutex_lock(&fc->mtx);
+        if ((sib = dirLookup(fc, path, e->dirLen, e->dirHash)) != NULL)
+            reused = copyDirDeps(fc, e, sib, base) == 0;
+        pthread_mutex_unlock(&fc->mtx);
+        if (reused && (lstat(path, &sb) == 0 ? !S_ISLNK(sb.st_mode) : errno == ENOENT))
+            return 0;
+        if (e->deps != NULL) {
+            pthread_mutex_lock(&fc->mtx);
+            releaseDeps(fc, e);
+            pthread_mutex_unlock(&fc->mtx);
+        }
+        e->dirDeps = -1;
+    }
+    return watchPath(fc, e, path);
+}
+
+static void
+freeEntry(struct fcEntry *e)
+{
+    int j;
+
+    if (e->fd != -1)
+        close(e->fd);
+    for (j = 0; j < e->ndeps; j++)
+        free(e->deps[j].name);
+    free(e->deps);
+    free(e->path);
+    free(e);
+}
+
+/* 从哈希表中移除并释放目录项的监视 */
+static void
+unlinkEntry(struct fdCache *fc, struct fcEntry *e)
+{
+    struct fcEntry **pp;
+
+    for (pp = &fc->buckets[e->hash & (fc->nbuckets - 1)]; *pp != e; pp = &(*pp)->hnext)
+        ;
+    *pp = e->hnext;
+    if (e->dprev != NULL) {
+        *e->dprev = e->dnext;
+        if (e->dnext != NULL)
+            e->dnext->dprev = e->dprev;
+        e->dprev = NULL;
+    }
+    releaseDeps(fc, e);
+    e->stale = 1;
+    fc->count--;
+}
+
+/* 缓存项失效: 空闲的立即关闭, 正在使用的在最后一次 fcRelease() 时关闭 */
+static void
+invalidate(struct fdCache *fc, struct fcEntry *e)
+{
+    unlinkEntry(fc, e);
+    fc->invalidations++;
+    if (e->refs == 0) {
+        lruRemove(fc, e);
+        freeEntry(e);
+    }
+}
+
+static void
+invalidateAll(struct fdCache *fc)
+{
+    struct fcEntry *e, *next;
+    size_t j;
+
+    for (j = 0; j < fc->nbuckets; j++)
+        for (e = fc->buckets[j]; e != NULL; e = next) {
+            next = e->hnext;
+            invalidate(fc, e);
+        }
+}
+
+/* 读出 inotify 队列中的所有事件 */
+static void
+drainEvents(struct fdCache *fc)
+{
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    const struct inotify_event *ev;
+    struct fcDep *d, **bucket;
+    uint64_t hash;
+    ssize_t n;
+    char *p;
+
+    while ((n = read(fc->inotifyFd, buf, sizeof(buf))) > 0) {
+        for (p = buf; p < buf + n; p += sizeof(struct inotify_event) + ev->len) {
+            ev = (const struct inotify_event *)p;
+            // 队列溢出时丢失了事件, 文件系统卸载后路径指向别的文件, 只能清空整个缓存
+            if (ev->mask & (IN_Q_OVERFLOW | IN_UNMOUNT)) {
+                invalidateAll(fc);
+                continue;
+            }
+            // 仍在使用的监视被内核删除, 之后不会再有它的事件
+            if (ev->mask & IN_IGNORED) {
+                if (watchFind(fc, ev->wd) != NULL)
+                    invalidateAll(fc);
+                continue;
+            }
+            if (ev->len == 0)
+                continue;
+            hash = hashDep(ev->wd, ev->name);
+            bucket = &fc->depBuckets[hash & (fc->ndepBuckets - 1)];
+            for (d = *bucket; d != NULL; ) {
+                if (d->hash != hash || d->wd != ev->wd || strcmp(d->name, ev->name) != 0) {
+                    d = d->next;
+                    continue;
+                }
+                if (d != &d->entry->deps[d->entry->ndeps - 1])
+                    fc->pathChanges++;
+                // invalidate() 移除了这个缓存项的所有目录项, 从头再找
+                invalidate(fc, d->entry);
+                d = *bucket;
+            }
+        }
+    }
+}
+
+static struct fcEntry *
+lookup(struct fdCache *fc, const char *path, int flags, uint64_t hash)
+{
+    struct fcEntry *e;
+
+    for (e = fc->buckets[hash & (fc->nbuckets - 1)]; e != NULL; e = e->hnext)
+        if (e->hash == hash && e->flags == flags && strcmp(e->path, path) == 0)
+            return e;
+    return NULL;
+}
+
+int
+fcInit(struct fdCache *fc, size_t capacity)
+{
+    struct rlimit rl;
+    size_t limit;
+
+    memset(fc, 0, sizeof(struct fdCache));
+    if (getrlimit(RLIMIT_NOFILE, &rl) == -1)
+        return -1;
+    limit = (rl.rlim_cur == RLIM_INFINITY || rl.rlim_cur / 2 > FC_MAX_CAPACITY) ?
+            FC_MAX_CAPACITY : rl.rlim_cur / 2;
+    if (capacity == 0 || capacity > limit)
+        capacity = limit;
+    if (capacity == 0) {
+        errno = EMFILE;
+        return -1;
+    }
+    fc->capacity = capacity;
+
+    // 每个缓存项的目录项个数约为路径的深度
+    for (fc->nbuckets = 16; fc->nbuckets < capacity * 2; fc->nbuckets <<= 1)
+        ;
+    fc->ndepBuckets = fc->nbuckets * 4;
+    fc->buckets = calloc(fc->nbuckets, sizeof(struct fcEntry *));
+    fc->watches = calloc(fc->nbuckets, sizeof(struct fcWatch *));
+    fc->dirBuckets = calloc(fc->nbuckets, sizeof(struct fcEntry *));
+    fc->depBuckets = calloc(fc->ndepBuckets, sizeof(struct fcDep *));
+    if (fc->buckets == NULL || fc->watches == NULL || fc->dirBuckets == NULL ||
+            fc->depBuckets == NULL)
+        goto fail;
+    if ((fc->inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) == -1)
+        goto fail;
+    pthread_mutex_init(&fc->mtx, NULL);
+    return 0;
+
+fail:
+    free(fc->buckets);
+    free(fc->watches);
+    free(fc->dirBuckets);
+    free(fc->depBuckets);
+    return -1;
+}
+
+struct fcEntry *
+fcOpen(struct fdCache *fc, const char *path, int flags, mode_t mode)
+{
+    struct fcEntry *e, *old, **dp;
+    struct stat sbFd, sbPath;
+    int key = KEY_FLAGS(flags), cacheable;
+    uint64_t hash = hashKey(path, key);
+    const char *base;
+
+    pthread_mutex_lock(&fc->mtx);
+    drainEvents(fc);
+    if ((e = lookup(fc, path, key, hash)) != NULL) {
+        if (e->refs++ == 0)
+            lruRemove(fc, e);
+        fc->hits++;
+        pthread_mutex_unlock(&fc->mtx);
+        return e;
+    }
+    fc->misses++;
+    pthread_mutex_unlock(&fc->mtx);
+
+    // 不持有锁解析路径和打开文件, 其他线程的命中不必等待
+    if ((e = calloc(1, sizeof(struct fcEntry))) == NULL)
+        return NULL;
+    e->fd = -1;
+    e->flags = key;
+    e->hash = hash;
+    e->refs = 1;
+    e->stale = 1;
+    e->dirDeps = -1;
+    // 最后一级是普通名字时才按目录部分查找, dirHash 为 0 表示不查找
+    e->dirLen = dirLength(path);
+    base = path + e->dirLen;
+    if (base[0] != '\0' && strcmp(base, ".") != 0 && strcmp(base, "..") != 0)
+        e->dirHash = hashDir(path, e->dirLen) | 1;
+    cacheable = !(flags & (O_TRUNC | O_EXCL));
+    if ((e->path = strdup(path)) == NULL ||
+            (cacheable && watchFile(fc, e, path) == -1))
+        cacheable = 0;
+    if (e->path == NULL || (e->fd = open(path, flags | O_CLOEXEC, mode)) == -1) {
+        pthread_mutex_lock(&fc->mtx);
+        releaseDeps(fc, e);
+        pthread_mutex_unlock(&fc->mtx);
+        freeEntry(e);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&fc->mtx);
+    drainEvents(fc);
+    if (!cacheable)
+        goto uncached;
+
+    // 其他线程已经打开了同一个文件
+    if ((old = lookup(fc, path, key, hash)) != NULL) {
+        if (old->refs++ == 0)
+            lruRemove(fc, old);
+        releaseDeps(fc, e);
+        pthread_mutex_unlock(&fc->mtx);
+        freeEntry(e);
+        return old;
+    }
+
+    if (fc->count >= fc->capacity) {
+        // 所有缓存项都在使用中
+        if (fc->lruTail == NULL)
+            goto uncached;
+        old = fc->lruTail;
+        lruRemove(fc, old);
+        unlinkEntry(fc, old);
+        freeEntry(old);
+        fc->evictions++;
+    }
+
+    e->stale = 0;
+    e->hnext = fc->buckets[hash & (fc->nbuckets - 1)];
+    fc->buckets[hash & (fc->nbuckets - 1)] = e;
+    linkDeps(fc, e);
+    if (e->dirHash != 0 && e->dirDeps >= 0) {
+        dp = &fc->dirBuckets[e->dirHash & (fc->nbuckets - 1)];
+        e->dnext = *dp;
+        if (e->dnext != NULL)
+            e->dnext->dprev = &e->dnext;
+        e->dprev = dp;
+        *dp = e;
+    }
+    fc->count++;
+
+    // 解析路径和打开之间可能有改变, 它们的事件可能已经被读出. 加入缓存之后的改变都会使它失效
+    if (fstat(e->fd, &sbFd) == -1 || stat(path, &sbPath) == -1 ||
+            sbFd.st_dev != sbPath.st_dev || sbFd.st_ino != sbPath.st_ino) {
+        unlinkEntry(fc, e);
+        fc->uncached++;
+    }
+    pthread_mutex_unlock(&fc->mtx);
+    return e;
+
+uncached:
+    releaseDeps(fc, e);
+    fc->uncached++;
+    pthread_mutex_unlock(&fc->mtx);
+    return e;
+}
+
+void
+fcRelease(struct fdCache *fc, struct fcEntry *e)
+{
+    pthread_mutex_lock(&fc->mtx);
+    if (--e->refs == 0) {
+        if (e->stale) {
+            pthread_mutex_unlock(&fc->mtx);
+            freeEntry(e);
+            return;
+        }
+        lruPush(fc, e);
+    }
+    pthread_mutex_unlock(&fc->mtx);
+}
+
+void
+fcInvalidate(struct fdCache *fc, const char *path)
+{
+    struct fcEntry *e, *next;
+    size_t j;
+
+    pthread_mutex_lock(&fc->mtx);
+    drainEvents(fc);
+    for (j = 0; j < fc->nbuckets; j++)
+        for (e = fc->buckets[j]; e != NULL; e = next) {
+            next = e->hnext;
+            if (strcmp(e->path, path) == 0)
+                invalidate(fc, e);
+        }
+    pthread_mutex_unlock(&fc->mtx);
+}
+
+void
+fcDestroy(struct fdCache *fc)
+{
+    struct fcEntry *e, *next;
+    struct fcWatch *w, *wnext;
+    size_t j;
+
+    for (j = 0; j < fc->nbuckets; j++) {
+        for (e = fc->buckets[j]; e != NULL; e = next) {
+            next = e->hnext;
+            freeEntry(e);
+        }
+        for (w = fc->watches[j]; w != NULL; w = wnext) {
+            wnext = w->next;
+            free(w);
+        }
+    }
+    // 关闭 inotify 描述符时删除所有监视
+    close(fc->inotifyFd);
+    pthread_mutex_destroy(&fc->mtx);
+    free(fc->buckets);
+    free(fc->watches);
+    free(fc->dirBuckets);
+    free(fc->depBuckets);
+}
@@ -0,0 +1,162 @@
+/**
+ * @file fdCache.h
+ * @author Lock
+ * @date 16 Oct 2026
+ * @brief 按路径和打开标志缓存打开的文件描述符
+ *
+ * 每次 open() 都要解析路径, 检查权限, 分配 `struct file`; close() 又要释放它们.
+ * 反复打开同一批文件时, 这里把文件描述符留在缓存中:
+ *   - 缓存项按 (路径, 打开标志) 查找, 有引用计数. fcOpen() 增加引用, fcRelease() 减少引用.
+ *   - 引用计数为 0 的缓存项按最近使用的顺序排列, 缓存满时关闭最久未使用的一个(LRU).
+ *   - 容量默认取 getrlimit(`RLIMIT_NOFILE`) 软限制的一半, 保证进程的其他部分仍有描述符可用.
+ *
+ * # 失效
+ * 缓存未命中时逐级解析路径(包括其中的符号链接和它们指向的路径),
+ * 用 inotify 监视经过的每一级目录, 并记录路径经过的目录项 (目录, 名字).
+ * 这些目录项被创建, 删除或被 rename() 移走, 覆盖时(`IN_CREATE`, `IN_DELETE`,
+ * `IN_MOVED_FROM`, `IN_MOVED_TO`), 依赖它们的缓存项失效. 这覆盖了文件本身被删除或覆盖,
+ * 符号链接被改指向别的文件, 以及某一级目录被移走或替换. 这些事件在对应的系统调用中
+ * 同步加入 inotify 队列, fcOpen() 查找之前先读出队列中的事件,
+ * 所以在文件被替换之后开始的 fcOpen() 不会返回旧文件.
+ *
+ * 命中时只读一次非阻塞的 inotify 描述符(没有事件时立即返回), 不再解析路径;
+ * 省下的是 open() 的路径解析和 open()/close() 中分配和释放 `struct file` 的开销.
+ * 未命中比直接 open() 慢: 每一级目录都要 lstat() 和 inotify_add_watch().
+ * 同一目录中已经有缓存的文件时, 复用它对目录部分的解析, 只需 lstat() 最后一级.
+ * 缓存项加入缓存之前用 fstat()/stat() 确认路径仍然指向打开的文件,
+ * 之后的改变都会产生事件.
+ *
+ * 没有覆盖的情况: 相对路径按未命中时的工作目录解析, 之后 chdir() 不会使缓存项失效;
+ * 在路径上挂载或卸载其他文件系统不会产生目录项事件.
+ * 监视所在的文件系统被卸载, 或者 inotify 队列溢出时清空整个缓存.
+ *
+ * 正在使用的缓存项失效后, 在最后一次 fcRelease() 时关闭.
+ *
+ * @warning 同一个缓存项的文件描述符由所有使用者共享, 包括文件偏移量.
+ * 只能使用 pread()/pwrite() 或者 `O_APPEND` 写入, 不能 lseek() 或 close() 它.
+ *
+ * @note 带有 `O_TRUNC` 或 `O_EXCL` 的打开, 以及 inotify 监视失败的文件不会被缓存,
+ * fcRelease() 时直接关闭.
+ *
+ * @example fdCacheBench.c
+ */
+#ifndef FD_CACHE_H
+#define FD_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#define FC_MAX_CAPACITY 65536           //!< RLIMIT_NOFILE 为无穷大时的容量
+
+/**
+ * @brief 解析路径时经过的目录项, 它改变时缓存项失效
+ */
+struct fcDep {
+    int wd;                     //!< 所在目录的 inotify 监视描述符
+    char *name;                 //!< 目录中的名字
+    uint64_t hash;              //!< (wd, name) 的哈希值
+    struct fcEntry *entry;
+    struct fcDep *next, **pprev;    //!< 按 (wd, name) 的哈希链, 不在链中时 pprev 为 NULL
+};
+
+/**
+ * @brief 监视的目录, 多个目录项共享同一个监视
+ */
+struct fcWatch {
+    int wd;
+    int refs;                   //!< 使用这个监视的目录项个数, 为 0 时删除监视
+    struct fcWatch *next;
+};
+
+/**
+ * @brief 缓存项
+ */
+struct fcEntry {
+    int fd;                     //!< 打开的文件描述符
+    int flags;                  //!< 打开标志
+    char *path;
+    uint64_t hash;
+    int refs;
+    struct fcDep *deps;         //!< 按解析顺序, 最后一个是文件本身的目录项
+    int ndeps;
+    int dirDeps;                //!< 前 dirDeps 个解析 path 的目录部分, 没有目录部分时为 -1
+    size_t dirLen;              //!< path 的目录部分(包括最后的 '/')的长度
+    uint64_t dirHash;
+    int stale;                  //!< 已经失效或没有缓存, 不在哈希表中
+    struct fcEntry *hnext;      //!< 哈希链
+    struct fcEntry *dnext, **dprev; //!< 按目录部分的哈希链, 同一目录中的文件共享目录的监视
+    struct fcEntry *prev, *next;    //!< LRU 链表, 只包含引用计数为 0 的缓存项
+};
+
+/**
+ * @brief 文件描述符缓存
+ */
+struct fdCache {
+    pthread_mutex_t mtx;
+    struct fcEntry **buckets;
+    size_t nbuckets;            //!< 2 的幂
+    struct fcDep **depBuckets;  //!< 按 (wd, name) 查找事件对应的缓存项
+    size_t ndepBuckets;         //!< 2 的幂
+    struct fcWatch **watches;   //!< 按监视描述符查找, 与 buckets 同样大小
+    struct fcEntry **dirBuckets;    //!< 按 path 的目录部分查找, 与 buckets 同样大小
+    size_t count;               //!< 缓存中的项数, 包括正在使用的
+    size_t capacity;
+    struct fcEntry *lruHead;    //!< 最近使用
+    struct fcEntry *lruTail;    //!< 最久未使用
+    int inotifyFd;
+
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;         //!< 因为容量关闭的缓存项
+    uint64_t invalidations;     //!< 因为文件改变失效的缓存项
+    uint64_t pathChanges;       //!< 其中因为路径中的符号链接或目录改变的
+    uint64_t uncached;          //!< 没有缓存的打开
+};
+
+/**
+ * @brief 初始化缓存
+ *
+ * @param fc 缓存
+ * @param capacity 最多缓存的描述符个数, 为 0 或超过 `RLIMIT_NOFILE` 软限制的一半时使用后者
+ *
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+int
+fcInit(struct fdCache *fc, size_t capacity);
+
+/**
+ * @brief 打开文件, 缓存中有时直接返回
+ *
+ * @param fc 缓存
+ * @param path 文件路径
+ * @param flags open() 的标志, 总是加上 `O_CLOEXEC`. `O_CREAT` 不是查找键的一部分
+ * @param mode 创建文件时的权限
+ *
+ * @return 缓存项, 描述符为其中的 `fd`. 使用完后调用 fcRelease()
+ * @retval NULL 失败
+ */
+struct fcEntry *
+fcOpen(struct fdCache *fc, const char *path, int flags, mode_t mode);
+
+/**
+ * @brief 释放 fcOpen() 返回的缓存项
+ */
+void
+fcRelease(struct fdCache *fc, struct fcEntry *e);
+
+/**
+ * @brief 使路径 @p path 的所有缓存项失效, 例如调用者自己替换了文件之后
+ */
+void
+fcInvalidate(struct fdCache *fc, const char *path);
+
+/**
+ * @brief 关闭所有缓存的描述符并释放缓存. 调用时不能有正在使用的缓存项
+ */
+void
+fcDestroy(struct fdCache *fc);
+
+#endif
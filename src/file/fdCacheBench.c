@@ -0,0 +1,342 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include "fdCache.h"
+
+/*
+ * 文件描述符缓存的效果
+ *
+ * 在一个目录中生成 nfiles 个小文件, 按 Zipf 分布(s = 0.99)选择文件,
+ * 每次操作打开文件, pread() 64 字节, 然后关闭. 对比:
+ *   - open() + pread() + close()
+ *   - fcOpen() + pread() + fcRelease(), 容量分别为 RLIMIT_NOFILE 决定的默认值和更小的值
+ * 报告每秒操作数, 每次操作的耗时和命中率. 最后检查文件被 rename() 覆盖,
+ * 删除, 符号链接改指向和上级目录被替换之后缓存不会返回旧文件.
+ *
+ * 编译: gcc -O2 -pthread fdCacheBench.c fdCache.c -lm -o fdCacheBench
+ * 用法: fdCacheBench [-d dir] [-f nfiles] [-o ops] [-t maxThreads]
+ */
+
+#define ZIPF_S 0.99
+#define MAX_THREADS 64
+
+void errExit(char *msg)
+{
+    extern int errno;
+    perror(msg);
+    exit(errno);
+}
+
+static double
+nowSec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static char dirPath[PATH_MAX / 2];
+static double *cdf;
+static long nfiles;
+static struct fdCache fc;
+
+static uint64_t
+xorshift(uint64_t *s)
+{
+    *s ^= *s << 13;
+    *s ^= *s >> 7;
+    *s ^= *s << 17;
+    return *s;
+}
+
+/* 按 Zipf 分布取一个排名, 再打散到所有文件 */
+static long
+zipf(uint64_t *seed)
+{
+    double u = (xorshift(seed) >> 11) * (1.0 / 9007199254740992.0);
+    long lo = 0, hi = nfiles - 1, mid;
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (cdf[mid] < u)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return (long)((uint64_t)lo * 0x9e3779b97f4a7c15ULL % nfiles);
+}
+
+static void
+filePath(char *buf, long j)
+{
+    snprintf(buf, PATH_MAX, "%s/f%06ld", dirPath, j);
+}
+
+static void
+writeFile(const char *path, const char *content)
+{
+    char tmp[PATH_MAX + 8];
+    int fd;
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    if ((fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR)) == -1)
+        errExit("open");
+    if (write(fd, content, strlen(content)) != (ssize_t)strlen(content))
+        errExit("write");
+    close(fd);
+    if (rename(tmp, path) == -1)
+        errExit("rename");
+}
+
+struct worker {
+    pthread_t tid;
+    int cached;
+    long ops;
+    uint64_t seed;
+};
+
+static void *
+workerMain(void *arg)
+{
+    struct worker *w = arg;
+    struct fcEntry *e;
+    char path[PATH_MAX], buf[64];
+    long j;
+    int fd;
+
+    for (j = 0; j < w->ops; j++) {
+        filePath(path, zipf(&w->seed));
+        if (w->cached) {
+            if ((e = fcOpen(&fc, path, O_RDONLY, 0)) == NULL)
+                errExit("fcOpen");
+            if (pread(e->fd, buf, sizeof(buf), 0) <= 0)
+                errExit("pread");
+            fcRelease(&fc, e);
+        } else {
+            if ((fd = open(path, O_RDONLY | O_CLOEXEC)) == -1)
+                errExit("open");
+            if (pread(fd, buf, sizeof(buf), 0) <= 0)
+                errExit("pread");
+            close(fd);
+        }
+    }
+    return NULL;
+}
+
+static void
+run(int nthreads, long ops, size_t capacity, int cached)
+{
+    struct worker w[MAX_THREADS];
+    double start, elapsed;
+    int k;
+
+    if (cached && fcInit(&fc, capacity) == -1)
+        errExit("fcInit");
+
+    start = nowSec();
+    for (k = 0; k < nthreads; k++) {
+        w[k].cached = cached;
+        w[k].ops = ops / nthreads;
+        w[k].seed = 88172645463325252ULL + k * 7919;
+        if ((errno = pthread_create(&w[k].tid, NULL, workerMain, &w[k])) != 0)
+            errExit("pthread_create");
+    }
+    for (k = 0; k < nthreads; k++)
+        pthread_join(w[k].tid, NULL);
+    elapsed = nowSec() - start;
+    ops = ops / nthreads * nthreads;
+
+    if (cached)
+        printf("fcOpen, capacity %-6zu %2d thr %10.0f op/s %7.0f ns/op  hit %5.1f%%  evict %lu\n",
+                fc.capacity, nthreads, ops / elapsed, elapsed * 1e9 / ops * nthreads,
+                100.0 * fc.hits / (fc.hits + fc.misses), (unsigned long)fc.evictions);
+    else
+        printf("open + close               %2d thr %10.0f op/s %7.0f ns/op\n",
+                nthreads, ops / elapsed, elapsed * 1e9 / ops * nthreads);
+    if (cached)
+        fcDestroy(&fc);
+}
+
+/* 读出缓存中文件的内容 */
+static void
+readCached(const char *path, char *buf, size_t size)
+{
+    struct fcEntry *e;
+    ssize_t n;
+
+    if ((e = fcOpen(&fc, path, O_RDONLY, 0)) == NULL) {
+        snprintf(buf, size, "(%s)", strerror(errno));
+        return;
+    }
+    if ((n = pread(e->fd, buf, size - 1, 0)) == -1)
+        errExit("pread");
+    buf[n] = '\0';
+    fcRelease(&fc, e);
+}
+
+/* 符号链接改指向别的文件, 上级目录被替换: 原文件本身没有 inotify 事件 */
+static int
+checkPathChange(void)
+{
+    char a[PATH_MAX], b[PATH_MAX], link[PATH_MAX], tmp[PATH_MAX];
+    char d1[PATH_MAX], d2[PATH_MAX], x1[PATH_MAX], x2[PATH_MAX], buf[64];
+    int ok = 1;
+
+    snprintf(a, sizeof(a), "%s/a", dirPath);
+    snprintf(b, sizeof(b), "%s/b", dirPath);
+    snprintf(link, sizeof(link), "%s/cur", dirPath);
+    snprintf(tmp, sizeof(tmp), "%s/cur.tmp", dirPath);
+    writeFile(a, "target a");
+    writeFile(b, "target b");
+    if (symlink("a", link) == -1)
+        errExit("symlink");
+    readCached(link, buf, sizeof(buf));
+    ok &= strcmp(buf, "target a") == 0;
+    if (symlink("b", tmp) == -1 || rename(tmp, link) == -1)
+        errExit("symlink");
+    readCached(link, buf, sizeof(buf));
+    ok &= strcmp(buf, "target b") == 0;
+
+    snprintf(d1, sizeof(d1), "%s/d1", dirPath);
+    snprintf(d2, sizeof(d2), "%s/d2", dirPath);
+    snprintf(x1, sizeof(x1), "%s/d1/x", dirPath);
+    snprintf(x2, sizeof(x2), "%s/d2/x", dirPath);
+    if (mkdir(d1, S_IRWXU) == -1 || mkdir(d2, S_IRWXU) == -1)
+        errExit("mkdir");
+    writeFile(x1, "dir 1");
+    writeFile(x2, "dir 2");
+    readCached(x1, buf, sizeof(buf));
+    ok &= strcmp(buf, "dir 1") == 0;
+    snprintf(tmp, sizeof(tmp), "%s/d.tmp", dirPath);
+    if (rename(d1, tmp) == -1 || rename(d2, d1) == -1 || rename(tmp, d2) == -1)
+        errExit("rename");
+    readCached(x1, buf, sizeof(buf));
+    ok &= strcmp(buf, "dir 2") == 0;
+
+    unlink(x1);
+    unlink(x2);
+    rmdir(d1);
+    rmdir(d2);
+    unlink(link);
+    unlink(a);
+    unlink(b);
+    return ok;
+}
+
+static void
+checkInvalidation(void)
+{
+    char path[PATH_MAX], buf[64];
+    struct fcEntry *held;
+    int ok = 1;
+
+    if (fcInit(&fc, 0) == -1)
+        errExit("fcInit");
+    filePath(path, 0);
+
+    writeFile(path, "version 1");
+    readCached(path, buf, sizeof(buf));
+    ok &= strcmp(buf, "version 1") == 0;
+
+    // rename() 覆盖
+    writeFile(path, "version 2");
+    readCached(path, buf, sizeof(buf));
+    ok &= strcmp(buf, "version 2") == 0;
+
+    // 正在使用时被覆盖: 使用者继续读旧文件, 新的打开得到新文件
+    if ((held = fcOpen(&fc, path, O_RDONLY, 0)) == NULL)
+        errExit("fcOpen");
+    writeFile(path, "version 3");
+    readCached(path, buf, sizeof(buf));
+    ok &= strcmp(buf, "version 3") == 0;
+    ok &= pread(held->fd, buf, 9, 0) == 9 && memcmp(buf, "version 2", 9) == 0;
+    fcRelease(&fc, held);
+
+    // 删除
+    if (unlink(path) == -1)
+        errExit("unlink");
+    ok &= fcOpen(&fc, path, O_RDONLY, 0) == NULL && errno == ENOENT;
+
+    ok &= checkPathChange();
+
+    printf("invalidation: %s (hits %lu, misses %lu, invalidations %lu, path changes %lu)\n",
+            ok ? "ok" : "FAILED", (unsigned long)fc.hits, (unsigned long)fc.misses,
+            (unsigned long)fc.invalidations, (unsigned long)fc.pathChanges);
+    fcDestroy(&fc);
+    writeFile(path, "file 0");
+}
+
+int
+main(int argc, char *argv[])
+{
+    const char *dir = "/var/tmp";
+    char path[PATH_MAX], content[32];
+    long ops = 2000000, j;
+    int maxThreads = 4, opt, t;
+    struct rlimit rl;
+    double sum;
+
+    nfiles = 20000;
+    while ((opt = getopt(argc, argv, "d:f:o:t:")) != -1) {
+        switch (opt) {
+        case 'd': dir = optarg; break;
+        case 'f': nfiles = atol(optarg); break;
+        case 'o': ops = atol(optarg); break;
+        case 't': maxThreads = atoi(optarg); break;
+        default:
+            fprintf(stderr, "Usage: %s [-d dir] [-f nfiles] [-o ops] [-t maxThreads]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (nfiles <= 0 || ops <= 0 || maxThreads < 1 || maxThreads > MAX_THREADS) {
+        fprintf(stderr, "nfiles and ops must be > 0, maxThreads in [1, %d]\n", MAX_THREADS);
+        exit(EXIT_FAILURE);
+    }
+
+    snprintf(dirPath, sizeof(dirPath), "%s/fdCache.d", dir);
+    if (mkdir(dirPath, S_IRWXU) == -1 && errno != EEXIST)
+        errExit("mkdir");
+    for (j = 0; j < nfiles; j++) {
+        filePath(path, j);
+        snprintf(content, sizeof(content), "file %ld", j);
+        writeFile(path, content);
+    }
+
+    if ((cdf = malloc(nfiles * sizeof(double))) == NULL)
+        errExit("malloc");
+    for (sum = 0, j = 0; j < nfiles; j++)
+        cdf[j] = sum += 1.0 / pow(j + 1, ZIPF_S);
+    for (j = 0; j < nfiles; j++)
+        cdf[j] /= sum;
+
+    if (getrlimit(RLIMIT_NOFILE, &rl) == -1)
+        errExit("getrlimit");
+    printf("RLIMIT_NOFILE %lu, %ld files\n", (unsigned long)rl.rlim_cur, nfiles);
+
+    for (t = 1; t <= maxThreads; t *= 2) {
+        run(t, ops, 0, 0);
+        run(t, ops, 0, 1);
+        run(t, ops, 1000, 1);
+        run(t, ops, 100, 1);
+    }
+    checkInvalidation();
+
+    for (j = 0; j < nfiles; j++) {
+        filePath(path, j);
+        unlink(path);
+    }
+    rmdir(dirPath);
+    free(cdf);
+    exit(EXIT_SUCCESS);
+}
@@ -15,6 +15,7 @@
  * 当操作磁盘文件时, 缓冲大块数据以减少系统调用( read(), write()), C 语言函数库的 I/O 函数
  * 比如( fprintf(), fscanf(), fgets(), fputs(), fgetc())
  * 正是这么做的. 因此, 使用 stdio 库可以使编程者免于自行处理对数据的缓冲.
+ * stdio 的每次调用都要对 FILE 加锁, 写入大量小记录时可以使用 bstream.h 中不加锁的缓冲流.
  *
  * ### 内核缓冲
  * 强制刷新内湖缓冲区到输出文件是可能的, 例如数据库应用要确保在继续操作前将输出真正的写入磁盘.
@@ -23,6 +24,16 @@
  *   仅仅确保数据和一小部分文件属性(如文件大小)被正确地写入到了磁盘上.
  *   - `synchronized I/O file integrity completion`: 保证文件完整性,
  *   确保数据以及文件的所有属性都已经被正确的写入到了磁盘上.
+ *
+ * wal.h 在 fdatasync() 之上实现了组提交的预写日志, 多个线程的提交合并为一次刷新.
+ *
+ * # 记录文件
+ * file.c 使用 fwrite() 写出带有编译器填充的结构体, 文件格式依赖于平台.
+ * recordStore.h 为同样的记录定义了带版本号的紧凑磁盘格式,
+ * 并通过 mmap() 按记录编号随机访问. 只扫描个别字段时,
+ * 可以用 columnStore.h 转换为按列存放的格式. 按名字查找记录使用 nameIndex.h 中的哈希索引.
+ *
+ * @example file.c
  */
 
 #include <unistd.h>
@@ -59,7 +70,8 @@
  * 系统默认缓冲区大小<BR>
  * 系统会自动设定该大小为最适合的大小来作为输入输出缓冲区的大小.
  * 并且保证至少为 `256` 个字节.<BR>
- * 也可以通过查看 fstat() 函数返回的结构中的 `st_blksize` 字段来设定最适合系统缓冲区大小的值.
+ * 也可以通过查看 fstat() 函数返回的结构中的 `st_blksize` 字段来设定最适合系统缓冲区大小的值.<BR>
+ * 不同缓冲区大小下各种 I/O 方式的吞吐量和系统调用次数可以用 bufSweepBench.c 测量.
  */
 #define BUFSIZ 1
 
@@ -69,6 +81,7 @@
  * <unistd.h>
  *
  * 文件描述符属于有限资源,当一个文件描述符不再使用时, 手动关闭该文件描述符是良好的编程习惯.
+ * 反复打开和关闭同一批文件时, 可以用 fdCache.h 缓存打开的描述符.
  *
  * @param fd 指定要关闭的文件描述符
  *
@@ -196,6 +209,8 @@ lseek(int fd, off_t offset, int whence);
  *     errExit("close");
  * @endcode
  *
+ * 生成的文件写完后要原子地出现在最终路径上时, 可以使用 publish.h.
+ *
  * @return 返回创建的临时文件的文件描述符
  * @retval -1 函数执行失败
  *
@@ -237,6 +252,7 @@ mkstemp(char *template);
  *   - `O_TRUNC` 如果文件存在, 且为只写或读写, 打开文件的同时截断文件内容, 即清空文件.
  *   - ---
  *   - `O_APPEND` 打开文件时自动将文件指针移动到文件结尾, 用于向文件中追加内容.
+ *   多个进程同时追加同一个文件时, 带分帧和校验的记录格式见 sharedLog.h.
  *   - `O_ASYNC` 当对于 open() 调用所返回的文件描述符可以实施I/O操作时,
  *   系统会产生一个信号通知进程. 这一特性被称为信号驱动I/O, 仅对特定类型文件有效,
  *   如 socket, 终端, FIIFOS.
@@ -284,7 +300,9 @@ open(const char *pathname, int flags, mode_t mode);
  *
  * <unistd.h>
  *
- * 使设置偏移量与读取操作成为原子操作
+ * 使设置偏移量与读取操作成为原子操作.
+ * 不修改文件偏移量, 多个线程可以共享同一个文件描述符读取不同的区域, 参见 parallelCopy.h.
+ * 按访问模式向内核提供预读和页缓存提示, 见 ioHint.h.
  *
  * @param fd 文件描述符
  * @param buf 用于保存读取到的字节
@@ -305,7 +323,8 @@ pread(int fd, void *buf, size_t count, off_t offset);
  *
  * <unistd.h>
  *
- * 使设置偏移量与写入操作成为原子操作
+ * 使设置偏移量与写入操作成为原子操作.
+ * 一次写入多个不连续的缓冲区可以使用 pwritev(), 追加大量小记录时见 appendBatch.h.
  *
  * @param fd 文件描述符
  * @param buf 用于保存要写入的字节
@@ -437,6 +456,8 @@ int ftruncate(int fd, off_t length);
  * 如果再此期间, 另一进程试图访问这几个字节, 那么内核将自动从缓冲区高速缓存中提供这些数据,
  * 而不是从文件中(读取过期的内容)
  *
+ * 磁盘带宽是瓶颈时, 记录和日志文件可以分块压缩后写入, 见 lzFile.h.
+ *
  * @see read()
  * @see pwrite()
  */
@@ -739,6 +760,8 @@ getchar(void);
 /**
  * @brief 读取一行的文件
  *
+ * 逐行读取大文件(如日志)时, 可以使用 lineSplit.h 中不复制数据的行切分器.
+ *
  * @param buf 用于存储获取到的字符串
  * @param n 缓冲区大小
  * @param fp 指定要读取的文件流
@@ -916,6 +939,8 @@ sprintf(char *restrict buf, const char *restrict format, ...);
  * @brief 向指定的缓冲区中写入格式化字符串
  *
  * 该函数同时指定了允许向缓冲区传入的最大字符数, 超过的字符都将被丢弃掉.
+ * 每次调用都要解析格式字符串并查询 locale, 热路径上格式化数字可以使用
+ * ../lib/fmt_num.h 中的函数(C++ 中可以使用 ../lib/fmt.hpp).
  *
  * @param buf 缓冲区地址
  * @param n 允许的最大字符数
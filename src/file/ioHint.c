@@ -0,0 +1,190 @@
+#define _GNU_SOURCE
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "ioHint.h"
+
+static off_t pageSize;
+
+static off_t
+pageDown(off_t off)
+{
+    return off & ~(pageSize - 1);
+}
+
+/* 整个文件的访问方式 */
+static void
+adviseAll(struct ioHint *ih, int advice, int madvice)
+{
+    if (ih->map != NULL)
+        madvise(ih->map, ih->size, madvice);
+    else
+        posix_fadvise(ih->fd, 0, 0, advice);
+    ih->hints++;
+}
+
+/* 预读 [off, off + len) */
+static void
+prefetch(struct ioHint *ih, off_t off, off_t len, int seq)
+{
+    off_t start;
+
+    if (off >= ih->size)
+        return;
+    if (len > ih->size - off)
+        len = ih->size - off;
+    if (ih->map != NULL) {
+        start = pageDown(off);
+        madvise(ih->map + start, off + len - start, MADV_WILLNEED);
+    } else if (seq) {
+        readahead(ih->fd, off, len);
+    } else {
+        posix_fadvise(ih->fd, off, len, POSIX_FADV_WILLNEED);
+    }
+    ih->hints++;
+}
+
+/* 丢弃 [dropEnd, end) 中的整页 */
+static void
+dropTo(struct ioHint *ih, off_t end)
+{
+    off_t start = ih->dropEnd;
+
+    end = (end >= ih->size) ? ih->size : pageDown(end);
+    if (end <= start)
+        return;
+    if (ih->map != NULL)
+        madvise(ih->map + start, end - start, MADV_DONTNEED);
+    if (ih->fd != -1)
+        posix_fadvise(ih->fd, start, end - start, POSIX_FADV_DONTNEED);
+    ih->hints++;
+    ih->droppedBytes += end - start;
+    ih->dropEnd = end;
+}
+
+static void
+setPattern(struct ioHint *ih, int pattern, off_t off)
+{
+    // 离开顺序访问时, 丢弃这次扫描剩下的页
+    if (ih->pattern == IH_SEQUENTIAL && (ih->flags & IH_DROP_BEHIND))
+        dropTo(ih, ih->lastEnd);
+
+    ih->pattern = pattern;
+    ih->switches++;
+    switch (pattern) {
+    case IH_SEQUENTIAL:
+        adviseAll(ih, POSIX_FADV_SEQUENTIAL, MADV_SEQUENTIAL);
+        ih->raEnd = off;
+        ih->dropEnd = pageDown(ih->runStart);
+        break;
+    case IH_STRIDED:
+        adviseAll(ih, POSIX_FADV_RANDOM, MADV_RANDOM);
+        ih->strideNext = off;
+        break;
+    case IH_RANDOM:
+        adviseAll(ih, POSIX_FADV_RANDOM, MADV_RANDOM);
+        break;
+    }
+}
+
+int
+ihInit(struct ioHint *ih, int fd, void *map, size_t mapSize, int flags)
+{
+    struct stat sb;
+
+    memset(ih, 0, sizeof(struct ioHint));
+    if (pageSize == 0)
+        pageSize = sysconf(_SC_PAGESIZE);
+    ih->fd = fd;
+    ih->flags = flags;
+    ih->map = map;
+    if (map != NULL) {
+        ih->size = mapSize;
+    } else {
+        if (fstat(fd, &sb) == -1)
+            return -1;
+        ih->size = sb.st_size;
+    }
+    ih->lastOff = ih->lastEnd = -1;
+    return 0;
+}
+
+void
+ihAccess(struct ioHint *ih, off_t off, size_t len)
+{
+    off_t end = off + len, stride, start;
+
+    // 判断模式. 顺序访问中重复读取同一段数据(off 在上一次读取的范围内)也算顺序
+    stride = off - ih->lastOff;
+    if (ih->lastEnd != -1 && off >= ih->lastOff && off <= ih->lastEnd &&
+            end > ih->lastEnd) {
+        if (ih->seqRun++ == 0) {
+            ih->runStart = ih->lastOff;
+            // 已经是顺序模式时开始新的一次扫描(例如回到文件开头再读一遍),
+            // 预读和丢弃的位置都从这次扫描开始, 而不是停在上一次扫描结束的地方
+            if (ih->pattern == IH_SEQUENTIAL) {
+                ih->raEnd = off;
+                ih->dropEnd = pageDown(ih->runStart);
+            }
+        }
+        ih->strideRun = ih->misses = 0;
+        if (ih->seqRun >= IH_SEQ_THRESHOLD && ih->pattern != IH_SEQUENTIAL)
+            setPattern(ih, IH_SEQUENTIAL, off);
+    } else if (ih->lastEnd != -1 && stride == ih->stride && stride != 0) {
+        ih->strideRun++;
+        ih->seqRun = ih->misses = 0;
+        if (ih->strideRun >= IH_STRIDE_THRESHOLD && ih->pattern != IH_STRIDED)
+            setPattern(ih, IH_STRIDED, off);
+    } else {
+        ih->seqRun = ih->strideRun = 0;
+        if (++ih->misses >= IH_RAND_THRESHOLD && ih->pattern != IH_RANDOM)
+            setPattern(ih, IH_RANDOM, off);
+    }
+    ih->stride = stride;
+    ih->lastOff = off;
+    ih->lastEnd = end;
+
+    switch (ih->pattern) {
+    case IH_SEQUENTIAL:
+        if (ih->seqRun == 0)
+            break;
+        // 剩下的预读不到一半时再发出一个窗口, 每个窗口只发出一次
+        if (end + IH_READAHEAD / 2 > ih->raEnd) {
+            start = (ih->raEnd > end) ? ih->raEnd : end;
+            prefetch(ih, start, IH_READAHEAD, 1);
+            ih->raEnd = start + IH_READAHEAD;
+        }
+        if ((ih->flags & IH_DROP_BEHIND) && off - ih->dropEnd >= IH_DROP_CHUNK)
+            dropTo(ih, off);
+        break;
+
+    case IH_STRIDED:
+        if (ih->strideRun == 0)
+            break;
+        // strideNext 落后于当前位置(或者跨步变了方向)时从下一个块重新开始
+        if ((ih->strideNext - off) / stride < 1)
+            ih->strideNext = off + stride;
+        while ((ih->strideNext - off) / stride <= IH_STRIDE_AHEAD &&
+                ih->strideNext >= 0 && ih->strideNext < ih->size) {
+            prefetch(ih, ih->strideNext, len, 0);
+            ih->strideNext += stride;
+        }
+        break;
+    }
+}
+
+ssize_t
+ihPread(struct ioHint *ih, void *buf, size_t len, off_t off)
+{
+    ihAccess(ih, off, len);
+    return pread(ih->fd, buf, len, off);
+}
+
+void
+ihEnd(struct ioHint *ih)
+{
+    if (ih->pattern == IH_SEQUENTIAL && (ih->flags & IH_DROP_BEHIND))
+        dropTo(ih, ih->lastEnd);
+}
@@ -0,0 +1,110 @@
+/**
+ * @file ioHint.h
+ * @author Lock
+ * @date 16 Oct 2026
+ * @brief 按访问模式向内核提供页缓存提示
+ *
+ * 内核的预读只认识简单的顺序读, 而且无从知道一次扫描之后数据不会再被访问:
+ * 扫描一个大文件时, 读过的页留在页缓存中, 把其他进程的热点数据挤出去.
+ * 调用者在每次读取之前调用 ihAccess(), 这里根据最近的偏移量判断访问模式:
+ *   - 顺序: 连续 @ref IH_SEQ_THRESHOLD 次读取都从上一次的结尾开始.
+ *   `POSIX_FADV_SEQUENTIAL`(加倍内核预读窗口), 并在当前位置之前保持
+ *   @ref IH_READAHEAD 字节已经发出 readahead(). 使用 @ref IH_DROP_BEHIND 时,
+ *   每读过 @ref IH_DROP_CHUNK 字节就用 `POSIX_FADV_DONTNEED` 丢弃这次扫描读过的页.
+ *   - 跨步: 连续 @ref IH_STRIDE_THRESHOLD 次读取的偏移量之差相同(可以为负).
+ *   `POSIX_FADV_RANDOM` 关闭内核预读(它会读入跨步之间用不到的数据),
+ *   改为对之后的 @ref IH_STRIDE_AHEAD 个块发出 `POSIX_FADV_WILLNEED`.
+ *   - 随机: 连续 @ref IH_RAND_THRESHOLD 次读取不符合以上两种模式. `POSIX_FADV_RANDOM`.
+ *
+ * 访问 mmap() 映射的文件时, 提示改为 madvise() 的 `MADV_SEQUENTIAL`, `MADV_RANDOM`
+ * 和 `MADV_WILLNEED`; 丢弃时先 `MADV_DONTNEED` 解除映射, 再对文件描述符 `POSIX_FADV_DONTNEED`.
+ *
+ * 所有提示都只是建议, 失败时忽略. `POSIX_FADV_DONTNEED` 不会丢弃脏页, 只对读取有效.
+ *
+ * @example ioHintBench.c
+ */
+#ifndef IO_HINT_H
+#define IO_HINT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define IH_SEQ_THRESHOLD 4              //!< 判定为顺序访问需要的连续读取次数
+#define IH_STRIDE_THRESHOLD 3           //!< 判定为跨步访问需要的相同跨步次数
+#define IH_RAND_THRESHOLD 8             //!< 判定为随机访问需要的不规则读取次数
+#define IH_READAHEAD (2 * 1024 * 1024)  //!< 顺序访问时提前发出的预读字节数
+#define IH_STRIDE_AHEAD 16              //!< 跨步访问时提前预取的块数
+#define IH_DROP_CHUNK (4 * 1024 * 1024) //!< 每读过多少字节丢弃一次
+
+#define IH_DROP_BEHIND 01               //!< 顺序访问时丢弃读过的页
+
+#define IH_UNKNOWN 0
+#define IH_SEQUENTIAL 1
+#define IH_STRIDED 2
+#define IH_RANDOM 3
+
+/**
+ * @brief 一个文件描述符或映射区域的访问状态
+ */
+struct ioHint {
+    int fd;                     //!< 只提供映射区域时为 -1
+    int flags;
+    char *map;                  //!< mmap() 映射的文件, 为 NULL 时使用 posix_fadvise()
+    off_t size;                 //!< 文件大小
+
+    int pattern;                //!< @ref IH_SEQUENTIAL 等
+    off_t lastOff;              //!< 上一次读取的偏移量
+    off_t lastEnd;              //!< 上一次读取的结尾
+    off_t stride;               //!< 上一次的跨步
+    int seqRun;
+    int strideRun;
+    int misses;
+    off_t runStart;             //!< 这次顺序访问开始的位置
+    off_t raEnd;                //!< 顺序预读已经发出到的位置
+    off_t strideNext;           //!< 下一个要预取的块
+    off_t dropEnd;              //!< 已经丢弃到的位置
+
+    uint64_t hints;             //!< 发出的提示次数
+    uint64_t droppedBytes;      //!< 丢弃的字节数
+    uint64_t switches;          //!< 访问模式改变的次数
+};
+
+/**
+ * @brief 初始化访问状态
+ *
+ * @param ih 访问状态
+ * @param fd 文件描述符, 由调用者关闭. 只提供 @p map 且不丢弃页时可以为 -1
+ * @param map mmap() 映射的整个文件, 通过 read()/pread() 访问时为 NULL
+ * @param mapSize 映射的大小
+ * @param flags 0 或 @ref IH_DROP_BEHIND
+ *
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+int
+ihInit(struct ioHint *ih, int fd, void *map, size_t mapSize, int flags);
+
+/**
+ * @brief 记录一次即将进行的读取, 按需发出提示
+ *
+ * @param ih 访问状态
+ * @param off 读取的偏移量
+ * @param len 读取的长度
+ */
+void
+ihAccess(struct ioHint *ih, off_t off, size_t len);
+
+/**
+ * @brief ihAccess() 之后 pread()
+ */
+ssize_t
+ihPread(struct ioHint *ih, void *buf, size_t len, off_t off);
+
+/**
+ * @brief 结束访问, 使用 @ref IH_DROP_BEHIND 时丢弃这次扫描剩下的页
+ */
+void
+ihEnd(struct ioHint *ih);
+
+#endif
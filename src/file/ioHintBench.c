@@ -0,0 +1,354 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "ioHint.h"
+
+/*
+ * 访问模式提示的效果
+ *
+ * 生成一个"热点"文件和一个大的扫描文件. 每次测试前把扫描文件逐出页缓存,
+ * 读入热点文件, 然后:
+ *   - 顺序扫描: 每次 pread() 128 KiB, 或者遍历 mmap() 映射的文件,
+ *   分别不加提示, 使用 ihAccess(), 使用 ihAccess() + IH_DROP_BEHIND
+ *   - 回到开头再扫描一遍: 同一个 ioHint 连续两次顺序 pread(), 每一遍都应该有预读和丢弃
+ *   - 跨步读取: 每隔 stride 字节读 4 KiB
+ *   - 随机读取: 随机读取 4 KiB
+ * 报告吞吐量, 扫描之后扫描文件留在页缓存中的比例(即它挤占的缓存), 以及热点文件仍然在缓存中的比例.
+ * 只有内存不足时热点文件才会被挤出, 用 -s 指定大于可用内存的扫描文件可以观察到区别.
+ *
+ * 编译: gcc -O2 ioHintBench.c ioHint.c -o ioHintBench
+ * 用法: ioHintBench [-d dir] [-s scanMiB] [-h hotMiB] [-k strideKiB] [-r randomReads]
+ */
+
+#define SCAN_BUF (128 * 1024)
+#define SMALL_READ 4096
+
+void errExit(char *msg)
+{
+    extern int errno;
+    perror(msg);
+    exit(errno);
+}
+
+static double
+nowSec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static char scanPath[PATH_MAX], hotPath[PATH_MAX];
+static off_t scanSize, hotSize;
+
+static void
+createFile(const char *path, off_t size)
+{
+    char *buf;
+    off_t off;
+    int fd;
+
+    if ((buf = malloc(1 << 20)) == NULL)
+        errExit("malloc");
+    memset(buf, 'x', 1 << 20);
+    if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR)) == -1)
+        errExit("open");
+    for (off = 0; off < size; off += 1 << 20)
+        if (write(fd, buf, 1 << 20) != 1 << 20)
+            errExit("write");
+    if (fsync(fd) == -1)
+        errExit("fsync");
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+    free(buf);
+}
+
+/* 文件在页缓存中的比例 */
+static double
+resident(const char *path, off_t size)
+{
+    long page = sysconf(_SC_PAGESIZE);
+    size_t npages = (size + page - 1) / page, j, cnt = 0;
+    unsigned char *vec;
+    void *map;
+    int fd;
+
+    if ((fd = open(path, O_RDONLY)) == -1)
+        errExit("open");
+    if ((map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED)
+        errExit("mmap");
+    if ((vec = malloc(npages)) == NULL)
+        errExit("malloc");
+    if (mincore(map, size, vec) == -1)
+        errExit("mincore");
+    for (j = 0; j < npages; j++)
+        cnt += vec[j] & 1;
+    free(vec);
+    munmap(map, size);
+    close(fd);
+    return (double)cnt / npages;
+}
+
+/* 逐出扫描文件, 读入热点文件 */
+static void
+prepare(void)
+{
+    char *buf;
+    int fd;
+
+    if ((fd = open(scanPath, O_RDONLY)) == -1)
+        errExit("open");
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+
+    if ((buf = malloc(SCAN_BUF)) == NULL)
+        errExit("malloc");
+    if ((fd = open(hotPath, O_RDONLY)) == -1)
+        errExit("open");
+    while (read(fd, buf, SCAN_BUF) > 0)
+        ;
+    close(fd);
+    free(buf);
+}
+
+static void
+report(const char *name, double elapsed, uint64_t bytes, struct ioHint *ih)
+{
+    printf("%-34s %8.1f MiB/s  scan cached %5.1f%%  hot cached %5.1f%%",
+            name, bytes / elapsed / (1 << 20),
+            100 * resident(scanPath, scanSize), 100 * resident(hotPath, hotSize));
+    if (ih != NULL)
+        printf("  hints %lu", (unsigned long)ih->hints);
+    printf("\n");
+}
+
+enum hintMode { NO_HINT, HINT, HINT_DROP };
+
+static const char *hintNames[] = { "", " + ihAccess", " + ihAccess + drop" };
+
+static void
+seqRead(enum hintMode mode)
+{
+    struct ioHint ih;
+    char name[64], *buf;
+    double start;
+    off_t off;
+    ssize_t n;
+    int fd;
+
+    prepare();
+    if ((buf = malloc(SCAN_BUF)) == NULL)
+        errExit("malloc");
+    if ((fd = open(scanPath, O_RDONLY)) == -1)
+        errExit("open");
+    if (ihInit(&ih, fd, NULL, 0, (mode == HINT_DROP) ? IH_DROP_BEHIND : 0) == -1)
+        errExit("ihInit");
+
+    start = nowSec();
+    for (off = 0; off < scanSize; off += n) {
+        n = (mode == NO_HINT) ? pread(fd, buf, SCAN_BUF, off) : ihPread(&ih, buf, SCAN_BUF, off);
+        if (n <= 0)
+            errExit("pread");
+    }
+    ihEnd(&ih);
+
+    snprintf(name, sizeof(name), "sequential pread%s", hintNames[mode]);
+    report(name, nowSec() - start, scanSize, (mode == NO_HINT) ? NULL : &ih);
+    close(fd);
+    free(buf);
+}
+
+/* 同一个描述符顺序读两遍, 分别报告每一遍 */
+static void
+seqRewind(void)
+{
+    struct ioHint ih;
+    uint64_t hints, dropped;
+    char name[64], *buf;
+    double start;
+    off_t off;
+    ssize_t n;
+    int fd, pass;
+
+    prepare();
+    if ((buf = malloc(SCAN_BUF)) == NULL)
+        errExit("malloc");
+    if ((fd = open(scanPath, O_RDONLY)) == -1)
+        errExit("open");
+    if (ihInit(&ih, fd, NULL, 0, IH_DROP_BEHIND) == -1)
+        errExit("ihInit");
+
+    for (pass = 0; pass < 2; pass++) {
+        hints = ih.hints;
+        dropped = ih.droppedBytes;
+        start = nowSec();
+        for (off = 0; off < scanSize; off += n)
+            if ((n = ihPread(&ih, buf, SCAN_BUF, off)) <= 0)
+                errExit("pread");
+        ihEnd(&ih);
+
+        snprintf(name, sizeof(name), "rewind pass %d + ihAccess + drop", pass);
+        printf("%-34s %8.1f MiB/s  scan cached %5.1f%%  hints %lu  dropped %lu MiB\n",
+                name, scanSize / (nowSec() - start) / (1 << 20),
+                100 * resident(scanPath, scanSize), (unsigned long)(ih.hints - hints),
+                (unsigned long)((ih.droppedBytes - dropped) >> 20));
+    }
+    close(fd);
+    free(buf);
+}
+
+static void
+seqMap(enum hintMode mode)
+{
+    struct ioHint ih;
+    volatile uint64_t sum = 0;
+    uint64_t s = 0;
+    char name[64], *map;
+    double start;
+    off_t off, j;
+    long page = sysconf(_SC_PAGESIZE);
+    int fd;
+
+    prepare();
+    if ((fd = open(scanPath, O_RDONLY)) == -1)
+        errExit("open");
+    if ((map = mmap(NULL, scanSize, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED)
+        errExit("mmap");
+    if (ihInit(&ih, fd, map, scanSize, (mode == HINT_DROP) ? IH_DROP_BEHIND : 0) == -1)
+        errExit("ihInit");
+
+    start = nowSec();
+    for (off = 0; off < scanSize; off += SCAN_BUF) {
+        if (mode != NO_HINT)
+            ihAccess(&ih, off, SCAN_BUF);
+        for (j = 0; j < SCAN_BUF && off + j < scanSize; j += page)
+            s += map[off + j];
+    }
+    ihEnd(&ih);
+    sum = s;
+    (void)sum;
+
+    snprintf(name, sizeof(name), "sequential mmap%s", hintNames[mode]);
+    report(name, nowSec() - start, scanSize, (mode == NO_HINT) ? NULL : &ih);
+    munmap(map, scanSize);
+    close(fd);
+}
+
+static void
+strided(enum hintMode mode, off_t stride)
+{
+    struct ioHint ih;
+    char name[64], buf[SMALL_READ];
+    double start;
+    uint64_t bytes = 0;
+    off_t off;
+    int fd;
+
+    prepare();
+    if ((fd = open(scanPath, O_RDONLY)) == -1)
+        errExit("open");
+    if (ihInit(&ih, fd, NULL, 0, 0) == -1)
+        errExit("ihInit");
+
+    start = nowSec();
+    for (off = 0; off + SMALL_READ <= scanSize; off += stride) {
+        if (((mode == NO_HINT) ? pread(fd, buf, SMALL_READ, off) :
+                    ihPread(&ih, buf, SMALL_READ, off)) != SMALL_READ)
+            errExit("pread");
+        bytes += SMALL_READ;
+    }
+
+    snprintf(name, sizeof(name), "strided %ld KiB%s", (long)(stride / 1024), hintNames[mode]);
+    report(name, nowSec() - start, bytes, (mode == NO_HINT) ? NULL : &ih);
+    close(fd);
+}
+
+static void
+randomRead(enum hintMode mode, long nreads)
+{
+    struct ioHint ih;
+    char name[64], buf[SMALL_READ];
+    uint64_t seed = 88172645463325252ULL, blocks = scanSize / SMALL_READ;
+    double start;
+    long j;
+    off_t off;
+    int fd;
+
+    prepare();
+    if ((fd = open(scanPath, O_RDONLY)) == -1)
+        errExit("open");
+    if (ihInit(&ih, fd, NULL, 0, 0) == -1)
+        errExit("ihInit");
+
+    start = nowSec();
+    for (j = 0; j < nreads; j++) {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        off = (off_t)(seed % blocks) * SMALL_READ;
+        if (((mode == NO_HINT) ? pread(fd, buf, SMALL_READ, off) :
+                    ihPread(&ih, buf, SMALL_READ, off)) != SMALL_READ)
+            errExit("pread");
+    }
+
+    snprintf(name, sizeof(name), "random 4 KiB%s", hintNames[mode]);
+    report(name, nowSec() - start, (uint64_t)nreads * SMALL_READ, (mode == NO_HINT) ? NULL : &ih);
+    close(fd);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const char *dir = "/var/tmp";
+    long scanMiB = 1024, hotMiB = 64, strideKiB = 128, nrand = 20000;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:s:h:k:r:")) != -1) {
+        switch (opt) {
+        case 'd': dir = optarg; break;
+        case 's': scanMiB = atol(optarg); break;
+        case 'h': hotMiB = atol(optarg); break;
+        case 'k': strideKiB = atol(optarg); break;
+        case 'r': nrand = atol(optarg); break;
+        default:
+            fprintf(stderr, "Usage: %s [-d dir] [-s scanMiB] [-h hotMiB] [-k strideKiB] "
+                    "[-r randomReads]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (scanMiB <= 0 || hotMiB <= 0 || strideKiB < 8 || nrand <= 0) {
+        fprintf(stderr, "sizes must be > 0, stride >= 8 KiB\n");
+        exit(EXIT_FAILURE);
+    }
+    snprintf(scanPath, sizeof(scanPath), "%s/ioHint.scan", dir);
+    snprintf(hotPath, sizeof(hotPath), "%s/ioHint.hot", dir);
+    scanSize = (off_t)scanMiB << 20;
+    hotSize = (off_t)hotMiB << 20;
+    createFile(scanPath, scanSize);
+    createFile(hotPath, hotSize);
+
+    seqRead(NO_HINT);
+    seqRead(HINT);
+    seqRead(HINT_DROP);
+    seqRewind();
+    seqMap(NO_HINT);
+    seqMap(HINT);
+    seqMap(HINT_DROP);
+    strided(NO_HINT, strideKiB * 1024);
+    strided(HINT, strideKiB * 1024);
+    randomRead(NO_HINT, nrand);
+    randomRead(HINT, nrand);
+
+    unlink(scanPath);
+    unlink(hotPath);
+    exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,406 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include "ioQueue.h"
+
+/*
+ * io_uring 系统调用, glibc 没有提供包装函数
+ */
+static int
+uringSetup(unsigned entries, struct io_uring_params *p)
+{
+    return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int
+uringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags)
+{
+    return syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, NULL, 0);
+}
+
+static int
+uringRegister(int fd, unsigned opcode, const void *arg, unsigned nr)
+{
+    return syscall(__NR_io_uring_register, fd, opcode, arg, nr);
+}
+
+static int
+uringInit(struct ioQueue *q)
+{
+    struct io_uring_params p;
+    char *sq, *cq;
+
+    memset(&p, 0, sizeof(p));
+    if ((q->ringFd = uringSetup(q->depth, &p)) == -1)
+        return -1;
+
+    q->sqRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    q->cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    // 较新的内核中 SQ 和 CQ 共用一次映射
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (q->cqRingSize > q->sqRingSize)
+            q->sqRingSize = q->cqRingSize;
+        q->cqRingSize = q->sqRingSize;
+    }
+
+    sq = mmap(NULL, q->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+            q->ringFd, IORING_OFF_SQ_RING);
+    if (sq == MAP_FAILED)
+        goto fail;
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        cq = sq;
+    } else {
+        cq = mmap(NULL, q->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                q->ringFd, IORING_OFF_CQ_RING);
+        if (cq == MAP_FAILED) {
+            munmap(sq, q->sqRingSize);
+            goto fail;
+        }
+    }
+    q->sqRing = sq;
+    q->cqRing = cq;
+
+    q->sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, q->ringFd, IORING_OFF_SQES);
+    if (q->sqes == MAP_FAILED) {
+        if (cq != sq)
+            munmap(cq, q->cqRingSize);
+        munmap(sq, q->sqRingSize);
+        goto fail;
+    }
+
+    q->sqHead = (unsigned *)(sq + p.sq_off.head);
+    q->sqTail = (unsigned *)(sq + p.sq_off.tail);
+    q->sqMask = (unsigned *)(sq + p.sq_off.ring_mask);
+    q->sqArray = (unsigned *)(sq + p.sq_off.array);
+    q->cqHead = (unsigned *)(cq + p.cq_off.head);
+    q->cqTail = (unsigned *)(cq + p.cq_off.tail);
+    q->cqMask = (unsigned *)(cq + p.cq_off.ring_mask);
+    q->cqes = cq + p.cq_off.cqes;
+    q->sqLocalTail = *q->sqTail;
+    q->depth = p.sq_entries;
+    q->backend = IOQ_BACKEND_URING;
+    return 0;
+
+fail:
+    close(q->ringFd);
+    return -1;
+}
+
+static void
+uringPrep(struct ioQueue *q, const struct ioqRequest *req)
+{
+    unsigned idx = q->sqLocalTail & *q->sqMask;
+    struct io_uring_sqe *sqe = (struct io_uring_sqe *)q->sqes + idx;
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->fd = req->fd;
+    if (req->fixedFile)
+        sqe->flags |= IOSQE_FIXED_FILE;
+    sqe->off = req->off;
+    sqe->addr = (uintptr_t)req->buf;
+    sqe->len = req->len;
+    sqe->user_data = req->user;
+
+    switch (req->op) {
+    case IOQ_READ:
+    case IOQ_WRITE:
+        if (req->bufIndex >= 0) {
+            sqe->opcode = req->op == IOQ_READ ? IORING_OP_READ_FIXED : IORING_OP_WRITE_FIXED;
+            sqe->buf_index = req->bufIndex;
+        } else {
+            sqe->opcode = req->op == IOQ_READ ? IORING_OP_READ : IORING_OP_WRITE;
+        }
+        break;
+    case IOQ_FSYNC:
+    case IOQ_FDATASYNC:
+        sqe->opcode = IORING_OP_FSYNC;
+        sqe->addr = 0;
+        sqe->len = 0;
+        sqe->off = 0;
+        if (req->op == IOQ_FDATASYNC)
+            sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+        break;
+    }
+
+    q->sqArray[idx] = idx;
+    q->sqLocalTail++;
+}
+
+static int
+uringSubmit(struct ioQueue *q)
+{
+    int n;
+
+    // 先让内核看到新的 SQE, 再调用 io_uring_enter()
+    __atomic_store_n(q->sqTail, q->sqLocalTail, __ATOMIC_RELEASE);
+    while ((n = uringEnter(q->ringFd, q->prepared, 0, 0)) == -1 && errno == EINTR)
+        ;
+    return n;
+}
+
+static int
+uringReap(struct ioQueue *q, struct ioqCompletion *cqes, unsigned max)
+{
+    unsigned head = *q->cqHead, tail = __atomic_load_n(q->cqTail, __ATOMIC_ACQUIRE);
+    struct io_uring_cqe *cqe;
+    unsigned n = 0;
+
+    while (head != tail && n < max) {
+        cqe = (struct io_uring_cqe *)q->cqes + (head & *q->cqMask);
+        cqes[n].user = cqe->user_data;
+        cqes[n].res = cqe->res;
+        n++;
+        head++;
+    }
+    __atomic_store_n(q->cqHead, head, __ATOMIC_RELEASE);
+    return n;
+}
+
+static int
+uringWait(struct ioQueue *q, struct ioqCompletion *cqes, unsigned max, unsigned min)
+{
+    unsigned n = uringReap(q, cqes, max);
+
+    while (n < min) {
+        if (uringEnter(q->ringFd, 0, min - n, IORING_ENTER_GETEVENTS) == -1 && errno != EINTR)
+            return n > 0 ? (int)n : -1;
+        n += uringReap(q, cqes + n, max - n);
+    }
+    return n;
+}
+
+/*
+ * 线程池实现
+ */
+static int
+execute(struct ioQueue *q, const struct ioqRequest *req)
+{
+    int fd = req->fd;
+    ssize_t n;
+
+    if (req->fixedFile) {
+        if ((unsigned)fd >= q->nfiles)
+            return -EBADF;
+        fd = q->files[fd];
+    }
+
+    switch (req->op) {
+    case IOQ_READ:
+        n = pread(fd, req->buf, req->len, req->off);
+        break;
+    case IOQ_WRITE:
+        n = pwrite(fd, req->buf, req->len, req->off);
+        break;
+    case IOQ_FSYNC:
+        n = fsync(fd);
+        break;
+    case IOQ_FDATASYNC:
+        n = fdatasync(fd);
+        break;
+    default:
+        return -EINVAL;
+    }
+    return n == -1 ? -errno : (int)n;
+}
+
+static void *
+worker(void *arg)
+{
+    struct ioQueue *q = arg;
+    struct ioqRequest req;
+    int res;
+
+    pthread_mutex_lock(&q->mtx);
+    for (;;) {
+        while (q->reqHead == q->reqTail && !q->stop)
+            pthread_cond_wait(&q->reqCond, &q->mtx);
+        if (q->stop)
+            break;
+        req = q->reqs[q->reqHead++ % q->depth];
+        pthread_mutex_unlock(&q->mtx);
+
+        res = execute(q, &req);
+
+        pthread_mutex_lock(&q->mtx);
+        q->dones[q->doneTail % q->depth].user = req.user;
+        q->dones[q->doneTail % q->depth].res = res;
+        q->doneTail++;
+        pthread_cond_signal(&q->doneCond);
+    }
+    pthread_mutex_unlock(&q->mtx);
+    return NULL;
+}
+
+static int
+poolInit(struct ioQueue *q)
+{
+    int j;
+
+    q->nthreads = q->depth < IOQ_MAX_THREADS ? q->depth : IOQ_MAX_THREADS;
+    q->reqs = calloc(q->depth, sizeof(struct ioqRequest));
+    q->dones = calloc(q->depth, sizeof(struct ioqCompletion));
+    q->threads = calloc(q->nthreads, sizeof(pthread_t));
+    if (q->reqs == NULL || q->dones == NULL || q->threads == NULL)
+        goto fail;
+
+    pthread_mutex_init(&q->mtx, NULL);
+    pthread_cond_init(&q->reqCond, NULL);
+    pthread_cond_init(&q->doneCond, NULL);
+    for (j = 0; j < q->nthreads; j++)
+        if ((errno = pthread_create(&q->threads[j], NULL, worker, q)) != 0) {
+            q->nthreads = j;
+            ioqDestroy(q);
+            return -1;
+        }
+    q->backend = IOQ_BACKEND_THREADS;
+    return 0;
+
+fail:
+    free(q->reqs);
+    free(q->dones);
+    free(q->threads);
+    errno = ENOMEM;
+    return -1;
+}
+
+int
+ioqInit(struct ioQueue *q, unsigned depth, int flags)
+{
+    memset(q, 0, sizeof(struct ioQueue));
+    if (depth == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    q->depth = depth;
+    q->ringFd = -1;
+
+    if (!(flags & IOQ_FORCE_THREADS)) {
+        if (uringInit(q) == 0)
+            return 0;
+        if (errno != ENOSYS && errno != EPERM && errno != EACCES)
+            return -1;
+        q->depth = depth;
+    }
+    return poolInit(q);
+}
+
+int
+ioqRegisterBuffers(struct ioQueue *q, const struct iovec *iov, unsigned n)
+{
+    if (q->backend == IOQ_BACKEND_URING)
+        return uringRegister(q->ringFd, IORING_REGISTER_BUFFERS, iov, n) < 0 ? -1 : 0;
+    return 0;                   // 线程池直接使用 buf 指针
+}
+
+int
+ioqRegisterFiles(struct ioQueue *q, const int *fds, unsigned n)
+{
+    if (q->backend == IOQ_BACKEND_URING)
+        return uringRegister(q->ringFd, IORING_REGISTER_FILES, fds, n) < 0 ? -1 : 0;
+
+    if ((q->files = malloc(n * sizeof(int))) == NULL)
+        return -1;
+    memcpy(q->files, fds, n * sizeof(int));
+    q->nfiles = n;
+    return 0;
+}
+
+int
+ioqPrep(struct ioQueue *q, const struct ioqRequest *req)
+{
+    if (q->prepared + q->inflight >= q->depth) {
+        errno = EBUSY;
+        return -1;
+    }
+
+    if (q->backend == IOQ_BACKEND_URING)
+        uringPrep(q, req);
+    else
+        q->reqs[(q->reqTail + q->prepared) % q->depth] = *req;
+    q->prepared++;
+    return 0;
+}
+
+int
+ioqSubmit(struct ioQueue *q)
+{
+    int n;
+
+    if (q->prepared == 0)
+        return 0;
+
+    if (q->backend == IOQ_BACKEND_URING) {
+        if ((n = uringSubmit(q)) == -1)
+            return -1;
+    } else {
+        pthread_mutex_lock(&q->mtx);
+        q->reqTail += q->prepared;
+        pthread_cond_broadcast(&q->reqCond);
+        pthread_mutex_unlock(&q->mtx);
+        n = q->prepared;
+    }
+    q->prepared -= n;
+    q->inflight += n;
+    return n;
+}
+
+int
+ioqWait(struct ioQueue *q, struct ioqCompletion *cqes, unsigned max, unsigned min)
+{
+    unsigned n = 0;
+    int ret;
+
+    if (min > q->inflight)
+        min = q->inflight;
+
+    if (q->backend == IOQ_BACKEND_URING) {
+        if ((ret = uringWait(q, cqes, max, min)) == -1)
+            return -1;
+        n = ret;
+    } else {
+        pthread_mutex_lock(&q->mtx);
+        while (q->doneTail - q->doneHead < min)
+            pthread_cond_wait(&q->doneCond, &q->mtx);
+        while (q->doneHead != q->doneTail && n < max)
+            cqes[n++] = q->dones[q->doneHead++ % q->depth];
+        pthread_mutex_unlock(&q->mtx);
+    }
+    q->inflight -= n;
+    return n;
+}
+
+void
+ioqDestroy(struct ioQueue *q)
+{
+    int j;
+
+    if (q->backend == IOQ_BACKEND_URING) {
+        munmap(q->sqes, (*q->sqMask + 1) * sizeof(struct io_uring_sqe));
+        if (q->cqRing != q->sqRing)
+            munmap(q->cqRing, q->cqRingSize);
+        munmap(q->sqRing, q->sqRingSize);
+        close(q->ringFd);
+        return;
+    }
+
+    pthread_mutex_lock(&q->mtx);
+    q->stop = 1;
+    pthread_cond_broadcast(&q->reqCond);
+    pthread_mutex_unlock(&q->mtx);
+    for (j = 0; j < q->nthreads; j++)
+        pthread_join(q->threads[j], NULL);
+    pthread_mutex_destroy(&q->mtx);
+    pthread_cond_destroy(&q->reqCond);
+    pthread_cond_destroy(&q->doneCond);
+    free(q->threads);
+    free(q->reqs);
+    free(q->dones);
+    free(q->files);
+}
@@ -0,0 +1,172 @@
+/**
+ * @file ioQueue.h
+ * @author Lock
+ * @date 16 Oct 2026
+ * @brief 异步批量文件 I/O: io_uring 与线程池两种实现
+ *
+ * file.h 中的 read(), write(), fsync() 都是同步的, 调用者在 I/O 完成之前被阻塞.
+ * 想要同时有 N 个未完成的 I/O, 只能使用 N 个线程.
+ *
+ * io_uring 使用两个与内核共享的环形队列: 应用程序向提交队列(SQ)写入请求,
+ * 内核向完成队列(CQ)写入结果. 一次 io_uring_enter() 可以提交一批请求并等待若干个完成,
+ * 一个线程就能维持很深的队列. 这里直接使用系统调用, 不依赖 liburing:
+ *   - io_uring_setup() 创建队列, 通过 mmap() 映射 SQ, CQ 和 SQE 数组.
+ *   - io_uring_register() 注册缓冲区(IORING_OP_READ_FIXED/WRITE_FIXED 不必每次
+ *   固定用户页面)和文件(IOSQE_FIXED_FILE 不必每次查找和引用文件描述符).
+ *   - io_uring_enter() 提交和等待.
+ *
+ * 内核不支持 io_uring(ENOSYS), 被禁用(EPERM)或者指定了 @ref IOQ_FORCE_THREADS 时,
+ * 使用线程池实现相同的接口, 线程个数不超过 @ref IOQ_MAX_THREADS.
+ *
+ * 使用方法:
+ * @code
+ * ioqPrep(&q, &req);          // 可以多次调用, 准备一批请求
+ * ioqSubmit(&q);              // 一次提交
+ * ioqWait(&q, cqes, 64, 1);   // 至少等待一个完成
+ * @endcode
+ *
+ * @example ioQueueBench.c
+ */
+#ifndef IO_QUEUE_H
+#define IO_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/uio.h>
+
+#define IOQ_MAX_THREADS 32
+
+#define IOQ_FORCE_THREADS 01    //!< ioqInit() 标志: 不使用 io_uring
+
+#define IOQ_BACKEND_URING 1
+#define IOQ_BACKEND_THREADS 2
+
+/**
+ * @brief 操作类型
+ */
+enum ioqOp {
+    IOQ_READ,
+    IOQ_WRITE,
+    IOQ_FSYNC,
+    IOQ_FDATASYNC,
+};
+
+/**
+ * @brief I/O 请求
+ */
+struct ioqRequest {
+    enum ioqOp op;
+    int fd;                     //!< 文件描述符, fixedFile 为真时是注册的文件的下标
+    int fixedFile;
+    int bufIndex;               //!< 注册的缓冲区的下标, -1 表示 buf 不是注册的缓冲区
+    void *buf;
+    size_t len;
+    uint64_t off;
+    uint64_t user;              //!< 原样返回给调用者
+};
+
+/**
+ * @brief 完成结果
+ */
+struct ioqCompletion {
+    uint64_t user;              //!< 请求中的 user
+    int res;                    //!< 读写的字节数, 失败时为负的 errno
+};
+
+/**
+ * @brief 异步 I/O 队列
+ */
+struct ioQueue {
+    int backend;                //!< @ref IOQ_BACKEND_URING 或 @ref IOQ_BACKEND_THREADS
+    unsigned depth;             //!< 最多的未完成请求个数
+    unsigned prepared;          //!< 已准备但没有提交的请求个数
+    unsigned inflight;          //!< 已提交但没有取回结果的请求个数
+
+    /* io_uring */
+    int ringFd;
+    void *sqRing, *cqRing;
+    size_t sqRingSize, cqRingSize;
+    void *sqes;
+    unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+    unsigned *cqHead, *cqTail, *cqMask;
+    void *cqes;
+    unsigned sqLocalTail;
+
+    /* 线程池 */
+    int nthreads;
+    pthread_t *threads;
+    pthread_mutex_t mtx;
+    pthread_cond_t reqCond, doneCond;
+    struct ioqRequest *reqs;            //!< 提交队列, 容量为 depth
+    struct ioqCompletion *dones;        //!< 完成队列, 容量为 depth
+    unsigned reqHead, reqTail, doneHead, doneTail;
+    int stop;
+    int *files;
+    unsigned nfiles;
+};
+
+/**
+ * @brief 创建队列
+ *
+ * @param q 队列
+ * @param depth 最多的未完成请求个数
+ * @param flags 0 或 @ref IOQ_FORCE_THREADS
+ *
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+int
+ioqInit(struct ioQueue *q, unsigned depth, int flags);
+
+/**
+ * @brief 注册缓冲区, 只能调用一次
+ */
+int
+ioqRegisterBuffers(struct ioQueue *q, const struct iovec *iov, unsigned n);
+
+/**
+ * @brief 注册文件, 只能调用一次
+ */
+int
+ioqRegisterFiles(struct ioQueue *q, const int *fds, unsigned n);
+
+/**
+ * @brief 准备一个请求, 在 ioqSubmit() 时提交
+ *
+ * @retval 0 成功
+ * @retval -1 未完成的请求已经达到 depth, errno 为 `EBUSY`
+ */
+int
+ioqPrep(struct ioQueue *q, const struct ioqRequest *req);
+
+/**
+ * @brief 提交所有已准备的请求
+ *
+ * @return 返回提交的请求个数
+ * @retval -1 失败
+ */
+int
+ioqSubmit(struct ioQueue *q);
+
+/**
+ * @brief 取回完成的请求
+ *
+ * @param q 队列
+ * @param cqes 用于保存完成结果
+ * @param max 最多取回的个数
+ * @param min 至少等待的个数, 0 表示不等待
+ *
+ * @return 返回取回的个数
+ * @retval -1 失败
+ */
+int
+ioqWait(struct ioQueue *q, struct ioqCompletion *cqes, unsigned max, unsigned min);
+
+/**
+ * @brief 销毁队列, 调用前应当取回所有完成结果
+ */
+void
+ioqDestroy(struct ioQueue *q);
+
+#endif
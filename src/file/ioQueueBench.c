@@ -0,0 +1,185 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include "ioQueue.h"
+
+/*
+ * 异步 I/O 队列深度测试
+ *
+ * 在一个文件上做 4 KiB 随机读, 队列深度从 1 到 128, 分别测试 io_uring 和线程池,
+ * 报告每秒完成的 I/O 次数(IOPS). 默认使用 O_DIRECT, 文件系统不支持时退回普通读.
+ * io_uring 使用注册的缓冲区和文件.
+ *
+ * 编译: gcc -O2 -pthread ioQueueBench.c ioQueue.c -o ioQueueBench
+ * 用法: ioQueueBench [-b] [-s sizeMiB] [-t seconds]
+ *   -b  使用页缓存(不使用 O_DIRECT)
+ */
+
+#define PATH "/tmp/ioq.dat"
+#define BLOCK 4096
+#define MAX_DEPTH 128
+
+void errExit(char *msg)
+{
+    extern int errno;
+    perror(msg);
+    exit(errno);
+}
+
+static double
+nowSec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t
+xorshift(uint64_t *s)
+{
+    *s ^= *s << 13;
+    *s ^= *s >> 7;
+    *s ^= *s << 17;
+    return *s;
+}
+
+/* 保持 depth 个未完成的读请求, 运行 seconds 秒 */
+static double
+run(int fd, int flags, unsigned depth, double seconds, char *bufs, int *backend)
+{
+    struct ioQueue q;
+    struct ioqRequest req;
+    struct ioqCompletion cqes[MAX_DEPTH];
+    struct iovec iov;
+    uint64_t seed = 88172645463325252ULL, nblocks, done = 0;
+    double start, end;
+    unsigned j;
+    int n, k;
+
+    if (ioqInit(&q, depth, flags) == -1)
+        errExit("ioqInit");
+    *backend = q.backend;
+    iov.iov_base = bufs;
+    iov.iov_len = (size_t)MAX_DEPTH * BLOCK;
+    if (ioqRegisterBuffers(&q, &iov, 1) == -1)
+        errExit("ioqRegisterBuffers");
+    if (ioqRegisterFiles(&q, &fd, 1) == -1)
+        errExit("ioqRegisterFiles");
+
+    nblocks = lseek(fd, 0, SEEK_END) / BLOCK;
+    memset(&req, 0, sizeof(req));
+    req.op = IOQ_READ;
+    req.fd = 0;
+    req.fixedFile = 1;
+    req.bufIndex = 0;
+    req.len = BLOCK;
+
+    // user 是缓冲区的下标, 完成后同一个缓冲区用于下一个请求
+    for (j = 0; j < depth; j++) {
+        req.buf = bufs + (size_t)j * BLOCK;
+        req.off = (xorshift(&seed) % nblocks) * BLOCK;
+        req.user = j;
+        if (ioqPrep(&q, &req) == -1)
+            errExit("ioqPrep");
+    }
+    if (ioqSubmit(&q) == -1)
+        errExit("ioqSubmit");
+
+    start = nowSec();
+    end = start + seconds;
+    while (nowSec() < end) {
+        if ((n = ioqWait(&q, cqes, MAX_DEPTH, 1)) == -1)
+            errExit("ioqWait");
+        for (k = 0; k < n; k++) {
+            if (cqes[k].res != BLOCK) {
+                fprintf(stderr, "read: %s\n", strerror(-cqes[k].res));
+                exit(EXIT_FAILURE);
+            }
+            req.buf = bufs + cqes[k].user * BLOCK;
+            req.off = (xorshift(&seed) % nblocks) * BLOCK;
+            req.user = cqes[k].user;
+            if (ioqPrep(&q, &req) == -1)
+                errExit("ioqPrep");
+        }
+        done += n;
+        if (ioqSubmit(&q) == -1)
+            errExit("ioqSubmit");
+    }
+    end = nowSec();
+
+    while (q.inflight > 0)
+        if (ioqWait(&q, cqes, MAX_DEPTH, q.inflight) == -1)
+            errExit("ioqWait");
+    ioqDestroy(&q);
+    return done / (end - start);
+}
+
+int
+main(int argc, char *argv[])
+{
+    static const int modes[] = { 0, IOQ_FORCE_THREADS };
+    char *bufs, *chunk;
+    uint64_t size = 256, j;
+    double seconds = 1, iops[2];
+    unsigned depth;
+    int fd, buffered = 0, ch, m, backend;
+
+    while ((ch = getopt(argc, argv, "bs:t:")) != -1) {
+        switch (ch) {
+        case 'b': buffered = 1; break;
+        case 's': size = strtoull(optarg, NULL, 10); break;
+        case 't': seconds = atof(optarg); break;
+        default:
+            fprintf(stderr, "Usage: %s [-b] [-s sizeMiB] [-t seconds]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (size == 0 || seconds <= 0) {
+        fprintf(stderr, "bad arguments\n");
+        exit(EXIT_FAILURE);
+    }
+    size *= 1024 * 1024;
+
+    if ((fd = open(PATH, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR)) == -1)
+        errExit("open");
+    if ((chunk = malloc(1024 * 1024)) == NULL)
+        errExit("malloc");
+    memset(chunk, 'x', 1024 * 1024);
+    for (j = 0; j < size; j += 1024 * 1024)
+        if (write(fd, chunk, 1024 * 1024) != 1024 * 1024)
+            errExit("write");
+    fsync(fd);
+    close(fd);
+    free(chunk);
+
+    fd = -1;
+    if (!buffered && (fd = open(PATH, O_RDONLY | O_DIRECT)) == -1)
+        fprintf(stderr, "O_DIRECT not supported, using the page cache\n");
+    if (fd == -1 && (fd = open(PATH, O_RDONLY)) == -1)
+        errExit("open");
+
+    if ((errno = posix_memalign((void **)&bufs, BLOCK, (size_t)MAX_DEPTH * BLOCK)) != 0)
+        errExit("posix_memalign");
+
+    printf("%6s %12s %12s\n", "depth", "io_uring", "threads");
+    for (depth = 1; depth <= MAX_DEPTH; depth *= 2) {
+        for (m = 0; m < 2; m++) {
+            iops[m] = run(fd, modes[m], depth, seconds, bufs, &backend);
+            if (m == 0 && backend != IOQ_BACKEND_URING)
+                iops[m] = 0;    // io_uring 不可用, 已经退回线程池
+        }
+        printf("%6u %12.0f %12.0f\n", depth, iops[0], iops[1]);
+        fflush(stdout);
+    }
+
+    free(bufs);
+    close(fd);
+    unlink(PATH);
+    exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,316 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <immintrin.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "lineSplit.h"
+
+static int useAvx2 = -1;
+
+void
+lsForceScalar(int scalar)
+{
+    useAvx2 = !scalar && __builtin_cpu_supports("avx2");
+}
+
+static inline int
+haveAvx2(void)
+{
+    if (useAvx2 == -1)
+        lsForceScalar(0);
+    return useAvx2;
+}
+
+/* data[0, 64) 中换行符的位图 */
+__attribute__((target("avx2")))
+static uint64_t
+newlineMask64(const char *data)
+{
+    const __m256i nl = _mm256_set1_epi8('\n');
+    uint32_t lo, hi;
+
+    lo = _mm256_movemask_epi8(_mm256_cmpeq_epi8(nl,
+                _mm256_loadu_si256((const __m256i *)data)));
+    hi = _mm256_movemask_epi8(_mm256_cmpeq_epi8(nl,
+                _mm256_loadu_si256((const __m256i *)(data + 32))));
+    return (uint64_t)hi << 32 | lo;
+}
+
+/*
+ * 返回 pos 之后第一个换行符的位置, 没有时返回 len.
+ * 位图一次覆盖 64 个字节, 不足 64 个字节的尾部逐字节生成,
+ * 并且 scan 只前进到 len, 缓冲模式读入更多数据后从 len 继续.
+ */
+static size_t
+findNewline(struct lineSplitter *ls)
+{
+    const char *p;
+    size_t j, n;
+
+    if (!haveAvx2()) {
+        p = memchr(ls->data + ls->pos, '\n', ls->len - ls->pos);
+        return (p == NULL) ? ls->len : (size_t)(p - ls->data);
+    }
+
+    while (ls->mask == 0) {
+        if (ls->scan >= ls->len)
+            return ls->len;
+        ls->maskBase = ls->scan;
+        if (ls->scan + 64 <= ls->len) {
+            ls->mask = newlineMask64(ls->data + ls->scan);
+            ls->scan += 64;
+        } else {
+            n = ls->len - ls->scan;
+            for (j = 0; j < n; j++)
+                ls->mask |= (uint64_t)(ls->data[ls->scan + j] == '\n') << j;
+            ls->scan = ls->len;
+        }
+    }
+
+    j = ls->maskBase + __builtin_ctzll(ls->mask);
+    ls->mask &= ls->mask - 1;
+    return j;
+}
+
+/*
+ * 把未处理的数据移动到缓冲区开头, 缓冲区已满时扩大一倍, 然后读取更多数据
+ *
+ * 返回读到的字节数, 0 表示文件结尾
+ */
+static ssize_t
+refill(struct lineSplitter *ls)
+{
+    size_t rest = ls->len - ls->pos;
+    char *buf;
+    ssize_t n;
+
+    if (ls->pos > 0) {
+        memmove(ls->buf, ls->buf + ls->pos, rest);
+        ls->scan -= ls->pos;
+        ls->pos = 0;
+        ls->len = rest;
+    }
+    if (ls->len == ls->cap) {
+        if ((buf = realloc(ls->buf, ls->cap * 2)) == NULL)
+            return -1;
+        ls->buf = buf;
+        ls->cap *= 2;
+    }
+    ls->data = ls->buf;
+    ls->mask = 0;
+
+    while ((n = read(ls->fd, ls->buf + ls->len, ls->cap - ls->len)) == -1)
+        if (errno != EINTR)
+            return -1;
+    ls->len += n;
+    if (n == 0)
+        ls->eof = 1;
+    return n;
+}
+
+void
+lsInitMem(struct lineSplitter *ls, const char *data, size_t len)
+{
+    memset(ls, 0, sizeof(struct lineSplitter));
+    ls->data = data;
+    ls->len = len;
+    ls->fd = -1;
+    ls->eof = 1;
+}
+
+int
+lsInitFd(struct lineSplitter *ls, int fd, size_t bufSize)
+{
+    memset(ls, 0, sizeof(struct lineSplitter));
+    if (bufSize == 0)
+        bufSize = LS_DEFAULT_BUF;
+    if ((ls->buf = malloc(bufSize)) == NULL)
+        return -1;
+    ls->data = ls->buf;
+    ls->cap = bufSize;
+    ls->fd = fd;
+    return 0;
+}
+
+int
+lsOpen(struct lineSplitter *ls, const char *path, size_t bufSize)
+{
+    struct stat sb;
+    char *map;
+    int fd;
+
+    if ((fd = open(path, O_RDONLY)) == -1)
+        return -1;
+
+    if (bufSize == 0) {
+        if (fstat(fd, &sb) == -1)
+            goto fail;
+        // 大小为 0 的文件不一定是空的(/proc 和 sysfs 下的文件), 和管道一样不能映射, 改用缓冲模式
+        map = (sb.st_size > 0) ? mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0) :
+                MAP_FAILED;
+        if (map != MAP_FAILED) {
+            madvise(map, sb.st_size, MADV_SEQUENTIAL);
+            close(fd);
+            lsInitMem(ls, map, sb.st_size);
+            ls->map = map;
+            ls->mapSize = sb.st_size;
+            return 0;
+        }
+    }
+
+    if (lsInitFd(ls, fd, bufSize) == -1)
+        goto fail;
+    ls->ownFd = 1;
+    return 0;
+
+fail:
+    close(fd);
+    return -1;
+}
+
+int
+lsNext(struct lineSplitter *ls, struct lsView *line)
+{
+    size_t nl;
+
+    for (;;) {
+        nl = findNewline(ls);
+        if (nl < ls->len) {
+            line->ptr = ls->data + ls->pos;
+            line->len = nl - ls->pos;
+            ls->pos = nl + 1;
+            return 1;
+        }
+        if (ls->eof)
+            break;
+        if (refill(ls) == -1)
+            return -1;
+    }
+
+    // 最后一行没有换行符
+    if (ls->pos < ls->len) {
+        line->ptr = ls->data + ls->pos;
+        line->len = ls->len - ls->pos;
+        ls->pos = ls->len;
+        return 1;
+    }
+    return 0;
+}
+
+void
+lsClose(struct lineSplitter *ls)
+{
+    if (ls->map != NULL)
+        munmap(ls->map, ls->mapSize);
+    free(ls->buf);
+    if (ls->ownFd)
+        close(ls->fd);
+    memset(ls, 0, sizeof(struct lineSplitter));
+    ls->fd = -1;
+}
+
+struct lsTask {
+    const char *data;
+    size_t len;
+    lsLineFn fn;
+    void *arg;
+    uint64_t lines;
+    int stop;
+};
+
+static void *
+lsWorker(void *arg)
+{
+    struct lsTask *task = arg;
+    struct lineSplitter ls;
+    struct lsView line;
+
+    lsInitMem(&ls, task->data, task->len);
+    while (lsNext(&ls, &line) == 1) {
+        task->lines++;
+        if (task->fn(&line, task->arg) != 0) {
+            task->stop = 1;
+            break;
+        }
+    }
+    return NULL;
+}
+
+int
+lsParallel(const char *path, int nthreads, lsLineFn fn, void **args, uint64_t *lines)
+{
+    struct lineSplitter whole;
+    struct lsTask *tasks;
+    pthread_t *tids;
+    const char *p;
+    size_t start, end;
+    int k, started, ret = 0;
+
+    if (nthreads < 1) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (lsOpen(&whole, path, 0) == -1)
+        return -1;
+    if (whole.fd != -1) {
+        // 不能映射的文件无法按偏移量切分
+        lsClose(&whole);
+        errno = EINVAL;
+        return -1;
+    }
+
+    tasks = calloc(nthreads, sizeof(struct lsTask));
+    tids = calloc(nthreads, sizeof(pthread_t));
+    if (tasks == NULL || tids == NULL) {
+        ret = -1;
+        goto out;
+    }
+
+    /*
+     * 第 k 个分界点先取 k * len / nthreads, 再移动到它之前一个字节开始的第一个换行符之后,
+     * 这样恰好落在行首的分界点不会移动
+     */
+    start = 0;
+    for (k = 0; k < nthreads; k++) {
+        end = (k == nthreads - 1) ? whole.len : whole.len / nthreads * (k + 1);
+        if (end < start)
+            end = start;
+        if (end > 0 && end < whole.len) {
+            p = memchr(whole.data + end - 1, '\n', whole.len - end + 1);
+            end = (p == NULL) ? whole.len : (size_t)(p - whole.data) + 1;
+        }
+        tasks[k].data = whole.data + start;
+        tasks[k].len = end - start;
+        tasks[k].fn = fn;
+        tasks[k].arg = (args == NULL) ? NULL : args[k];
+        start = end;
+    }
+
+    for (started = 0; started < nthreads; started++)
+        if ((errno = pthread_create(&tids[started], NULL, lsWorker, &tasks[started])) != 0) {
+            ret = -1;
+            break;
+        }
+    for (k = 0; k < started; k++)
+        pthread_join(tids[k], NULL);
+
+    if (lines != NULL)
+        *lines = 0;
+    for (k = 0; k < started; k++) {
+        if (tasks[k].stop)
+            ret = -1;
+        if (lines != NULL)
+            *lines += tasks[k].lines;
+    }
+
+out:
+    free(tasks);
+    free(tids);
+    lsClose(&whole);
+    return ret;
+}
@@ -0,0 +1,132 @@
+/**
+ * @file lineSplit.h
+ * @author Lock
+ * @date 16 Oct 2026
+ * @brief 基于 AVX2 的按行切分, 用于替换读取大文件时的 fgets()
+ *
+ * fgets() 每次调用都要对 FILE 加锁, 在 stdio 缓冲区中逐字节查找换行符,
+ * 再把整行复制到调用者的缓冲区. 处理几个 GB 的日志时, 时间主要花在这些地方.
+ *
+ * lineSplitter 直接在 mmap() 映射的文件或大的读缓冲区上查找换行符,
+ * 返回指向原数据的视图(@ref lsView), 不复制数据:
+ *   - 每次用 AVX2 比较 64 个字节, 得到一个 64 位的换行符位图,
+ *   之后的行直接从位图中取出(tzcnt), 行很短时每 64 个字节只需要两次比较.
+ *   不支持 AVX2 时使用 memchr().
+ *   - 缓冲模式(用于管道或不能映射的文件)下, 跨越缓冲区边界的行被移动到缓冲区开头再继续读取,
+ *   一行比缓冲区还长时扩大缓冲区, 所以行的长度没有限制.
+ *   - lsParallel() 把映射的文件按字节数均分给多个线程, 每个分界点移动到下一个换行符之后,
+ *   每一行恰好由一个线程处理.
+ *
+ * 返回的行不包括换行符, 文件的最后一行可以没有换行符.
+ *
+ * @example lineSplitBench.c
+ */
+#ifndef LINE_SPLIT_H
+#define LINE_SPLIT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define LS_DEFAULT_BUF (1024 * 1024)
+
+/**
+ * @brief 一行数据, 指向切分器的数据, 不以 '\0' 结尾
+ */
+struct lsView {
+    const char *ptr;
+    size_t len;
+};
+
+/**
+ * @brief 行切分器
+ */
+struct lineSplitter {
+    const char *data;           //!< 映射的文件, 调用者的内存或读缓冲区
+    size_t len;                 //!< data 中有效数据的长度
+    size_t pos;                 //!< 下一行的起始位置
+    size_t scan;                //!< 下一个要生成位图的位置
+    size_t maskBase;            //!< mask 的第 0 位对应的位置
+    uint64_t mask;              //!< [maskBase, maskBase + 64) 中尚未返回的换行符
+    int fd;                     //!< 缓冲模式下读取的文件描述符, 否则为 -1
+    int ownFd;                  //!< lsOpen() 打开的文件描述符
+    char *buf;                  //!< 缓冲模式的缓冲区
+    size_t cap;
+    char *map;                  //!< lsOpen() 映射的区域
+    size_t mapSize;
+    int eof;
+};
+
+/**
+ * @brief 处理一行, 返回非 0 时停止
+ */
+typedef int (*lsLineFn)(const struct lsView *line, void *arg);
+
+/**
+ * @brief 切分内存中的数据
+ */
+void
+lsInitMem(struct lineSplitter *ls, const char *data, size_t len);
+
+/**
+ * @brief 用 read() 读取文件描述符(可以是管道), 缓冲模式
+ *
+ * @param bufSize 初始缓冲区大小, 为 0 时使用 @ref LS_DEFAULT_BUF
+ *
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+int
+lsInitFd(struct lineSplitter *ls, int fd, size_t bufSize);
+
+/**
+ * @brief 打开文件
+ *
+ * @param bufSize 为 0 时映射整个文件, 否则使用大小为 @p bufSize 的缓冲区.
+ * 不能映射或者 `st_size` 为 0 的文件(管道, /proc 和 sysfs 下的文件)总是使用缓冲区
+ *
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+int
+lsOpen(struct lineSplitter *ls, const char *path, size_t bufSize);
+
+/**
+ * @brief 获取下一行
+ *
+ * 缓冲模式下, @p line 只在下一次调用 lsNext() 之前有效.
+ *
+ * @retval 1 成功
+ * @retval 0 没有更多的行
+ * @retval -1 读取失败
+ */
+int
+lsNext(struct lineSplitter *ls, struct lsView *line);
+
+/**
+ * @brief 释放资源, 关闭 lsOpen() 打开的文件
+ */
+void
+lsClose(struct lineSplitter *ls);
+
+/**
+ * @brief 多个线程并行处理文件中的每一行
+ *
+ * @param path 文件路径
+ * @param nthreads 线程个数
+ * @param fn 处理函数, 在多个线程中同时调用
+ * @param args 第 k 个线程调用 @p fn 时传入 args[k], 为 NULL 时传入 NULL
+ * @param lines 不为 NULL 时返回总行数
+ *
+ * @retval 0 成功
+ * @retval -1 失败, 或 @p fn 返回了非 0
+ */
+int
+lsParallel(const char *path, int nthreads, lsLineFn fn, void **args, uint64_t *lines);
+
+/**
+ * @brief 禁用 AVX2 实现, 用于对比测试
+ */
+void
+lsForceScalar(int scalar);
+
+#endif
@@ -0,0 +1,217 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include "lineSplit.h"
+
+/*
+ * lineSplitter 与 fgets() 的对比
+ *
+ * 生成一个行长度在 20 到 200 字节之间的日志文件, 分别用
+ *   - fgets()
+ *   - fgets_unlocked()
+ *   - getline()
+ *   - lsNext(), 映射整个文件, AVX2 与 memchr()
+ *   - lsNext(), 64 KiB 缓冲区(有跨越边界的行)
+ *   - lsParallel(), 1 到 maxThreads 个线程
+ * 统计行数和所有行的总长度, 检查各种方式的结果一致.
+ *
+ * 编译: gcc -O2 -pthread lineSplitBench.c lineSplit.c -o lineSplitBench
+ * 用法: lineSplitBench [-s sizeMiB] [-t maxThreads]
+ */
+
+#define PATH "/tmp/lineSplit.log"
+#define LINE_MAX_LEN 4096
+
+void errExit(char *msg)
+{
+    extern int errno;
+    perror(msg);
+    exit(errno);
+}
+
+static double
+nowSec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t expectLines, expectBytes, fileSize;
+
+static void
+report(const char *name, double elapsed, uint64_t lines, uint64_t bytes)
+{
+    printf("%-24s %8.3f s %8.0f MB/s %6.2f ns/line%s\n", name, elapsed,
+            fileSize / elapsed / 1e6, elapsed * 1e9 / lines,
+            (lines == expectLines && bytes == expectBytes) ? "" : "  MISMATCH");
+}
+
+static void
+makeFile(uint64_t size)
+{
+    char line[256];
+    uint64_t seed = 88172645463325252ULL;
+    FILE *fp;
+    int len, j;
+
+    if ((fp = fopen(PATH, "w")) == NULL)
+        errExit("fopen");
+    while (fileSize < size) {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        len = 20 + seed % 181;
+        for (j = 0; j < len; j++)
+            line[j] = 'a' + (seed >> (j % 48)) % 26;
+        line[len] = '\n';
+        if (fwrite(line, len + 1, 1, fp) != 1)
+            errExit("fwrite");
+        fileSize += len + 1;
+        expectLines++;
+        expectBytes += len;
+    }
+    if (fclose(fp) == EOF)
+        errExit("fclose");
+}
+
+static void
+benchStdio(int unlocked)
+{
+    char buf[LINE_MAX_LEN];
+    uint64_t lines = 0, bytes = 0;
+    double start;
+    FILE *fp;
+    char *s;
+
+    if ((fp = fopen(PATH, "r")) == NULL)
+        errExit("fopen");
+    start = nowSec();
+    for (;;) {
+        s = unlocked ? fgets_unlocked(buf, sizeof(buf), fp) : fgets(buf, sizeof(buf), fp);
+        if (s == NULL)
+            break;
+        lines++;
+        bytes += strlen(buf) - 1;
+    }
+    report(unlocked ? "fgets_unlocked" : "fgets", nowSec() - start, lines, bytes);
+    fclose(fp);
+}
+
+static void
+benchGetline(void)
+{
+    uint64_t lines = 0, bytes = 0;
+    size_t cap = 0;
+    char *buf = NULL;
+    ssize_t n;
+    double start;
+    FILE *fp;
+
+    if ((fp = fopen(PATH, "r")) == NULL)
+        errExit("fopen");
+    start = nowSec();
+    while ((n = getline(&buf, &cap, fp)) != -1) {
+        lines++;
+        bytes += n - 1;
+    }
+    report("getline", nowSec() - start, lines, bytes);
+    free(buf);
+    fclose(fp);
+}
+
+static void
+benchSplitter(const char *name, size_t bufSize, int scalar)
+{
+    struct lineSplitter ls;
+    struct lsView line;
+    uint64_t lines = 0, bytes = 0;
+    double start;
+    int s;
+
+    lsForceScalar(scalar);
+    start = nowSec();
+    if (lsOpen(&ls, PATH, bufSize) == -1)
+        errExit("lsOpen");
+    while ((s = lsNext(&ls, &line)) == 1) {
+        lines++;
+        bytes += line.len;
+    }
+    if (s == -1)
+        errExit("lsNext");
+    lsClose(&ls);
+    report(name, nowSec() - start, lines, bytes);
+    lsForceScalar(0);
+}
+
+static int
+addLen(const struct lsView *line, void *arg)
+{
+    *(uint64_t *)arg += line->len;
+    return 0;
+}
+
+static void
+benchParallel(int nthreads)
+{
+    uint64_t bytes[64], *args[64], lines, total = 0;
+    char name[32];
+    double start;
+    int k;
+
+    for (k = 0; k < nthreads; k++) {
+        bytes[k] = 0;
+        args[k] = &bytes[k];
+    }
+    start = nowSec();
+    if (lsParallel(PATH, nthreads, addLen, (void **)args, &lines) == -1)
+        errExit("lsParallel");
+    for (k = 0; k < nthreads; k++)
+        total += bytes[k];
+    snprintf(name, sizeof(name), "lsParallel x%d", nthreads);
+    report(name, nowSec() - start, lines, total);
+}
+
+int
+main(int argc, char *argv[])
+{
+    uint64_t sizeMiB = 512;
+    int maxThreads = 8, opt, k;
+
+    while ((opt = getopt(argc, argv, "s:t:")) != -1) {
+        switch (opt) {
+        case 's': sizeMiB = strtoull(optarg, NULL, 10); break;
+        case 't': maxThreads = atoi(optarg); break;
+        default:
+            fprintf(stderr, "Usage: %s [-s sizeMiB] [-t maxThreads]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (sizeMiB == 0 || maxThreads < 1 || maxThreads > 64) {
+        fprintf(stderr, "sizeMiB must be > 0, maxThreads in [1, 64]\n");
+        exit(EXIT_FAILURE);
+    }
+
+    makeFile(sizeMiB << 20);
+    printf("%llu lines, %llu bytes (page cache warm)\n",
+            (unsigned long long)expectLines, (unsigned long long)fileSize);
+
+    benchStdio(0);
+    benchStdio(1);
+    benchGetline();
+    benchSplitter("lsNext mmap avx2", 0, 0);
+    benchSplitter("lsNext mmap memchr", 0, 1);
+    benchSplitter("lsNext buf 64K avx2", 64 * 1024, 0);
+    benchSplitter("lsNext buf 64K memchr", 64 * 1024, 1);
+    for (k = 1; k <= maxThreads; k *= 2)
+        benchParallel(k);
+
+    unlink(PATH);
+    exit(EXIT_SUCCESS);
+}
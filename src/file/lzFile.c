@@ -0,0 +1,651 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "lzFile.h"
+#include "../lib/lz_block.h"
+#include "../lib/crc32c.h"
+
+#define BLOCK_HDR sizeof(struct lfBlock)
+
+static int
+setError(struct lzFile *lf, int err)
+{
+    if (lf->err == 0)
+        lf->err = err;
+    errno = lf->err;
+    return -1;
+}
+
+/* 压缩一块, 压缩后不比原数据小时原样存放 */
+static void
+compressSlot(struct lfSlot *s)
+{
+    struct lfBlock *hdr = (struct lfBlock *)s->comp;
+    size_t clen;
+
+    clen = (s->rawLen > 1) ? lzCompress(s->raw, s->rawLen, s->comp + BLOCK_HDR, s->rawLen - 1) : 0;
+    if (clen == 0) {
+        memcpy(s->comp + BLOCK_HDR, s->raw, s->rawLen);
+        hdr->clen = s->rawLen | LF_STORED;
+        clen = s->rawLen;
+    } else {
+        hdr->clen = clen;
+    }
+    hdr->ulen = s->rawLen;
+    hdr->crc = crc32c(0, s->raw, s->rawLen);
+    s->compLen = BLOCK_HDR + clen;
+}
+
+/* 解压 comp 中的一块到 raw, 解压后的长度必须等于 expect */
+static int
+decodeBlock(const char *comp, size_t compLen, char *raw, size_t blockSize, size_t expect)
+{
+    const struct lfBlock *hdr = (const struct lfBlock *)comp;
+    size_t clen;
+
+    if (compLen < BLOCK_HDR || hdr->ulen != expect || expect > blockSize)
+        goto bad;
+    clen = hdr->clen & ~LF_STORED;
+    if (clen != compLen - BLOCK_HDR)
+        goto bad;
+    if (hdr->clen & LF_STORED) {
+        if (clen != expect)
+            goto bad;
+        memcpy(raw, comp + BLOCK_HDR, clen);
+    } else if (lzDecompress(comp + BLOCK_HDR, clen, raw, blockSize) != (ssize_t)expect) {
+        goto bad;
+    }
+    if (crc32c(0, raw, expect) != hdr->crc)
+        goto bad;
+    return 0;
+
+bad:
+    errno = EBADMSG;
+    return -1;
+}
+
+static void
+decompressSlot(struct lzFile *lf, struct lfSlot *s)
+{
+    s->err = (decodeBlock(s->comp, s->compLen, s->raw, lf->blockSize, s->rawLen) == 0) ? 0 : errno;
+}
+
+/* 处理当前批中还没有线程领取的块, 调用者和后台线程都执行它 */
+static void
+runJobs(struct lzFile *lf)
+{
+    int j;
+
+    while ((j = __atomic_fetch_add(&lf->next, 1, __ATOMIC_RELAXED)) < lf->nslots) {
+        if (lf->writing)
+            compressSlot(&lf->slots[j]);
+        else
+            decompressSlot(lf, &lf->slots[j]);
+    }
+}
+
+static void *
+workerMain(void *arg)
+{
+    struct lzFile *lf = arg;
+    uint64_t seen = 0;
+
+    pthread_mutex_lock(&lf->mtx);
+    for (;;) {
+        while (lf->gen == seen && !lf->stop)
+            pthread_cond_wait(&lf->start, &lf->mtx);
+        if (lf->stop)
+            break;
+        seen = lf->gen;
+        pthread_mutex_unlock(&lf->mtx);
+
+        runJobs(lf);
+
+        pthread_mutex_lock(&lf->mtx);
+        if (++lf->finished == lf->nthreads - 1)
+            pthread_cond_signal(&lf->done);
+    }
+    pthread_mutex_unlock(&lf->mtx);
+    return NULL;
+}
+
+/* 并行处理前 n 个块, 返回时全部完成 */
+static void
+runBatch(struct lzFile *lf, int n)
+{
+    lf->nslots = n;
+    if (lf->nthreads == 1 || n == 1) {
+        lf->next = 0;
+        runJobs(lf);
+        return;
+    }
+
+    pthread_mutex_lock(&lf->mtx);
+    lf->next = 0;
+    lf->finished = 0;
+    lf->gen++;
+    pthread_cond_broadcast(&lf->start);
+    pthread_mutex_unlock(&lf->mtx);
+
+    runJobs(lf);
+
+    // 等所有后台线程离开 runJobs(), 之后才能修改槽位
+    pthread_mutex_lock(&lf->mtx);
+    while (lf->finished < lf->nthreads - 1)
+        pthread_cond_wait(&lf->done, &lf->mtx);
+    pthread_mutex_unlock(&lf->mtx);
+}
+
+static void
+stopWorkers(struct lzFile *lf, int started)
+{
+    int j;
+
+    pthread_mutex_lock(&lf->mtx);
+    lf->stop = 1;
+    pthread_cond_broadcast(&lf->start);
+    pthread_mutex_unlock(&lf->mtx);
+    for (j = 0; j < started; j++)
+        pthread_join(lf->workers[j], NULL);
+}
+
+static void
+freeAll(struct lzFile *lf)
+{
+    int j;
+
+    if (lf->slots != NULL) {
+        for (j = 0; j < lf->nthreads; j++) {
+            free(lf->slots[j].raw);
+            free(lf->slots[j].comp);
+        }
+    }
+    free(lf->slots);
+    free(lf->workers);
+    free(lf->index);
+    lf->index = NULL;
+    free(lf->cache);
+    free(lf->cacheComp);
+    pthread_cond_destroy(&lf->start);
+    pthread_cond_destroy(&lf->done);
+    pthread_mutex_destroy(&lf->mtx);
+}
+
+/* 分配槽位并启动 nthreads - 1 个后台线程, fd 和 blockSize 已经设置 */
+static int
+setup(struct lzFile *lf, int nthreads)
+{
+    int j, err;
+
+    if (nthreads < 1)
+        nthreads = 1;
+    if (nthreads > LF_MAX_THREADS)
+        nthreads = LF_MAX_THREADS;
+    lf->nthreads = nthreads;
+    lf->cachedBlock = -1;
+    pthread_mutex_init(&lf->mtx, NULL);
+    pthread_cond_init(&lf->start, NULL);
+    pthread_cond_init(&lf->done, NULL);
+
+    if ((lf->slots = calloc(nthreads, sizeof(struct lfSlot))) == NULL ||
+            (lf->workers = calloc(nthreads, sizeof(pthread_t))) == NULL)
+        goto fail;
+    for (j = 0; j < nthreads; j++) {
+        if ((lf->slots[j].raw = malloc(lf->blockSize)) == NULL ||
+                (lf->slots[j].comp = malloc(BLOCK_HDR + lf->blockSize)) == NULL)
+            goto fail;
+    }
+
+    for (j = 0; j < nthreads - 1; j++) {
+        if ((err = pthread_create(&lf->workers[j], NULL, workerMain, lf)) != 0) {
+            stopWorkers(lf, j);
+            errno = err;
+            goto fail;
+        }
+    }
+    return 0;
+
+fail:
+    err = errno;
+    freeAll(lf);
+    errno = err;
+    return -1;
+}
+
+static int
+pwriteAll(int fd, struct iovec *iov, int iovcnt, off_t off)
+{
+    ssize_t n;
+
+    while (iovcnt > 0) {
+        if ((n = pwritev(fd, iov, iovcnt, off)) == -1) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        off += n;
+        while (iovcnt > 0 && (size_t)n >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return 0;
+}
+
+/* 读满 len 字节, 文件提前结束时 errno 为 EBADMSG */
+static int
+preadAll(int fd, void *buf, size_t len, off_t off)
+{
+    ssize_t n;
+
+    while (len > 0) {
+        if ((n = pread(fd, buf, len, off)) == -1) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        if (n == 0) {
+            errno = EBADMSG;
+            return -1;
+        }
+        buf = (char *)buf + n;
+        len -= n;
+        off += n;
+    }
+    return 0;
+}
+
+static int
+addIndex(struct lzFile *lf, uint64_t off)
+{
+    uint64_t *p;
+    uint64_t cap;
+
+    if (lf->nblocks == lf->indexCap) {
+        cap = (lf->indexCap == 0) ? 1024 : lf->indexCap * 2;
+        if ((p = realloc(lf->index, cap * sizeof(uint64_t))) == NULL)
+            return -1;
+        lf->index = p;
+        lf->indexCap = cap;
+    }
+    lf->index[lf->nblocks++] = off;
+    return 0;
+}
+
+/* 压缩前 n 个槽位并按顺序写出 */
+static int
+flushBatch(struct lzFile *lf, int n)
+{
+    struct iovec iov[LF_MAX_THREADS];
+    uint64_t off = lf->off;
+    int j;
+
+    if (n == 0)
+        return 0;
+    runBatch(lf, n);
+    for (j = 0; j < n; j++) {
+        iov[j].iov_base = lf->slots[j].comp;
+        iov[j].iov_len = lf->slots[j].compLen;
+        if (addIndex(lf, off) == -1)
+            return setError(lf, errno);
+        off += lf->slots[j].compLen;
+        lf->size += lf->slots[j].rawLen;
+        lf->slots[j].rawLen = 0;
+    }
+    if (pwriteAll(lf->fd, iov, n, lf->off) == -1)
+        return setError(lf, errno);
+    lf->compBytes += off - lf->off;
+    lf->off = off;
+    return 0;
+}
+
+int
+lfCreate(struct lzFile *lf, const char *path, size_t blockSize, int nthreads)
+{
+    struct lfHeader hdr;
+    int err;
+
+    memset(lf, 0, sizeof(struct lzFile));
+    if (blockSize == 0)
+        blockSize = LF_DEFAULT_BLOCK;
+    if (blockSize > LF_MAX_BLOCK) {
+        errno = EINVAL;
+        return -1;
+    }
+    lf->blockSize = blockSize;
+    lf->writing = 1;
+
+    if ((lf->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR)) == -1)
+        return -1;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, LF_MAGIC, sizeof(hdr.magic));
+    hdr.version = LF_VERSION;
+    hdr.blockSize = blockSize;
+    if (pwrite(lf->fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) || setup(lf, nthreads) == -1) {
+        err = (errno == 0) ? EIO : errno;
+        close(lf->fd);
+        errno = err;
+        return -1;
+    }
+    lf->off = sizeof(hdr);
+    return 0;
+}
+
+ssize_t
+lfWrite(struct lzFile *lf, const void *buf, size_t len)
+{
+    struct lfSlot *s;
+    size_t done = 0, n;
+
+    if (!lf->writing) {
+        errno = EBADF;
+        return -1;
+    }
+    if (lf->err != 0)
+        return setError(lf, lf->err);
+
+    while (done < len) {
+        s = &lf->slots[lf->cur];
+        n = lf->blockSize - s->rawLen;
+        if (n > len - done)
+            n = len - done;
+        memcpy(s->raw + s->rawLen, (const char *)buf + done, n);
+        s->rawLen += n;
+        done += n;
+        if (s->rawLen == lf->blockSize && ++lf->cur == lf->nthreads) {
+            lf->cur = 0;
+            if (flushBatch(lf, lf->nthreads) == -1)
+                return -1;
+        }
+    }
+    return len;
+}
+
+/* 读取并检查文件末尾的索引, 没有完整的索引时返回 -1 */
+static int
+loadIndex(struct lzFile *lf, uint64_t fileSize)
+{
+    struct lfTrailer tr;
+    uint64_t indexOff, j;
+
+    if (fileSize < sizeof(struct lfHeader) + sizeof(tr) ||
+            preadAll(lf->fd, &tr, sizeof(tr), fileSize - sizeof(tr)) == -1 ||
+            memcmp(tr.magic, LF_INDEX_MAGIC, sizeof(tr.magic)) != 0 ||
+            tr.nblocks > (fileSize - sizeof(struct lfHeader) - sizeof(tr)) / sizeof(uint64_t))
+        return -1;
+    indexOff = fileSize - sizeof(tr) - tr.nblocks * sizeof(uint64_t);
+    if (tr.size > tr.nblocks * lf->blockSize || (tr.nblocks > 0 && tr.size <= (tr.nblocks - 1) * lf->blockSize))
+        return -1;
+    if (tr.nblocks > 0 && (lf->index = malloc(tr.nblocks * sizeof(uint64_t))) == NULL)
+        return -1;
+    if (preadAll(lf->fd, lf->index, tr.nblocks * sizeof(uint64_t), indexOff) == -1 ||
+            crc32c(0, lf->index, tr.nblocks * sizeof(uint64_t)) != tr.crc)
+        goto bad;
+    // 偏移量必须递增, 且都在块数据的范围内
+    for (j = 0; j < tr.nblocks; j++) {
+        if (lf->index[j] + BLOCK_HDR > indexOff ||
+                lf->index[j] < ((j == 0) ? sizeof(struct lfHeader) : lf->index[j - 1] + BLOCK_HDR))
+            goto bad;
+    }
+    lf->nblocks = lf->indexCap = tr.nblocks;
+    lf->size = tr.size;
+    lf->off = indexOff;
+    return 0;
+
+bad:
+    free(lf->index);
+    lf->index = NULL;
+    return -1;
+}
+
+/* 没有索引时从头扫描块头部, 在第一个不完整或者不像块头部的位置停止 */
+static int
+scanBlocks(struct lzFile *lf, uint64_t fileSize)
+{
+    struct lfBlock b;
+    uint64_t off = sizeof(struct lfHeader);
+    size_t clen;
+
+    while (off + BLOCK_HDR <= fileSize) {
+        if (preadAll(lf->fd, &b, sizeof(b), off) == -1)
+            return (errno == EBADMSG) ? 0 : -1;
+        clen = b.clen & ~LF_STORED;
+        if (b.ulen == 0 || b.ulen > lf->blockSize || clen > lf->blockSize ||
+                off + BLOCK_HDR + clen > fileSize)
+            break;
+        if (addIndex(lf, off) == -1)
+            return -1;
+        lf->size += b.ulen;
+        off += BLOCK_HDR + clen;
+        // 只有最后一块可以不满
+        if (b.ulen < lf->blockSize)
+            break;
+    }
+    lf->off = off;
+    return 0;
+}
+
+int
+lfOpen(struct lzFile *lf, const char *path, int nthreads)
+{
+    struct lfHeader hdr;
+    struct stat st;
+    int err;
+
+    memset(lf, 0, sizeof(struct lzFile));
+    if ((lf->fd = open(path, O_RDONLY | O_CLOEXEC)) == -1)
+        return -1;
+    if (fstat(lf->fd, &st) == -1 || preadAll(lf->fd, &hdr, sizeof(hdr), 0) == -1)
+        goto fail;
+    if (memcmp(hdr.magic, LF_MAGIC, sizeof(hdr.magic)) != 0 || hdr.version != LF_VERSION ||
+            hdr.blockSize == 0 || hdr.blockSize > LF_MAX_BLOCK) {
+        errno = EBADMSG;
+        goto fail;
+    }
+    lf->blockSize = hdr.blockSize;
+
+    if (loadIndex(lf, st.st_size) == 0) {
+        lf->hadIndex = 1;
+    } else if (scanBlocks(lf, st.st_size) == -1) {
+        goto fail;
+    }
+    if (setup(lf, nthreads) == -1)
+        goto fail;
+    posix_fadvise(lf->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    return 0;
+
+fail:
+    err = errno;
+    free(lf->index);
+    close(lf->fd);
+    errno = err;
+    return -1;
+}
+
+/* 解压后块 b 的长度 */
+static size_t
+blockLen(const struct lzFile *lf, uint64_t b)
+{
+    return (b + 1 < lf->nblocks) ? lf->blockSize : lf->size - b * lf->blockSize;
+}
+
+/* 块 b 在文件中的长度, 包括块头部 */
+static size_t
+compLen(const struct lzFile *lf, uint64_t b)
+{
+    return ((b + 1 < lf->nblocks) ? lf->index[b + 1] : lf->off) - lf->index[b];
+}
+
+/* 读入并解压下一批块, 返回块数, 0 表示文件结束 */
+static int
+loadBatch(struct lzFile *lf)
+{
+    struct iovec iov[LF_MAX_THREADS];
+    uint64_t left = lf->nblocks - lf->nextBlock, total = 0;
+    struct lfSlot *s;
+    ssize_t got;
+    int n, j;
+
+    n = (left < (uint64_t)lf->nthreads) ? (int)left : lf->nthreads;
+    if (n == 0)
+        return 0;
+    for (j = 0; j < n; j++) {
+        s = &lf->slots[j];
+        s->compLen = compLen(lf, lf->nextBlock + j);
+        s->rawLen = blockLen(lf, lf->nextBlock + j);
+        if (s->compLen > BLOCK_HDR + lf->blockSize)
+            return setError(lf, EBADMSG);
+        iov[j].iov_base = s->comp;
+        iov[j].iov_len = s->compLen;
+        total += s->compLen;
+    }
+    // 一批块在文件中是连续的, 一次 preadv() 读入
+    do {
+        got = preadv(lf->fd, iov, n, lf->index[lf->nextBlock]);
+    } while (got == -1 && errno == EINTR);
+    if (got == -1)
+        return setError(lf, errno);
+    if ((uint64_t)got != total)
+        return setError(lf, EBADMSG);
+
+    runBatch(lf, n);
+    for (j = 0; j < n; j++) {
+        if (lf->slots[j].err != 0)
+            return setError(lf, lf->slots[j].err);
+    }
+    lf->compBytes += total;
+    lf->nextBlock += n;
+    lf->cur = 0;
+    lf->pos = 0;
+    return n;
+}
+
+ssize_t
+lfRead(struct lzFile *lf, void *buf, size_t len)
+{
+    struct lfSlot *s;
+    size_t done = 0, n;
+    int ret;
+
+    if (lf->writing) {
+        errno = EBADF;
+        return -1;
+    }
+    if (lf->err != 0)
+        return setError(lf, lf->err);
+
+    while (done < len) {
+        s = &lf->slots[lf->cur];
+        if (lf->cur < lf->nslots && lf->pos < s->rawLen) {
+            n = s->rawLen - lf->pos;
+            if (n > len - done)
+                n = len - done;
+            memcpy((char *)buf + done, s->raw + lf->pos, n);
+            lf->pos += n;
+            done += n;
+        } else if (lf->cur + 1 < lf->nslots) {
+            lf->cur++;
+            lf->pos = 0;
+        } else if ((ret = loadBatch(lf)) <= 0) {
+            // 已经读到的数据先返回, 错误留给下一次调用
+            if (ret == -1 && done == 0)
+                return -1;
+            break;
+        }
+    }
+    return done;
+}
+
+ssize_t
+lfPread(struct lzFile *lf, void *buf, size_t len, uint64_t off)
+{
+    size_t done = 0, n, clen, pos;
+    uint64_t b;
+
+    if (lf->writing) {
+        errno = EBADF;
+        return -1;
+    }
+    if (lf->cache == NULL) {
+        if ((lf->cache = malloc(lf->blockSize)) == NULL ||
+                (lf->cacheComp = malloc(BLOCK_HDR + lf->blockSize)) == NULL)
+            return -1;
+    }
+
+    while (done < len && off < lf->size) {
+        b = off / lf->blockSize;
+        if (lf->cachedBlock != (int64_t)b) {
+            lf->cachedBlock = -1;
+            clen = compLen(lf, b);
+            lf->cachedLen = blockLen(lf, b);
+            if (clen > BLOCK_HDR + lf->blockSize) {
+                errno = EBADMSG;
+                return -1;
+            }
+            if (preadAll(lf->fd, lf->cacheComp, clen, lf->index[b]) == -1 ||
+                    decodeBlock(lf->cacheComp, clen, lf->cache, lf->blockSize, lf->cachedLen) == -1)
+                return -1;
+            lf->cachedBlock = b;
+        }
+        pos = off - b * lf->blockSize;
+        n = lf->cachedLen - pos;
+        if (n > len - done)
+            n = len - done;
+        memcpy((char *)buf + done, lf->cache + pos, n);
+        done += n;
+        off += n;
+    }
+    return done;
+}
+
+/* 写出剩下的块, 然后是索引和尾部 */
+static int
+finish(struct lzFile *lf)
+{
+    struct lfTrailer tr;
+    struct iovec iov[2];
+
+    if (flushBatch(lf, lf->cur + (lf->slots[lf->cur].rawLen > 0)) == -1)
+        return -1;
+    memset(&tr, 0, sizeof(tr));
+    tr.nblocks = lf->nblocks;
+    tr.size = lf->size;
+    tr.crc = crc32c(0, lf->index, lf->nblocks * sizeof(uint64_t));
+    memcpy(tr.magic, LF_INDEX_MAGIC, sizeof(tr.magic));
+    iov[0].iov_base = lf->index;
+    iov[0].iov_len = lf->nblocks * sizeof(uint64_t);
+    iov[1].iov_base = &tr;
+    iov[1].iov_len = sizeof(tr);
+    if (pwriteAll(lf->fd, iov, 2, lf->off) == -1)
+        return setError(lf, errno);
+    return 0;
+}
+
+int
+lfClose(struct lzFile *lf)
+{
+    int err;
+
+    if (lf->writing && lf->err == 0)
+        finish(lf);
+    err = lf->err;
+    stopWorkers(lf, lf->nthreads - 1);
+    if (close(lf->fd) == -1 && err == 0)
+        err = errno;
+    freeAll(lf);
+    if (err != 0) {
+        errno = err;
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,191 @@
+/**
+ * @file lzFile.h
+ * @author Lock
+ * @date 16 Oct 2026
+ * @brief 分块压缩的文件
+ *
+ * 记录文件和日志文件按原样写入磁盘, 磁盘带宽是瓶颈. 这里把数据切成固定大小的块,
+ * 每块用 lz_block.h 的 LZ 编码独立压缩, 任何一块都可以单独解压.
+ *
+ * 文件布局:
+ *   - 64 字节的头部 @ref lfHeader.
+ *   - 若干个块, 每块是 @ref lfBlock 头部加压缩数据. 压缩后不比原数据小的块原样存放.
+ *   头部中的 CRC32C 覆盖解压后的数据.
+ *   - 索引: 每块在文件中的偏移量(uint64_t), 然后是 @ref lfTrailer.
+ *   lfClose() 时写入, 用于随机访问.
+ *
+ * 写入和顺序读取以批为单位并行: 一批有 nthreads 个块, 由 nthreads - 1 个后台线程
+ * 和调用者一起压缩(解压), 然后按顺序写出(返回).
+ *
+ * lfPread() 每次至少解压一整块, 随机读取较多时应该使用较小的块(如 16 KiB),
+ * 代价是压缩率稍低.
+ *
+ * 没有索引的文件(写入者崩溃)仍然可以读取: lfOpen() 从头扫描块头部重建索引,
+ * 在第一个不完整的块处停止.
+ *
+ * @example lzFileBench.c
+ */
+#ifndef LZ_FILE_H
+#define LZ_FILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#define LF_MAGIC "LZBLOCKS"
+#define LF_INDEX_MAGIC "LZBINDEX"
+#define LF_VERSION 1
+#define LF_DEFAULT_BLOCK (256 * 1024)   //!< 默认的块大小
+#define LF_MAX_BLOCK (16 * 1024 * 1024)
+#define LF_MAX_THREADS 64
+#define LF_STORED 0x80000000u           //!< lfBlock.clen 的最高位: 数据没有压缩
+
+/**
+ * @brief 磁盘上的文件头部
+ */
+struct lfHeader {
+    char magic[8];              //!< @ref LF_MAGIC
+    uint32_t version;           //!< @ref LF_VERSION
+    uint32_t blockSize;         //!< 除最后一块外每块解压后的大小
+    char reserved[48];
+} __attribute__((packed));
+
+/**
+ * @brief 磁盘上的块头部
+ */
+struct lfBlock {
+    uint32_t clen;              //!< 之后的数据长度, 最高位为 @ref LF_STORED
+    uint32_t ulen;              //!< 解压后的长度
+    uint32_t crc;               //!< 解压后数据的 CRC32C
+} __attribute__((packed));
+
+/**
+ * @brief 磁盘上的索引尾部, 位于文件末尾
+ */
+struct lfTrailer {
+    uint64_t nblocks;
+    uint64_t size;              //!< 解压后的总长度
+    uint32_t crc;               //!< 索引数组的 CRC32C
+    char magic[8];              //!< @ref LF_INDEX_MAGIC
+} __attribute__((packed));
+
+struct lzFile;
+
+/**
+ * @brief 一批中的一个块
+ */
+struct lfSlot {
+    char *raw;                  //!< 解压后的数据, 大小为 blockSize
+    char *comp;                 //!< 块头部和压缩数据
+    size_t rawLen;
+    size_t compLen;             //!< 包括块头部
+    int err;                    //!< 解压失败时的 errno
+};
+
+/**
+ * @brief 打开的压缩文件
+ */
+struct lzFile {
+    int fd;
+    int writing;
+    size_t blockSize;
+    int nthreads;
+
+    struct lfSlot *slots;       //!< nthreads 个
+    int nslots;                 //!< 当前批中的块数
+    int cur;                    //!< 写: 正在填充的块; 读: 正在返回的块
+    size_t pos;                 //!< 读: 在当前块中的位置
+
+    uint64_t *index;            //!< 每块的文件偏移量
+    uint64_t nblocks;
+    uint64_t indexCap;
+    uint64_t size;              //!< 解压后的总长度
+    uint64_t off;               //!< 写: 下一块的文件偏移量
+    uint64_t nextBlock;         //!< 读: 下一批的第一块
+    int hadIndex;               //!< 读: 文件有完整的索引
+
+    char *cache;                //!< lfPread() 最近解压的块
+    int64_t cachedBlock;
+    size_t cachedLen;
+    char *cacheComp;
+
+    pthread_t *workers;
+    pthread_mutex_t mtx;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    uint64_t gen;               //!< 每批加 1
+    int next;                   //!< 下一个要处理的块
+    int finished;
+    int stop;
+
+    int err;                    //!< 出错时的 errno, 之后的操作都会失败
+    uint64_t compBytes;         //!< 写出或读入的块字节数, 包括块头部
+};
+
+/**
+ * @brief 创建(截断)压缩文件
+ *
+ * @param lf 压缩文件
+ * @param path 路径
+ * @param blockSize 块大小, 为 0 时使用 @ref LF_DEFAULT_BLOCK
+ * @param nthreads 压缩线程数, 包括调用者
+ *
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+int
+lfCreate(struct lzFile *lf, const char *path, size_t blockSize, int nthreads);
+
+/**
+ * @brief 写入数据
+ *
+ * @return 返回 @p len
+ * @retval -1 失败
+ */
+ssize_t
+lfWrite(struct lzFile *lf, const void *buf, size_t len);
+
+/**
+ * @brief 打开压缩文件读取
+ *
+ * @param lf 压缩文件
+ * @param path 路径
+ * @param nthreads 顺序读取时的解压线程数, 包括调用者
+ *
+ * @retval 0 成功
+ * @retval -1 失败, 文件格式不正确时 errno 为 `EBADMSG`
+ */
+int
+lfOpen(struct lzFile *lf, const char *path, int nthreads);
+
+/**
+ * @brief 顺序读取解压后的数据
+ *
+ * @return 返回读取的字节数, 0 表示文件结束
+ * @retval -1 失败, 数据损坏时 errno 为 `EBADMSG`
+ */
+ssize_t
+lfRead(struct lzFile *lf, void *buf, size_t len);
+
+/**
+ * @brief 从解压后的偏移量 @p off 处读取, 只解压需要的块
+ *
+ * 与 lfRead() 的位置无关. 最近解压的一块被缓存, 连续的小读取不必重复解压.
+ *
+ * @return 返回读取的字节数, 超过文件末尾时返回 0
+ * @retval -1 失败
+ */
+ssize_t
+lfPread(struct lzFile *lf, void *buf, size_t len, uint64_t off);
+
+/**
+ * @brief 关闭文件. 写入时压缩剩下的数据, 写出索引
+ *
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+int
+lfClose(struct lzFile *lf);
+
+#endif
@@ -0,0 +1,311 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "lzFile.h"
+#include "recordStore.h"
+
+/*
+ * 分块压缩文件的压缩率和吞吐量
+ *
+ * 在内存中生成 sizeMiB 的记录文件内容(@ref rsHeader 加 itemRecord, name 为 4 ~ 20 个随机小写字母,
+ * total 为 0 ~ 10^6 的随机数), 然后:
+ *   - 原样 write() + fsync() 到磁盘, 再丢弃页缓存后读出, 作为对比.
+ *   - 用 1 ~ threads 个线程压缩写入(含 fsync()), 再丢弃页缓存后解压读取并与原数据比较,
+ *   报告压缩率和按解压后大小计算的 GB/s.
+ *   - 文件在页缓存中时, 随机 lfPread() 单条记录的延迟, 与 pread() 原始文件对比.
+ *   - 截掉索引和最后一块的一部分, 检查没有索引时仍能读出前面完整的块.
+ *
+ * 编译: gcc -O2 -pthread lzFileBench.c lzFile.c ../lib/lz_block.c ../lib/crc32c.c -o lzFileBench
+ * 用法: lzFileBench [-d dir] [-s sizeMiB] [-b blockKiB] [-t threads] [-r lookups]
+ */
+
+#define IO_CHUNK (1024 * 1024)
+
+void errExit(char *msg)
+{
+    extern int errno;
+    perror(msg);
+    exit(errno);
+}
+
+static double
+nowSec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t
+xorshift(uint64_t *s)
+{
+    *s ^= *s << 13;
+    *s ^= *s >> 7;
+    *s ^= *s << 17;
+    return *s;
+}
+
+/* 生成 size 字节的记录文件内容 */
+static char *
+generate(size_t size)
+{
+    struct rsHeader *hdr;
+    struct itemRecord *r;
+    uint64_t seed = 88172645463325252ULL, n, j, len;
+    char *buf;
+
+    if ((buf = calloc(1, size)) == NULL)
+        errExit("calloc");
+    n = (size - sizeof(struct rsHeader)) / sizeof(struct itemRecord);
+    hdr = (struct rsHeader *)buf;
+    memcpy(hdr->magic, RS_MAGIC, sizeof(hdr->magic));
+    hdr->version = RS_VERSION;
+    hdr->recordSize = sizeof(struct itemRecord);
+    hdr->count = n;
+    r = (struct itemRecord *)(buf + sizeof(struct rsHeader));
+    for (j = 0; j < n; j++) {
+        r[j].total = xorshift(&seed) % 1000000;
+        r[j].count = j & 0x7fff;
+        for (len = 4 + xorshift(&seed) % 17; len > 0; len--)
+            r[j].name[len - 1] = 'a' + xorshift(&seed) % 26;
+    }
+    return buf;
+}
+
+static void
+syncAndDrop(const char *path)
+{
+    int fd;
+
+    if ((fd = open(path, O_RDONLY)) == -1)
+        errExit("open");
+    if (fsync(fd) == -1)
+        errExit("fsync");
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
+
+static off_t
+fileSize(const char *path)
+{
+    struct stat st;
+
+    if (stat(path, &st) == -1)
+        errExit("stat");
+    return st.st_size;
+}
+
+static double
+writeRaw(const char *path, const char *data, size_t size)
+{
+    double start = nowSec();
+    size_t off;
+    ssize_t n;
+    int fd;
+
+    if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR)) == -1)
+        errExit("open");
+    for (off = 0; off < size; off += n)
+        if ((n = write(fd, data + off, (size - off < IO_CHUNK) ? size - off : IO_CHUNK)) <= 0)
+            errExit("write");
+    close(fd);
+    syncAndDrop(path);
+    return nowSec() - start;
+}
+
+static double
+readRaw(const char *path, size_t size)
+{
+    double start = nowSec();
+    size_t off;
+    ssize_t n;
+    char *buf;
+    int fd;
+
+    if ((buf = malloc(IO_CHUNK)) == NULL)
+        errExit("malloc");
+    if ((fd = open(path, O_RDONLY)) == -1)
+        errExit("open");
+    for (off = 0; off < size; off += n)
+        if ((n = read(fd, buf, IO_CHUNK)) <= 0)
+            errExit("read");
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+    free(buf);
+    return nowSec() - start;
+}
+
+static double
+writeLz(const char *path, const char *data, size_t size, size_t blockSize, int nthreads)
+{
+    double start = nowSec();
+    struct lzFile lf;
+    size_t off, n;
+
+    if (lfCreate(&lf, path, blockSize, nthreads) == -1)
+        errExit("lfCreate");
+    for (off = 0; off < size; off += n) {
+        n = (size - off < IO_CHUNK) ? size - off : IO_CHUNK;
+        if (lfWrite(&lf, data + off, n) == -1)
+            errExit("lfWrite");
+    }
+    if (lfClose(&lf) == -1)
+        errExit("lfClose");
+    syncAndDrop(path);
+    return nowSec() - start;
+}
+
+/* 顺序读出并与原数据比较, 返回读出的字节数 */
+static size_t
+readLz(const char *path, const char *data, size_t size, int nthreads, double *sec, int *hadIndex)
+{
+    double start = nowSec();
+    struct lzFile lf;
+    size_t total = 0;
+    ssize_t n;
+    char *buf;
+
+    if ((buf = malloc(IO_CHUNK)) == NULL)
+        errExit("malloc");
+    if (lfOpen(&lf, path, nthreads) == -1)
+        errExit("lfOpen");
+    while ((n = lfRead(&lf, buf, IO_CHUNK)) > 0) {
+        if (total + n > size || memcmp(buf, data + total, n) != 0) {
+            printf("  DATA MISMATCH at %zu\n", total);
+            break;
+        }
+        total += n;
+    }
+    if (n == -1)
+        errExit("lfRead");
+    *sec = nowSec() - start;
+    if (hadIndex != NULL)
+        *hadIndex = lf.hadIndex;
+    lfClose(&lf);
+    free(buf);
+    return total;
+}
+
+static void
+randomAccess(const char *lzPath, const char *rawPath, const char *data, size_t size, long lookups)
+{
+    struct itemRecord rec;
+    struct lzFile lf;
+    uint64_t seed = 2463534242ULL, n, off;
+    double start, lzSec, rawSec;
+    long j;
+    int fd;
+
+    if (lfOpen(&lf, lzPath, 1) == -1)
+        errExit("lfOpen");
+    if ((fd = open(rawPath, O_RDONLY)) == -1)
+        errExit("open");
+    n = (size - sizeof(struct rsHeader)) / sizeof(struct itemRecord);
+
+    // 先把两个文件读入页缓存, 只比较解压和系统调用的开销
+    readLz(lzPath, data, size, 1, &lzSec, NULL);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+    for (off = 0; off < size; off += 4096)
+        pread(fd, &rec, 1, off);
+
+    start = nowSec();
+    for (j = 0; j < lookups; j++) {
+        off = sizeof(struct rsHeader) + xorshift(&seed) % n * sizeof(rec);
+        if (lfPread(&lf, &rec, sizeof(rec), off) != sizeof(rec) ||
+                memcmp(&rec, data + off, sizeof(rec)) != 0) {
+            printf("  RECORD MISMATCH at %lu\n", (unsigned long)off);
+            break;
+        }
+    }
+    lzSec = nowSec() - start;
+
+    seed = 2463534242ULL;
+    start = nowSec();
+    for (j = 0; j < lookups; j++) {
+        off = sizeof(struct rsHeader) + xorshift(&seed) % n * sizeof(rec);
+        if (pread(fd, &rec, sizeof(rec), off) != sizeof(rec))
+            errExit("pread");
+    }
+    rawSec = nowSec() - start;
+
+    printf("random record  lfPread %7.2f us/op  pread %7.2f us/op\n",
+            lzSec * 1e6 / lookups, rawSec * 1e6 / lookups);
+    close(fd);
+    lfClose(&lf);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const char *dir = "/var/tmp";
+    char rawPath[PATH_MAX], lzPath[PATH_MAX];
+    long sizeMiB = 512, blockKiB = LF_DEFAULT_BLOCK / 1024, lookups = 100000;
+    int opt, maxThreads, t, hadIndex;
+    size_t size, got, blockSize;
+    double sec, rsec, gb;
+    off_t lzSize;
+    char *data;
+
+    maxThreads = sysconf(_SC_NPROCESSORS_ONLN);
+    while ((opt = getopt(argc, argv, "d:s:b:t:r:")) != -1) {
+        switch (opt) {
+        case 'd': dir = optarg; break;
+        case 's': sizeMiB = atol(optarg); break;
+        case 'b': blockKiB = atol(optarg); break;
+        case 't': maxThreads = atoi(optarg); break;
+        case 'r': lookups = atol(optarg); break;
+        default:
+            fprintf(stderr, "Usage: %s [-d dir] [-s sizeMiB] [-b blockKiB] [-t threads] "
+                    "[-r lookups]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (sizeMiB <= 0 || blockKiB <= 0 || maxThreads <= 0 || lookups <= 0) {
+        fprintf(stderr, "arguments must be > 0\n");
+        exit(EXIT_FAILURE);
+    }
+    size = (size_t)sizeMiB << 20;
+    blockSize = (size_t)blockKiB << 10;
+    gb = size / 1e9;
+    snprintf(rawPath, sizeof(rawPath), "%s/lzFile.raw", dir);
+    snprintf(lzPath, sizeof(lzPath), "%s/lzFile.lz", dir);
+
+    data = generate(size);
+    printf("%ld MiB of %zu-byte records, block %ld KiB\n", sizeMiB, sizeof(struct itemRecord),
+            blockKiB);
+    sec = writeRaw(rawPath, data, size);
+    rsec = readRaw(rawPath, size);
+    printf("raw            write %6.2f GB/s  read %6.2f GB/s\n", gb / sec, gb / rsec);
+
+    for (t = 1; t <= maxThreads; t = (t * 2 > maxThreads && t < maxThreads) ? maxThreads : t * 2) {
+        sec = writeLz(lzPath, data, size, blockSize, t);
+        lzSize = fileSize(lzPath);
+        got = readLz(lzPath, data, size, t, &rsec, NULL);
+        printf("%2d threads     write %6.2f GB/s  read %6.2f GB/s  ratio %5.2f%s\n", t,
+                gb / sec, gb / rsec, (double)size / lzSize, (got == size) ? "" : "  SHORT READ");
+    }
+
+    randomAccess(lzPath, rawPath, data, size, lookups);
+
+    // 模拟写入者崩溃: 去掉索引和最后一块的一半
+    lzSize = fileSize(lzPath);
+    if (truncate(lzPath, lzSize - sizeof(struct lfTrailer) -
+                (size + blockSize - 1) / blockSize * sizeof(uint64_t) - 100) == -1)
+        errExit("truncate");
+    got = readLz(lzPath, data, size, maxThreads, &rsec, &hadIndex);
+    printf("torn file      index %s, recovered %zu of %zu bytes (%zu full blocks)\n",
+            hadIndex ? "found" : "rebuilt", got, size, got / blockSize);
+
+    unlink(rawPath);
+    unlink(lzPath);
+    free(data);
+    exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,398 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "nameIndex.h"
+
+_Static_assert(sizeof(struct niHeader) <= NI_HEADER_SIZE, "niHeader size");
+
+struct buildArg {
+    struct nameIndex *ni;
+    const struct recordStore *rs;
+    uint64_t first, last;
+};
+
+static inline uint64_t
+mix64(uint64_t x)
+{
+    x ^= x >> 32;
+    x *= 0xd6e8feb86659fd93ULL;
+    x ^= x >> 32;
+    x *= 0xd6e8feb86659fd93ULL;
+    x ^= x >> 32;
+    return x;
+}
+
+uint64_t
+niHash(const char *name)
+{
+    size_t len = strnlen(name, RS_NAMESIZE), j;
+    uint64_t h = 0x9e3779b97f4a7c15ULL ^ len, w;
+
+    // 每次处理 8 个字节
+    for (j = 0; j + 8 <= len; j += 8) {
+        memcpy(&w, name + j, 8);
+        h = mix64(h ^ w);
+    }
+    if (j < len) {
+        w = 0;
+        memcpy(&w, name + j, len - j);
+        h = mix64(h ^ w);
+    }
+    return mix64(h);
+}
+
+static inline int
+nameEqual(const char *key, const char *name)
+{
+    return strncmp(key, name, RS_NAMESIZE) == 0;
+}
+
+/*
+ * 分块 Bloom 过滤器: 高 32 位哈希选择一个 64 字节的块, 每个名字的 k 位都落在这一块中,
+ * 检查一个名字最多一次缓存未命中. 块内位置取自哈希值乘以一个奇数常量之后的低 54 位,
+ * 每 9 位一个.
+ */
+#define BLOOM_BLOCK_BITS 512
+
+static inline uint64_t *
+bloomBlock(const struct nameIndex *ni, uint64_t h)
+{
+    uint64_t nblocks = ni->hdr->bloomBits / BLOOM_BLOCK_BITS;
+
+    return ni->bloom + ((h >> 32) & (nblocks - 1)) * (BLOOM_BLOCK_BITS / 64);
+}
+
+static inline void
+bloomSet(struct nameIndex *ni, uint64_t h, int atomic)
+{
+    uint64_t *blk = bloomBlock(ni, h), g = h * 0x9e3779b97f4a7c15ULL, bit;
+    int i;
+
+    for (i = 0; i < NI_BLOOM_K; i++, g >>= 9) {
+        bit = g & (BLOOM_BLOCK_BITS - 1);
+        if (atomic)
+            __atomic_fetch_or(&blk[bit >> 6], 1ULL << (bit & 63), __ATOMIC_RELAXED);
+        else
+            blk[bit >> 6] |= 1ULL << (bit & 63);
+    }
+}
+
+static inline int
+bloomTest(const struct nameIndex *ni, uint64_t h)
+{
+    const uint64_t *blk = bloomBlock(ni, h);
+    uint64_t g = h * 0x9e3779b97f4a7c15ULL, bit;
+    int i;
+
+    for (i = 0; i < NI_BLOOM_K; i++, g >>= 9) {
+        bit = g & (BLOOM_BLOCK_BITS - 1);
+        if (!(blk[bit >> 6] & (1ULL << (bit & 63))))
+            return 0;
+    }
+    return 1;
+}
+
+static size_t
+indexSize(uint64_t nslots, uint64_t bloomBits)
+{
+    return NI_HEADER_SIZE + bloomBits / 8 + nslots * sizeof(struct niSlot);
+}
+
+static void
+setPointers(struct nameIndex *ni)
+{
+    ni->hdr = (struct niHeader *)ni->base;
+    ni->bloom = (uint64_t *)(ni->base + NI_HEADER_SIZE);
+    ni->slots = (struct niSlot *)(ni->base + NI_HEADER_SIZE + ni->hdr->bloomBits / 8);
+}
+
+/* 槽位个数: 能在最大装载因子以内容纳 n 个条目的最小的 2 的幂 */
+static uint64_t
+slotsFor(uint64_t n)
+{
+    uint64_t s = NI_MIN_SLOTS;
+
+    while (s * NI_MAX_LOAD < n + 1)
+        s <<= 1;
+    return s;
+}
+
+/*
+ * 创建并映射一个新的空索引文件. 未写入的部分读出来都是 0, 正好是空槽位和空的 Bloom 过滤器.
+ * 用 fallocate() 预先分配磁盘块, 避免随机写入稀疏文件时在缺页处理中逐页分配.
+ */
+static int
+createFile(struct nameIndex *ni, const char *path, uint64_t nslots)
+{
+    struct niHeader hdr;
+    int savedErrno;
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, NI_MAGIC, sizeof(hdr.magic));
+    hdr.version = NI_VERSION;
+    hdr.nslots = nslots;
+    hdr.bloomBits = nslots * 8;
+
+    ni->size = indexSize(hdr.nslots, hdr.bloomBits);
+    if ((ni->fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC,
+                    S_IRUSR | S_IWUSR | S_IRGRP)) == -1)
+        return -1;
+    if (fallocate(ni->fd, 0, 0, ni->size) == -1 &&
+            (errno != EOPNOTSUPP || ftruncate(ni->fd, ni->size) == -1))
+        goto fail;
+
+    ni->base = mmap(NULL, ni->size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, ni->fd, 0);
+    if (ni->base == MAP_FAILED)
+        goto fail;
+    memcpy(ni->base, &hdr, sizeof(hdr));
+    setPointers(ni);
+    return 0;
+
+fail:
+    savedErrno = errno;
+    close(ni->fd);
+    unlink(path);
+    errno = savedErrno;
+    return -1;
+}
+
+static void
+unmapIndex(struct nameIndex *ni)
+{
+    munmap(ni->base, ni->size);
+    close(ni->fd);
+}
+
+/* 单线程插入 */
+static void
+insertSlot(struct nameIndex *ni, uint64_t h, uint64_t recno)
+{
+    uint64_t mask = ni->hdr->nslots - 1, j;
+
+    for (j = h & mask; ni->slots[j].recno1 != 0; j = (j + 1) & mask)
+        ;
+    ni->slots[j].hash = h;
+    ni->slots[j].recno1 = recno + 1;
+    ni->hdr->entries++;
+    bloomSet(ni, h, 0);
+}
+
+/* 多线程插入: 通过 CAS 抢占空槽位 */
+static void
+insertSlotAtomic(struct nameIndex *ni, uint64_t h, uint64_t recno)
+{
+    uint64_t mask = ni->hdr->nslots - 1, j, expected;
+
+    for (j = h & mask; ; j = (j + 1) & mask) {
+        expected = 0;
+        if (__atomic_load_n(&ni->slots[j].recno1, __ATOMIC_RELAXED) == 0 &&
+                __atomic_compare_exchange_n(&ni->slots[j].recno1, &expected,
+                    recno + 1, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            break;
+    }
+    ni->slots[j].hash = h;
+    bloomSet(ni, h, 1);
+}
+
+/*
+ * 扩容: 在临时文件中建立两倍大小的索引, 再用 rename() 原子地替换旧文件
+ */
+static int
+grow(struct nameIndex *ni)
+{
+    struct nameIndex nn;
+    char tmp[PATH_MAX + 8];
+    uint64_t j;
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", ni->path);
+    if (createFile(&nn, tmp, ni->hdr->nslots * 2) == -1)
+        return -1;
+
+    for (j = 0; j < ni->hdr->nslots; j++)
+        if (ni->slots[j].recno1 != 0)
+            insertSlot(&nn, ni->slots[j].hash, ni->slots[j].recno1 - 1);
+    nn.hdr->indexed = ni->hdr->indexed;
+
+    if (msync(nn.base, nn.size, MS_SYNC) == -1 || rename(tmp, ni->path) == -1) {
+        unmapIndex(&nn);
+        unlink(tmp);
+        return -1;
+    }
+
+    unmapIndex(ni);
+    ni->fd = nn.fd;
+    ni->base = nn.base;
+    ni->size = nn.size;
+    setPointers(ni);
+    return 0;
+}
+
+int
+niAdd(struct nameIndex *ni, const struct recordStore *rs, uint64_t recno)
+{
+    const struct itemRecord *rec;
+
+    if (recno != ni->hdr->indexed || (rec = rsGet(rs, recno)) == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if ((ni->hdr->entries + 1) > ni->hdr->nslots * NI_MAX_LOAD && grow(ni) == -1)
+        return -1;
+
+    insertSlot(ni, niHash(rec->name), recno);
+    ni->hdr->indexed++;
+    return 0;
+}
+
+int
+niOpen(struct nameIndex *ni, const char *path, const struct recordStore *rs)
+{
+    struct niHeader hdr;
+    struct stat sb;
+    uint64_t j;
+
+    memset(ni, 0, sizeof(struct nameIndex));
+    if (strlen(path) >= sizeof(ni->path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(ni->path, path);
+
+    if ((ni->fd = open(path, O_RDWR | O_CLOEXEC)) == -1) {
+        if (errno != ENOENT)
+            return -1;
+        if (createFile(ni, path, slotsFor(rsCount(rs))) == -1)
+            return -1;
+    } else {
+        if (fstat(ni->fd, &sb) == -1 ||
+                pread(ni->fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) ||
+                memcmp(hdr.magic, NI_MAGIC, sizeof(hdr.magic)) != 0 ||
+                hdr.version != NI_VERSION ||
+                (size_t)sb.st_size != indexSize(hdr.nslots, hdr.bloomBits) ||
+                hdr.indexed > rsCount(rs)) {
+            close(ni->fd);
+            errno = EBADMSG;
+            return -1;
+        }
+        ni->size = sb.st_size;
+        ni->base = mmap(NULL, ni->size, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, ni->fd, 0);
+        if (ni->base == MAP_FAILED) {
+            close(ni->fd);
+            return -1;
+        }
+        setPointers(ni);
+    }
+
+    // 为上次关闭之后追加的记录补建索引
+    for (j = ni->hdr->indexed; j < rsCount(rs); j++)
+        if (niAdd(ni, rs, j) == -1) {
+            unmapIndex(ni);
+            return -1;
+        }
+
+    return 0;
+}
+
+static void *
+buildWorker(void *arg)
+{
+    struct buildArg *ba = arg;
+    uint64_t j;
+
+    for (j = ba->first; j < ba->last; j++)
+        insertSlotAtomic(ba->ni, niHash(rsGet(ba->rs, j)->name), j);
+    return NULL;
+}
+
+int
+niBuild(const char *path, const struct recordStore *rs, int nthreads)
+{
+    struct nameIndex ni;
+    struct buildArg *args;
+    pthread_t *tids;
+    uint64_t n = rsCount(rs), per;
+    char tmp[PATH_MAX + 8];
+    int j, started = 0, ret = -1;
+
+    if (nthreads < 1)
+        nthreads = 1;
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    if (createFile(&ni, tmp, slotsFor(n)) == -1)
+        return -1;
+
+    args = calloc(nthreads, sizeof(struct buildArg));
+    tids = calloc(nthreads, sizeof(pthread_t));
+    if (args == NULL || tids == NULL)
+        goto out;
+
+    per = (n + nthreads - 1) / nthreads;
+    for (j = 0; j < nthreads; j++) {
+        args[j].ni = &ni;
+        args[j].rs = rs;
+        args[j].first = (uint64_t)j * per < n ? (uint64_t)j * per : n;
+        args[j].last = args[j].first + per < n ? args[j].first + per : n;
+        errno = pthread_create(&tids[j], NULL, buildWorker, &args[j]);
+        if (errno != 0)
+            break;
+        started++;
+    }
+    for (j = 0; j < started; j++)
+        pthread_join(tids[j], NULL);
+    if (started != nthreads)
+        goto out;
+
+    ni.hdr->entries = n;
+    ni.hdr->indexed = n;
+    if (msync(ni.base, ni.size, MS_SYNC) == -1 || rename(tmp, path) == -1)
+        goto out;
+    ret = 0;
+
+out:
+    free(args);
+    free(tids);
+    unmapIndex(&ni);
+    if (ret == -1)
+        unlink(tmp);
+    return ret;
+}
+
+int64_t
+niLookup(const struct nameIndex *ni, const struct recordStore *rs, const char *name)
+{
+    uint64_t h = niHash(name), mask = ni->hdr->nslots - 1, j, r;
+
+    if (!bloomTest(ni, h))
+        return -1;
+
+    for (j = h & mask; (r = ni->slots[j].recno1) != 0; j = (j + 1) & mask)
+        if (ni->slots[j].hash == h && nameEqual(name, rsGet(rs, r - 1)->name))
+            return r - 1;
+
+    return -1;
+}
+
+int
+niSync(struct nameIndex *ni)
+{
+    return msync(ni->base, ni->size, MS_SYNC);
+}
+
+int
+niClose(struct nameIndex *ni)
+{
+    int ret = niSync(ni);
+
+    unmapIndex(ni);
+    return ret;
+}
@@ -0,0 +1,140 @@
+/**
+ * @file nameIndex.h
+ * @author Lock
+ * @date 16 Oct 2026
+ * @brief 记录文件 name 字段上的持久化哈希索引
+ *
+ * 在 recordStore.h 的记录文件中按 `name` 查找记录只能顺序扫描整个文件.
+ * 索引文件保存一张开放寻址(线性探测)的哈希表, 从名字映射到记录编号,
+ * 文件整体通过 mmap() 访问, 打开之后查找不需要任何系统调用.
+ *
+ * 索引文件布局:
+ *   - 4096 字节的头部 @ref niHeader
+ *   - Bloom 过滤器位图, 每个槽位 8 位, 使用 @ref NI_BLOOM_K 个哈希函数.
+ *   位图按 64 字节分块, 一个名字的所有位都在同一块中.
+ *   查找一个不存在的名字时, 绝大多数情况下只需检查位图就能返回, 不必探测哈希表.
+ *   - 槽位数组 @ref niSlot, 槽位个数是 2 的幂. 槽位中保存完整的 64 位哈希值,
+ *   扩容时不必重新读取记录中的名字.
+ *
+ * 索引有两种建立方式:
+ *   - 增量: 每次 rsAppend() 之后调用 niAdd(). 装载因子超过 @ref NI_MAX_LOAD 时,
+ *   把索引重建到一个两倍大小的新文件中, 然后 rename() 替换旧文件.
+ *   - 批量: niBuild() 为已有的记录文件并行建立索引, 多个线程用
+ *   比较并交换(CAS)抢占槽位, 用原子或设置 Bloom 过滤器的位.
+ *
+ * 头部中的 `indexed` 记录已经建立索引的记录个数, niOpen() 时会为之后追加的记录补建索引.
+ *
+ * @note 名字重复时, niLookup() 返回其中任意一条记录.
+ *
+ * @example nameIndexBench.c
+ */
+#ifndef NAME_INDEX_H
+#define NAME_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <limits.h>
+#include "recordStore.h"
+
+#define NI_MAGIC "ITEMNIDX"
+#define NI_VERSION 1
+#define NI_HEADER_SIZE 4096
+#define NI_MIN_SLOTS 1024
+#define NI_MAX_LOAD 0.7         //!< 最大装载因子
+#define NI_BLOOM_K 6            //!< Bloom 过滤器的哈希函数个数
+
+/**
+ * @brief 磁盘上的索引头部
+ */
+struct niHeader {
+    char magic[8];              //!< @ref NI_MAGIC
+    uint32_t version;           //!< @ref NI_VERSION
+    uint32_t reserved;
+    uint64_t nslots;            //!< 槽位个数, 2 的幂
+    uint64_t bloomBits;         //!< Bloom 过滤器的位数, 2 的幂
+    uint64_t entries;           //!< 已使用的槽位个数
+    uint64_t indexed;           //!< 已建立索引的记录个数
+} __attribute__((packed));
+
+/**
+ * @brief 哈希表槽位
+ */
+struct niSlot {
+    uint64_t hash;              //!< 名字的哈希值
+    uint64_t recno1;            //!< 记录编号加 1, 0 表示空槽位
+};
+
+/**
+ * @brief 打开的索引
+ */
+struct nameIndex {
+    int fd;
+    char *base;
+    size_t size;
+    struct niHeader *hdr;
+    uint64_t *bloom;
+    struct niSlot *slots;
+    char path[PATH_MAX];
+};
+
+/**
+ * @brief 计算名字的哈希值, 只使用第一个空字符之前(最多 @ref RS_NAMESIZE 个)的字节
+ */
+uint64_t
+niHash(const char *name);
+
+/**
+ * @brief 打开索引文件, 不存在时创建, 并为 @p rs 中尚未建立索引的记录补建索引
+ *
+ * @retval 0 成功
+ * @retval -1 失败, 文件格式不正确时 errno 为 `EBADMSG`
+ */
+int
+niOpen(struct nameIndex *ni, const char *path, const struct recordStore *rs);
+
+/**
+ * @brief 为 @p rs 中的全部记录并行建立索引, 覆盖 @p path
+ *
+ * @param path 索引文件路径
+ * @param rs 记录文件
+ * @param nthreads 线程个数
+ *
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+int
+niBuild(const char *path, const struct recordStore *rs, int nthreads);
+
+/**
+ * @brief 把编号为 @p recno 的记录加入索引
+ *
+ * 记录必须按编号顺序加入, 即 @p recno 等于头部中的 `indexed`.
+ *
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+int
+niAdd(struct nameIndex *ni, const struct recordStore *rs, uint64_t recno);
+
+/**
+ * @brief 按名字查找记录
+ *
+ * @return 返回记录编号
+ * @retval -1 不存在
+ */
+int64_t
+niLookup(const struct nameIndex *ni, const struct recordStore *rs, const char *name);
+
+/**
+ * @brief 把索引同步到磁盘
+ */
+int
+niSync(struct nameIndex *ni);
+
+/**
+ * @brief 关闭索引
+ */
+int
+niClose(struct nameIndex *ni);
+
+#endif
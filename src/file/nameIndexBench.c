@@ -0,0 +1,160 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include "recordStore.h"
+#include "nameIndex.h"
+
+/*
+ * 名字索引的建立与查找测试
+ *
+ * 先生成一个记录文件, 然后测试:
+ *   - 逐条 niAdd() 增量建立索引(包含扩容)
+ *   - 使用 1, 2, 4, ... 个线程并行建立索引
+ *   - 查找存在的名字和不存在的名字(后者大多被 Bloom 过滤器挡住)
+ *   - 与顺序扫描记录文件查找进行对比
+ *
+ * 编译: gcc -O2 -pthread nameIndexBench.c nameIndex.c recordStore.c -o nameIndexBench
+ * 用法: nameIndexBench [records [threads]]
+ */
+
+#define REC_PATH "/tmp/test.rec"
+#define IDX_PATH "/tmp/test.idx"
+#define LOOKUPS 1000000
+#define KEYS 65536              // 预先生成的查找键, 不把格式化的开销计入查找时间
+#define SCANS 10
+
+void errExit(char *msg)
+{
+    extern int errno;
+    perror(msg);
+    exit(errno);
+}
+
+static double
+nowSec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t
+xorshift(uint64_t *s)
+{
+    *s ^= *s << 13;
+    *s ^= *s >> 7;
+    *s ^= *s << 17;
+    return *s;
+}
+
+int
+main(int argc, char *argv[])
+{
+    struct recordStore rs;
+    struct nameIndex ni;
+    struct itemRecord rec;
+    uint64_t n, j, seed = 0x9e3779b97f4a7c15ULL, target;
+    static char hitKeys[KEYS][RS_NAMESIZE], missKeys[KEYS][RS_NAMESIZE];
+    static uint64_t hitRecno[KEYS];
+    char name[RS_NAMESIZE];
+    long found, wrong;
+    int64_t r;
+    int maxThreads, t;
+    double start;
+
+    n = (argc > 1) ? strtoull(argv[1], NULL, 10) : 10000000;
+    maxThreads = (argc > 2) ? atoi(argv[2]) : sysconf(_SC_NPROCESSORS_ONLN);
+    if (n == 0 || maxThreads < 1) {
+        fprintf(stderr, "Usage: %s [records [threads]]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    unlink(REC_PATH);
+    unlink(IDX_PATH);
+    if (rsOpen(&rs, REC_PATH, RS_CREATE) == -1)
+        errExit("rsOpen");
+    if (niOpen(&ni, IDX_PATH, &rs) == -1)
+        errExit("niOpen");
+
+    // 增量: 每追加一条记录就加入索引
+    memset(&rec, 0, sizeof(rec));
+    start = nowSec();
+    for (j = 0; j < n; j++) {
+        rec.count = (int16_t)(j & 0x7fff);
+        rec.total = (int64_t)j;
+        snprintf(rec.name, RS_NAMESIZE, "item-%llu", (unsigned long long)j);
+        if ((r = rsAppend(&rs, &rec)) == -1)
+            errExit("rsAppend");
+        if (niAdd(&ni, &rs, r) == -1)
+            errExit("niAdd");
+    }
+    printf("append + niAdd:       %8.1f ns/rec  (%llu slots)\n",
+            (nowSec() - start) * 1e9 / n, (unsigned long long)ni.hdr->nslots);
+    if (niClose(&ni) == -1)
+        errExit("niClose");
+
+    // 批量: 并行建立
+    for (t = 1; t <= maxThreads; t *= 2) {
+        start = nowSec();
+        if (niBuild(IDX_PATH, &rs, t) == -1)
+            errExit("niBuild");
+        printf("niBuild %2d thread(s): %8.1f ns/rec\n", t, (nowSec() - start) * 1e9 / n);
+    }
+
+    if (niOpen(&ni, IDX_PATH, &rs) == -1)
+        errExit("niOpen");
+
+    for (j = 0; j < KEYS; j++) {
+        hitRecno[j] = xorshift(&seed) % n;
+        snprintf(hitKeys[j], RS_NAMESIZE, "item-%llu", (unsigned long long)hitRecno[j]);
+        snprintf(missKeys[j], RS_NAMESIZE, "miss-%llu", (unsigned long long)xorshift(&seed));
+    }
+
+    // 存在的名字
+    found = wrong = 0;
+    start = nowSec();
+    for (j = 0; j < LOOKUPS; j++) {
+        r = niLookup(&ni, &rs, hitKeys[j % KEYS]);
+        if (r >= 0)
+            found++;
+        if (r != (int64_t)hitRecno[j % KEYS])
+            wrong++;
+    }
+    printf("lookup hit:           %8.1f ns/op   (%ld found, %ld wrong)\n",
+            (nowSec() - start) * 1e9 / LOOKUPS, found, wrong);
+
+    // 不存在的名字
+    found = 0;
+    start = nowSec();
+    for (j = 0; j < LOOKUPS; j++) {
+        if (niLookup(&ni, &rs, missKeys[j % KEYS]) >= 0)
+            found++;
+    }
+    printf("lookup miss:          %8.1f ns/op   (%ld found)\n",
+            (nowSec() - start) * 1e9 / LOOKUPS, found);
+
+    // 对比: 顺序扫描
+    found = 0;
+    start = nowSec();
+    for (j = 0; j < SCANS; j++) {
+        target = xorshift(&seed) % n;
+        snprintf(name, sizeof(name), "item-%llu", (unsigned long long)target);
+        for (r = 0; r < (int64_t)n; r++)
+            if (strncmp(rsGet(&rs, r)->name, name, RS_NAMESIZE) == 0) {
+                found++;
+                break;
+            }
+    }
+    printf("linear scan:          %8.1f ns/op   (%ld found)\n",
+            (nowSec() - start) * 1e9 / SCANS, found);
+
+    niClose(&ni);
+    rsClose(&rs);
+    unlink(REC_PATH);
+    unlink(IDX_PATH);
+    exit(EXIT_SUCCESS);
+}
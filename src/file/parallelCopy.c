@@ -0,0 +1,329 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "parallelCopy.h"
+#include "../lib/crc32c.h"
+
+#define PC_ALIGN (64 * 1024)
+
+/* 一个块的校验和 */
+struct pcChunk {
+    uint64_t off;
+    uint64_t len;
+    uint32_t crc;
+    int haveCrc;                // 用 copy_file_range() 复制的块没有校验和
+};
+
+struct pcJob {
+    int in, out;                // out 为 -1 时只计算校验和
+    uint64_t size;
+    int nthreads;
+    int computeCrc;
+    int copyRange;              // 仍然可以使用 copy_file_range()
+
+    pthread_mutex_t mtx;
+    uint64_t next;              // 下一个未领取的偏移量
+    struct pcChunk *chunks;
+    size_t nchunks;
+    int err;
+};
+
+/*
+ * 领取下一个块: 剩余字节数的 1/(4 * nthreads), 按 PC_ALIGN 对齐
+ */
+static int
+takeChunk(struct pcJob *job, struct pcChunk **chunk)
+{
+    uint64_t len;
+
+    pthread_mutex_lock(&job->mtx);
+    if (job->err != 0 || job->next >= job->size) {
+        pthread_mutex_unlock(&job->mtx);
+        return 0;
+    }
+    len = (job->size - job->next) / (4 * job->nthreads);
+    len = (len + PC_ALIGN - 1) & ~(uint64_t)(PC_ALIGN - 1);
+    if (len < PC_MIN_CHUNK)
+        len = PC_MIN_CHUNK;
+    if (len > PC_MAX_CHUNK)
+        len = PC_MAX_CHUNK;
+    if (len > job->size - job->next)
+        len = job->size - job->next;
+
+    *chunk = &job->chunks[job->nchunks++];
+    (*chunk)->off = job->next;
+    (*chunk)->len = len;
+    (*chunk)->crc = 0;
+    (*chunk)->haveCrc = 0;
+    job->next += len;
+    pthread_mutex_unlock(&job->mtx);
+    return 1;
+}
+
+static void
+setError(struct pcJob *job, int err)
+{
+    pthread_mutex_lock(&job->mtx);
+    if (job->err == 0)
+        job->err = err;
+    pthread_mutex_unlock(&job->mtx);
+}
+
+/* 用 copy_file_range() 复制一个块, 不支持时返回 1 */
+static int
+copyRange(struct pcJob *job, struct pcChunk *c)
+{
+    loff_t inOff = c->off, outOff = c->off;
+    uint64_t left = c->len;
+    ssize_t n;
+
+    while (left > 0) {
+        n = copy_file_range(job->in, &inOff, job->out, &outOff, left, 0);
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+            if (left == c->len && (errno == EXDEV || errno == ENOSYS ||
+                        errno == EOPNOTSUPP || errno == EINVAL)) {
+                __atomic_store_n(&job->copyRange, 0, __ATOMIC_RELAXED);
+                return 1;
+            }
+            return -1;
+        }
+        if (n == 0) {           // 源文件被截断
+            errno = EIO;
+            return -1;
+        }
+        left -= n;
+    }
+    return 0;
+}
+
+/* 用 pread()/pwrite() 复制一个块, 同时计算校验和 */
+static int
+copyBuffered(struct pcJob *job, struct pcChunk *c, char *buf)
+{
+    uint64_t off = c->off, end = c->off + c->len;
+    size_t want, done;
+    ssize_t n;
+
+    while (off < end) {
+        want = end - off < PC_IO_SIZE ? end - off : PC_IO_SIZE;
+        if ((n = pread(job->in, buf, want, off)) == -1) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        if (n == 0) {
+            errno = EIO;
+            return -1;
+        }
+        if (job->computeCrc)
+            c->crc = crc32c(c->crc, buf, n);
+
+        for (done = 0; job->out != -1 && done < (size_t)n; ) {
+            ssize_t w = pwrite(job->out, buf + done, n - done, off + done);
+            if (w == -1) {
+                if (errno == EINTR)
+                    continue;
+                return -1;
+            }
+            done += w;
+        }
+        off += n;
+    }
+    c->haveCrc = job->computeCrc;
+    return 0;
+}
+
+static void *
+worker(void *arg)
+{
+    struct pcJob *job = arg;
+    struct pcChunk *c;
+    char *buf;
+    int ret;
+
+    if ((errno = posix_memalign((void **)&buf, 4096, PC_IO_SIZE)) != 0) {
+        setError(job, errno);
+        return NULL;
+    }
+
+    while (takeChunk(job, &c)) {
+        ret = 1;
+        if (job->out != -1 && __atomic_load_n(&job->copyRange, __ATOMIC_RELAXED))
+            ret = copyRange(job, c);
+        if (ret == 1)
+            ret = copyBuffered(job, c, buf);
+        if (ret == -1)
+            setError(job, errno);
+    }
+
+    free(buf);
+    return NULL;
+}
+
+static int
+chunkCmp(const void *a, const void *b)
+{
+    const struct pcChunk *x = a, *y = b;
+
+    return x->off < y->off ? -1 : x->off > y->off;
+}
+
+/*
+ * 启动线程处理整个文件. 成功时, 如果所有块都计算了校验和, 通过 crc 返回整个文件的校验和.
+ */
+static int
+runJob(struct pcJob *job, uint32_t *crc, int *haveCrc, uint64_t *nchunks)
+{
+    pthread_t *tids;
+    size_t j;
+    int started = 0, k;
+
+    if (job->nthreads < 1)
+        job->nthreads = 1;
+    pthread_mutex_init(&job->mtx, NULL);
+    job->next = 0;
+    job->nchunks = 0;
+    job->err = 0;
+
+    // 每个块至少 PC_MIN_CHUNK 字节, 块的个数不会超过这个值
+    job->chunks = calloc(job->size / PC_MIN_CHUNK + 1, sizeof(struct pcChunk));
+    tids = calloc(job->nthreads, sizeof(pthread_t));
+    if (job->chunks == NULL || tids == NULL) {
+        job->err = ENOMEM;
+        goto out;
+    }
+
+    for (k = 0; k < job->nthreads; k++) {
+        if ((errno = pthread_create(&tids[k], NULL, worker, job)) != 0) {
+            setError(job, errno);
+            break;
+        }
+        started++;
+    }
+    for (k = 0; k < started; k++)
+        pthread_join(tids[k], NULL);
+
+    // 其他线程关闭 copy_file_range() 之前, 已经有块用它复制过了, 这些块没有校验和
+    for (j = 0; j < job->nchunks && job->chunks[j].haveCrc; j++)
+        ;
+    if (job->err == 0 && job->computeCrc && j == job->nchunks) {
+        qsort(job->chunks, job->nchunks, sizeof(struct pcChunk), chunkCmp);
+        for (*crc = 0, j = 0; j < job->nchunks; j++)
+            *crc = crc32cCombine(*crc, job->chunks[j].crc, job->chunks[j].len);
+        *haveCrc = 1;
+    }
+    if (nchunks != NULL)
+        *nchunks = job->nchunks;
+
+out:
+    free(job->chunks);
+    free(tids);
+    pthread_mutex_destroy(&job->mtx);
+    if (job->err != 0) {
+        errno = job->err;
+        return -1;
+    }
+    return 0;
+}
+
+int
+pcChecksum(const char *path, int nthreads, uint32_t *crc)
+{
+    struct pcJob job;
+    struct stat sb;
+    int haveCrc = 0, ret;
+
+    memset(&job, 0, sizeof(job));
+    if ((job.in = open(path, O_RDONLY | O_CLOEXEC)) == -1)
+        return -1;
+    if (fstat(job.in, &sb) == -1) {
+        close(job.in);
+        return -1;
+    }
+    posix_fadvise(job.in, 0, 0, POSIX_FADV_SEQUENTIAL);
+    job.out = -1;
+    job.size = sb.st_size;
+    job.nthreads = nthreads;
+    job.computeCrc = 1;
+
+    ret = runJob(&job, crc, &haveCrc, NULL);
+    close(job.in);
+    return ret;
+}
+
+int
+pcCopy(const char *src, const char *dst, const struct pcOptions *opt, struct pcResult *res)
+{
+    struct pcResult r;
+    struct pcJob job;
+    struct stat sb;
+    uint32_t dstCrc;
+    int savedErrno;
+
+    memset(&r, 0, sizeof(r));
+    memset(&job, 0, sizeof(job));
+    job.out = -1;
+    if ((job.in = open(src, O_RDONLY | O_CLOEXEC)) == -1)
+        return -1;
+    if (fstat(job.in, &sb) == -1)
+        goto fail;
+    if ((job.out = open(dst, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                    sb.st_mode & 0777)) == -1)
+        goto fail;
+
+    // 预分配目标文件
+    if (sb.st_size > 0 && fallocate(job.out, 0, 0, sb.st_size) == -1 &&
+            (errno != EOPNOTSUPP || ftruncate(job.out, sb.st_size) == -1))
+        goto fail;
+    posix_fadvise(job.in, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    job.size = sb.st_size;
+    job.nthreads = opt->nthreads;
+    job.copyRange = opt->copyRange;
+    job.computeCrc = 1;
+    if (runJob(&job, &r.crc, &r.haveCrc, &r.chunks) == -1)
+        goto fail;
+    r.bytes = job.size;
+    r.usedCopyRange = job.copyRange;
+
+    if (opt->sync && fsync(job.out) == -1)
+        goto fail;
+    close(job.in);
+    if (close(job.out) == -1)
+        return -1;
+
+    if (opt->verify) {
+        // copy_file_range() 没有经过用户空间, 需要另外读一遍源文件
+        if (!r.haveCrc) {
+            if (pcChecksum(src, opt->nthreads, &r.crc) == -1)
+                return -1;
+            r.haveCrc = 1;
+        }
+        if (pcChecksum(dst, opt->nthreads, &dstCrc) == -1)
+            return -1;
+        if (dstCrc != r.crc) {
+            errno = EIO;
+            return -1;
+        }
+    }
+
+    if (res != NULL)
+        *res = r;
+    return 0;
+
+fail:
+    savedErrno = errno;
+    close(job.in);
+    if (job.out != -1)
+        close(job.out);
+    errno = savedErrno;
+    return -1;
+}
@@ -0,0 +1,76 @@
+/**
+ * @file parallelCopy.h
+ * @author Lock
+ * @date 16 Oct 2026
+ * @brief 基于 pread()/pwrite() 的并行文件复制与校验
+ *
+ * pread() 和 pwrite() 显式指定偏移量, 不修改文件偏移量, 多个线程可以共享同一个文件描述符,
+ * 各自读写文件的不同区域. 这里把文件切分为块, 由线程池中的线程领取:
+ *   - 块大小是自适应的(guided scheduling): 每次领取剩余字节数的 1/(4 * 线程数),
+ *   限制在 [@ref PC_MIN_CHUNK, @ref PC_MAX_CHUNK] 之间.
+ *   开始时块大, 领取次数少; 接近结尾时块小, 各线程几乎同时完成.
+ *   - 目标文件先用 fallocate() 预分配到最终大小, 写入时不再修改文件大小和分配磁盘块.
+ *   - 内核支持时优先使用 copy_file_range(), 数据不经过用户空间, 在支持 reflink
+ *   的文件系统上甚至不复制数据. 第一次返回 `EXDEV`, `ENOSYS`, `EOPNOTSUPP` 或 `EINVAL`
+ *   时, 所有线程改用 pread()/pwrite().
+ *
+ * 使用 pread()/pwrite() 时, 每个块在复制的同时计算 CRC32C. 所有块的校验和按偏移量排序后
+ * 用 crc32cCombine() 合并为整个文件的校验和, 校验时只需再读一遍目标文件.
+ *
+ * @example parallelCopyBench.c
+ */
+#ifndef PARALLEL_COPY_H
+#define PARALLEL_COPY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define PC_MIN_CHUNK (256 * 1024)
+#define PC_MAX_CHUNK (64 * 1024 * 1024)
+#define PC_IO_SIZE (1024 * 1024)        //!< 每次 pread()/pwrite() 的字节数
+
+/**
+ * @brief 复制选项
+ */
+struct pcOptions {
+    int nthreads;               //!< 线程个数
+    int copyRange;              //!< 是否尝试 copy_file_range()
+    int verify;                 //!< 复制完成后是否比较两个文件的校验和
+    int sync;                   //!< 完成前是否 fsync() 目标文件
+};
+
+/**
+ * @brief 复制结果
+ */
+struct pcResult {
+    uint64_t bytes;             //!< 复制的字节数
+    uint64_t chunks;            //!< 块的个数
+    int usedCopyRange;          //!< 是否全部通过 copy_file_range() 完成
+    uint32_t crc;               //!< 源文件的 CRC32C, 只有计算过时才有效
+    int haveCrc;
+};
+
+/**
+ * @brief 并行复制文件
+ *
+ * @param src 源文件
+ * @param dst 目标文件, 已存在时被截断
+ * @param opt 选项
+ * @param res 用于返回复制结果, 可以为 NULL
+ *
+ * @retval 0 成功
+ * @retval -1 失败, 校验不一致时 errno 为 `EIO`
+ */
+int
+pcCopy(const char *src, const char *dst, const struct pcOptions *opt, struct pcResult *res);
+
+/**
+ * @brief 并行计算文件的 CRC32C
+ *
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+int
+pcChecksum(const char *path, int nthreads, uint32_t *crc);
+
+#endif
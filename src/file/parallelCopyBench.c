@@ -0,0 +1,180 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include "parallelCopy.h"
+
+/*
+ * 并行复制测试
+ *
+ * 生成一个大文件, 分别用单线程 read()/write() 循环, 多线程 pread()/pwrite()
+ * 以及 copy_file_range() 复制, 最后校验一次.
+ * 使用 -c 时, 每次复制前把源文件逐出页缓存(需要文件已经写回磁盘), 测试冷读.
+ *
+ * 编译: gcc -O2 -pthread parallelCopyBench.c parallelCopy.c ../lib/crc32c.c -o parallelCopyBench
+ * 用法: parallelCopyBench [-c] [-s sizeMiB] [-t maxThreads]
+ */
+
+#define SRC_PATH "/tmp/pc.src"
+#define DST_PATH "/tmp/pc.dst"
+#define BUF_SIZE (1024 * 1024)
+
+static int cold;
+
+void errExit(char *msg)
+{
+    extern int errno;
+    perror(msg);
+    exit(errno);
+}
+
+static double
+nowSec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+dropCache(const char *path)
+{
+    int fd;
+
+    if (!cold)
+        return;
+    if ((fd = open(path, O_RDONLY)) == -1)
+        errExit("open");
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
+
+/* 基准: 单线程 read()/write() 循环 */
+static void
+simpleCopy(void)
+{
+    static char buf[BUF_SIZE];
+    ssize_t n;
+    int in, out;
+
+    if ((in = open(SRC_PATH, O_RDONLY)) == -1)
+        errExit("open");
+    if ((out = open(DST_PATH, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR)) == -1)
+        errExit("open");
+    while ((n = read(in, buf, BUF_SIZE)) > 0)
+        if (write(out, buf, n) != n)
+            errExit("write");
+    if (n == -1)
+        errExit("read");
+    close(in);
+    close(out);
+}
+
+static void
+report(const char *name, double elapsed, uint64_t size, const struct pcResult *r)
+{
+    printf("%-26s %8.2f GB/s", name, size / elapsed / 1e9);
+    if (r != NULL)
+        printf("  (%llu chunks%s)", (unsigned long long)r->chunks,
+                r->usedCopyRange ? ", copy_file_range" : "");
+    printf("\n");
+    fflush(stdout);
+}
+
+int
+main(int argc, char *argv[])
+{
+    struct pcOptions opt;
+    struct pcResult r;
+    char *buf, name[64];
+    uint64_t size, j, seed = 0x9e3779b97f4a7c15ULL;
+    uint32_t crc;
+    int maxThreads = 8, t, fd, ch;
+    double start;
+
+    size = 1024;
+    while ((ch = getopt(argc, argv, "cs:t:")) != -1) {
+        switch (ch) {
+        case 'c': cold = 1; break;
+        case 's': size = strtoull(optarg, NULL, 10); break;
+        case 't': maxThreads = atoi(optarg); break;
+        default:
+            fprintf(stderr, "Usage: %s [-c] [-s sizeMiB] [-t maxThreads]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (size == 0 || maxThreads < 1) {
+        fprintf(stderr, "bad arguments\n");
+        exit(EXIT_FAILURE);
+    }
+    size *= 1024 * 1024;
+
+    if ((buf = malloc(BUF_SIZE)) == NULL)
+        errExit("malloc");
+    if ((fd = open(SRC_PATH, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR)) == -1)
+        errExit("open");
+    for (j = 0; j < size; j += BUF_SIZE) {
+        uint64_t *p = (uint64_t *)buf;
+        size_t k;
+
+        for (k = 0; k < BUF_SIZE / 8; k++) {
+            seed ^= seed << 13;
+            seed ^= seed >> 7;
+            seed ^= seed << 17;
+            p[k] = seed;
+        }
+        if (write(fd, buf, BUF_SIZE) != BUF_SIZE)
+            errExit("write");
+    }
+    close(fd);
+    free(buf);
+
+    dropCache(SRC_PATH);
+    start = nowSec();
+    simpleCopy();
+    report("read/write loop", nowSec() - start, size, NULL);
+
+    memset(&opt, 0, sizeof(opt));
+    for (t = 1; t <= maxThreads; t *= 2) {
+        opt.nthreads = t;
+        opt.copyRange = 0;
+        dropCache(SRC_PATH);
+        start = nowSec();
+        if (pcCopy(SRC_PATH, DST_PATH, &opt, &r) == -1)
+            errExit("pcCopy");
+        snprintf(name, sizeof(name), "pread/pwrite %d thread(s)", t);
+        report(name, nowSec() - start, size, &r);
+    }
+
+    opt.nthreads = maxThreads;
+    opt.copyRange = 1;
+    dropCache(SRC_PATH);
+    start = nowSec();
+    if (pcCopy(SRC_PATH, DST_PATH, &opt, &r) == -1)
+        errExit("pcCopy");
+    snprintf(name, sizeof(name), "copy_file_range %d thr", maxThreads);
+    report(name, nowSec() - start, size, &r);
+
+    start = nowSec();
+    if (pcChecksum(SRC_PATH, maxThreads, &crc) == -1)
+        errExit("pcChecksum");
+    report("checksum", nowSec() - start, size, NULL);
+
+    opt.copyRange = 0;
+    opt.verify = 1;
+    start = nowSec();
+    if (pcCopy(SRC_PATH, DST_PATH, &opt, &r) == -1)
+        errExit("pcCopy verify");
+    report("copy + verify", nowSec() - start, size, &r);
+    printf("crc32c %08x / %08x\n", crc, r.crc);
+
+    unlink(SRC_PATH);
+    unlink(DST_PATH);
+    exit(EXIT_SUCCESS);
+}
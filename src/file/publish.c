@@ -0,0 +1,308 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "publish.h"
+
+/* 把 path 拆分为目录和文件名 */
+static int
+splitPath(struct pubFile *pf, const char *path)
+{
+    const char *slash = strrchr(path, '/');
+    const char *name = (slash == NULL) ? path : slash + 1;
+    size_t dirLen;
+
+    if (*name == '\0' || strlen(name) + 8 > NAME_MAX) {
+        errno = (*name == '\0') ? EINVAL : ENAMETOOLONG;
+        return -1;
+    }
+    if (slash == NULL) {
+        strcpy(pf->dir, ".");
+    } else {
+        dirLen = (slash == path) ? 1 : (size_t)(slash - path);
+        if (dirLen >= sizeof(pf->dir)) {
+            errno = ENAMETOOLONG;
+            return -1;
+        }
+        memcpy(pf->dir, path, dirLen);
+        pf->dir[dirLen] = '\0';
+    }
+    strcpy(pf->name, name);
+    return 0;
+}
+
+static int
+createNamed(struct pubFile *pf)
+{
+    char template[PATH_MAX];
+    char *base;
+
+    if (snprintf(template, sizeof(template), "%s/.%s.XXXXXX", pf->dir, pf->name)
+            >= (int)sizeof(template)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    if ((pf->fd = mkstemp(template)) == -1)
+        return -1;
+    base = strrchr(template, '/') + 1;
+    strcpy(pf->tmpName, base);
+    return 0;
+}
+
+int
+pubCreate(struct pubFile *pf, const char *path, mode_t mode, int flags, size_t bufSize)
+{
+    int savedErrno;
+
+    memset(pf, 0, sizeof(struct pubFile));
+    pf->fd = pf->dirFd = -1;
+    pf->flags = flags;
+    if (splitPath(pf, path) == -1)
+        return -1;
+    if ((pf->dirFd = open(pf->dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) == -1)
+        return -1;
+
+    if (!(flags & PUB_NAMED_TMP)) {
+        pf->fd = openat(pf->dirFd, ".", O_TMPFILE | O_WRONLY | O_CLOEXEC, mode);
+        // 内核或文件系统不支持 O_TMPFILE 时, 可能返回这几种错误
+        if (pf->fd == -1 && errno != EOPNOTSUPP && errno != EISDIR && errno != EINVAL)
+            goto fail;
+        pf->anon = (pf->fd != -1);
+    }
+    if (pf->fd == -1 && createNamed(pf) == -1)
+        goto fail;
+
+    // mkstemp() 创建的文件权限为 0600, O_TMPFILE 受 umask 影响, 统一设置为 mode
+    if (fchmod(pf->fd, mode) == -1)
+        goto fail;
+
+    pf->cap = (bufSize == 0) ? PUB_DEFAULT_BUF : bufSize;
+    if ((pf->buf = malloc(pf->cap)) == NULL)
+        goto fail;
+    return 0;
+
+fail:
+    savedErrno = errno;
+    pubAbort(pf);
+    errno = savedErrno;
+    return -1;
+}
+
+static int
+writeAll(struct pubFile *pf, const char *p, size_t n)
+{
+    ssize_t w;
+
+    while (n > 0) {
+        if ((w = write(pf->fd, p, n)) == -1) {
+            if (errno == EINTR)
+                continue;
+            pf->err = errno;
+            return -1;
+        }
+        p += w;
+        n -= w;
+        pf->size += w;
+    }
+
+    // 提前发起回写, 提交时的 fdatasync() 不必等待整个文件
+    if ((pf->flags & PUB_SYNC_MASK) != PUB_SYNC_NONE &&
+            pf->size - pf->writeback >= PUB_WRITEBACK_CHUNK) {
+        sync_file_range(pf->fd, pf->writeback, pf->size - pf->writeback,
+                SYNC_FILE_RANGE_WRITE);
+        pf->writeback = pf->size;
+    }
+    return 0;
+}
+
+int
+pubWrite(struct pubFile *pf, const void *data, size_t len)
+{
+    size_t n;
+
+    if (pf->err != 0) {
+        errno = pf->err;
+        return -1;
+    }
+
+    if (pf->len + len <= pf->cap) {
+        memcpy(pf->buf + pf->len, data, len);
+        pf->len += len;
+        return 0;
+    }
+
+    // 先填满缓冲区写出, 剩下的大块数据直接写, 小块数据放入缓冲区
+    n = pf->cap - pf->len;
+    memcpy(pf->buf + pf->len, data, n);
+    data = (const char *)data + n;
+    len -= n;
+    pf->len = 0;
+    if (writeAll(pf, pf->buf, pf->cap) == -1)
+        return -1;
+    if (len >= pf->cap)
+        return writeAll(pf, data, len);
+    memcpy(pf->buf, data, len);
+    pf->len = len;
+    return 0;
+}
+
+/*
+ * 匿名文件已经存在目标时, 先链接到一个随机的隐藏名, 再覆盖目标
+ */
+static int
+linkAnon(struct pubFile *pf)
+{
+    char procPath[64], tmp[NAME_MAX + 16];
+    struct timespec ts;
+    int tries;
+
+    snprintf(procPath, sizeof(procPath), "/proc/self/fd/%d", pf->fd);
+    if (linkat(AT_FDCWD, procPath, pf->dirFd, pf->name, AT_SYMLINK_FOLLOW) == 0)
+        return 0;
+    if (errno != EEXIST)
+        return -1;
+
+    for (tries = 0; tries < 100; tries++) {
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        snprintf(tmp, sizeof(tmp), ".%s.%06lx", pf->name,
+                (unsigned long)((ts.tv_nsec ^ getpid() * 2654435761u) + tries) & 0xffffff);
+        if (linkat(AT_FDCWD, procPath, pf->dirFd, tmp, AT_SYMLINK_FOLLOW) == 0)
+            break;
+        if (errno != EEXIST)
+            return -1;
+    }
+    if (tries == 100)
+        return -1;
+    if (renameat(pf->dirFd, tmp, pf->dirFd, pf->name) == -1) {
+        unlinkat(pf->dirFd, tmp, 0);
+        return -1;
+    }
+    return 0;
+}
+
+/* 写出缓冲区, 需要刷新时对剩下的部分发起回写 */
+static int
+flushData(struct pubFile *pf)
+{
+    if (pf->err != 0) {
+        errno = pf->err;
+        return -1;
+    }
+    if (pf->len > 0 && writeAll(pf, pf->buf, pf->len) == -1)
+        return -1;
+    pf->len = 0;
+
+    if ((pf->flags & PUB_SYNC_MASK) != PUB_SYNC_NONE && pf->size > pf->writeback) {
+        sync_file_range(pf->fd, pf->writeback, pf->size - pf->writeback,
+                SYNC_FILE_RANGE_WRITE);
+        pf->writeback = pf->size;
+    }
+    return 0;
+}
+
+/* 按持久化级别刷新文件, 然后放到目标路径上 */
+static int
+publish(struct pubFile *pf)
+{
+    if ((pf->flags & PUB_SYNC_MASK) != PUB_SYNC_NONE && fdatasync(pf->fd) == -1)
+        return -1;
+
+    if (pf->anon)
+        return linkAnon(pf);
+    if (renameat(pf->dirFd, pf->tmpName, pf->dirFd, pf->name) == -1)
+        return -1;
+    pf->tmpName[0] = '\0';
+    return 0;
+}
+
+/* 释放资源, 删除没有发布的临时文件 */
+static void
+release(struct pubFile *pf)
+{
+    if (pf->fd != -1)
+        close(pf->fd);
+    if (pf->tmpName[0] != '\0')
+        unlinkat(pf->dirFd, pf->tmpName, 0);
+    if (pf->dirFd != -1)
+        close(pf->dirFd);
+    free(pf->buf);
+    pf->fd = pf->dirFd = -1;
+    pf->buf = NULL;
+    pf->tmpName[0] = '\0';
+}
+
+int
+pubCommit(struct pubFile *pf)
+{
+    int ret, savedErrno;
+
+    ret = flushData(pf);
+    if (ret == 0)
+        ret = publish(pf);
+    if (ret == 0 && (pf->flags & PUB_SYNC_MASK) == PUB_SYNC_FULL)
+        ret = fsync(pf->dirFd);
+    savedErrno = errno;
+    release(pf);
+    errno = savedErrno;
+    return ret;
+}
+
+int
+pubCommitAll(struct pubFile **files, int n)
+{
+    int j, k, ret = 0, savedErrno = 0;
+    char *ok;
+
+    if ((ok = calloc(n > 0 ? n : 1, 1)) == NULL)
+        return -1;
+
+    // 先让所有文件同时开始回写, 之后的 fdatasync() 大多只需等待已经在进行的 I/O
+    for (j = 0; j < n; j++) {
+        if (flushData(files[j]) == 0) {
+            ok[j] = 1;
+        } else {
+            ret = -1;
+            savedErrno = errno;
+        }
+    }
+    for (j = 0; j < n; j++) {
+        if (!ok[j])
+            continue;
+        if (publish(files[j]) == -1) {
+            ok[j] = 0;
+            ret = -1;
+            savedErrno = errno;
+        }
+    }
+
+    // 每个目录只 fsync() 一次
+    for (j = 0; j < n; j++) {
+        if (!ok[j] || (files[j]->flags & PUB_SYNC_MASK) != PUB_SYNC_FULL)
+            continue;
+        for (k = 0; k < j; k++)
+            if (ok[k] && (files[k]->flags & PUB_SYNC_MASK) == PUB_SYNC_FULL &&
+                    strcmp(files[k]->dir, files[j]->dir) == 0)
+                break;
+        if (k == j && fsync(files[j]->dirFd) == -1) {
+            ret = -1;
+            savedErrno = errno;
+        }
+    }
+
+    for (j = 0; j < n; j++)
+        release(files[j]);
+    free(ok);
+    errno = savedErrno;
+    return ret;
+}
+
+void
+pubAbort(struct pubFile *pf)
+{
+    release(pf);
+}
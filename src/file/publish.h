@@ -0,0 +1,123 @@
+/**
+ * @file publish.h
+ * @author Lock
+ * @date 16 Oct 2026
+ * @brief 原子地发布文件: 读者要么看不到文件, 要么看到完整的文件
+ *
+ * 直接 open(O_TRUNC) 写入时, 读者可能看到写了一半的文件, 崩溃后还可能留下不完整的文件.
+ * 这里先创建一个没有名字的文件, 写完并按需要刷新到磁盘后, 再把它放到目标路径上:
+ *   - 优先使用 `O_TMPFILE` 在目标目录中创建匿名文件, 写入期间目录中没有任何文件名,
+ *   崩溃后也不会留下临时文件. 完成后用 linkat() 通过 `/proc/self/fd/N` 链接到目标路径.
+ *   目标已经存在时先链接到一个隐藏的临时名, 再 rename() 覆盖目标.
+ *   - 文件系统不支持 `O_TMPFILE` 时, 使用 mkstemp() 在同一目录创建 `.<文件名>.XXXXXX`,
+ *   完成后 rename() 为目标路径. rename() 在同一文件系统内是原子的.
+ *
+ * 写入经过一个较大的缓冲区, 大块数据直接 write(). 需要刷新时, 每写出
+ * @ref PUB_WRITEBACK_CHUNK 字节就用 sync_file_range() 发起异步回写,
+ * 提交时的 fdatasync() 只需等待剩下的部分.
+ *
+ * # 持久化级别
+ *   - @ref PUB_SYNC_NONE: 不刷新. 读者不会看到不完整的文件, 但崩溃后文件内容可能为空.
+ *   - @ref PUB_SYNC_DATA: 链接前 fdatasync(), 崩溃后目标路径要么是旧文件, 要么是完整的新文件,
+ *   但新的目录项本身可能丢失.
+ *   - @ref PUB_SYNC_FULL: 在 @ref PUB_SYNC_DATA 的基础上, 链接后 fsync() 目录,
+ *   pubCommit() 返回后发布的文件在崩溃后一定存在.
+ *
+ * # 批量发布
+ * 一次发布很多文件时, pubCommitAll() 先让所有文件同时开始回写, 再逐个刷新和链接,
+ * 最后对每个涉及的目录只 fsync() 一次, 而不是每个文件一次.
+ *
+ * @example publishBench.c
+ */
+#ifndef PUBLISH_H
+#define PUBLISH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <limits.h>
+#include <sys/types.h>
+
+#define PUB_SYNC_NONE 0             //!< 不刷新
+#define PUB_SYNC_DATA 1             //!< 链接前 fdatasync() 文件
+#define PUB_SYNC_FULL 2             //!< 另外在链接后 fsync() 目录
+#define PUB_SYNC_MASK 3
+#define PUB_NAMED_TMP 4             //!< 不使用 `O_TMPFILE`, 用于对比测试
+
+#define PUB_DEFAULT_BUF (1024 * 1024)
+#define PUB_WRITEBACK_CHUNK (8 * 1024 * 1024)
+
+/**
+ * @brief 正在写入的文件
+ */
+struct pubFile {
+    int fd;
+    int dirFd;                  //!< 目标所在的目录
+    int anon;                   //!< 是否为 `O_TMPFILE` 创建的匿名文件
+    int flags;
+    char dir[PATH_MAX];         //!< 目标所在目录的路径
+    char name[NAME_MAX + 1];    //!< 目标文件名
+    char tmpName[NAME_MAX + 1]; //!< mkstemp() 创建的临时文件名
+    char *buf;
+    size_t cap;
+    size_t len;                 //!< 缓冲区中的字节数
+    uint64_t size;              //!< 已经写出的字节数
+    uint64_t writeback;         //!< 已经发起回写的字节数
+    int err;                    //!< 写入失败时的 errno, 之后的写入和提交都会失败
+};
+
+/**
+ * @brief 创建一个将要发布到 @p path 的文件
+ *
+ * @param pf 文件
+ * @param path 目标路径, 所在的目录必须已经存在
+ * @param mode 文件权限, 不受 umask 影响
+ * @param flags 持久化级别, 可以或上 @ref PUB_NAMED_TMP
+ * @param bufSize 缓冲区大小, 为 0 时使用 @ref PUB_DEFAULT_BUF
+ *
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+int
+pubCreate(struct pubFile *pf, const char *path, mode_t mode, int flags, size_t bufSize);
+
+/**
+ * @brief 写入数据
+ *
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+int
+pubWrite(struct pubFile *pf, const void *data, size_t len);
+
+/**
+ * @brief 刷新并发布文件, 然后释放资源
+ *
+ * 无论成功与否, 返回后 @p pf 都不能再使用. 失败时不会修改目标路径.
+ *
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+int
+pubCommit(struct pubFile *pf);
+
+/**
+ * @brief 批量发布, 每个目录只 fsync() 一次
+ *
+ * 所有文件按顺序发布, 某个文件失败后继续发布其余的文件.
+ *
+ * @param files 文件
+ * @param n 文件个数
+ *
+ * @retval 0 全部成功
+ * @retval -1 有文件发布失败
+ */
+int
+pubCommitAll(struct pubFile **files, int n);
+
+/**
+ * @brief 放弃写入的数据, 删除临时文件并释放资源
+ */
+void
+pubAbort(struct pubFile *pf);
+
+#endif
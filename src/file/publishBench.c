@@ -0,0 +1,200 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "publish.h"
+
+/*
+ * 原子发布测试
+ *
+ * 在目录中发布 n 个大小为 size 的文件, 对比:
+ *   - open(O_TRUNC) + write() 直接写入(不是原子的, 作为基准)
+ *   - `O_TMPFILE` 与 mkstemp() 临时文件
+ *   - 各个持久化级别
+ *   - PUB_SYNC_FULL 下逐个 pubCommit() 与一次 pubCommitAll()
+ * 每轮结束后检查目录中只有目标文件, 且大小正确.
+ *
+ * 编译: gcc -O2 publishBench.c publish.c -o publishBench
+ * 用法: publishBench [-d dir] [-n files] [-s sizeKiB]
+ */
+
+#define MAX_FILES 4096
+
+void errExit(char *msg)
+{
+    extern int errno;
+    perror(msg);
+    exit(errno);
+}
+
+static double
+nowSec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static const char *dir = "/var/tmp";
+static int nfiles = 64;
+static size_t fileSize = 1024 * 1024;
+static char *data;
+
+static void
+targetPath(char *path, int j)
+{
+    snprintf(path, PATH_MAX, "%s/pub-%04d.dat", dir, j);
+}
+
+/* 检查目标文件的大小, 并确认没有遗留的临时文件, 然后删除目标文件 */
+static void
+verify(const char *name)
+{
+    char path[PATH_MAX];
+    struct dirent *de;
+    struct stat sb;
+    DIR *dp;
+    int j;
+
+    for (j = 0; j < nfiles; j++) {
+        targetPath(path, j);
+        if (stat(path, &sb) == -1 || (size_t)sb.st_size != fileSize) {
+            fprintf(stderr, "%s: %s is missing or truncated\n", name, path);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if ((dp = opendir(dir)) == NULL)
+        errExit("opendir");
+    while ((de = readdir(dp)) != NULL)
+        if (strncmp(de->d_name, ".pub-", 5) == 0) {
+            fprintf(stderr, "%s: temporary file %s left behind\n", name, de->d_name);
+            exit(EXIT_FAILURE);
+        }
+    closedir(dp);
+    for (j = 0; j < nfiles; j++) {
+        targetPath(path, j);
+        unlink(path);
+    }
+}
+
+static void
+report(const char *name, double elapsed)
+{
+    printf("%-28s %8.3f ms/file %8.0f MB/s\n", name, elapsed * 1e3 / nfiles,
+            (double)nfiles * fileSize / elapsed / 1e6);
+    verify(name);
+}
+
+static void
+writeChunks(struct pubFile *pf)
+{
+    size_t off, n;
+
+    // 64 KiB 为单位写入, 经过 pubFile 的缓冲区
+    for (off = 0; off < fileSize; off += n) {
+        n = (fileSize - off < 65536) ? fileSize - off : 65536;
+        if (pubWrite(pf, data + off, n) == -1)
+            errExit("pubWrite");
+    }
+}
+
+static void
+benchPlain(int doSync)
+{
+    char path[PATH_MAX];
+    double start;
+    int j, fd;
+
+    start = nowSec();
+    for (j = 0; j < nfiles; j++) {
+        targetPath(path, j);
+        if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) == -1)
+            errExit("open");
+        if (write(fd, data, fileSize) != (ssize_t)fileSize)
+            errExit("write");
+        if (doSync && fdatasync(fd) == -1)
+            errExit("fdatasync");
+        close(fd);
+    }
+    report(doSync ? "open+write+fdatasync" : "open+write", nowSec() - start);
+}
+
+static void
+benchPublish(const char *name, int flags, int batch)
+{
+    static struct pubFile files[MAX_FILES];
+    struct pubFile *ptrs[MAX_FILES];
+    char path[PATH_MAX];
+    double start;
+    int j;
+
+    start = nowSec();
+    for (j = 0; j < nfiles; j++) {
+        targetPath(path, j);
+        if (pubCreate(&files[j], path, 0644, flags, 0) == -1)
+            errExit("pubCreate");
+        writeChunks(&files[j]);
+        ptrs[j] = &files[j];
+        if (!batch && pubCommit(&files[j]) == -1)
+            errExit("pubCommit");
+    }
+    if (batch && pubCommitAll(ptrs, nfiles) == -1)
+        errExit("pubCommitAll");
+    report(name, nowSec() - start);
+}
+
+int
+main(int argc, char *argv[])
+{
+    struct pubFile pf;
+    char path[PATH_MAX];
+    size_t j;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:n:s:")) != -1) {
+        switch (opt) {
+        case 'd': dir = optarg; break;
+        case 'n': nfiles = atoi(optarg); break;
+        case 's': fileSize = strtoull(optarg, NULL, 10) * 1024; break;
+        default:
+            fprintf(stderr, "Usage: %s [-d dir] [-n files] [-s sizeKiB]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (nfiles < 1 || nfiles > MAX_FILES || fileSize == 0) {
+        fprintf(stderr, "files must be in [1, %d], size must be > 0\n", MAX_FILES);
+        exit(EXIT_FAILURE);
+    }
+    if ((data = malloc(fileSize)) == NULL)
+        errExit("malloc");
+    for (j = 0; j < fileSize; j++)
+        data[j] = j * 31;
+
+    targetPath(path, 0);
+    if (pubCreate(&pf, path, 0644, 0, 0) == -1)
+        errExit("pubCreate");
+    printf("%s: %s, %d files x %zu KiB\n", dir,
+            pf.anon ? "O_TMPFILE supported" : "O_TMPFILE not supported, using mkstemp()",
+            nfiles, fileSize / 1024);
+    pubAbort(&pf);
+
+    benchPlain(0);
+    benchPlain(1);
+    benchPublish("tmpfile nosync", PUB_SYNC_NONE, 0);
+    benchPublish("mkstemp nosync", PUB_SYNC_NONE | PUB_NAMED_TMP, 0);
+    benchPublish("tmpfile datasync", PUB_SYNC_DATA, 0);
+    benchPublish("tmpfile full", PUB_SYNC_FULL, 0);
+    benchPublish("mkstemp full", PUB_SYNC_FULL | PUB_NAMED_TMP, 0);
+    benchPublish("tmpfile full, batch", PUB_SYNC_FULL, 1);
+    benchPublish("mkstemp full, batch", PUB_SYNC_FULL | PUB_NAMED_TMP, 1);
+
+    free(data);
+    exit(EXIT_SUCCESS);
+}
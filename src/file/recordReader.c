@@ -0,0 +1,100 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "recordReader.h"
+
+static ssize_t
+readAt(struct recordReader *rr, void *buf, size_t len, uint64_t off)
+{
+    if (rr->cache != NULL)
+        return bcPread(rr->cache, buf, len, off);
+    if (rr->hint != NULL)
+        return ihPread(rr->hint, buf, len, off);
+    return pread(rr->fd, buf, len, off);
+}
+
+int
+rrOpen(struct recordReader *rr, const char *path, size_t cacheBytes, int flags)
+{
+    struct rsHeader hdr;
+    int savedErrno;
+
+    memset(rr, 0, sizeof(struct recordReader));
+    rr->fd = -1;
+    if (flags & RR_DIRECT) {
+        rr->fd = open(path, O_RDONLY | O_DIRECT | O_CLOEXEC);
+        rr->direct = rr->fd != -1;
+    }
+    if (rr->fd == -1 && (rr->fd = open(path, O_RDONLY | O_CLOEXEC)) == -1)
+        return -1;
+
+    if (flags & RR_DIRECT) {
+        if ((rr->cache = malloc(sizeof(struct blockCache))) == NULL)
+            goto fail;
+        if (bcInit(rr->cache, rr->fd, cacheBytes) == -1) {
+            free(rr->cache);
+            rr->cache = NULL;
+            goto fail;
+        }
+    } else if (flags & RR_HINT) {
+        if ((rr->hint = malloc(sizeof(struct ioHint))) == NULL)
+            goto fail;
+        if (ihInit(rr->hint, rr->fd, NULL, 0, IH_DROP_BEHIND) == -1) {
+            free(rr->hint);
+            rr->hint = NULL;
+            goto fail;
+        }
+    }
+
+    if (readAt(rr, &hdr, sizeof(hdr), 0) != sizeof(hdr) ||
+            memcmp(hdr.magic, RS_MAGIC, sizeof(hdr.magic)) != 0 ||
+            hdr.version != RS_VERSION ||
+            hdr.recordSize != sizeof(struct itemRecord)) {
+        errno = EBADMSG;
+        goto fail;
+    }
+    rr->count = hdr.count;
+    return 0;
+
+fail:
+    savedErrno = errno;
+    rrClose(rr);
+    errno = savedErrno;
+    return -1;
+}
+
+int
+rrGet(struct recordReader *rr, uint64_t n, struct itemRecord *rec)
+{
+    ssize_t r;
+
+    if (n >= rr->count) {
+        errno = ERANGE;
+        return -1;
+    }
+    r = readAt(rr, rec, sizeof(*rec), RS_HEADER_SIZE + n * sizeof(*rec));
+    if (r != sizeof(*rec)) {
+        if (r >= 0)
+            errno = EIO;
+        return -1;
+    }
+    return 0;
+}
+
+void
+rrClose(struct recordReader *rr)
+{
+    if (rr->cache != NULL) {
+        bcDestroy(rr->cache);
+        free(rr->cache);
+    }
+    if (rr->hint != NULL) {
+        ihEnd(rr->hint);
+        free(rr->hint);
+    }
+    if (rr->fd != -1)
+        close(rr->fd);
+}
@@ -0,0 +1,71 @@
+/**
+ * @file recordReader.h
+ * @author Lock
+ * @date 16 Oct 2026
+ * @brief 通过 pread() 读取记录文件, 可选 O_DIRECT 和用户空间块缓存
+ *
+ * recordStore.h 通过 mmap() 访问记录, 缓存完全交给内核页缓存.
+ * 记录文件远大于内存时, 一次全表扫描就会把热点记录挤出页缓存.
+ * 这里提供只读的另一条路径:
+ *   - 不使用 @ref RR_DIRECT 时, 每条记录一次 pread(), 经过页缓存.
+ *   - 使用 @ref RR_DIRECT 时, 以 `O_DIRECT` 打开文件, 记录从 blockCache.h
+ *   的块缓存中读取, 缓存大小和替换策略(2Q)由调用者控制, 扫描不会淘汰热点数据.
+ *   文件系统不支持 `O_DIRECT` 时(例如 tmpfs), 仍然使用块缓存, 但经过页缓存读取.
+ *   - 不使用 @ref RR_DIRECT 而使用 @ref RR_HINT 时, 每次读取之前经过 ioHint.h
+ *   判断访问模式, 顺序扫描读过的页会被丢弃, 同样不会淘汰热点数据.
+ *
+ * @example blockCacheBench.c
+ */
+#ifndef RECORD_READER_H
+#define RECORD_READER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "recordStore.h"
+#include "blockCache.h"
+#include "ioHint.h"
+
+#define RR_DIRECT 01            //!< 使用 O_DIRECT 和块缓存
+#define RR_HINT 02              //!< 按访问模式提供页缓存提示, 顺序扫描时丢弃读过的页
+
+/**
+ * @brief 打开的记录文件
+ */
+struct recordReader {
+    int fd;
+    int direct;                 //!< 是否成功使用了 O_DIRECT
+    uint64_t count;             //!< 打开时的记录个数
+    struct blockCache *cache;   //!< 不使用块缓存时为 NULL
+    struct ioHint *hint;        //!< 不使用 @ref RR_HINT 时为 NULL
+};
+
+/**
+ * @brief 以只读方式打开记录文件
+ *
+ * @param rr 记录文件
+ * @param path 文件路径
+ * @param cacheBytes 块缓存大小, 只在使用 @ref RR_DIRECT 时有效
+ * @param flags 0, @ref RR_DIRECT 或 @ref RR_HINT
+ *
+ * @retval 0 成功
+ * @retval -1 失败, 文件格式不正确时 errno 为 `EBADMSG`
+ */
+int
+rrOpen(struct recordReader *rr, const char *path, size_t cacheBytes, int flags);
+
+/**
+ * @brief 读取编号为 @p n 的记录
+ *
+ * @retval 0 成功
+ * @retval -1 失败, 编号越界时 errno 为 `ERANGE`
+ */
+int
+rrGet(struct recordReader *rr, uint64_t n, struct itemRecord *rec);
+
+/**
+ * @brief 关闭记录文件
+ */
+void
+rrClose(struct recordReader *rr);
+
+#endif
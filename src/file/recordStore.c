@@ -0,0 +1,223 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "recordStore.h"
+
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "recordStore 的磁盘格式为小端字节序"
+#endif
+
+_Static_assert(sizeof(struct rsHeader) == RS_HEADER_SIZE, "rsHeader size");
+_Static_assert(sizeof(struct itemRecord) == 60, "itemRecord size");
+
+static size_t
+pageRoundUp(size_t n)
+{
+    size_t page = sysconf(_SC_PAGESIZE);
+
+    return (n + page - 1) & ~(page - 1);
+}
+
+/* 返回文件当前已分配的大小 */
+static off_t
+fileSize(const struct recordStore *rs)
+{
+    return RS_HEADER_SIZE + (off_t)rs->capacity * sizeof(struct itemRecord);
+}
+
+/*
+ * 把文件 [mapped, newSize) 这一段映射到预留区域中, 紧接在已映射部分之后
+ */
+static int
+mapTo(struct recordStore *rs, off_t newSize)
+{
+    size_t newMapped = pageRoundUp(newSize);
+    int prot = (rs->flags & RS_RDONLY) ? PROT_READ : PROT_READ | PROT_WRITE;
+
+    if (newMapped > rs->reserved) {
+        errno = EFBIG;
+        return -1;
+    }
+
+    if (newMapped > rs->mapped) {
+        if (mmap(rs->base + rs->mapped, newMapped - rs->mapped, prot,
+                    MAP_SHARED | MAP_FIXED, rs->fd, rs->mapped) == MAP_FAILED)
+            return -1;
+        rs->mapped = newMapped;
+    }
+
+    rs->capacity = (newSize - RS_HEADER_SIZE) / sizeof(struct itemRecord);
+    return 0;
+}
+
+/*
+ * 按 RS_GROW_CHUNK 扩展文件. fallocate() 同时分配磁盘块并修改文件大小,
+ * 文件系统不支持时退回到 ftruncate(), 此时文件是稀疏的.
+ */
+static int
+grow(struct recordStore *rs)
+{
+    off_t size = fileSize(rs);
+
+    if (fallocate(rs->fd, 0, size, RS_GROW_CHUNK) == -1) {
+        if (errno != EOPNOTSUPP)
+            return -1;
+        if (ftruncate(rs->fd, size + RS_GROW_CHUNK) == -1)
+            return -1;
+    }
+
+    return mapTo(rs, size + RS_GROW_CHUNK);
+}
+
+static int
+initHeader(int fd)
+{
+    struct rsHeader hdr;
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, RS_MAGIC, sizeof(hdr.magic));
+    hdr.version = RS_VERSION;
+    hdr.recordSize = sizeof(struct itemRecord);
+    hdr.count = 0;
+
+    if (pwrite(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr))
+        return -1;
+    return 0;
+}
+
+static int
+checkHeader(int fd, off_t size)
+{
+    struct rsHeader hdr;
+
+    if (size < RS_HEADER_SIZE ||
+            pread(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) ||
+            memcmp(hdr.magic, RS_MAGIC, sizeof(hdr.magic)) != 0 ||
+            hdr.version != RS_VERSION ||
+            hdr.recordSize != sizeof(struct itemRecord) ||
+            RS_HEADER_SIZE + hdr.count * sizeof(struct itemRecord) > (uint64_t)size) {
+        errno = EBADMSG;
+        return -1;
+    }
+    return 0;
+}
+
+int
+rsOpen(struct recordStore *rs, const char *path, int flags)
+{
+    struct stat sb;
+    int oflags, savedErrno;
+
+    memset(rs, 0, sizeof(struct recordStore));
+    rs->flags = flags;
+    rs->base = MAP_FAILED;
+
+    oflags = (flags & RS_RDONLY) ? O_RDONLY : O_RDWR;
+    if ((flags & RS_CREATE) && !(flags & RS_RDONLY))
+        oflags |= O_CREAT;
+
+    if ((rs->fd = open(path, oflags | O_CLOEXEC, S_IRUSR | S_IWUSR | S_IRGRP)) == -1)
+        return -1;
+
+    if (fstat(rs->fd, &sb) == -1)
+        goto fail;
+
+    if (sb.st_size == 0 && !(flags & RS_RDONLY)) {
+        if (initHeader(rs->fd) == -1)
+            goto fail;
+        sb.st_size = RS_HEADER_SIZE;
+    } else if (checkHeader(rs->fd, sb.st_size) == -1) {
+        goto fail;
+    }
+
+    // 预留虚拟地址空间, 之后文件的映射都放在这段区域里, 地址不会改变
+    rs->reserved = RS_MAX_MAP;
+    if ((size_t)sb.st_size > rs->reserved)
+        rs->reserved = pageRoundUp(sb.st_size);
+    rs->base = mmap(NULL, rs->reserved, PROT_NONE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (rs->base == MAP_FAILED)
+        goto fail;
+
+    if (mapTo(rs, sb.st_size) == -1)
+        goto fail;
+    rs->hdr = (struct rsHeader *)rs->base;
+
+    return 0;
+
+fail:
+    savedErrno = errno;
+    if (rs->base != MAP_FAILED)
+        munmap(rs->base, rs->reserved);
+    close(rs->fd);
+    errno = savedErrno;
+    return -1;
+}
+
+int64_t
+rsAppend(struct recordStore *rs, const struct itemRecord *rec)
+{
+    uint64_t n = rs->hdr->count;
+
+    if (rs->flags & RS_RDONLY) {
+        errno = EBADF;
+        return -1;
+    }
+
+    if (n == rs->capacity && grow(rs) == -1)
+        return -1;
+
+    memcpy(rs->base + RS_HEADER_SIZE + n * sizeof(struct itemRecord),
+            rec, sizeof(struct itemRecord));
+
+    // 先写记录再增加计数, 同一进程中的读者看到计数时记录内容已经完整
+    __atomic_store_n(&rs->hdr->count, n + 1, __ATOMIC_RELEASE);
+
+    return n;
+}
+
+int
+rsRefresh(struct recordStore *rs)
+{
+    struct stat sb;
+
+    if (fstat(rs->fd, &sb) == -1)
+        return -1;
+    if (sb.st_size <= fileSize(rs))
+        return 0;
+    return mapTo(rs, sb.st_size);
+}
+
+int
+rsSync(struct recordStore *rs)
+{
+    if (rs->flags & RS_RDONLY)
+        return 0;
+    return msync(rs->base, rs->mapped, MS_SYNC);
+}
+
+int
+rsClose(struct recordStore *rs)
+{
+    int ret = 0;
+
+    if (!(rs->flags & RS_RDONLY)) {
+        if (msync(rs->base, rs->mapped, MS_SYNC) == -1)
+            ret = -1;
+        // 释放末尾预分配但未使用的空间
+        if (ftruncate(rs->fd, RS_HEADER_SIZE +
+                    rs->hdr->count * sizeof(struct itemRecord)) == -1)
+            ret = -1;
+    }
+
+    munmap(rs->base, rs->reserved);
+    if (close(rs->fd) == -1)
+        ret = -1;
+
+    return ret;
+}
@@ -0,0 +1,160 @@
+/**
+ * @file recordStore.h
+ * @author Lock
+ * @date 16 Oct 2026
+ * @brief 基于 mmap() 的定长记录文件
+ *
+ * file.c 用 fwrite() 直接写出内存中的结构体:
+ * @code{.c}
+ * struct {
+ *     short count;
+ *     long  total;
+ *     char  name[NAMESIZE];
+ * } item;
+ * @endcode
+ * 在 x86_64 上 `count` 之后有 6 个字节的填充, 结构体大小为 72 字节,
+ * 文件的布局取决于编译器和平台, 也没有任何头部用来识别文件格式的版本.
+ *
+ * 这里定义了一个紧凑的磁盘格式:
+ *   - 文件开头是 64 字节的 @ref rsHeader, 包含魔数, 版本号, 记录大小和记录个数.
+ *   - 之后是连续存放的 @ref itemRecord, 每条 60 字节, 没有填充, 整数为小端字节序.
+ *
+ * 文件通过 mmap() 映射到内存, 读取第 n 条记录只是一次地址计算,
+ * 不需要任何系统调用. 打开时预留一段足够大的虚拟地址空间,
+ * 文件增长后把新的部分用 `MAP_FIXED` 映射到预留区域的后面,
+ * 所以已经返回的记录指针在追加之后依然有效.
+ *
+ * 追加记录时直接写入映射区域. 文件每次按 @ref RS_GROW_CHUNK 增长,
+ * 使用 fallocate() 预先分配磁盘块, 这样写入映射页时不会因为磁盘空间不足而收到 SIGBUS,
+ * 也避免了每次追加都修改文件大小.
+ *
+ * @note 记录个数保存在头部中, 只有 rsSync() 之后才保证持久化.
+ * 崩溃后最多丢失最后一次 rsSync() 之后追加的记录.
+ *
+ * @example recordStoreBench.c
+ */
+#ifndef RECORD_STORE_H
+#define RECORD_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define RS_MAGIC "ITEMRECS"
+#define RS_VERSION 1
+#define RS_NAMESIZE 50
+#define RS_HEADER_SIZE 64
+#define RS_GROW_CHUNK (64 * 1024 * 1024)        //!< 文件每次增长的字节数
+#define RS_MAX_MAP ((off_t)64 * 1024 * 1024 * 1024) //!< 默认预留的虚拟地址空间
+
+#define RS_CREATE 01            //!< 文件不存在时创建
+#define RS_RDONLY 02            //!< 只读打开
+
+/**
+ * @brief 磁盘上的文件头部
+ */
+struct rsHeader {
+    char magic[8];              //!< @ref RS_MAGIC
+    uint32_t version;           //!< @ref RS_VERSION
+    uint32_t recordSize;        //!< sizeof(struct itemRecord)
+    uint64_t count;             //!< 已提交的记录个数
+    char reserved[40];
+} __attribute__((packed));
+
+/**
+ * @brief 磁盘上的一条记录, 与 file.c 中的结构体字段相同, 但没有填充
+ */
+struct itemRecord {
+    int16_t count;
+    int64_t total;
+    char name[RS_NAMESIZE];
+} __attribute__((packed));
+
+/**
+ * @brief 打开的记录文件
+ */
+struct recordStore {
+    int fd;
+    int flags;
+    char *base;                 //!< 映射(预留)区域起始地址, 即文件头部
+    size_t reserved;            //!< 预留的虚拟地址空间大小
+    size_t mapped;              //!< 已映射的文件字节数
+    uint64_t capacity;          //!< 已分配空间可以容纳的记录个数
+    struct rsHeader *hdr;
+};
+
+/**
+ * @brief 打开或创建记录文件
+ *
+ * @param rs 记录文件
+ * @param path 文件路径
+ * @param flags @ref RS_CREATE, @ref RS_RDONLY
+ *
+ * @retval 0 成功
+ * @retval -1 失败, 文件格式不正确时 errno 为 `EBADMSG`
+ */
+int
+rsOpen(struct recordStore *rs, const char *path, int flags);
+
+/**
+ * @brief 追加一条记录
+ *
+ * @return 返回新记录的编号
+ * @retval -1 失败
+ */
+int64_t
+rsAppend(struct recordStore *rs, const struct itemRecord *rec);
+
+/**
+ * @brief 把映射区域以及头部的记录个数同步到磁盘
+ *
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+int
+rsSync(struct recordStore *rs);
+
+/**
+ * @brief 关闭记录文件, 并把文件截断到实际使用的大小
+ */
+int
+rsClose(struct recordStore *rs);
+
+/**
+ * @brief 映射其他进程追加后增长的文件
+ *
+ * 头部中的记录个数由所有打开文件的进程共享, 但每个进程只映射了打开时(或自己增长时)的文件大小.
+ * 其他进程追加的记录超出这个范围后, 要调用本函数才能读取.
+ *
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+int
+rsRefresh(struct recordStore *rs);
+
+/**
+ * @brief 返回本进程可以读取的记录个数, 不超过已映射的部分
+ */
+static inline uint64_t
+rsCount(const struct recordStore *rs)
+{
+    uint64_t count = __atomic_load_n(&rs->hdr->count, __ATOMIC_ACQUIRE);
+
+    return (count < rs->capacity) ? count : rs->capacity;
+}
+
+/**
+ * @brief 按编号读取记录, 不产生系统调用
+ *
+ * @return 返回指向映射区域中记录的指针, 编号越界或者记录还没有映射(见 rsRefresh())时返回 NULL
+ */
+static inline const struct itemRecord *
+rsGet(const struct recordStore *rs, uint64_t n)
+{
+    if (n >= rsCount(rs))
+        return NULL;
+    return (const struct itemRecord *)
+        (rs->base + RS_HEADER_SIZE + n * sizeof(struct itemRecord));
+}
+
+#endif
@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include "recordStore.h"
+
+/*
+ * 记录文件的追加与随机读取测试, 并与每条记录一次 pread() 的方式对比
+ *
+ * 编译: gcc -O2 recordStoreBench.c recordStore.c -o recordStoreBench
+ * 用法: recordStoreBench [path] [records]
+ */
+
+void errExit(char *msg)
+{
+    extern int errno;
+    perror(msg);
+    exit(errno);
+}
+
+static double
+nowSec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* xorshift64, 生成随机的记录编号 */
+static uint64_t
+nextRand(uint64_t *s)
+{
+    *s ^= *s << 13;
+    *s ^= *s >> 7;
+    *s ^= *s << 17;
+    return *s;
+}
+
+int
+main(int argc, char *argv[])
+{
+    struct recordStore rs;
+    struct itemRecord rec;
+    const struct itemRecord *rp;
+    const char *path;
+    uint64_t n, j, seed, idx;
+    int64_t sum;
+    double start, elapsed;
+    int fd;
+
+    path = (argc > 1) ? argv[1] : "/tmp/test.rec";
+    n = (argc > 2) ? strtoull(argv[2], NULL, 10) : 10000000;
+    if (n == 0) {
+        fprintf(stderr, "records must be > 0\n");
+        exit(EXIT_FAILURE);
+    }
+
+    unlink(path);
+    if (rsOpen(&rs, path, RS_CREATE) == -1)
+        errExit("rsOpen");
+
+    memset(&rec, 0, sizeof(rec));
+    start = nowSec();
+    for (j = 0; j < n; j++) {
+        rec.count = (int16_t)j;
+        rec.total = (int64_t)j * 3;
+        snprintf(rec.name, RS_NAMESIZE, "item-%llu", (unsigned long long)j);
+        if (rsAppend(&rs, &rec) == -1)
+            errExit("rsAppend");
+    }
+    elapsed = nowSec() - start;
+    printf("append:        %10.1f ns/record\n", elapsed * 1e9 / n);
+
+    if (rsClose(&rs) == -1)
+        errExit("rsClose");
+
+    if (rsOpen(&rs, path, RS_RDONLY) == -1)
+        errExit("rsOpen");
+    if (rsCount(&rs) != n) {
+        fprintf(stderr, "record count mismatch\n");
+        exit(EXIT_FAILURE);
+    }
+
+    seed = 88172645463325252ULL;
+    sum = 0;
+    start = nowSec();
+    for (j = 0; j < n; j++) {
+        rp = rsGet(&rs, nextRand(&seed) % n);
+        sum += rp->total;
+    }
+    elapsed = nowSec() - start;
+    printf("mmap random:   %10.1f ns/record (sum %lld)\n", elapsed * 1e9 / n,
+            (long long)sum);
+
+    if ((fd = open(path, O_RDONLY)) == -1)
+        errExit("open");
+    seed = 88172645463325252ULL;
+    sum = 0;
+    start = nowSec();
+    for (j = 0; j < n; j++) {
+        idx = nextRand(&seed) % n;
+        if (pread(fd, &rec, sizeof(rec), RS_HEADER_SIZE + idx * sizeof(rec))
+                != sizeof(rec))
+            errExit("pread");
+        sum += rec.total;
+    }
+    elapsed = nowSec() - start;
+    printf("pread random:  %10.1f ns/record (sum %lld)\n", elapsed * 1e9 / n,
+            (long long)sum);
+
+    close(fd);
+    rsClose(&rs);
+    exit(EXIT_SUCCESS);
+}
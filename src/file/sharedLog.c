@@ -0,0 +1,306 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "sharedLog.h"
+#include "../lib/crc32c.h"
+
+/* 头部中 magic 和 crc 之后的字段加上数据的校验和 */
+static uint32_t
+frameCrc(const struct slHeader *h, const void *data, size_t len)
+{
+    uint32_t crc;
+
+    crc = crc32c(0, &h->len, sizeof(struct slHeader) - offsetof(struct slHeader, len));
+    return crc32c(crc, data, len);
+}
+
+int
+slOpen(struct sharedLog *sl, const char *path)
+{
+    memset(sl, 0, sizeof(struct sharedLog));
+    sl->fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    if (sl->fd == -1)
+        return -1;
+    sl->pid = getpid();
+    pthread_mutex_init(&sl->bigMtx, NULL);
+    return 0;
+}
+
+/* 一次 writev() 追加一个记录或分片 */
+static int
+appendFrame(struct sharedLog *sl, int type, uint32_t frag, const void *data, size_t len)
+{
+    struct slHeader h;
+    struct iovec iov[2];
+    ssize_t n;
+
+    h.magic = SL_MAGIC;
+    h.len = len;
+    h.type = type;
+    h.reserved = 0;
+    h.pid = sl->pid;
+    h.frag = frag;
+    h.crc = frameCrc(&h, data, len);
+
+    iov[0].iov_base = &h;
+    iov[0].iov_len = sizeof(h);
+    iov[1].iov_base = (void *)data;
+    iov[1].iov_len = len;
+
+    // 不能重试剩下的部分: 其他进程的记录可能已经追加在后面
+    if ((n = writev(sl->fd, iov, 2)) == -1)
+        return -1;
+    if ((size_t)n != sizeof(h) + len) {
+        errno = EIO;
+        return -1;
+    }
+    return 0;
+}
+
+static int
+lockBig(struct sharedLog *sl, int type)
+{
+    struct flock fl;
+
+    memset(&fl, 0, sizeof(fl));
+    fl.l_type = type;
+    fl.l_whence = SEEK_SET;
+    fl.l_start = SL_LOCK_OFFSET;
+    fl.l_len = 1;
+    while (fcntl(sl->fd, F_SETLKW, &fl) == -1)
+        if (errno != EINTR)
+            return -1;
+    return 0;
+}
+
+int
+slAppend(struct sharedLog *sl, const void *data, size_t len)
+{
+    const char *p = data;
+    size_t n;
+    uint32_t frag;
+    int ret = 0, savedErrno;
+
+    if (len <= SL_FRAG_DATA) {
+        sl->appends++;
+        return appendFrame(sl, SL_FULL, 0, data, len);
+    }
+    if (len > SL_MAX_RECORD) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+
+    pthread_mutex_lock(&sl->bigMtx);
+    if (lockBig(sl, F_WRLCK) == -1) {
+        pthread_mutex_unlock(&sl->bigMtx);
+        return -1;
+    }
+    for (frag = 0; len > 0; frag++) {
+        n = (len > SL_FRAG_DATA) ? SL_FRAG_DATA : len;
+        if (appendFrame(sl, (frag == 0) ? SL_FIRST : (n == len) ? SL_LAST : SL_MIDDLE,
+                    frag, p, n) == -1) {
+            ret = -1;
+            break;
+        }
+        p += n;
+        len -= n;
+    }
+    savedErrno = errno;
+    lockBig(sl, F_UNLCK);
+    pthread_mutex_unlock(&sl->bigMtx);
+    sl->bigAppends++;
+    errno = savedErrno;
+    return ret;
+}
+
+int
+slSync(struct sharedLog *sl)
+{
+    return fdatasync(sl->fd);
+}
+
+int
+slClose(struct sharedLog *sl)
+{
+    pthread_mutex_destroy(&sl->bigMtx);
+    return close(sl->fd);
+}
+
+int
+slReaderOpen(struct slReader *r, const char *path)
+{
+    struct stat sb;
+    void *map;
+    int fd;
+
+    memset(r, 0, sizeof(struct slReader));
+    if ((fd = open(path, O_RDONLY | O_CLOEXEC)) == -1)
+        return -1;
+    if (fstat(fd, &sb) == -1) {
+        close(fd);
+        return -1;
+    }
+    if (sb.st_size > 0) {
+        map = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            close(fd);
+            return -1;
+        }
+        madvise(map, sb.st_size, MADV_SEQUENTIAL);
+        r->data = map;
+        r->size = sb.st_size;
+    }
+    close(fd);
+    return 0;
+}
+
+/* pos 处是否是一个完整有效的记录或分片 */
+static int
+validAt(const struct slReader *r, size_t pos, struct slHeader *h)
+{
+    if (r->size - pos < sizeof(struct slHeader))
+        return 0;
+    memcpy(h, r->data + pos, sizeof(struct slHeader));
+    if (h->magic != SL_MAGIC || h->len > SL_FRAG_DATA ||
+            h->type < SL_FULL || h->type > SL_LAST ||
+            r->size - pos - sizeof(struct slHeader) < h->len)
+        return 0;
+    return frameCrc(h, r->data + pos + sizeof(struct slHeader), h->len) == h->crc;
+}
+
+/* 从 pos 开始查找下一个有效的头部, 没有时返回 size */
+static size_t
+resync(const struct slReader *r, size_t pos)
+{
+    const uint32_t magic = SL_MAGIC;
+    struct slHeader h;
+    const char *p;
+
+    while (pos < r->size) {
+        p = memmem(r->data + pos, r->size - pos, &magic, sizeof(magic));
+        if (p == NULL)
+            break;
+        pos = p - r->data;
+        if (validAt(r, pos, &h))
+            return pos;
+        pos++;
+    }
+    return r->size;
+}
+
+static int
+bigAppend(struct slReader *r, const char *data, size_t len)
+{
+    char *big;
+    size_t cap;
+
+    if (r->bigLen + len > r->bigCap) {
+        for (cap = r->bigCap ? r->bigCap : SL_ATOMIC_MAX; cap < r->bigLen + len; cap *= 2)
+            ;
+        if ((big = realloc(r->big, cap)) == NULL)
+            return -1;
+        r->big = big;
+        r->bigCap = cap;
+    }
+    memcpy(r->big + r->bigLen, data, len);
+    r->bigLen += len;
+    return 0;
+}
+
+int
+slNext(struct slReader *r, const void **data, size_t *len, uint32_t *pid)
+{
+    struct slHeader h;
+    const char *payload;
+    size_t next;
+
+    for (;;) {
+        if (r->pos >= r->size)
+            break;
+
+        if (!validAt(r, r->pos, &h)) {
+            next = resync(r, r->pos + 1);
+            if (next == r->size) {
+                r->tornTail = 1;
+                r->pos = r->size;
+                break;
+            }
+            r->skipped += next - r->pos;
+            r->pos = next;
+            continue;
+        }
+
+        payload = r->data + r->pos + sizeof(struct slHeader);
+        r->pos += sizeof(struct slHeader) + h.len;
+        r->validEnd = r->pos;
+
+        switch (h.type) {
+        case SL_FULL:
+            r->records++;
+            *data = payload;
+            *len = h.len;
+            if (pid != NULL)
+                *pid = h.pid;
+            return 1;
+
+        case SL_FIRST:
+            if (r->inBig)
+                r->dropped++;
+            r->inBig = 1;
+            r->bigPid = h.pid;
+            r->bigLen = 0;
+            r->bigFrag = 1;
+            if (h.frag != 0 || bigAppend(r, payload, h.len) == -1) {
+                r->inBig = 0;
+                if (h.frag == 0)
+                    return -1;
+                r->dropped++;
+            }
+            break;
+
+        default:
+            // 大记录同一时刻只有一个写入者, 分片必须来自同一进程且连续
+            if (!r->inBig || h.pid != r->bigPid || h.frag != r->bigFrag) {
+                if (r->inBig) {
+                    r->inBig = 0;
+                    r->dropped++;
+                }
+                break;
+            }
+            if (bigAppend(r, payload, h.len) == -1)
+                return -1;
+            r->bigFrag++;
+            if (h.type == SL_LAST) {
+                r->inBig = 0;
+                r->records++;
+                *data = r->big;
+                *len = r->bigLen;
+                if (pid != NULL)
+                    *pid = h.pid;
+                return 1;
+            }
+            break;
+        }
+    }
+
+    if (r->inBig) {
+        r->inBig = 0;
+        r->dropped++;
+    }
+    return 0;
+}
+
+void
+slReaderClose(struct slReader *r)
+{
+    if (r->data != NULL)
+        munmap((void *)r->data, r->size);
+    free(r->big);
+    memset(r, 0, sizeof(struct slReader));
+}
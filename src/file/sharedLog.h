@@ -0,0 +1,159 @@
+/**
+ * @file sharedLog.h
+ * @author Lock
+ * @date 16 Oct 2026
+ * @brief 多个进程同时追加的日志文件
+ *
+ * 以 `O_APPEND` 打开的文件, 每次 write() 都先把偏移量移到文件末尾再写入,
+ * 这两步对同一文件的其他 write() 是原子的(Linux 在整个写入期间持有 inode 锁),
+ * 所以多个进程各自用一次 writev() 写出头部和数据, 记录之间不会交错, 也不需要加锁.
+ *
+ * # 记录格式
+ * 每条记录由 24 字节的 @ref slHeader 和数据组成. 头部带有魔数和覆盖头部与数据的 CRC32C.
+ *
+ * # 大记录
+ * 一次写入的大小限制为 @ref SL_ATOMIC_MAX, 避免因为磁盘空间不足等原因出现部分写入.
+ * 更大的记录拆分为多个分片(@ref SL_FIRST, @ref SL_MIDDLE, @ref SL_LAST),
+ * 每个分片仍然是一次原子的追加. 写分片期间持有一个 fcntl() 记录锁
+ * (锁住远超文件末尾的一个字节, 与数据无关), 所以同一时刻只有一条大记录在写,
+ * 其他进程的小记录可以夹在它的分片之间, 读者按分片类型重新组装.
+ *
+ * # 读取
+ * slNext() 按顺序返回完整的记录:
+ *   - 遇到魔数, 长度或校验和不正确的内容时, 向后逐字节查找下一个有效的头部,
+ *   跳过的字节数记录在 `skipped` 中.
+ *   - 文件末尾不完整的记录(写入者崩溃或断电)被忽略, `tornTail` 置 1,
+ *   `validEnd` 为最后一个有效的记录或分片的结尾.
+ *   - 没有 @ref SL_LAST 的大记录(写入者在写分片时崩溃)被丢弃.
+ *
+ * @example sharedLogBench.c
+ */
+#ifndef SHARED_LOG_H
+#define SHARED_LOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#define SL_MAGIC 0x4c4f4753             //!< "SGOL"
+#define SL_ATOMIC_MAX (64 * 1024)       //!< 一次原子追加的最大字节数, 包括头部
+#define SL_MAX_RECORD (256 * 1024 * 1024)   //!< 记录的最大长度
+#define SL_LOCK_OFFSET ((off_t)1 << 62) //!< 大记录锁住的字节
+
+#define SL_FULL 1                       //!< 完整的记录
+#define SL_FIRST 2                      //!< 大记录的第一个分片
+#define SL_MIDDLE 3
+#define SL_LAST 4
+
+/**
+ * @brief 记录或分片的头部
+ */
+struct slHeader {
+    uint32_t magic;             //!< @ref SL_MAGIC
+    uint32_t crc;               //!< 头部其余字段和数据的 CRC32C
+    uint32_t len;               //!< 数据长度, 不包括头部
+    uint16_t type;              //!< @ref SL_FULL 等
+    uint16_t reserved;
+    uint32_t pid;               //!< 写入者的进程 ID
+    uint32_t frag;              //!< 分片序号, 从 0 开始
+};
+
+#define SL_FRAG_DATA (SL_ATOMIC_MAX - sizeof(struct slHeader))  //!< 每个分片的数据长度
+
+/**
+ * @brief 写入者
+ */
+struct sharedLog {
+    int fd;
+    uint32_t pid;
+    pthread_mutex_t bigMtx;     //!< fcntl() 锁属于进程, 同一进程的线程之间另外加锁
+    uint64_t appends;
+    uint64_t bigAppends;
+};
+
+/**
+ * @brief 读者
+ */
+struct slReader {
+    const char *data;           //!< 映射的文件
+    size_t size;
+    size_t pos;
+    char *big;                  //!< 正在组装的大记录
+    size_t bigLen;
+    size_t bigCap;
+    uint32_t bigPid;
+    uint32_t bigFrag;           //!< 下一个期望的分片序号
+    int inBig;
+
+    uint64_t records;
+    uint64_t skipped;           //!< 跳过的损坏字节数
+    uint64_t dropped;           //!< 丢弃的不完整大记录数
+    int tornTail;               //!< 文件末尾有不完整的记录
+    size_t validEnd;            //!< 最后一个有效的记录或分片的结尾
+};
+
+/**
+ * @brief 打开或创建日志文件
+ *
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+int
+slOpen(struct sharedLog *sl, const char *path);
+
+/**
+ * @brief 追加一条记录
+ *
+ * 不超过 @ref SL_FRAG_DATA 字节的记录用一次 writev() 追加,
+ * 更大的记录在 fcntl() 锁的保护下分片追加.
+ *
+ * @retval 0 成功
+ * @retval -1 失败, 或者发生了部分写入(记录不完整, 读者会跳过它)
+ */
+int
+slAppend(struct sharedLog *sl, const void *data, size_t len);
+
+/**
+ * @brief fdatasync() 日志文件
+ */
+int
+slSync(struct sharedLog *sl);
+
+/**
+ * @brief 关闭日志文件
+ */
+int
+slClose(struct sharedLog *sl);
+
+/**
+ * @brief 打开日志文件读取, 读取打开时的文件内容
+ *
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+int
+slReaderOpen(struct slReader *r, const char *path);
+
+/**
+ * @brief 读取下一条完整的记录
+ *
+ * @param r 读者
+ * @param data 返回记录的数据, 在下一次调用 slNext() 之前有效
+ * @param len 返回记录的长度
+ * @param pid 不为 NULL 时返回写入者的进程 ID
+ *
+ * @retval 1 成功
+ * @retval 0 没有更多的记录
+ * @retval -1 失败
+ */
+int
+slNext(struct slReader *r, const void **data, size_t *len, uint32_t *pid);
+
+/**
+ * @brief 关闭读者
+ */
+void
+slReaderClose(struct slReader *r);
+
+#endif
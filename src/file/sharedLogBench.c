@@ -0,0 +1,222 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "sharedLog.h"
+
+/*
+ * 多个进程同时追加同一个日志文件
+ *
+ * 1, 2, 4 ... 个写入进程各自 slOpen() 同一个文件, 共追加 n 条 16 ~ 256 字节的记录,
+ * 每隔 bigEvery 条追加一条 200 KiB 的大记录(分片写入). 然后:
+ *   - 用读者检查每个进程的记录按顺序全部读出, 内容正确, 没有跳过的字节
+ *   - 截掉文件末尾的几个字节, 检查读者识别出不完整的尾部
+ *   - 在文件中间写入垃圾, 检查读者能跳过它继续读取
+ *
+ * 编译: gcc -O2 -pthread sharedLogBench.c sharedLog.c ../lib/crc32c.c -o sharedLogBench
+ * 用法: sharedLogBench [-d dir] [-n records] [-b bigEvery] [-p maxProcs]
+ */
+
+#define MAX_PROCS 64
+#define BIG_SIZE (200 * 1024)
+
+void errExit(char *msg)
+{
+    extern int errno;
+    perror(msg);
+    exit(errno);
+}
+
+static double
+nowSec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static char path[PATH_MAX];
+static long bigEvery;
+
+/* 第 k 个进程的第 j 条记录: 前 8 字节为 (k, j), 之后是由它们决定的字节 */
+static size_t
+makeRecord(char *buf, uint32_t k, uint32_t j)
+{
+    size_t len, i;
+
+    if (bigEvery > 0 && j % bigEvery == bigEvery - 1)
+        len = BIG_SIZE + j % 1000;
+    else
+        len = 16 + (j * 2654435761u >> 8) % 241;
+    memcpy(buf, &k, 4);
+    memcpy(buf + 4, &j, 4);
+    for (i = 8; i < len; i++)
+        buf[i] = (char)(k * 31 + j + i);
+    return len;
+}
+
+static void
+writer(uint32_t k, long n)
+{
+    struct sharedLog sl;
+    char *buf;
+    size_t len;
+    long j;
+
+    if ((buf = malloc(BIG_SIZE + 1000)) == NULL)
+        errExit("malloc");
+    if (slOpen(&sl, path) == -1)
+        errExit("slOpen");
+    for (j = 0; j < n; j++) {
+        len = makeRecord(buf, k, j);
+        if (slAppend(&sl, buf, len) == -1)
+            errExit("slAppend");
+    }
+    slClose(&sl);
+    free(buf);
+}
+
+/* 读出全部记录并检查, 返回读到的记录数 */
+static long
+verify(int nprocs, long perProc, struct slReader *r, int strict)
+{
+    long next[MAX_PROCS] = {0}, cnt = 0;
+    char *expect;
+    const void *data;
+    size_t len;
+    uint32_t k, j;
+    int s;
+
+    if ((expect = malloc(BIG_SIZE + 1000)) == NULL)
+        errExit("malloc");
+    if (slReaderOpen(r, path) == -1)
+        errExit("slReaderOpen");
+    while ((s = slNext(r, &data, &len, NULL)) == 1) {
+        memcpy(&k, data, 4);
+        memcpy(&j, (const char *)data + 4, 4);
+        if (k >= (uint32_t)nprocs || (strict && j != next[k]) || j < next[k] ||
+                len != makeRecord(expect, k, j) || memcmp(data, expect, len) != 0) {
+            printf("  BAD RECORD proc %u seq %u (expected %ld)\n", k, j,
+                    (k < (uint32_t)nprocs) ? next[k] : -1L);
+            break;
+        }
+        next[k] = j + 1;
+        cnt++;
+    }
+    if (s == -1)
+        errExit("slNext");
+    if (strict)
+        for (k = 0; k < (uint32_t)nprocs; k++)
+            if (next[k] != perProc)
+                printf("  MISSING RECORDS proc %u: %ld of %ld\n", k, next[k], perProc);
+    free(expect);
+    return cnt;
+}
+
+static void
+run(int nprocs, long n)
+{
+    struct slReader r;
+    struct stat sb;
+    double start, elapsed;
+    long perProc = n / nprocs, cnt;
+    pid_t pids[MAX_PROCS];
+    off_t mid;
+    int k, fd, status;
+
+    if (unlink(path) == -1 && errno != ENOENT)
+        errExit("unlink");
+
+    start = nowSec();
+    for (k = 0; k < nprocs; k++) {
+        if ((pids[k] = fork()) == -1)
+            errExit("fork");
+        if (pids[k] == 0) {
+            writer(k, perProc);
+            _exit(EXIT_SUCCESS);
+        }
+    }
+    for (k = 0; k < nprocs; k++) {
+        if (waitpid(pids[k], &status, 0) == -1)
+            errExit("waitpid");
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            fprintf(stderr, "writer %d failed\n", k);
+            exit(EXIT_FAILURE);
+        }
+    }
+    elapsed = nowSec() - start;
+
+    if (stat(path, &sb) == -1)
+        errExit("stat");
+    printf("%2d procs %10.0f rec/s %8.1f MiB/s", nprocs, perProc * nprocs / elapsed,
+            sb.st_size / elapsed / (1 << 20));
+
+    // 完整的文件
+    cnt = verify(nprocs, perProc, &r, 1);
+    if (cnt != perProc * nprocs || r.skipped != 0 || r.dropped != 0 || r.tornTail)
+        printf("  VERIFY FAILED (%ld records, skipped %lu, dropped %lu, torn %d)",
+                cnt, (unsigned long)r.skipped, (unsigned long)r.dropped, r.tornTail);
+    slReaderClose(&r);
+
+    // 截掉末尾: 最后一条记录丢失, 其余不受影响
+    if (truncate(path, sb.st_size - 5) == -1)
+        errExit("truncate");
+    cnt = verify(nprocs, perProc, &r, 0);
+    if (!r.tornTail || cnt < perProc * nprocs - 1 || r.skipped != 0)
+        printf("  TORN TAIL NOT DETECTED");
+    slReaderClose(&r);
+
+    // 中间写入垃圾: 跳过损坏的字节后继续读取
+    if ((fd = open(path, O_WRONLY)) == -1)
+        errExit("open");
+    mid = sb.st_size / 2;
+    if (pwrite(fd, "garbage garbage garbage", 23, mid) != 23)
+        errExit("pwrite");
+    close(fd);
+    cnt = verify(nprocs, perProc, &r, 0);
+    if (r.skipped == 0 || cnt < perProc * nprocs / 2)
+        printf("  CORRUPTION NOT SKIPPED");
+    printf("  (corrupt: %ld records, skipped %lu bytes)\n", cnt, (unsigned long)r.skipped);
+    slReaderClose(&r);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const char *dir = "/var/tmp";
+    long n = 1000000;
+    int maxProcs = 64, opt, p;
+
+    bigEvery = 10000;
+    while ((opt = getopt(argc, argv, "d:n:b:p:")) != -1) {
+        switch (opt) {
+        case 'd': dir = optarg; break;
+        case 'n': n = atol(optarg); break;
+        case 'b': bigEvery = atol(optarg); break;
+        case 'p': maxProcs = atoi(optarg); break;
+        default:
+            fprintf(stderr, "Usage: %s [-d dir] [-n records] [-b bigEvery] [-p maxProcs]\n",
+                    argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (n <= 0 || bigEvery < 0 || maxProcs < 1 || maxProcs > MAX_PROCS) {
+        fprintf(stderr, "records must be > 0, maxProcs in [1, %d]\n", MAX_PROCS);
+        exit(EXIT_FAILURE);
+    }
+    snprintf(path, sizeof(path), "%s/sharedLog.dat", dir);
+
+    for (p = 1; p <= maxProcs; p *= 2)
+        run(p, n);
+
+    unlink(path);
+    exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,570 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "wal.h"
+#include "../lib/crc32c.h"
+
+#define ZERO_CHUNK (1024 * 1024)
+
+_Static_assert(sizeof(struct walSegHeader) <= WAL_SEG_HEADER, "walSegHeader size");
+_Static_assert(sizeof(struct walRecord) == 16, "walRecord size");
+
+static size_t
+recordSize(size_t len)
+{
+    return (sizeof(struct walRecord) + len + 7) & ~(size_t)7;
+}
+
+/* 记录的校验和: 先数据, 后 len 和 lsn, 数据部分可以在加锁之前计算 */
+static uint32_t
+recordCrc(uint32_t dataCrc, const struct walRecord *rec)
+{
+    return crc32c(dataCrc, &rec->len, sizeof(rec->len) + sizeof(rec->lsn));
+}
+
+static void
+segPath(const char *dir, uint64_t segNo, const char *suffix, char *buf, size_t size)
+{
+    snprintf(buf, size, "%s/wal-%016llx.%s", dir, (unsigned long long)segNo, suffix);
+}
+
+static int
+fsyncDir(const char *dir)
+{
+    int fd, ret;
+
+    if ((fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) == -1)
+        return -1;
+    ret = fsync(fd);
+    close(fd);
+    return ret;
+}
+
+/* 把 [off, end) 写为 0 */
+static int
+zeroFill(int fd, uint64_t off, uint64_t end)
+{
+    static const char zeros[ZERO_CHUNK];
+    ssize_t n;
+
+    while (off < end) {
+        n = pwrite(fd, zeros, end - off < ZERO_CHUNK ? end - off : ZERO_CHUNK, off);
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        off += n;
+    }
+    return 0;
+}
+
+/* 准备段文件: 临时文件写满 0 并 fsync(), 这是创建段文件中耗时的部分 */
+static int
+prepareSegment(const char *dir, uint64_t segNo)
+{
+    char tmp[PATH_MAX + 32];
+    int fd, savedErrno;
+
+    segPath(dir, segNo, "tmp", tmp, sizeof(tmp));
+    if ((fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR)) == -1)
+        return -1;
+    if (zeroFill(fd, 0, WAL_SEG_SIZE) == -1 || fsync(fd) == -1) {
+        savedErrno = errno;
+        close(fd);
+        unlink(tmp);
+        errno = savedErrno;
+        return -1;
+    }
+    return fd;
+}
+
+/*
+ * 完成段文件: 在准备好的临时文件中写入头部, 持久化后再改名,
+ * 崩溃时不会留下不完整的段文件. 失败时关闭 fd.
+ */
+static int
+finishSegment(const char *dir, int fd, uint64_t segNo, uint64_t firstLsn)
+{
+    char tmp[PATH_MAX + 32], path[PATH_MAX + 32];
+    struct walSegHeader hdr;
+    int savedErrno;
+
+    segPath(dir, segNo, "tmp", tmp, sizeof(tmp));
+    segPath(dir, segNo, "log", path, sizeof(path));
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, WAL_SEG_MAGIC, sizeof(hdr.magic));
+    hdr.segNo = segNo;
+    hdr.firstLsn = firstLsn;
+    hdr.crc = crc32c(0, &hdr, offsetof(struct walSegHeader, crc));
+
+    if (pwrite(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) || fdatasync(fd) == -1 ||
+            rename(tmp, path) == -1 || fsyncDir(dir) == -1) {
+        savedErrno = errno;
+        close(fd);
+        unlink(tmp);
+        errno = savedErrno;
+        return -1;
+    }
+    return fd;
+}
+
+static int
+createSegment(const char *dir, uint64_t segNo, uint64_t firstLsn)
+{
+    int fd;
+
+    if ((fd = prepareSegment(dir, segNo)) == -1)
+        return -1;
+    return finishSegment(dir, fd, segNo, firstLsn);
+}
+
+/* 丢弃准备好但没有用到的临时文件 */
+static void
+dropSpare(struct wal *w, int fd, uint64_t segNo)
+{
+    char tmp[PATH_MAX + 32];
+
+    segPath(w->dir, segNo, "tmp", tmp, sizeof(tmp));
+    close(fd);
+    unlink(tmp);
+}
+
+/* 后台线程: 当前段切换之后准备下一个段的临时文件 */
+static void *
+preparerMain(void *arg)
+{
+    struct wal *w = arg;
+    uint64_t segNo;
+    int fd;
+
+    pthread_mutex_lock(&w->mtx);
+    for (;;) {
+        while (!w->stop && (w->spareFd != -1 || w->err != 0 || w->prepFailed == w->segNo + 2))
+            pthread_cond_wait(&w->prepWake, &w->mtx);
+        if (w->stop)
+            break;
+        segNo = w->segNo + 1;
+        w->preparing = 1;
+        pthread_mutex_unlock(&w->mtx);
+
+        fd = prepareSegment(w->dir, segNo);
+
+        pthread_mutex_lock(&w->mtx);
+        w->preparing = 0;
+        if (fd == -1)
+            w->prepFailed = segNo + 1;
+        else if (segNo == w->segNo + 1)
+            w->spareFd = fd;
+        else
+            dropSpare(w, fd, segNo);
+        pthread_cond_broadcast(&w->cond);
+    }
+    pthread_mutex_unlock(&w->mtx);
+    return NULL;
+}
+
+/* 打开段文件并检查头部, 失败或格式不正确时返回 -1 */
+static int
+openSegment(const char *dir, uint64_t segNo, struct walSegHeader *hdr)
+{
+    char path[PATH_MAX + 32];
+    struct stat sb;
+    int fd;
+
+    segPath(dir, segNo, "log", path, sizeof(path));
+    if ((fd = open(path, O_RDWR | O_CLOEXEC)) == -1)
+        return -1;
+    if (fstat(fd, &sb) == -1 || sb.st_size != WAL_SEG_SIZE ||
+            pread(fd, hdr, sizeof(*hdr), 0) != sizeof(*hdr) ||
+            memcmp(hdr->magic, WAL_SEG_MAGIC, sizeof(hdr->magic)) != 0 ||
+            hdr->segNo != segNo ||
+            hdr->crc != crc32c(0, hdr, offsetof(struct walSegHeader, crc))) {
+        close(fd);
+        errno = EBADMSG;
+        return -1;
+    }
+    return fd;
+}
+
+/* 找出目录中最小和最大的段号, 没有段文件时返回 0 */
+static int
+findSegments(const char *dir, uint64_t *first, uint64_t *last)
+{
+    DIR *dirp;
+    struct dirent *dp;
+    unsigned long long segNo;
+    char c;
+    int found = 0;
+
+    if ((dirp = opendir(dir)) == NULL)
+        return -1;
+    while ((dp = readdir(dirp)) != NULL) {
+        if (sscanf(dp->d_name, "wal-%16llx.lo%c", &segNo, &c) != 2 || c != 'g')
+            continue;
+        if (!found || segNo < *first)
+            *first = segNo;
+        if (!found || segNo > *last)
+            *last = segNo;
+        found = 1;
+    }
+    closedir(dirp);
+    return found;
+}
+
+/*
+ * 扫描一个段文件, 对有效记录调用 replay. *lsn 为期望的下一个 LSN,
+ * 返回第一条无效记录的偏移量.
+ */
+static uint64_t
+scanSegment(int fd, uint64_t *lsn, walReplayFn replay, void *arg)
+{
+    const struct walRecord *rec;
+    uint64_t off = WAL_SEG_HEADER;
+    size_t size;
+    char *base;
+
+    base = mmap(NULL, WAL_SEG_SIZE, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (base == MAP_FAILED)
+        return off;
+    madvise(base, WAL_SEG_SIZE, MADV_SEQUENTIAL);
+
+    while (off + sizeof(struct walRecord) <= WAL_SEG_SIZE) {
+        rec = (const struct walRecord *)(base + off);
+        if (rec->lsn != *lsn || rec->len > WAL_MAX_RECORD)
+            break;
+        size = recordSize(rec->len);
+        if (off + size > WAL_SEG_SIZE ||
+                rec->crc != recordCrc(crc32c(0, rec + 1, rec->len), rec))
+            break;
+        if (replay != NULL)
+            replay(rec->lsn, rec + 1, rec->len, arg);
+        (*lsn)++;
+        off += size;
+    }
+
+    munmap(base, WAL_SEG_SIZE);
+    return off;
+}
+
+/*
+ * 恢复: 依次扫描各段, 一个段中的记录结束后, 只有下一个段的 firstLsn
+ * 与期望的 LSN 一致时才继续. 最后一条有效记录之后的内容清零, 之后的段删除.
+ */
+static int
+recover(struct wal *w, walReplayFn replay, void *arg)
+{
+    struct walSegHeader hdr;
+    char path[PATH_MAX + 32];
+    uint64_t first, last, s, lsn, off;
+    int fd, nfd, ret;
+
+    if ((ret = findSegments(w->dir, &first, &last)) == -1)
+        return -1;
+    if (ret == 0) {
+        if ((w->fd = createSegment(w->dir, 0, 0)) == -1)
+            return -1;
+        w->firstSegNo = w->segNo = 0;
+        w->segOff = WAL_SEG_HEADER;
+        return 0;
+    }
+
+    if ((fd = openSegment(w->dir, first, &hdr)) == -1)
+        return -1;
+    lsn = hdr.firstLsn;
+    for (s = first; ; s++) {
+        off = scanSegment(fd, &lsn, replay, arg);
+        if (s == last || (nfd = openSegment(w->dir, s + 1, &hdr)) == -1)
+            break;
+        if (hdr.firstLsn != lsn) {
+            close(nfd);
+            break;
+        }
+        close(fd);
+        fd = nfd;
+    }
+
+    // 清除未提交的尾部, 避免以后写入较短的记录后, 旧数据中恰好有能通过校验的记录
+    if (zeroFill(fd, off, WAL_SEG_SIZE) == -1 || fdatasync(fd) == -1) {
+        close(fd);
+        return -1;
+    }
+    for (; last > s; last--) {
+        segPath(w->dir, last, "log", path, sizeof(path));
+        unlink(path);
+    }
+
+    w->fd = fd;
+    w->firstSegNo = first;
+    w->segNo = s;
+    w->segOff = off;
+    w->nextLsn = w->durableLsn = lsn;
+    return 0;
+}
+
+int
+walOpen(struct wal *w, const char *dir, walReplayFn replay, void *arg)
+{
+    memset(w, 0, sizeof(struct wal));
+    w->fd = -1;
+    if (strlen(dir) >= sizeof(w->dir)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(w->dir, dir);
+    if (mkdir(dir, S_IRWXU | S_IRGRP | S_IXGRP) == -1 && errno != EEXIST)
+        return -1;
+
+    // 按页对齐, 以后可以改用 O_DIRECT 写入
+    if ((errno = posix_memalign((void **)&w->buf[0], 4096, WAL_BUF_SIZE)) != 0)
+        return -1;
+    if ((errno = posix_memalign((void **)&w->buf[1], 4096, WAL_BUF_SIZE)) != 0) {
+        free(w->buf[0]);
+        return -1;
+    }
+
+    if (recover(w, replay, arg) == -1) {
+        free(w->buf[0]);
+        free(w->buf[1]);
+        return -1;
+    }
+
+    w->spareFd = -1;
+    pthread_mutex_init(&w->mtx, NULL);
+    pthread_cond_init(&w->cond, NULL);
+    pthread_cond_init(&w->prepWake, NULL);
+    if ((errno = pthread_create(&w->preparer, NULL, preparerMain, w)) != 0) {
+        pthread_cond_destroy(&w->prepWake);
+        pthread_cond_destroy(&w->cond);
+        pthread_mutex_destroy(&w->mtx);
+        close(w->fd);
+        free(w->buf[0]);
+        free(w->buf[1]);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * leader 刷新活动缓冲区. 调用时持有锁且没有其他 leader,
+ * 写入和 fdatasync() 期间释放锁, 其他线程继续向另一个缓冲区追加记录.
+ */
+static void
+flushLocked(struct wal *w)
+{
+    char *buf = w->buf[w->active];
+    size_t len = w->len, done = 0;
+    uint64_t off = w->segOff, end = w->nextLsn;
+    int fd = w->fd, err = 0;
+    ssize_t n;
+
+    w->flushing = 1;
+    w->active ^= 1;
+    w->len = 0;
+    w->segOff += len;
+    pthread_mutex_unlock(&w->mtx);
+
+    while (done < len) {
+        if ((n = pwrite(fd, buf + done, len - done, off + done)) == -1) {
+            if (errno == EINTR)
+                continue;
+            err = errno;
+            break;
+        }
+        done += n;
+    }
+    if (err == 0 && len > 0 && fdatasync(fd) == -1)
+        err = errno;
+
+    pthread_mutex_lock(&w->mtx);
+    // fdatasync() 失败之后不能确定哪些数据已经落盘, 之后的操作全部失败
+    if (err != 0)
+        w->err = err;
+    else
+        w->durableLsn = end;
+    if (len > 0)
+        w->syncs++;
+    w->flushing = 0;
+    pthread_cond_broadcast(&w->cond);
+}
+
+/*
+ * 切换到下一个段. 调用时持有锁, 缓冲区为空且没有其他 leader,
+ * 即所有记录都已持久化. 通常后台线程已经准备好了临时文件, 只需写入头部并改名;
+ * 后台线程正在准备时等待它, 准备失败时同步创建. 写入段文件期间释放锁.
+ */
+static void
+switchLocked(struct wal *w)
+{
+    uint64_t segNo = w->segNo + 1, firstLsn = w->nextLsn;
+    int fd;
+
+    w->flushing = 1;
+    while (w->spareFd == -1 && w->preparing)
+        pthread_cond_wait(&w->cond, &w->mtx);
+    fd = w->spareFd;
+    w->spareFd = -1;
+    // 同步创建时后台线程不能同时准备同一个临时文件
+    if (fd == -1)
+        w->prepFailed = segNo + 1;
+    pthread_mutex_unlock(&w->mtx);
+    if (fd != -1)
+        fd = finishSegment(w->dir, fd, segNo, firstLsn);
+    else
+        fd = createSegment(w->dir, segNo, firstLsn);
+    pthread_mutex_lock(&w->mtx);
+    if (fd == -1) {
+        w->err = errno;
+    } else {
+        close(w->fd);
+        w->fd = fd;
+        w->segNo = segNo;
+        w->segOff = WAL_SEG_HEADER;
+        pthread_cond_signal(&w->prepWake);
+    }
+    w->flushing = 0;
+    pthread_cond_broadcast(&w->cond);
+}
+
+int
+walAppend(struct wal *w, const void *data, size_t len, uint64_t *lsn)
+{
+    struct walRecord *rec;
+    uint32_t dataCrc;
+    size_t need;
+
+    if (len > WAL_MAX_RECORD) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+    need = recordSize(len);
+    dataCrc = crc32c(0, data, len);
+
+    pthread_mutex_lock(&w->mtx);
+    for (;;) {
+        if (w->err != 0) {
+            pthread_mutex_unlock(&w->mtx);
+            errno = w->err;
+            return -1;
+        }
+        if (w->segOff + w->len + need <= WAL_SEG_SIZE && w->len + need <= WAL_BUF_SIZE)
+            break;
+        if (w->flushing)
+            pthread_cond_wait(&w->cond, &w->mtx);
+        else if (w->len > 0)
+            flushLocked(w);
+        else
+            switchLocked(w);
+    }
+
+    rec = (struct walRecord *)(w->buf[w->active] + w->len);
+    rec->len = len;
+    rec->lsn = w->nextLsn;
+    memcpy(rec + 1, data, len);
+    memset((char *)(rec + 1) + len, 0, need - sizeof(struct walRecord) - len);
+    rec->crc = recordCrc(dataCrc, rec);
+    *lsn = w->nextLsn++;
+    w->len += need;
+    pthread_mutex_unlock(&w->mtx);
+    return 0;
+}
+
+int
+walSync(struct wal *w, uint64_t lsn)
+{
+    int ret = 0;
+
+    pthread_mutex_lock(&w->mtx);
+    // 还没有分配的 LSN 永远不会持久化
+    if (lsn >= w->nextLsn) {
+        pthread_mutex_unlock(&w->mtx);
+        errno = EINVAL;
+        return -1;
+    }
+    while (w->durableLsn <= lsn && w->err == 0) {
+        if (w->flushing)
+            pthread_cond_wait(&w->cond, &w->mtx);
+        else
+            flushLocked(w);
+    }
+    if (w->durableLsn <= lsn) {
+        errno = w->err;
+        ret = -1;
+    }
+    pthread_mutex_unlock(&w->mtx);
+    return ret;
+}
+
+int
+walCommit(struct wal *w, const void *data, size_t len, uint64_t *lsn)
+{
+    if (walAppend(w, data, len, lsn) == -1)
+        return -1;
+    return walSync(w, *lsn);
+}
+
+int
+walTruncate(struct wal *w, uint64_t lsn)
+{
+    struct walSegHeader hdr;
+    char path[PATH_MAX + 32];
+    int fd, removed = 0, ret = 0;
+
+    pthread_mutex_lock(&w->mtx);
+    while (w->firstSegNo < w->segNo) {
+        // 下一个段的第一条记录不大于 lsn 时, 这个段中的记录都小于 lsn
+        if ((fd = openSegment(w->dir, w->firstSegNo + 1, &hdr)) == -1) {
+            ret = -1;
+            break;
+        }
+        close(fd);
+        if (hdr.firstLsn > lsn)
+            break;
+        segPath(w->dir, w->firstSegNo, "log", path, sizeof(path));
+        if (unlink(path) == -1) {
+            ret = -1;
+            break;
+        }
+        w->firstSegNo++;
+        removed = 1;
+    }
+    pthread_mutex_unlock(&w->mtx);
+
+    if (removed && fsyncDir(w->dir) == -1)
+        ret = -1;
+    return ret;
+}
+
+int
+walClose(struct wal *w)
+{
+    int ret = 0;
+
+    if (w->nextLsn > 0 && walSync(w, w->nextLsn - 1) == -1)
+        ret = -1;
+
+    pthread_mutex_lock(&w->mtx);
+    w->stop = 1;
+    pthread_cond_signal(&w->prepWake);
+    pthread_mutex_unlock(&w->mtx);
+    pthread_join(w->preparer, NULL);
+    if (w->spareFd != -1)
+        dropSpare(w, w->spareFd, w->segNo + 1);
+
+    if (close(w->fd) == -1)
+        ret = -1;
+    free(w->buf[0]);
+    free(w->buf[1]);
+    pthread_mutex_destroy(&w->mtx);
+    pthread_cond_destroy(&w->cond);
+    pthread_cond_destroy(&w->prepWake);
+    return ret;
+}
@@ -0,0 +1,166 @@
+/**
+ * @file wal.h
+ * @author Lock
+ * @date 16 Oct 2026
+ * @brief 组提交的预写日志(write-ahead log)
+ *
+ * 日志由一个目录中的若干段文件组成, 文件名为 `wal-<段号>.log`.
+ *
+ * # 记录格式
+ * 每条记录由 @ref walRecord 头部和数据组成, 按 8 字节对齐. 头部中的 CRC32C
+ * 覆盖 `len`, `lsn` 和数据. 记录不会跨越段文件, 段尾放不下时写入下一个段.
+ *
+ * # 组提交
+ * fdatasync() 的耗时远大于一次 write(). 多个线程并发提交时:
+ *   - walAppend() 只把记录复制到内存中的缓冲区, 并分配日志序号(LSN).
+ *   - walSync() 等待记录持久化. 如果当前没有线程在刷新, 调用者成为 leader,
+ *   把缓冲区中所有线程的记录用一次 pwrite() 和一次 fdatasync() 写入磁盘;
+ *   否则等待 leader 完成.
+ *   - leader 刷新期间, 其他线程写入另一个缓冲区, 由下一个 leader 一起刷新.
+ *
+ * # 预分配
+ * 段文件在创建时写满 0 并 fsync(), 然后才 rename() 为正式的文件名.
+ * 之后的写入既不改变文件大小, 也不需要分配磁盘块(fallocate() 分配的块处于未写入状态,
+ * 第一次写入时仍要修改元数据), fdatasync() 只需刷新数据.
+ *
+ * 写满 64 MiB 需要较长时间, 切换段期间所有追加都要等待. 所以后台线程在切换到段 N 之后
+ * 立即准备好段 N + 1 的临时文件(写满 0 并 fsync()). 切换时只需写入头部,
+ * fdatasync() 并 rename(). 只有写入速度超过准备速度, 切换时临时文件还没有准备好,
+ * 才等待后台线程; 后台线程准备失败时改为同步创建.
+ *
+ * # 恢复
+ * walOpen() 按顺序扫描所有段, 对每条有效的记录调用回调函数.
+ * 遇到校验和不正确, 长度不合理或 LSN 不连续的记录时停止, 这里之后的内容视为没有提交,
+ * 会被清零, 之后的段文件会被删除. 新的记录从这里继续写入.
+ *
+ * @example walBench.c
+ */
+#ifndef WAL_H
+#define WAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <limits.h>
+#include <pthread.h>
+
+#define WAL_SEG_MAGIC "WALSEG01"
+#define WAL_SEG_SIZE (64 * 1024 * 1024)     //!< 段文件大小
+#define WAL_SEG_HEADER 4096                 //!< 段文件头部大小
+#define WAL_BUF_SIZE (1024 * 1024)          //!< 每个组提交缓冲区的大小
+#define WAL_MAX_RECORD (WAL_BUF_SIZE - sizeof(struct walRecord))
+
+/**
+ * @brief 段文件头部
+ */
+struct walSegHeader {
+    char magic[8];              //!< @ref WAL_SEG_MAGIC
+    uint64_t segNo;             //!< 段号
+    uint64_t firstLsn;          //!< 段中第一条记录的 LSN
+    uint32_t crc;               //!< 前面字段的 CRC32C
+} __attribute__((packed));
+
+/**
+ * @brief 记录头部
+ */
+struct walRecord {
+    uint32_t crc;               //!< `len`, `lsn` 和数据的 CRC32C
+    uint32_t len;               //!< 数据长度, 不包括头部
+    uint64_t lsn;               //!< 日志序号, 从 0 开始连续递增
+};
+
+/**
+ * @brief 恢复时对每条记录调用的函数
+ */
+typedef void (*walReplayFn)(uint64_t lsn, const void *data, size_t len, void *arg);
+
+/**
+ * @brief 打开的日志
+ */
+struct wal {
+    char dir[PATH_MAX];
+    int fd;                     //!< 当前段文件
+    uint64_t firstSegNo;        //!< 最早的段号
+    uint64_t segNo;             //!< 当前段号
+    uint64_t segOff;            //!< 下一次刷新写入的文件偏移量
+
+    uint64_t nextLsn;           //!< 下一条记录的 LSN
+    uint64_t durableLsn;        //!< 小于该值的记录都已持久化
+
+    char *buf[2];               //!< 两个组提交缓冲区
+    int active;                 //!< 正在接收记录的缓冲区
+    size_t len;                 //!< 活动缓冲区中的字节数
+
+    int flushing;               //!< 是否有 leader 正在刷新或切换段
+    int err;                    //!< 刷新失败时的 errno, 之后的操作都会失败
+    pthread_mutex_t mtx;
+    pthread_cond_t cond;
+
+    pthread_t preparer;         //!< 准备下一个段文件的后台线程
+    pthread_cond_t prepWake;    //!< 唤醒后台线程
+    int spareFd;                //!< 准备好的段 segNo + 1 的临时文件, 没有时为 -1
+    int preparing;              //!< 后台线程正在准备段 segNo + 1
+    uint64_t prepFailed;        //!< 准备失败或者已经同步创建的段号 + 1, 后台线程跳过它
+    int stop;
+
+    uint64_t syncs;             //!< fdatasync() 次数
+};
+
+/**
+ * @brief 打开日志目录, 不存在时创建, 并恢复已有的记录
+ *
+ * @param w 日志
+ * @param dir 目录路径
+ * @param replay 恢复时对每条有效记录调用的函数, 可以为 NULL
+ * @param arg 传给 @p replay 的参数
+ *
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+int
+walOpen(struct wal *w, const char *dir, walReplayFn replay, void *arg);
+
+/**
+ * @brief 追加一条记录, 不等待持久化
+ *
+ * @param w 日志
+ * @param data 数据
+ * @param len 数据长度, 不超过 @ref WAL_MAX_RECORD
+ * @param lsn 用于返回记录的 LSN
+ *
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+int
+walAppend(struct wal *w, const void *data, size_t len, uint64_t *lsn);
+
+/**
+ * @brief 等待 LSN 不大于 @p lsn 的记录全部持久化
+ *
+ * @retval 0 成功
+ * @retval -1 失败, @p lsn 还没有分配时 errno 为 `EINVAL`
+ */
+int
+walSync(struct wal *w, uint64_t lsn);
+
+/**
+ * @brief 追加一条记录并等待持久化
+ */
+int
+walCommit(struct wal *w, const void *data, size_t len, uint64_t *lsn);
+
+/**
+ * @brief 删除所有记录的 LSN 都小于 @p lsn 的段文件, 通常在检查点之后调用
+ *
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+int
+walTruncate(struct wal *w, uint64_t lsn);
+
+/**
+ * @brief 刷新所有记录并关闭日志
+ */
+int
+walClose(struct wal *w);
+
+#endif
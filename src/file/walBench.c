@@ -0,0 +1,210 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <dirent.h>
+#include <pthread.h>
+#include "wal.h"
+
+/*
+ * 组提交测试
+ *
+ * 分别使用 1, 2, 4, ... 个写线程, 每个线程循环调用 walCommit() 提交固定大小的记录,
+ * 统计每秒提交次数, 每次 fdatasync() 合并的提交个数以及提交延迟.
+ * 最大延迟包括切换段文件时的等待, 用较大的记录(-s)可以在测试时间内写满多个段.
+ * 每一轮结束后重新打开日志, 检查恢复出的记录个数.
+ *
+ * 编译: gcc -O2 -pthread walBench.c wal.c ../lib/crc32c.c -o walBench
+ * 用法: walBench [-d dir] [-t seconds] [-w maxWriters] [-s recordSize]
+ */
+
+#define NBUCKETS 32             // 按微秒取 log2 的延迟直方图
+
+struct writer {
+    pthread_t tid;
+    struct wal *w;
+    size_t recSize;
+    long commits;
+    double latSum;
+    double latMax;
+    long hist[NBUCKETS];
+};
+
+static volatile int stop;
+
+void errExit(char *msg)
+{
+    extern int errno;
+    perror(msg);
+    exit(errno);
+}
+
+static double
+nowSec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *
+writerFunc(void *arg)
+{
+    struct writer *wr = arg;
+    char *data;
+    uint64_t lsn;
+    double start, lat;
+    int b;
+
+    if ((data = malloc(wr->recSize)) == NULL)
+        errExit("malloc");
+    memset(data, 'x', wr->recSize);
+
+    while (!stop) {
+        start = nowSec();
+        if (walCommit(wr->w, data, wr->recSize, &lsn) == -1)
+            errExit("walCommit");
+        lat = (nowSec() - start) * 1e6;
+        wr->latSum += lat;
+        if (lat > wr->latMax)
+            wr->latMax = lat;
+        for (b = 0; b < NBUCKETS - 1 && (1L << (b + 1)) <= lat; b++)
+            ;
+        wr->hist[b]++;
+        wr->commits++;
+    }
+    free(data);
+    return NULL;
+}
+
+/* 直方图的分位数, 返回所在桶的上界(微秒) */
+static long
+percentile(const long *hist, long total, double p)
+{
+    long seen = 0;
+    int b;
+
+    for (b = 0; b < NBUCKETS; b++) {
+        seen += hist[b];
+        if (seen >= total * p)
+            break;
+    }
+    return 1L << (b + 1);
+}
+
+static void
+countRecord(uint64_t lsn, const void *data, size_t len, void *arg)
+{
+    (void)lsn;
+    (void)data;
+    (void)len;
+    (*(long *)arg)++;
+}
+
+static void
+cleanDir(const char *dir)
+{
+    DIR *dirp;
+    struct dirent *dp;
+    char path[PATH_MAX + 256];
+
+    if ((dirp = opendir(dir)) == NULL)
+        return;
+    while ((dp = readdir(dirp)) != NULL)
+        if (strncmp(dp->d_name, "wal-", 4) == 0) {
+            snprintf(path, sizeof(path), "%s/%s", dir, dp->d_name);
+            unlink(path);
+        }
+    closedir(dirp);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const char *dir = "/tmp/walbench";
+    struct wal w;
+    struct writer *wrs;
+    long commits, replayed, hist[NBUCKETS];
+    double latSum, latMax, elapsed, start, seconds = 2;
+    size_t recSize = 128;
+    int maxWriters = 64, n, j, b, opt;
+
+    while ((opt = getopt(argc, argv, "d:t:w:s:")) != -1) {
+        switch (opt) {
+        case 'd': dir = optarg; break;
+        case 't': seconds = atof(optarg); break;
+        case 'w': maxWriters = atoi(optarg); break;
+        case 's': recSize = strtoul(optarg, NULL, 10); break;
+        default:
+            fprintf(stderr, "Usage: %s [-d dir] [-t seconds] [-w maxWriters] [-s recordSize]\n",
+                    argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (maxWriters < 1 || seconds <= 0 || recSize > WAL_MAX_RECORD) {
+        fprintf(stderr, "bad arguments\n");
+        exit(EXIT_FAILURE);
+    }
+    if ((wrs = calloc(maxWriters, sizeof(struct writer))) == NULL)
+        errExit("calloc");
+
+    printf("%7s %10s %10s %12s %9s %8s %8s %9s %9s\n", "writers", "commits/s", "syncs/s",
+            "commits/sync", "avg(us)", "p50(us)", "p99(us)", "max(us)", "replayed");
+
+    for (n = 1; n <= maxWriters; n *= 2) {
+        cleanDir(dir);
+        if (walOpen(&w, dir, NULL, NULL) == -1)
+            errExit("walOpen");
+
+        stop = 0;
+        memset(wrs, 0, n * sizeof(struct writer));
+        start = nowSec();
+        for (j = 0; j < n; j++) {
+            wrs[j].w = &w;
+            wrs[j].recSize = recSize;
+            errno = pthread_create(&wrs[j].tid, NULL, writerFunc, &wrs[j]);
+            if (errno != 0)
+                errExit("pthread_create");
+        }
+        usleep(seconds * 1e6);
+        stop = 1;
+        for (j = 0; j < n; j++)
+            pthread_join(wrs[j].tid, NULL);
+        elapsed = nowSec() - start;
+
+        commits = 0;
+        latSum = latMax = 0;
+        memset(hist, 0, sizeof(hist));
+        for (j = 0; j < n; j++) {
+            commits += wrs[j].commits;
+            latSum += wrs[j].latSum;
+            if (wrs[j].latMax > latMax)
+                latMax = wrs[j].latMax;
+            for (b = 0; b < NBUCKETS; b++)
+                hist[b] += wrs[j].hist[b];
+        }
+
+        printf("%7d %10.0f %10.0f %12.1f %9.1f %8ld %8ld %9.0f", n, commits / elapsed,
+                w.syncs / elapsed, (double)commits / w.syncs, latSum / commits,
+                percentile(hist, commits, 0.5), percentile(hist, commits, 0.99), latMax);
+        if (walClose(&w) == -1)
+            errExit("walClose");
+
+        // 恢复: 所有已提交的记录都应当能读回
+        replayed = 0;
+        if (walOpen(&w, dir, countRecord, &replayed) == -1)
+            errExit("walOpen");
+        walClose(&w);
+        printf(" %9ld%s\n", replayed, replayed == commits ? "" : " MISMATCH");
+        fflush(stdout);
+    }
+
+    cleanDir(dir);
+    rmdir(dir);
+    free(wrs);
+    exit(EXIT_SUCCESS);
+}
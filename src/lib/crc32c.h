@@ -0,0 +1,28 @@
+/* crc32c.h
+
+   Header file for crc32c.c.
+*/
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Update the CRC32C (Castagnoli) checksum 'crc' with 'len' bytes from 'buf'.
+   Start with crc == 0; the result of one call can be passed to the next to
+   checksum a buffer in pieces. Uses the SSE4.2 crc32 instruction when the
+   CPU has it, slicing-by-8 tables otherwise. */
+
+uint32_t crc32c(uint32_t crc, const void *buf, size_t len);
+
+/* Same result as crc32c(), always using the table-driven code */
+
+uint32_t crc32cSoftware(uint32_t crc, const void *buf, size_t len);
+
+/* Given crc1 = crc32c(0, A, lenA) and crc2 = crc32c(0, B, len2), return
+   crc32c(0, AB, lenA + len2). Lets threads checksum pieces of a buffer
+   independently and merge the results. */
+
+uint32_t crc32cCombine(uint32_t crc1, uint32_t crc2, size_t len2);
+
+#endif
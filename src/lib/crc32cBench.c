@@ -0,0 +1,166 @@
+/* crc32cBench.c
+
+   Measure CRC32C throughput in GB/s for a byte-at-a-time table, the
+   slicing-by-8 fallback and the dispatched implementation (SSE4.2 when
+   available), for several buffer sizes. Then checksum a large buffer with
+   several threads and merge the pieces with crc32cCombine().
+
+   Usage: crc32cBench [threads]
+
+   Build: gcc -O2 -pthread crc32cBench.c crc32c.c -o crc32cBench
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "crc32c.h"
+
+#define TOTAL (256L * 1024 * 1024)      /* Bytes checksummed per measurement */
+#define BIG (256L * 1024 * 1024)        /* Buffer for the parallel run */
+
+struct piece {
+    pthread_t tid;
+    const unsigned char *buf;
+    size_t len;
+    uint32_t crc;
+};
+
+static uint32_t byteTable[256];
+
+static uint32_t
+crcBytewise(uint32_t crc, const void *buf, size_t len)
+{
+    const unsigned char *p = buf;
+
+    crc = ~crc;
+    while (len-- > 0)
+        crc = (crc >> 8) ^ byteTable[(crc ^ *p++) & 0xff];
+    return ~crc;
+}
+
+static double
+nowSec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double
+measure(uint32_t (*fn)(uint32_t, const void *, size_t), const unsigned char *buf,
+        size_t size, long total, uint32_t *crc)
+{
+    double start;
+    long j, rounds = total / size;
+
+    start = nowSec();
+    for (j = 0; j < rounds; j++)
+        *crc = fn(*crc, buf, size);
+    return (double)rounds * size / (nowSec() - start) / 1e9;
+}
+
+static void *
+pieceFunc(void *arg)
+{
+    struct piece *pc = arg;
+
+    pc->crc = crc32c(0, pc->buf, pc->len);
+    return NULL;
+}
+
+int
+main(int argc, char *argv[])
+{
+    static const size_t sizes[] = { 64, 512, 4096, 65536, 1024 * 1024, 16 * 1024 * 1024 };
+    unsigned char *buf;
+    struct piece *pcs;
+    uint32_t c1, c2, c3, crc, whole;
+    size_t j, len, off, per;
+    int nthreads, k, s;
+    double start, t1;
+
+    nthreads = (argc > 1) ? atoi(argv[1]) : 4;
+    if (nthreads < 1) {
+        fprintf(stderr, "Usage: %s [threads]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    for (j = 0; j < 256; j++) {
+        crc = j;
+        for (k = 0; k < 8; k++)
+            crc = (crc >> 1) ^ (0x82f63b78 & -(crc & 1));
+        byteTable[j] = crc;
+    }
+
+    if ((buf = malloc(BIG + 8)) == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    srandom(1);
+    for (j = 0; j < BIG + 8; j++)
+        buf[j] = random();
+
+    /* Check all implementations against each other on odd lengths and
+       alignments, and check crc32cCombine() */
+
+    for (k = 0; k < 2000; k++) {
+        off = random() % 8;
+        len = random() % (k < 1000 ? 1000 : 100000);
+        c1 = crcBytewise(0, buf + off, len);
+        c2 = crc32cSoftware(0, buf + off, len);
+        c3 = crc32c(0, buf + off, len);
+        per = len ? random() % len : 0;
+        crc = crc32cCombine(crc32c(0, buf + off, per), crc32c(0, buf + off + per, len - per),
+                len - per);
+        if (c1 != c2 || c1 != c3 || c1 != crc) {
+            fprintf(stderr, "mismatch: len %zu off %zu: %08x %08x %08x %08x\n",
+                    len, off, c1, c2, c3, crc);
+            exit(EXIT_FAILURE);
+        }
+    }
+    printf("check \"123456789\": %08x (expect e3069283)\n\n", crc32c(0, "123456789", 9));
+
+    printf("%10s %10s %10s %10s\n", "size", "bytewise", "slice-8", "crc32c");
+    for (s = 0; s < (int)(sizeof(sizes) / sizeof(sizes[0])); s++) {
+        c1 = c2 = c3 = 0;
+        printf("%10zu", sizes[s]);
+        printf(" %10.2f", measure(crcBytewise, buf, sizes[s], TOTAL / 8, &c1));
+        printf(" %10.2f", measure(crc32cSoftware, buf, sizes[s], TOTAL, &c2));
+        printf(" %10.2f GB/s\n", measure(crc32c, buf, sizes[s], TOTAL * 4, &c3));
+    }
+
+    /* Parallel: each thread checksums a piece, pieces are merged in order */
+
+    start = nowSec();
+    whole = crc32c(0, buf, BIG);
+    t1 = nowSec() - start;
+
+    if ((pcs = calloc(nthreads, sizeof(struct piece))) == NULL) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    per = BIG / nthreads;
+    start = nowSec();
+    for (k = 0; k < nthreads; k++) {
+        pcs[k].buf = buf + k * per;
+        pcs[k].len = (k == nthreads - 1) ? BIG - k * per : per;
+        if (pthread_create(&pcs[k].tid, NULL, pieceFunc, &pcs[k]) != 0) {
+            perror("pthread_create");
+            exit(EXIT_FAILURE);
+        }
+    }
+    crc = 0;
+    for (k = 0; k < nthreads; k++) {
+        pthread_join(pcs[k].tid, NULL);
+        crc = crc32cCombine(crc, pcs[k].crc, pcs[k].len);
+    }
+    printf("\n1 thread: %.2f GB/s, %d threads + combine: %.2f GB/s (%s)\n",
+            BIG / t1 / 1e9, nthreads, BIG / (nowSec() - start) / 1e9,
+            crc == whole ? "match" : "MISMATCH");
+
+    free(pcs);
+    free(buf);
+    exit(EXIT_SUCCESS);
+}
@@ -36,23 +36,52 @@ terminate(Boolean useExit3)
       * outputting the caller-supplied error message specified in
         'format' and 'ap'. */
 
-static void
-outputError(Boolean useErr, int err, Boolean flushStdout,
-        const char *format, va_list ap)
-{
 #define BUF_SIZE 500
-    char buf[BUF_SIZE], userMsg[BUF_SIZE], errText[BUF_SIZE];
 
-    vsnprintf(userMsg, BUF_SIZE, format, ap);
+/* Append the string 's' to 'buf' (of size BUF_SIZE) at offset 'len',
+   truncating; return the new length */
 
-    if (useErr)
-        snprintf(errText, BUF_SIZE, " [%s %s]",
-                (err > 0 && err <= MAX_ENAME) ?
-                ename[err] : "?UNKNOWN?", strerror(err));
-    else
-        snprintf(errText, BUF_SIZE, ":");
+static size_t
+appendStr(char *buf, size_t len, const char *s)
+{
+    size_t n = strlen(s);
 
-    snprintf(buf, BUF_SIZE, "ERROR%s %s\n", errText, userMsg);
+    if (n > BUF_SIZE - 1 - len)
+        n = BUF_SIZE - 1 - len;
+    memcpy(buf + len, s, n);
+    return len + n;
+}
+
+/* The fixed parts of the message are copied directly; only the
+   caller's format goes through vsnprintf() */
+
+static void
+outputError(Boolean useErr, int err, Boolean flushStdout,
+        const char *format, va_list ap)
+{
+    char buf[BUF_SIZE];
+    size_t len;
+    int n;
+
+    len = appendStr(buf, 0, "ERROR");
+    if (useErr) {
+        len = appendStr(buf, len, " [");
+        len = appendStr(buf, len, (err > 0 && err <= MAX_ENAME) ?
+                ename[err] : "?UNKNOWN?");
+        len = appendStr(buf, len, " ");
+        len = appendStr(buf, len, strerror(err));
+        len = appendStr(buf, len, "]");
+    } else {
+        len = appendStr(buf, len, ":");
+    }
+    len = appendStr(buf, len, " ");
+
+    /* Keep room for the newline */
+    n = vsnprintf(buf + len, BUF_SIZE - 1 - len, format, ap);
+    if (n > 0)
+        len += min((size_t)n, BUF_SIZE - 2 - len);
+    buf[len++] = '\n';
+    buf[len] = '\0';
 
     if (flushStdout)
         fflush(stdout);       /* Flush any pending stdout */
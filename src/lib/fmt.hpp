@@ -0,0 +1,208 @@
+/* fmt.hpp
+
+   Type-safe "{}" formatting into caller buffers, built on fmt_num.c.
+   Requires C++20.
+
+   The format string is checked at compile time: the number of "{}"
+   placeholders must match the number of arguments, and a single '{' or
+   '}' must be written as "{{" or "}}". A mismatch is a compile error:
+
+       char buf[64];
+       size_t n = fmt::format(buf, "{} items, {} total\n", count, total);
+       fmt::format(buf, "{} items\n");          // Error: 1 placeholder, 0 args
+
+   Integers are formatted in decimal (plain char is written as a
+   character; signed char and unsigned char as numbers), float and double
+   as the shortest string that reads back exactly as that type (see
+   fmtFloat() and fmtDouble()), long double as double, bool as
+   "true"/"false"; C strings and std::string_view are copied. There
+   are no width, precision or locale options.
+
+   Like snprintf(), output is truncated to fit the buffer and always null
+   terminated (if size > 0), and the return value is the length the
+   complete output would have had.
+*/
+#ifndef FMT_HPP
+#define FMT_HPP
+
+#include <cstddef>
+#include <cstring>
+#include <concepts>
+#include <string_view>
+#include <type_traits>
+#include "fmt_num.h"
+
+namespace fmt {
+
+/* Bounded output buffer; 'len' keeps counting past the end */
+
+class Writer {
+public:
+    Writer(char *buf, size_t size) : buf_(buf), cap_(size > 0 ? size - 1 : 0) {}
+
+    void
+    put(const char *s, size_t n)
+    {
+        if (len_ < cap_)
+            std::memcpy(buf_ + len_, s, n < cap_ - len_ ? n : cap_ - len_);
+        len_ += n;
+    }
+
+    void
+    put(char c)
+    {
+        if (len_ < cap_)
+            buf_[len_] = c;
+        len_++;
+    }
+
+    size_t
+    finish(size_t size)
+    {
+        if (size > 0)
+            buf_[len_ < cap_ ? len_ : cap_] = '\0';
+        return len_;
+    }
+
+private:
+    char *buf_;
+    size_t cap_;
+    size_t len_ = 0;
+};
+
+template <typename T>
+concept Formattable =
+    std::integral<std::remove_cvref_t<T>> ||
+    std::floating_point<std::remove_cvref_t<T>> ||
+    std::convertible_to<T, std::string_view>;
+
+template <typename T>
+inline void
+writeArg(Writer &w, const T &v)
+{
+    using U = std::remove_cvref_t<T>;
+    char tmp[FMT_DOUBLE_MAX];
+
+    if constexpr (std::same_as<U, bool>) {
+        if (v)
+            w.put("true", 4);
+        else
+            w.put("false", 5);
+    } else if constexpr (std::same_as<U, char>) {
+        w.put(v);
+    } else if constexpr (std::integral<U> && std::is_signed_v<U>) {
+        w.put(tmp, fmtI64(tmp, v));
+    } else if constexpr (std::integral<U>) {
+        w.put(tmp, fmtU64(tmp, v));
+    } else if constexpr (std::same_as<U, float>) {
+        w.put(tmp, fmtFloat(tmp, v));
+    } else if constexpr (std::floating_point<U>) {
+        w.put(tmp, fmtDouble(tmp, v));
+    } else {
+        std::string_view s = v;
+        w.put(s.data(), s.size());
+    }
+}
+
+/* Not constexpr: calling it from a consteval function is the compile
+   error reported for a bad format string */
+
+inline void formatStringError(const char *) {}
+
+/* Count "{}" placeholders; -1 for a stray brace */
+
+consteval int
+countPlaceholders(std::string_view s)
+{
+    int n = 0;
+
+    for (size_t j = 0; j < s.size(); j++) {
+        if (s[j] == '{') {
+            if (j + 1 < s.size() && s[j + 1] == '{')
+                j++;
+            else if (j + 1 < s.size() && s[j + 1] == '}')
+                n++, j++;
+            else
+                return -1;
+        } else if (s[j] == '}') {
+            if (j + 1 < s.size() && s[j + 1] == '}')
+                j++;
+            else
+                return -1;
+        }
+    }
+    return n;
+}
+
+template <typename... Args>
+class FormatString {
+public:
+    template <size_t N>
+    consteval FormatString(const char (&s)[N]) : str_(s, N - 1)
+    {
+        int n = countPlaceholders(str_);
+
+        if (n < 0)
+            formatStringError("unmatched '{' or '}' in format string");
+        if (n != static_cast<int>(sizeof...(Args)))
+            formatStringError("number of {} does not match number of arguments");
+    }
+
+    constexpr std::string_view
+    get() const
+    {
+        return str_;
+    }
+
+private:
+    std::string_view str_;
+};
+
+/* Copy the literal text up to the next placeholder, unescaping "{{" and
+   "}}"; returns the position after the placeholder */
+
+inline size_t
+writeLiteral(Writer &w, std::string_view s, size_t pos)
+{
+    size_t start = pos;
+
+    while (pos < s.size()) {
+        if (s[pos] == '{' || s[pos] == '}') {
+            w.put(s.data() + start, pos - start);
+            if (s[pos] == '{' && s[pos + 1] == '}')
+                return pos + 2;
+            w.put(s[pos]);
+            pos += 2;
+            start = pos;
+        } else {
+            pos++;
+        }
+    }
+    w.put(s.data() + start, pos - start);
+    return pos;
+}
+
+template <Formattable... Args>
+inline size_t
+format(char *buf, size_t size, FormatString<std::type_identity_t<Args>...> fs,
+        const Args &...args)
+{
+    Writer w(buf, size);
+    std::string_view s = fs.get();
+    size_t pos = 0;
+
+    ((pos = writeLiteral(w, s, pos), writeArg(w, args)), ...);
+    writeLiteral(w, s, pos);
+    return w.finish(size);
+}
+
+template <size_t N, Formattable... Args>
+inline size_t
+format(char (&buf)[N], FormatString<std::type_identity_t<Args>...> fs, const Args &...args)
+{
+    return format(buf, N, fs, args...);
+}
+
+}  /* namespace fmt */
+
+#endif
@@ -0,0 +1,167 @@
+/* fmtBench.cpp
+
+   Compare snprintf() with fmt_num.c and fmt::format() for the reply
+   format of the sequence-number server ("%d\n"), for 64-bit integers of
+   every length, and for doubles (snprintf("%.17g") always round-trips
+   but is not shortest; fmtDouble() is shortest). Every output is checked
+   against snprintf()/strtod() before timing.
+
+   Usage: fmtBench [count]
+
+   Build: gcc -O2 -c fmt_num.c && g++ -std=c++20 -O2 fmtBench.cpp fmt_num.o -o fmtBench
+*/
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <ctime>
+#include "fmt.hpp"
+
+static double
+nowSec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t seed = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t
+nextRand(void)
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    return seed;
+}
+
+static volatile size_t sink;
+
+static double
+report(const char *name, double elapsed, long n, double base)
+{
+    double ns = elapsed * 1e9 / n;
+
+    if (base > 0)
+        printf("%-26s %8.2f ns/op %6.1fx\n", name, ns, base / ns);
+    else
+        printf("%-26s %8.2f ns/op\n", name, ns);
+    return ns;
+}
+
+template <typename Fn>
+static double
+timeLoop(long n, Fn fn)
+{
+    double start = nowSec();
+
+    for (long j = 0; j < n; j++)
+        sink = sink + fn(j);
+    return nowSec() - start;
+}
+
+static void
+checkInts(const int64_t *v, long n)
+{
+    char a[32], b[32];
+    size_t len;
+
+    for (long j = 0; j < n; j++) {
+        len = fmtI64(a, v[j]);
+        a[len] = '\0';
+        snprintf(b, sizeof(b), "%lld", (long long)v[j]);
+        if (strcmp(a, b) != 0) {
+            fprintf(stderr, "fmtI64 mismatch: %s vs %s\n", a, b);
+            exit(EXIT_FAILURE);
+        }
+        fmt::format(a, "{}\n", v[j]);
+        if (strncmp(a, b, strlen(b)) != 0 || strcmp(a + strlen(b), "\n") != 0) {
+            fprintf(stderr, "fmt::format mismatch: %s vs %s\n", a, b);
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+static void
+checkDoubles(const double *v, long n)
+{
+    char a[32], b[32];
+    size_t len;
+
+    for (long j = 0; j < n; j++) {
+        len = fmtDouble(a, v[j]);
+        a[len] = '\0';
+        len = fmtDoubleExact(b, v[j]);
+        b[len] = '\0';
+        if (strtod(a, NULL) != v[j] || strcmp(a, b) != 0) {
+            fprintf(stderr, "fmtDouble mismatch: %s vs exact %s\n", a, b);
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+int
+main(int argc, char *argv[])
+{
+    long n = (argc > 1) ? atol(argv[1]) : 5000000;
+    int64_t *small, *wide;
+    double *dbl, base;
+    uint64_t bits;
+    char buf[64];
+
+    if (n <= 0) {
+        fprintf(stderr, "count must be > 0\n");
+        exit(EXIT_FAILURE);
+    }
+    small = new int64_t[n];
+    wide = new int64_t[n];
+    dbl = new double[n];
+    for (long j = 0; j < n; j++) {
+        small[j] = nextRand() % 1000000;        /* Sequence numbers */
+        wide[j] = (int64_t)nextRand() >> (nextRand() % 64);
+        do {
+            bits = nextRand();
+            memcpy(&dbl[j], &bits, sizeof(double));
+        } while (dbl[j] != dbl[j] || dbl[j] - dbl[j] != 0);   /* Skip NaN and inf */
+        if (j & 1)
+            dbl[j] = (double)(nextRand() % 100000) / 100;     /* Prices */
+    }
+    checkInts(small, n);
+    checkInts(wide, n);
+    checkDoubles(dbl, n < 1000000 ? n : 1000000);
+
+    printf("int \"%%d\\n\", values < 10^6\n");
+    base = report("snprintf", timeLoop(n, [&](long j) {
+        return (size_t)snprintf(buf, sizeof(buf), "%d\n", (int)small[j]); }), n, 0);
+    report("fmtI64", timeLoop(n, [&](long j) {
+        size_t len = fmtI64(buf, small[j]);
+        buf[len] = '\n';
+        return len + 1; }), n, base);
+    report("fmt::format", timeLoop(n, [&](long j) {
+        return fmt::format(buf, "{}\n", small[j]); }), n, base);
+
+    printf("int64, all lengths\n");
+    base = report("snprintf", timeLoop(n, [&](long j) {
+        return (size_t)snprintf(buf, sizeof(buf), "%lld", (long long)wide[j]); }), n, 0);
+    report("fmtI64", timeLoop(n, [&](long j) {
+        return fmtI64(buf, wide[j]); }), n, base);
+
+    printf("double, random bits and prices\n");
+    base = report("snprintf %.17g", timeLoop(n, [&](long j) {
+        return (size_t)snprintf(buf, sizeof(buf), "%.17g", dbl[j]); }), n, 0);
+    report("snprintf %g", timeLoop(n, [&](long j) {
+        return (size_t)snprintf(buf, sizeof(buf), "%g", dbl[j]); }), n, base);
+    report("fmtDouble", timeLoop(n, [&](long j) {
+        return fmtDouble(buf, dbl[j]); }), n, base);
+    report("fmt::format", timeLoop(n, [&](long j) {
+        return fmt::format(buf, "{} {}\n", small[j], dbl[j]); }), n, base);
+    report("fmtDoubleExact", timeLoop(n / 10, [&](long j) {
+        return fmtDoubleExact(buf, dbl[j]); }), n / 10, base);
+
+    delete[] small;
+    delete[] wide;
+    delete[] dbl;
+    return 0;
+}
@@ -0,0 +1,575 @@
+/* fmt_num.c
+
+   Locale-independent integer and floating-point formatting.
+
+   Integers are converted without data-dependent loops, since with mixed
+   lengths the loop exits are mispredicted on almost every call. The
+   digit count comes from the bit length, and the only branch is between
+   values of up to 8 digits and longer ones:
+     - up to 8 digits are converted in a 64-bit register with SWAR
+       (SIMD within a register) arithmetic, shifted so the first
+       significant digit is the lowest byte, and stored as 8 bytes;
+     - longer values are split into three 8-digit groups (divisions by
+       constants, so multiplications), each written as four pairs from a
+       200-byte table of "00".."99" into a zero-padded scratch area, and
+       the last 'n' digits are copied out with one fixed-size copy from
+       a variable offset.
+   Both stores may go past the digits, which is why the integer functions
+   need FMT_INT_MAX bytes.
+
+   Doubles use Grisu3 (Florian Loitsch, "Printing Floating-Point Numbers
+   Quickly and Accurately with Integers", PLDI 2010): the value and the
+   boundaries of its rounding interval are scaled into [2^-60, 2^-32)
+   by a cached 64-bit power of ten, and digits are generated until the
+   remainder falls inside the interval. Grisu3 knows when the imprecision
+   of the 64-bit arithmetic might make its result wrong or not the
+   shortest; that happens for about 0.5% of doubles, which then take the
+   exact (and much slower) snprintf()/strtod() search.
+
+   Floats go through the same digit generation with the (much wider)
+   rounding interval of the float, and fall back to a search that reads
+   back with strtof(), so 0.1f is "0.1" rather than the digits of the
+   double it converts to.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fmt_num.h"
+
+static const char digitPairs[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static const uint64_t pow10Table[20] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+    100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL,
+    1000000000000ULL, 10000000000000ULL, 100000000000000ULL,
+    1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL,
+    1000000000000000000ULL, 10000000000000000000ULL
+};
+
+/* Number of decimal digits in 'v': log10(2) ~= 1233 / 4096 gives the
+   count from the bit length, off by at most one */
+
+static inline int
+countDigits(uint64_t v)
+{
+    int t = ((64 - __builtin_clzll(v | 1)) * 1233) >> 12;
+
+    return t + 1 - (v < pow10Table[t]);
+}
+
+/* Exactly 8 digits of 'v' < 10^8, with no data-dependent branches */
+
+static inline void
+write8(char *p, uint32_t v)
+{
+    uint32_t hi = v / 10000, lo = v % 10000;
+
+    memcpy(p, digitPairs + (hi / 100) * 2, 2);
+    memcpy(p + 2, digitPairs + (hi % 100) * 2, 2);
+    memcpy(p + 4, digitPairs + (lo / 100) * 2, 2);
+    memcpy(p + 6, digitPairs + (lo % 100) * 2, 2);
+}
+
+/* The 8 digits of 'v' < 10^8 as characters, the first in the lowest
+   byte: two 4-digit halves in 32-bit lanes are split into pairs in
+   16-bit lanes (n / 100 == (n * 5243) >> 19 for n < 10^4), then into
+   digits in bytes (n / 10 == (n * 103) >> 10 for n < 100) */
+
+static inline uint64_t
+swar8(uint32_t v)
+{
+    uint64_t x, q, t;
+
+    x = (v / 10000) | ((uint64_t)(v % 10000) << 32);
+    q = ((x * 5243) >> 19) & 0x0000007f0000007fULL;
+    x = q | ((x - q * 100) << 16);
+    t = ((x * 103) >> 10) & 0x000f000f000f000fULL;
+    x = t | ((x - t * 10) << 8);
+    return x + 0x3030303030303030ULL;
+}
+
+/* Digits of 'v' into 'buf', writing at most 'width' bytes (at least 8
+   and at least the digit count of 'v'). The 24 digits of the three
+   groups end at tmp + 24; the copy may read up to 20 bytes past that. */
+
+static inline size_t
+writeU64(char *buf, uint64_t v, size_t width)
+{
+    char tmp[48];
+    size_t n = countDigits(v) + (v == 0);      /* countDigits(0) is 0 */
+    uint64_t r, x;
+
+    if (v < 100000000) {
+        x = swar8(v) >> (8 * (8 - n));
+        memcpy(buf, &x, 8);
+        return n;
+    }
+    memset(tmp + 24, 0, 24);
+    r = v % 10000000000000000ULL;
+    write8(tmp, v / 10000000000000000ULL);
+    write8(tmp + 8, r / 100000000);
+    write8(tmp + 16, r % 100000000);
+    memcpy(buf, tmp + 24 - n, width);
+    return n;
+}
+
+size_t
+fmtU64(char *buf, uint64_t v)
+{
+    return writeU64(buf, v, FMT_INT_MAX);
+}
+
+/* Half of mixed values are negative, so the sign is not a branch: the
+   '-' is always written, and overwritten by the digits if 'v' >= 0 */
+
+size_t
+fmtI64(char *buf, int64_t v)
+{
+    size_t neg = v < 0;
+    uint64_t mag = neg ? 0 - (uint64_t)v : (uint64_t)v;
+
+    /* The magnitude has at most 19 digits */
+    buf[0] = '-';
+    return neg + writeU64(buf + neg, mag, FMT_INT_MAX - 1);
+}
+
+/* A 64-bit significand and a binary exponent: f * 2^e */
+
+struct diyFp {
+    uint64_t f;
+    int e;
+};
+
+/* Normalized powers of ten 10^k for k = -348, -340, ..., 340:
+   significand rounded to nearest, binary exponent, k. Generated with
+   exact rational arithmetic. */
+
+static const struct {
+    uint64_t f;
+    int16_t e;
+    int16_t k;
+} cachedPowers[] = {
+    { 0xfa8fd5a0081c0288ULL, -1220, -348 },
+    { 0xbaaee17fa23ebf76ULL, -1193, -340 },
+    { 0x8b16fb203055ac76ULL, -1166, -332 },
+    { 0xcf42894a5dce35eaULL, -1140, -324 },
+    { 0x9a6bb0aa55653b2dULL, -1113, -316 },
+    { 0xe61acf033d1a45dfULL, -1087, -308 },
+    { 0xab70fe17c79ac6caULL, -1060, -300 },
+    { 0xff77b1fcbebcdc4fULL, -1034, -292 },
+    { 0xbe5691ef416bd60cULL, -1007, -284 },
+    { 0x8dd01fad907ffc3cULL,  -980, -276 },
+    { 0xd3515c2831559a83ULL,  -954, -268 },
+    { 0x9d71ac8fada6c9b5ULL,  -927, -260 },
+    { 0xea9c227723ee8bcbULL,  -901, -252 },
+    { 0xaecc49914078536dULL,  -874, -244 },
+    { 0x823c12795db6ce57ULL,  -847, -236 },
+    { 0xc21094364dfb5637ULL,  -821, -228 },
+    { 0x9096ea6f3848984fULL,  -794, -220 },
+    { 0xd77485cb25823ac7ULL,  -768, -212 },
+    { 0xa086cfcd97bf97f4ULL,  -741, -204 },
+    { 0xef340a98172aace5ULL,  -715, -196 },
+    { 0xb23867fb2a35b28eULL,  -688, -188 },
+    { 0x84c8d4dfd2c63f3bULL,  -661, -180 },
+    { 0xc5dd44271ad3cdbaULL,  -635, -172 },
+    { 0x936b9fcebb25c996ULL,  -608, -164 },
+    { 0xdbac6c247d62a584ULL,  -582, -156 },
+    { 0xa3ab66580d5fdaf6ULL,  -555, -148 },
+    { 0xf3e2f893dec3f126ULL,  -529, -140 },
+    { 0xb5b5ada8aaff80b8ULL,  -502, -132 },
+    { 0x87625f056c7c4a8bULL,  -475, -124 },
+    { 0xc9bcff6034c13053ULL,  -449, -116 },
+    { 0x964e858c91ba2655ULL,  -422, -108 },
+    { 0xdff9772470297ebdULL,  -396, -100 },
+    { 0xa6dfbd9fb8e5b88fULL,  -369,  -92 },
+    { 0xf8a95fcf88747d94ULL,  -343,  -84 },
+    { 0xb94470938fa89bcfULL,  -316,  -76 },
+    { 0x8a08f0f8bf0f156bULL,  -289,  -68 },
+    { 0xcdb02555653131b6ULL,  -263,  -60 },
+    { 0x993fe2c6d07b7facULL,  -236,  -52 },
+    { 0xe45c10c42a2b3b06ULL,  -210,  -44 },
+    { 0xaa242499697392d3ULL,  -183,  -36 },
+    { 0xfd87b5f28300ca0eULL,  -157,  -28 },
+    { 0xbce5086492111aebULL,  -130,  -20 },
+    { 0x8cbccc096f5088ccULL,  -103,  -12 },
+    { 0xd1b71758e219652cULL,   -77,   -4 },
+    { 0x9c40000000000000ULL,   -50,    4 },
+    { 0xe8d4a51000000000ULL,   -24,   12 },
+    { 0xad78ebc5ac620000ULL,     3,   20 },
+    { 0x813f3978f8940984ULL,    30,   28 },
+    { 0xc097ce7bc90715b3ULL,    56,   36 },
+    { 0x8f7e32ce7bea5c70ULL,    83,   44 },
+    { 0xd5d238a4abe98068ULL,   109,   52 },
+    { 0x9f4f2726179a2245ULL,   136,   60 },
+    { 0xed63a231d4c4fb27ULL,   162,   68 },
+    { 0xb0de65388cc8ada8ULL,   189,   76 },
+    { 0x83c7088e1aab65dbULL,   216,   84 },
+    { 0xc45d1df942711d9aULL,   242,   92 },
+    { 0x924d692ca61be758ULL,   269,  100 },
+    { 0xda01ee641a708deaULL,   295,  108 },
+    { 0xa26da3999aef774aULL,   322,  116 },
+    { 0xf209787bb47d6b85ULL,   348,  124 },
+    { 0xb454e4a179dd1877ULL,   375,  132 },
+    { 0x865b86925b9bc5c2ULL,   402,  140 },
+    { 0xc83553c5c8965d3dULL,   428,  148 },
+    { 0x952ab45cfa97a0b3ULL,   455,  156 },
+    { 0xde469fbd99a05fe3ULL,   481,  164 },
+    { 0xa59bc234db398c25ULL,   508,  172 },
+    { 0xf6c69a72a3989f5cULL,   534,  180 },
+    { 0xb7dcbf5354e9beceULL,   561,  188 },
+    { 0x88fcf317f22241e2ULL,   588,  196 },
+    { 0xcc20ce9bd35c78a5ULL,   614,  204 },
+    { 0x98165af37b2153dfULL,   641,  212 },
+    { 0xe2a0b5dc971f303aULL,   667,  220 },
+    { 0xa8d9d1535ce3b396ULL,   694,  228 },
+    { 0xfb9b7cd9a4a7443cULL,   720,  236 },
+    { 0xbb764c4ca7a44410ULL,   747,  244 },
+    { 0x8bab8eefb6409c1aULL,   774,  252 },
+    { 0xd01fef10a657842cULL,   800,  260 },
+    { 0x9b10a4e5e9913129ULL,   827,  268 },
+    { 0xe7109bfba19c0c9dULL,   853,  276 },
+    { 0xac2820d9623bf429ULL,   880,  284 },
+    { 0x80444b5e7aa7cf85ULL,   907,  292 },
+    { 0xbf21e44003acdd2dULL,   933,  300 },
+    { 0x8e679c2f5e44ff8fULL,   960,  308 },
+    { 0xd433179d9c8cb841ULL,   986,  316 },
+    { 0x9e19db92b4e31ba9ULL,  1013,  324 },
+    { 0xeb96bf6ebadf77d9ULL,  1039,  332 },
+    { 0xaf87023b9bf0ee6bULL,  1066,  340 },
+};
+
+#define CACHED_POWERS_OFFSET 348        /* -k of the first entry */
+#define CACHED_POWERS_STEP 8
+#define MIN_TARGET_EXP (-60)            /* Scaled exponent range for digit generation */
+
+#define HIDDEN_BIT (1ULL << 52)
+#define FLOAT_HIDDEN_BIT (1U << 23)
+
+static inline struct diyFp
+diyMul(struct diyFp a, struct diyFp b)
+{
+    unsigned __int128 p = (unsigned __int128)a.f * b.f;
+    struct diyFp r;
+
+    r.f = (uint64_t)(p >> 64) + ((uint64_t)p >> 63);     /* Round half up */
+    r.e = a.e + b.e + 64;
+    return r;
+}
+
+static inline struct diyFp
+diyNormalize(struct diyFp a)
+{
+    int shift = __builtin_clzll(a.f);
+
+    a.f <<= shift;
+    a.e -= shift;
+    return a;
+}
+
+/* Shrink the last digit while that moves the result closer to w (whose
+   distance to the upper end of the unsafe interval is 'distTooHighW'),
+   then check that the result is provably inside the safe interval and
+   provably the closest candidate. 'unit' is the possible error. */
+
+static int
+roundWeed(char *digits, int len, uint64_t distTooHighW, uint64_t unsafeInterval,
+        uint64_t rest, uint64_t tenKappa, uint64_t unit)
+{
+    uint64_t smallDist = distTooHighW - unit;
+    uint64_t bigDist = distTooHighW + unit;
+
+    while (rest < smallDist && unsafeInterval - rest >= tenKappa &&
+            (rest + tenKappa < smallDist ||
+             smallDist - rest >= rest + tenKappa - smallDist)) {
+        digits[len - 1]--;
+        rest += tenKappa;
+    }
+
+    /* Another candidate could be closer to w; can't decide */
+    if (rest < bigDist && unsafeInterval - rest >= tenKappa &&
+            (rest + tenKappa < bigDist ||
+             bigDist - rest > rest + tenKappa - bigDist))
+        return 0;
+
+    return 2 * unit <= rest && rest <= unsafeInterval - 4 * unit;
+}
+
+/* Generate the shortest digits of a number in (low, high), closest to w.
+   All three share the exponent, which is in [-60, -32]. */
+
+static int
+digitGen(struct diyFp low, struct diyFp w, struct diyFp high, char *digits,
+        int *len, int *kappa)
+{
+    uint64_t unit = 1;
+    uint64_t tooLow = low.f - unit, tooHigh = high.f + unit;
+    uint64_t unsafeInterval = tooHigh - tooLow;
+    int shift = -w.e;
+    uint64_t one = 1ULL << shift;
+    uint32_t integrals = tooHigh >> shift;
+    uint64_t fractionals = tooHigh & (one - 1);
+    uint64_t divisor, rest;
+    int k;
+
+    for (k = 0, divisor = 1; divisor * 10 <= integrals; k++)
+        divisor *= 10;
+    *kappa = k + 1;
+    *len = 0;
+
+    while (*kappa > 0) {
+        digits[(*len)++] = '0' + integrals / divisor;
+        integrals %= divisor;
+        (*kappa)--;
+        rest = ((uint64_t)integrals << shift) + fractionals;
+        if (rest < unsafeInterval)
+            return roundWeed(digits, *len, tooHigh - w.f, unsafeInterval, rest,
+                    divisor << shift, unit);
+        divisor /= 10;
+    }
+
+    for (;;) {
+        fractionals *= 10;
+        unit *= 10;
+        unsafeInterval *= 10;
+        digits[(*len)++] = '0' + (fractionals >> shift);
+        fractionals &= one - 1;
+        (*kappa)--;
+        if (fractionals < unsafeInterval)
+            return roundWeed(digits, *len, (tooHigh - w.f) * unit, unsafeInterval,
+                    fractionals, one, unit);
+    }
+}
+
+/* Shortest digits of a positive finite value w = w.f * 2^w.e, whose
+   rounding interval is narrower below if 'narrowLow' (a power of two
+   that is not the smallest normal): w = digits * 10^decExp. Returns 0
+   if the result can't be guaranteed. */
+
+static int
+grisu3(struct diyFp w, int narrowLow, char *digits, int *len, int *decExp)
+{
+    struct diyFp plus, minus, c;
+    int minExp, k, idx, kappa, ok;
+    double x;
+
+    /* Rounding interval (minus, plus) */
+    plus.f = (w.f << 1) + 1;
+    plus.e = w.e - 1;
+    plus = diyNormalize(plus);
+    if (narrowLow) {
+        minus.f = (w.f << 2) - 1;
+        minus.e = w.e - 2;
+    } else {
+        minus.f = (w.f << 1) - 1;
+        minus.e = w.e - 1;
+    }
+    minus.f <<= minus.e - plus.e;
+    minus.e = plus.e;
+    w = diyNormalize(w);
+
+    /* Cached power c = 10^-k such that w * c has an exponent in
+       [MIN_TARGET_EXP, MIN_TARGET_EXP + 28] */
+    minExp = MIN_TARGET_EXP - (w.e + 64);
+    x = (minExp + 63) * 0.30102999566398114;
+    k = (int)x;
+    if (x > k)
+        k++;
+    idx = (CACHED_POWERS_OFFSET + k - 1) / CACHED_POWERS_STEP + 1;
+    c.f = cachedPowers[idx].f;
+    c.e = cachedPowers[idx].e;
+
+    ok = digitGen(diyMul(minus, c), diyMul(w, c), diyMul(plus, c), digits, len, &kappa);
+    *decExp = kappa - cachedPowers[idx].k;
+    return ok;
+}
+
+static int
+grisu3Double(double v, char *digits, int *len, int *decExp)
+{
+    struct diyFp w;
+    uint64_t bits;
+    int biased;
+
+    memcpy(&bits, &v, sizeof(bits));
+    biased = (bits >> 52) & 0x7ff;
+    w.f = bits & (HIDDEN_BIT - 1);
+    if (biased == 0) {
+        w.e = -1074;
+    } else {
+        w.f |= HIDDEN_BIT;
+        w.e = biased - 1075;
+    }
+    return grisu3(w, w.f == HIDDEN_BIT && biased > 1, digits, len, decExp);
+}
+
+/* Same for a float: the interval is that of the float, which is much
+   wider than the 64-bit arithmetic's error, so this rarely fails */
+
+static int
+grisu3Float(float v, char *digits, int *len, int *decExp)
+{
+    struct diyFp w;
+    uint32_t bits;
+    int biased;
+
+    memcpy(&bits, &v, sizeof(bits));
+    biased = (bits >> 23) & 0xff;
+    w.f = bits & (FLOAT_HIDDEN_BIT - 1);
+    if (biased == 0) {
+        w.e = -149;
+    } else {
+        w.f |= FLOAT_HIDDEN_BIT;
+        w.e = biased - 150;
+    }
+    return grisu3(w, w.f == FLOAT_HIDDEN_BIT && biased > 1, digits, len, decExp);
+}
+
+/* Exact fallback: the shortest precision whose correctly rounded
+   output reads back as 'v' (with strtof() if 'isFloat') */
+
+static void
+exactDigits(double v, int isFloat, char *digits, int *len, int *decExp)
+{
+    char tmp[32], *p;
+    int prec, n;
+
+    for (prec = 0; prec < 17; prec++) {
+        snprintf(tmp, sizeof(tmp), "%.*e", prec, v);
+        if (isFloat ? strtof(tmp, NULL) == (float)v : strtod(tmp, NULL) == v)
+            break;
+    }
+
+    n = 0;
+    for (p = tmp; *p != 'e'; p++)
+        if (*p != '.')
+            digits[n++] = *p;
+    *len = n;
+    *decExp = atoi(p + 1) - (n - 1);
+}
+
+/* Write digits * 10^decExp in plain or exponent notation */
+
+static size_t
+layout(char *buf, const char *digits, int len, int decExp)
+{
+    int k, sciExp, j;
+    char *p = buf;
+
+    while (len > 1 && digits[len - 1] == '0') {
+        len--;
+        decExp++;
+    }
+    k = len + decExp;           /* Position of the decimal point */
+    sciExp = k - 1;
+
+    if (sciExp >= -5 && sciExp < 17) {
+        if (k <= 0) {
+            *p++ = '0';
+            *p++ = '.';
+            for (j = k; j < 0; j++)
+                *p++ = '0';
+            memcpy(p, digits, len);
+            p += len;
+        } else if (k >= len) {
+            memcpy(p, digits, len);
+            p += len;
+            for (j = len; j < k; j++)
+                *p++ = '0';
+        } else {
+            memcpy(p, digits, k);
+            p += k;
+            *p++ = '.';
+            memcpy(p, digits + k, len - k);
+            p += len - k;
+        }
+        return p - buf;
+    }
+
+    *p++ = digits[0];
+    if (len > 1) {
+        *p++ = '.';
+        memcpy(p, digits + 1, len - 1);
+        p += len - 1;
+    }
+    *p++ = 'e';
+    *p++ = (sciExp < 0) ? '-' : '+';
+    if (sciExp < 0)
+        sciExp = -sciExp;
+    if (sciExp >= 100)
+        *p++ = '0' + sciExp / 100;
+    *p++ = digitPairs[(sciExp % 100) * 2];
+    *p++ = digitPairs[(sciExp % 100) * 2 + 1];
+    return p - buf;
+}
+
+/* Sign, zero, infinity and NaN; returns -1 for other values */
+
+static int
+special(char *buf, double *v, size_t *n)
+{
+    *n = 0;
+    if (*v != *v) {
+        memcpy(buf, "nan", 3);
+        *n = 3;
+        return 1;
+    }
+    if (__builtin_signbit(*v)) {
+        buf[(*n)++] = '-';
+        *v = -*v;
+    }
+    if (*v == 0) {
+        buf[(*n)++] = '0';
+        return 1;
+    }
+    if (__builtin_isinf(*v)) {
+        memcpy(buf + *n, "inf", 3);
+        *n += 3;
+        return 1;
+    }
+    return 0;
+}
+
+size_t
+fmtDouble(char *buf, double v)
+{
+    char digits[20];
+    int len, decExp;
+    size_t n;
+
+    if (special(buf, &v, &n))
+        return n;
+    if (!grisu3Double(v, digits, &len, &decExp))
+        exactDigits(v, 0, digits, &len, &decExp);
+    return n + layout(buf + n, digits, len, decExp);
+}
+
+size_t
+fmtDoubleExact(char *buf, double v)
+{
+    char digits[20];
+    int len, decExp;
+    size_t n;
+
+    if (special(buf, &v, &n))
+        return n;
+    exactDigits(v, 0, digits, &len, &decExp);
+    return n + layout(buf + n, digits, len, decExp);
+}
+
+size_t
+fmtFloat(char *buf, float v)
+{
+    char digits[20];
+    int len, decExp;
+    double d = v;
+    size_t n;
+
+    if (special(buf, &d, &n))
+        return n;
+    if (!grisu3Float((float)d, digits, &len, &decExp))
+        exactDigits(d, 1, digits, &len, &decExp);
+    return n + layout(buf + n, digits, len, decExp);
+}
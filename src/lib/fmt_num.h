@@ -0,0 +1,56 @@
+/* fmt_num.h
+
+   Header file for fmt_num.c.
+
+   Locale-independent number formatting into caller buffers. None of the
+   functions write a terminating null byte; they return the number of
+   characters written. fmtU64() and fmtI64() need FMT_INT_MAX bytes of
+   space and may overwrite bytes of it past the returned length.
+*/
+#ifndef FMT_NUM_H
+#define FMT_NUM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FMT_INT_MAX     20      /* Longest fmtU64()/fmtI64() output */
+#define FMT_DOUBLE_MAX  24      /* Longest fmtDouble()/fmtFloat() output */
+
+/* Decimal representation of 'v', like printf("%" PRIu64) */
+
+size_t fmtU64(char *buf, uint64_t v);
+
+/* Decimal representation of 'v', like printf("%" PRId64) */
+
+size_t fmtI64(char *buf, int64_t v);
+
+/* Shortest decimal representation of 'v' that reads back (with strtod())
+   as exactly 'v'. Plain notation is used for decimal exponents from -5
+   to 16, e.g. "0.001", "123.25", "1e+17"; otherwise the output looks
+   like printf("%e") without trailing zeros, e.g. "1.5e-07". Infinities
+   and NaN are written as "inf", "-inf" and "nan". */
+
+size_t fmtDouble(char *buf, double v);
+
+/* Same as fmtDouble(), always using the slow exact search (tries
+   snprintf("%.*e") with increasing precision until strtod() gives back
+   'v'). Used when the fast algorithm cannot prove its result shortest,
+   and by the benchmark to check the fast path. */
+
+size_t fmtDoubleExact(char *buf, double v);
+
+/* Same as fmtDouble() for a float: the shortest representation that
+   reads back (with strtof()) as exactly 'v', e.g. "0.1" for 0.1f where
+   fmtDouble() would give "0.10000000149011612" */
+
+size_t fmtFloat(char *buf, float v);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,198 @@
+/* getNumBench.c
+
+   Throughput of getLongs() against a strtol() loop with the same checks,
+   in millions of values per second, for short (< 1000), mixed-length
+   and 19-digit values, with some negative numbers. The results of the
+   two parsers are compared, and a few malformed inputs are checked for
+   the reported error and position.
+
+   Usage: getNumBench [values]
+
+   Build: gcc -O2 getNumBench.c get_num.c -o getNumBench
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <stdint.h>
+#include "get_num.h"
+
+static double
+nowSec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t seed = 88172645463325252ULL;
+
+static uint64_t
+nextRand(void)
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    return seed;
+}
+
+/* Text of 'n' values separated by spaces and newlines; 'kind' 0 is
+   short, 1 mixed length, 2 full 19-digit values */
+
+static char *
+makeText(long n, int kind, size_t *len)
+{
+    char *text, *p;
+    long v, j;
+
+    if ((text = malloc(n * 22 + 1)) == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    p = text;
+    for (j = 0; j < n; j++) {
+        if (kind == 0)
+            v = nextRand() % 1000;
+        else if (kind == 1)
+            v = (long)(nextRand() >> 1) >> (nextRand() % 63);
+        else
+            v = 1000000000000000000L + (long)(nextRand() % 8000000000000000000UL);
+        if (nextRand() % 8 == 0)
+            v = -v;
+        p += sprintf(p, "%ld%c", v, (j % 16 == 15) ? '\n' : ' ');
+    }
+    *len = p - text;
+    return text;
+}
+
+/* The loop getNum() would need for a buffer: strtol() plus the checks
+   for overflow and trailing garbage */
+
+static long
+strtolAll(const char *text, long *out, long max)
+{
+    const char *p = text;
+    char *endptr;
+    long n = 0;
+
+    while (n < max) {
+        while (*p == ' ' || *p == '\n')
+            p++;
+        if (*p == '\0')
+            break;
+        errno = 0;
+        out[n] = strtol(p, &endptr, 10);
+        if (errno != 0 || endptr == p ||
+                (*endptr != ' ' && *endptr != '\n' && *endptr != '\0')) {
+            fprintf(stderr, "strtol failed at offset %ld\n", (long)(p - text));
+            exit(EXIT_FAILURE);
+        }
+        p = endptr;
+        n++;
+    }
+    return n;
+}
+
+static void
+checkError(const char *text, int flags, int expErr, size_t expPos)
+{
+    struct gnBulk res;
+    long out[8];
+
+    getLongs(text, strlen(text), flags, out, 8, &res);
+    if (res.err != expErr || res.pos != expPos) {
+        fprintf(stderr, "\"%s\": got %s at %zu, expected %s at %zu\n", text,
+                gnErrStr(res.err), res.pos, gnErrStr(expErr), expPos);
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void
+checkErrors(void)
+{
+    struct gnBulk res;
+    long l[4];
+    int i[4];
+
+    checkError("12 34 5x6", 0, GN_ERR_DIGIT, 7);
+    checkError("1,2,,3\n", 0, 0, 7);
+    checkError("9223372036854775807 -9223372036854775808", 0, 0, 40);
+    checkError("1 9223372036854775808", 0, GN_ERR_RANGE, 2);
+    checkError("1 -9223372036854775809", 0, GN_ERR_RANGE, 2);
+    checkError("1 123456789012345678901234", 0, GN_ERR_RANGE, 2);
+    checkError("00000000000000000000000042", 0, 0, 26);
+    checkError("3 -1", GN_NONNEG, GN_ERR_NONNEG, 2);
+    checkError("3 0", GN_GT_0, GN_ERR_GT_0, 2);
+    checkError("- 1", 0, GN_ERR_DIGIT, 1);
+    checkError("ff 0x1F 19", GN_BASE_16, 0, 10);
+    checkError("0x1f 017 9", GN_ANY_BASE, 0, 10);
+    checkError("017 018", GN_ANY_BASE, GN_ERR_DIGIT, 6);
+
+    if (getLongs("0x1f 017 9", 10, GN_ANY_BASE, l, 4, &res) == -1 ||
+            res.count != 3 || l[0] != 31 || l[1] != 15 || l[2] != 9) {
+        fprintf(stderr, "GN_ANY_BASE values wrong\n");
+        exit(EXIT_FAILURE);
+    }
+    if (getInts("2147483647 2147483648", 21, 0, i, 4, &res) != -1 ||
+            res.err != GN_ERR_RANGE || res.pos != 11 || res.count != 1) {
+        fprintf(stderr, "getInts range check wrong\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+int
+main(int argc, char *argv[])
+{
+    static const char *kinds[] = { "short", "mixed", "19-digit" };
+    struct gnBulk res;
+    long n, got, *a, *b;
+    double start, tStrtol, tBulk;
+    size_t len;
+    char *text;
+    int kind;
+
+    n = (argc > 1) ? atol(argv[1]) : 10000000;
+    if (n <= 0) {
+        fprintf(stderr, "values must be > 0\n");
+        exit(EXIT_FAILURE);
+    }
+    checkErrors();
+
+    a = malloc(n * sizeof(long));
+    b = malloc(n * sizeof(long));
+    if (a == NULL || b == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    printf("%-9s %8s %14s %14s %8s\n", "values", "MB", "strtol Mval/s",
+            "getLongs Mval/s", "speedup");
+    for (kind = 0; kind < 3; kind++) {
+        text = makeText(n, kind, &len);
+
+        start = nowSec();
+        got = strtolAll(text, a, n);
+        tStrtol = nowSec() - start;
+
+        start = nowSec();
+        if (getLongs(text, len, 0, b, n, &res) == -1) {
+            fprintf(stderr, "getLongs: %s at offset %zu\n", gnErrStr(res.err), res.pos);
+            exit(EXIT_FAILURE);
+        }
+        tBulk = nowSec() - start;
+
+        if (got != n || (long)res.count != n || memcmp(a, b, n * sizeof(long)) != 0) {
+            fprintf(stderr, "%s: results differ\n", kinds[kind]);
+            exit(EXIT_FAILURE);
+        }
+        printf("%-9s %8.1f %14.1f %14.1f %7.1fx\n", kinds[kind], len / 1e6,
+                n / tStrtol / 1e6, n / tBulk / 1e6, tStrtol / tBulk);
+        free(text);
+    }
+
+    free(a);
+    free(b);
+    exit(EXIT_SUCCESS);
+}
@@ -7,6 +7,7 @@
 #include <string.h>
 #include <limits.h>
 #include <errno.h>
+#include <stdint.h>
 #include "get_num.h"
 /* Print a diagnostic message that contains a function name ('fname'),
    the value of a command-line argument ('arg'), the name of that
@@ -85,3 +86,214 @@ getInt(const char *arg, int flags, const char *name)
 
     return (int) res;
 }
+/* Bulk parsing.
+
+   Decimal fields are converted with SWAR (SIMD within a register)
+   arithmetic: 8 input bytes are loaded into a 64-bit word, the number of
+   leading digit bytes is found with a few masks and a count-trailing-zeros,
+   and up to 8 digits are combined into their value with three
+   multiplications, pairing 1-digit, then 2-digit, then 4-digit groups.
+   Fields of more than 8 digits take one more step per 8 digits. Other
+   bases are parsed one character at a time. */
+
+static const unsigned char delimTable[256] = {
+    [' '] = 1, ['\t'] = 1, ['\n'] = 1, ['\r'] = 1, [','] = 1
+};
+
+static const uint64_t pow10Table[9] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000
+};
+
+/* Number of leading ASCII digits in the 8 bytes of 'x' (the first byte
+   is the lowest). A byte is a digit if its high nibble is 3 and adding
+   6 does not carry out of the low nibble; a carry between bytes can
+   only start at a byte that already failed the first test. */
+
+static inline int
+leadingDigits(uint64_t x)
+{
+    uint64_t nd, m;
+
+    nd = ((x & 0xf0f0f0f0f0f0f0f0ULL) ^ 0x3030303030303030ULL) |
+        (((x + 0x0606060606060606ULL) & 0xf0f0f0f0f0f0f0f0ULL) ^ 0x3030303030303030ULL);
+    m = (nd | ((nd & 0x7f7f7f7f7f7f7f7fULL) + 0x7f7f7f7f7f7f7f7fULL)) &
+        0x8080808080808080ULL;
+    return (m == 0) ? 8 : __builtin_ctzll(m) >> 3;
+}
+
+/* Value of the first 'n' (1 to 8) digits in 'x'. Shifting them to the
+   top fills the low bytes with zero digits. */
+
+static inline uint64_t
+convertDigits(uint64_t x, int n)
+{
+    x <<= 8 * (8 - n);
+    x = (x & 0x0f0f0f0f0f0f0f0fULL) * 2561 >> 8;
+    x = (x & 0x00ff00ff00ff00ffULL) * 6553601 >> 16;
+    return (x & 0x0000ffff0000ffffULL) * 42949672960001ULL >> 32;
+}
+
+static int
+parseDecimal(const char **pp, const char *end, uint64_t *mag)
+{
+    const char *p = *pp;
+    uint64_t v = 0, x;
+    int n, total = 0;
+
+    do {
+        if (end - p >= 8) {
+            memcpy(&x, p, 8);
+        } else {
+            x = 0;              /* Zero bytes are not digits */
+            memcpy(&x, p, end - p);
+        }
+        n = leadingDigits(x);
+        if (n == 0)
+            break;
+        if (total + n <= 19) {
+            v = v * pow10Table[n] + convertDigits(x, n);
+        } else if (__builtin_mul_overflow(v, pow10Table[n], &v) ||
+                __builtin_add_overflow(v, convertDigits(x, n), &v)) {
+            *pp = p;
+            return GN_ERR_RANGE;
+        }
+        total += n;
+        p += n;
+    } while (n == 8);
+
+    *pp = p;
+    if (total == 0)
+        return GN_ERR_DIGIT;
+    *mag = v;
+    return 0;
+}
+
+static int
+parseBase(const char **pp, const char *end, int base, uint64_t *mag)
+{
+    const char *p = *pp;
+    uint64_t v = 0;
+    int d, ndigits = 0;
+    char c;
+
+    /* Prefixes as accepted by strtol() */
+    if ((base == 0 || base == 16) && end - p > 2 && p[0] == '0' &&
+            (p[1] | 0x20) == 'x') {
+        p += 2;
+        base = 16;
+    } else if (base == 0) {
+        base = (p < end && *p == '0') ? 8 : 10;
+    }
+
+    for (; p < end; p++, ndigits++) {
+        c = *p;
+        if (c >= '0' && c <= '9')
+            d = c - '0';
+        else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f')
+            d = (c | 0x20) - 'a' + 10;
+        else
+            break;
+        if (d >= base)
+            break;
+        if (__builtin_mul_overflow(v, (uint64_t)base, &v) ||
+                __builtin_add_overflow(v, (uint64_t)d, &v)) {
+            *pp = p;
+            return GN_ERR_RANGE;
+        }
+    }
+
+    *pp = p;
+    if (ndigits == 0)
+        return GN_ERR_DIGIT;
+    *mag = v;
+    return 0;
+}
+
+/* Common loop of getLongs() and getInts(): values must be in [lo, hi],
+   and are stored in 'outL' or 'outI', whichever is not NULL */
+
+static int
+bulkParse(const char *buf, size_t len, int flags, long lo, long hi,
+        long *outL, int *outI, size_t maxOut, struct gnBulk *res)
+{
+    const char *p = buf, *end = buf + len, *field;
+    uint64_t mag;
+    size_t count = 0;
+    int base, neg, err;
+    long v;
+
+    base = (flags & GN_ANY_BASE) ? 0 : (flags & GN_BASE_8) ? 8 :
+                        (flags & GN_BASE_16) ? 16 : 10;
+
+    for (;;) {
+        while (p < end && delimTable[(unsigned char)*p])
+            p++;
+        if (p == end || count == maxOut)
+            break;
+
+        field = p;
+        neg = (*p == '-');
+        if (*p == '-' || *p == '+')
+            p++;
+
+        err = (base == 10) ? parseDecimal(&p, end, &mag) : parseBase(&p, end, base, &mag);
+        if (err == 0 && p < end && !delimTable[(unsigned char)*p])
+            err = GN_ERR_DIGIT;
+
+        if (err == 0) {
+            if (mag > (neg ? (uint64_t)-(lo + 1) + 1 : (uint64_t)hi)) {
+                err = GN_ERR_RANGE;
+            } else {
+                v = neg ? (long)(0 - mag) : (long)mag;
+                if ((flags & GN_NONNEG) && v < 0)
+                    err = GN_ERR_NONNEG;
+                else if ((flags & GN_GT_0) && v <= 0)
+                    err = GN_ERR_GT_0;
+            }
+        }
+
+        if (err != 0) {
+            res->count = count;
+            res->pos = ((err == GN_ERR_DIGIT) ? p : field) - buf;
+            res->err = err;
+            return -1;
+        }
+
+        if (outL != NULL)
+            outL[count++] = v;
+        else
+            outI[count++] = (int) v;
+    }
+
+    res->count = count;
+    res->pos = p - buf;
+    res->err = 0;
+    return 0;
+}
+
+int
+getLongs(const char *buf, size_t len, int flags, long *out, size_t maxOut,
+        struct gnBulk *res)
+{
+    return bulkParse(buf, len, flags, LONG_MIN, LONG_MAX, out, NULL, maxOut, res);
+}
+
+int
+getInts(const char *buf, size_t len, int flags, int *out, size_t maxOut,
+        struct gnBulk *res)
+{
+    return bulkParse(buf, len, flags, INT_MIN, INT_MAX, NULL, out, maxOut, res);
+}
+
+const char *
+gnErrStr(int err)
+{
+    switch (err) {
+    case 0:             return "no error";
+    case GN_ERR_DIGIT:  return "nonnumeric characters";
+    case GN_ERR_RANGE:  return "integer out of range";
+    case GN_ERR_NONNEG: return "negative value not allowed";
+    case GN_ERR_GT_0:   return "value must be > 0";
+    default:            return "unknown error";
+    }
+}
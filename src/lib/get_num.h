@@ -5,6 +5,8 @@
 #ifndef GET_NUM_H
 #define GET_NUM_H
 
+#include <stddef.h>
+
 #define GN_NONNEG       01      /* Value must be >= 0 */
 #define GN_GT_0         02      /* Value must be > 0 */
 
@@ -17,4 +19,41 @@ long getLong(const char *arg, int flags, const char *name);
 
 int getInt(const char *arg, int flags, const char *name);
 
+/* Bulk parsing of delimited integers (getLongs(), getInts()). Fields are
+   separated by runs of spaces, tabs, newlines, carriage returns and
+   commas; each field is an optional sign followed by digits in the base
+   selected by 'flags'. Errors are reported instead of terminating the
+   process. */
+
+#define GN_ERR_DIGIT    1       /* Nonnumeric character */
+#define GN_ERR_RANGE    2       /* Value out of range for the result type */
+#define GN_ERR_NONNEG   3       /* Negative value with GN_NONNEG */
+#define GN_ERR_GT_0     4       /* Value <= 0 with GN_GT_0 */
+
+struct gnBulk {
+    size_t count;               /* Number of values stored */
+    size_t pos;                 /* Offset of the first byte not consumed;
+                                   on error, of the offending character
+                                   (GN_ERR_DIGIT) or field (others) */
+    int err;                    /* 0 or GN_ERR_* */
+};
+
+/* Parse the fields in buf[0..len) into 'out' (at most 'maxOut' values).
+   The last field ends at 'len'; when reading a file in chunks, pass only
+   up to the last delimiter of each chunk. Returns 0 when all input was
+   parsed or 'out' is full, -1 on the first invalid field; details are in
+   'res'. Decimal input is converted 8 digits at a time. */
+
+int getLongs(const char *buf, size_t len, int flags, long *out, size_t maxOut,
+        struct gnBulk *res);
+
+/* Same as getLongs(), with values limited to the range of int */
+
+int getInts(const char *buf, size_t len, int flags, int *out, size_t maxOut,
+        struct gnBulk *res);
+
+/* Description of a GN_ERR_* code */
+
+const char *gnErrStr(int err);
+
 #endif
@@ -0,0 +1,263 @@
+/* lz_block.c
+
+   LZ77 block compression, with the LZ4 block layout. The compressed
+   block is a series of sequences:
+
+       token     high 4 bits: literal count, low 4 bits: match length - 4;
+                 15 in either field means more length bytes follow
+       [length]  255, 255, ..., last (< 255), added to the literal count
+       literals
+       offset    2 bytes little-endian, distance back to the match (1..65535)
+       [length]  extra match length bytes, as above
+
+   The last sequence has only literals and ends the block. As in LZ4, the
+   last 5 bytes are always literals and no match starts in the last 12,
+   so the decoder's fast paths may copy 8 or 16 bytes at a time.
+
+   The compressor is greedy: a 16K-entry hash table of 4-byte sequences
+   gives one candidate per position, and after a run of misses it skips
+   ahead faster (1 byte per step for the first 64 misses, 2 for the next
+   64, ...), so incompressible data goes through quickly.
+*/
+#include <string.h>
+#include <stdint.h>
+#include "lz_block.h"
+
+#define MIN_MATCH 4
+#define MF_LIMIT 12             /* No match starts in the last 12 bytes */
+#define LAST_LITERALS 5         /* The last 5 bytes are always literals */
+#define MAX_OFFSET 65535
+#define HASH_LOG 14
+#define SKIP_TRIGGER 6
+
+static inline uint32_t
+read32(const void *p)
+{
+    uint32_t v;
+
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static inline uint64_t
+read64(const void *p)
+{
+    uint64_t v;
+
+    memcpy(&v, p, 8);
+    return v;
+}
+
+static inline uint32_t
+hash4(uint32_t v)
+{
+    return (v * 2654435761u) >> (32 - HASH_LOG);
+}
+
+/* Number of equal bytes at 'a' and 'b', stopping at 'limit' (for 'a') */
+
+static inline size_t
+matchLength(const uint8_t *a, const uint8_t *b, const uint8_t *limit)
+{
+    const uint8_t *start = a;
+    uint64_t diff;
+
+    while (a + 8 <= limit) {
+        diff = read64(a) ^ read64(b);
+        if (diff != 0)
+            return a - start + (__builtin_ctzll(diff) >> 3);
+        a += 8;
+        b += 8;
+    }
+    while (a < limit && *a == *b) {
+        a++;
+        b++;
+    }
+    return a - start;
+}
+
+static inline uint8_t *
+writeLength(uint8_t *op, size_t len)
+{
+    while (len >= 255) {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = len;
+    return op;
+}
+
+size_t
+lzCompress(const void *src, size_t n, void *dst, size_t cap)
+{
+    uint32_t table[1 << HASH_LOG];
+    const uint8_t *base = src, *ip = base, *anchor = base, *ref;
+    const uint8_t *iend = base + n, *mfLimit = iend - MF_LIMIT, *matchLimit = iend - LAST_LITERALS;
+    uint8_t *op = dst, *oend = op + cap, *token;
+    size_t litLen, mlen;
+    uint32_t h, attempts, step;
+
+    if (n < MF_LIMIT + 1)
+        goto last;
+    memset(table, 0, sizeof(table));
+    ip++;
+
+    for (;;) {
+        /* Find the next match */
+        attempts = 1 << SKIP_TRIGGER;
+        step = 1;
+        for (;;) {
+            h = hash4(read32(ip));
+            ref = base + table[h];
+            table[h] = ip - base;
+            if (ip - ref <= MAX_OFFSET && read32(ref) == read32(ip))
+                break;
+            ip += step;
+            step = attempts++ >> SKIP_TRIGGER;
+            if (ip > mfLimit)
+                goto last;
+        }
+
+        /* Extend the match backwards over pending literals */
+        while (ip > anchor && ref > base && ip[-1] == ref[-1]) {
+            ip--;
+            ref--;
+        }
+
+        litLen = ip - anchor;
+        if ((size_t)(oend - op) < 1 + litLen / 255 + 1 + litLen + 2 + LAST_LITERALS + 1)
+            return 0;
+        token = op++;
+        if (litLen >= 15) {
+            *token = 15 << 4;
+            op = writeLength(op, litLen - 15);
+        } else {
+            *token = litLen << 4;
+        }
+        memcpy(op, anchor, litLen);
+        op += litLen;
+
+        *op++ = (ip - ref) & 0xff;
+        *op++ = (ip - ref) >> 8;
+
+        mlen = matchLength(ip + MIN_MATCH, ref + MIN_MATCH, matchLimit);
+        ip += MIN_MATCH + mlen;
+        if (mlen >= 15) {
+            if ((size_t)(oend - op) < mlen / 255 + 1 + LAST_LITERALS + 1)
+                return 0;
+            *token |= 15;
+            op = writeLength(op, mlen - 15);
+        } else {
+            *token |= mlen;
+        }
+        anchor = ip;
+        if (ip > mfLimit)
+            break;
+        /* Also index a position inside the match just written */
+        table[hash4(read32(ip - 2))] = ip - 2 - base;
+    }
+
+last:
+    litLen = iend - anchor;
+    if ((size_t)(oend - op) < 1 + litLen / 255 + 1 + litLen)
+        return 0;
+    token = op++;
+    if (litLen >= 15) {
+        *token = 15 << 4;
+        op = writeLength(op, litLen - 15);
+    } else {
+        *token = litLen << 4;
+    }
+    memcpy(op, anchor, litLen);
+    op += litLen;
+    return op - (uint8_t *)dst;
+}
+
+/* Read an extended length; returns 0 on truncated input or overflow */
+
+static inline int
+readLength(const uint8_t **ipp, const uint8_t *iend, size_t *len, size_t max)
+{
+    const uint8_t *ip = *ipp;
+    unsigned b;
+
+    do {
+        if (ip >= iend)
+            return 0;
+        b = *ip++;
+        *len += b;
+        if (*len > max)
+            return 0;
+    } while (b == 255);
+    *ipp = ip;
+    return 1;
+}
+
+ssize_t
+lzDecompress(const void *src, size_t n, void *dst, size_t cap)
+{
+    const uint8_t *ip = src, *iend = ip + n, *match;
+    uint8_t *base = dst, *op = base, *oend = op + cap;
+    size_t len, off, d, c;
+    unsigned token;
+
+    for (;;) {
+        if (ip >= iend)
+            return -1;
+        token = *ip++;
+
+        /* Literals; short runs are copied 16 bytes at a time */
+        len = token >> 4;
+        if (len == 15 && !readLength(&ip, iend, &len, cap))
+            return -1;
+        if (len <= 16 && iend - ip >= 16 && oend - op >= 16) {
+            memcpy(op, ip, 16);
+        } else {
+            if (len > (size_t)(iend - ip) || len > (size_t)(oend - op))
+                return -1;
+            memcpy(op, ip, len);
+        }
+        op += len;
+        ip += len;
+        if (ip == iend)
+            break;
+
+        /* Match */
+        if (iend - ip < 2)
+            return -1;
+        off = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (off == 0 || off > (size_t)(op - base))
+            return -1;
+        match = op - off;
+        len = token & 15;
+        if (len == 15 && !readLength(&ip, iend, &len, cap))
+            return -1;
+        len += MIN_MATCH;
+        if (len > (size_t)(oend - op))
+            return -1;
+
+        if (off >= 16 && len <= 16 && oend - op >= 16) {
+            memcpy(op, match, 16);
+        } else if (off >= 8 && (size_t)(oend - op) >= len + 8) {
+            /* 8 bytes at a time: with offset >= 8 every byte read has
+               already been written */
+            for (c = 0; c < len; c += 8)
+                memcpy(op + c, match + c, 8);
+        } else {
+            /* Short offset (a repeating pattern) or too close to the end
+               of the buffer: copy one period byte by byte, then keep
+               doubling the copied prefix, which never overlaps */
+            c = (off < len) ? off : len;
+            for (d = 0; d < c; d++)
+                op[d] = match[d];
+            while (c < len) {
+                d = (c < len - c) ? c : len - c;
+                memcpy(op + c, op, d);
+                c += d;
+            }
+        }
+        op += len;
+    }
+    return op - base;
+}
@@ -0,0 +1,33 @@
+/* lz_block.h
+
+   Header file for lz_block.c.
+
+   A byte-oriented LZ77 block codec in the style of LZ4: no entropy
+   coding, 64 KiB window, each block compressed and decompressed
+   independently of every other block.
+*/
+#ifndef LZ_BLOCK_H
+#define LZ_BLOCK_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/* Largest compressed size of 'n' input bytes (incompressible data grows
+   by one byte per 255, plus a few bytes of framing) */
+
+#define LZ_BOUND(n) ((n) + (n) / 255 + 16)
+
+/* Compress 'n' bytes from 'src' into 'dst', which has room for 'cap'
+   bytes. Returns the compressed size, or 0 if it does not fit in 'cap';
+   with cap >= LZ_BOUND(n) it always fits. */
+
+size_t lzCompress(const void *src, size_t n, void *dst, size_t cap);
+
+/* Decompress 'n' bytes from 'src' into 'dst', which has room for 'cap'
+   bytes. Returns the decompressed size, or -1 if the input is malformed
+   or would decompress to more than 'cap' bytes. Never reads or writes
+   outside the given buffers, whatever the input. */
+
+ssize_t lzDecompress(const void *src, size_t n, void *dst, size_t cap);
+
+#endif
@@ -0,0 +1,360 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "connPool.h"
+
+#define SLAB_MIN_SIZE (64 * 1024)
+#define SLAB_MIN_OBJS 8
+#define OBJ_ALIGN 16
+
+/*
+ * slab 头部位于 slab 的起始位置, 因为 slab 按 slabSize 对齐,
+ * 任意对象的地址与 ~(slabSize - 1) 相与即可得到它所在的 slab
+ */
+struct slab {
+    struct slab *prev;
+    struct slab *next;
+    unsigned freeMark;          /* objPoolTrim() 统计空闲对象时使用 */
+};
+
+#define SLAB_HDR_SIZE ((sizeof(struct slab) + OBJ_ALIGN - 1) & ~(size_t)(OBJ_ALIGN - 1))
+
+struct poolCache {
+    void *head;
+    unsigned count;
+};
+
+static struct objPool *pools[OBJ_POOL_MAX];
+static int npools;
+static pthread_mutex_t poolsLock = PTHREAD_MUTEX_INITIALIZER;
+
+static __thread struct poolCache tcache[OBJ_POOL_MAX];
+static __thread int tcacheRegistered;
+
+static pthread_key_t tcacheKey;
+static pthread_once_t tcacheOnce = PTHREAD_ONCE_INIT;
+
+static inline void *
+nextOf(void *obj)
+{
+    return *(void **)obj;
+}
+
+static inline void
+setNext(void *obj, void *next)
+{
+    *(void **)obj = next;
+}
+
+/* 把 cache 中的前 n 个对象移入全局仓库 */
+static void
+depotPush(struct objPool *pool, struct poolCache *c, unsigned n)
+{
+    void *first, *last;
+    unsigned j;
+
+    if (n == 0)
+        return;
+
+    first = last = c->head;
+    for (j = 1; j < n; j++)
+        last = nextOf(last);
+    c->head = nextOf(last);
+    c->count -= n;
+
+    pthread_mutex_lock(&pool->lock);
+    setNext(last, pool->depot);
+    pool->depot = first;
+    pool->depotCount += n;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/* 线程退出时把所有缓存归还全局仓库, 否则这些对象将无法再被使用 */
+static void
+tcacheDestructor(void *arg)
+{
+    struct poolCache *cache = arg;
+    int j;
+
+    for (j = 0; j < OBJ_POOL_MAX; j++)
+        if (pools[j] != NULL && cache[j].count > 0)
+            depotPush(pools[j], &cache[j], cache[j].count);
+}
+
+static void
+tcacheKeyCreate(void)
+{
+    pthread_key_create(&tcacheKey, tcacheDestructor);
+}
+
+static struct poolCache *
+getCache(struct objPool *pool)
+{
+    if (!tcacheRegistered) {
+        pthread_once(&tcacheOnce, tcacheKeyCreate);
+        pthread_setspecific(tcacheKey, tcache);
+        tcacheRegistered = 1;
+    }
+    return &tcache[pool->id];
+}
+
+static size_t
+roundUpPow2(size_t n)
+{
+    size_t p = 1;
+
+    while (p < n)
+        p <<= 1;
+    return p;
+}
+
+int
+objPoolInit(struct objPool *pool, size_t objSize)
+{
+    memset(pool, 0, sizeof(struct objPool));
+
+    if (objSize < sizeof(void *))
+        objSize = sizeof(void *);
+    pool->objSize = (objSize + OBJ_ALIGN - 1) & ~(size_t)(OBJ_ALIGN - 1);
+    pool->slabSize = roundUpPow2(SLAB_HDR_SIZE + pool->objSize * SLAB_MIN_OBJS);
+    if (pool->slabSize < SLAB_MIN_SIZE)
+        pool->slabSize = SLAB_MIN_SIZE;
+    pool->objsPerSlab = (pool->slabSize - SLAB_HDR_SIZE) / pool->objSize;
+
+    errno = pthread_mutex_init(&pool->lock, NULL);
+    if (errno != 0)
+        return -1;
+
+    pthread_mutex_lock(&poolsLock);
+    if (npools == OBJ_POOL_MAX) {
+        pthread_mutex_unlock(&poolsLock);
+        pthread_mutex_destroy(&pool->lock);
+        errno = ENOSPC;
+        return -1;
+    }
+    pool->id = npools;
+    pools[npools++] = pool;
+    pthread_mutex_unlock(&poolsLock);
+
+    return 0;
+}
+
+/*
+ * 分配一个按 slabSize 对齐的 slab: 多映射 slabSize 字节, 再把首尾多余的部分释放掉
+ */
+static struct slab *
+slabCreate(struct objPool *pool)
+{
+    char *raw, *base;
+    size_t head;
+
+    raw = mmap(NULL, pool->slabSize * 2, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED)
+        return NULL;
+
+    base = (char *)(((uintptr_t)raw + pool->slabSize - 1) & ~(uintptr_t)(pool->slabSize - 1));
+    head = base - raw;
+    if (head > 0)
+        munmap(raw, head);
+    munmap(base + pool->slabSize, pool->slabSize - head);
+
+    return (struct slab *)base;
+}
+
+/* 仓库为空时调用, 调用者持有 pool->lock */
+static int
+depotGrow(struct objPool *pool)
+{
+    struct slab *s;
+    char *obj;
+    unsigned j;
+
+    if ((s = slabCreate(pool)) == NULL)
+        return -1;
+
+    s->prev = NULL;
+    s->next = pool->slabs;
+    if (pool->slabs != NULL)
+        pool->slabs->prev = s;
+    pool->slabs = s;
+    pool->nslabs++;
+    pool->slabAllocs++;
+
+    obj = (char *)s + SLAB_HDR_SIZE;
+    for (j = 0; j < pool->objsPerSlab; j++, obj += pool->objSize) {
+        setNext(obj, pool->depot);
+        pool->depot = obj;
+    }
+    pool->depotCount += pool->objsPerSlab;
+
+    return 0;
+}
+
+void *
+objPoolAlloc(struct objPool *pool)
+{
+    struct poolCache *c = getCache(pool);
+    void *obj;
+    unsigned j;
+
+    if (c->head == NULL) {
+        // 从全局仓库一次取一批, 摊薄加锁的开销
+        pthread_mutex_lock(&pool->lock);
+        if (pool->depot == NULL && depotGrow(pool) == -1) {
+            pthread_mutex_unlock(&pool->lock);
+            errno = ENOMEM;
+            return NULL;
+        }
+        for (j = 0; j < OBJ_POOL_BATCH && pool->depot != NULL; j++) {
+            obj = pool->depot;
+            pool->depot = nextOf(obj);
+            setNext(obj, c->head);
+            c->head = obj;
+        }
+        pool->depotCount -= j;
+        c->count += j;
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    obj = c->head;
+    c->head = nextOf(obj);
+    c->count--;
+    return obj;
+}
+
+void
+objPoolFree(struct objPool *pool, void *obj)
+{
+    struct poolCache *c = getCache(pool);
+
+    setNext(obj, c->head);
+    c->head = obj;
+    c->count++;
+
+    if (c->count >= OBJ_POOL_BATCH * 2)
+        depotPush(pool, c, OBJ_POOL_BATCH);
+}
+
+static inline struct slab *
+slabOf(struct objPool *pool, void *obj)
+{
+    return (struct slab *)((uintptr_t)obj & ~(uintptr_t)(pool->slabSize - 1));
+}
+
+size_t
+objPoolTrim(struct objPool *pool)
+{
+    struct poolCache *c = getCache(pool);
+    struct slab *s, *next;
+    void *obj, **pp;
+    size_t freed = 0;
+
+    depotPush(pool, c, c->count);
+
+    pthread_mutex_lock(&pool->lock);
+
+    // 第一遍: 统计每个 slab 中位于仓库里的空闲对象个数
+    for (s = pool->slabs; s != NULL; s = s->next)
+        s->freeMark = 0;
+    for (obj = pool->depot; obj != NULL; obj = nextOf(obj))
+        slabOf(pool, obj)->freeMark++;
+
+    // 第二遍: 把完全空闲的 slab 中的对象从仓库链表中摘除
+    for (pp = &pool->depot; *pp != NULL; ) {
+        if (slabOf(pool, *pp)->freeMark == pool->objsPerSlab) {
+            *pp = nextOf(*pp);
+            pool->depotCount--;
+        } else {
+            pp = (void **)*pp;
+        }
+    }
+
+    for (s = pool->slabs; s != NULL; s = next) {
+        next = s->next;
+        if (s->freeMark != pool->objsPerSlab)
+            continue;
+        if (s->prev != NULL)
+            s->prev->next = s->next;
+        else
+            pool->slabs = s->next;
+        if (s->next != NULL)
+            s->next->prev = s->prev;
+        munmap(s, pool->slabSize);
+        pool->nslabs--;
+        pool->slabFrees++;
+        freed++;
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+    return freed;
+}
+
+const size_t connBufClassSize[CONN_BUF_CLASSES] = {
+    512, 2048, 8192, 32768
+};
+
+static struct objPool bufPools[CONN_BUF_CLASSES];
+
+int
+connBufInit(void)
+{
+    int j;
+
+    for (j = 0; j < CONN_BUF_CLASSES; j++)
+        if (objPoolInit(&bufPools[j],
+                    sizeof(struct connBuf) + connBufClassSize[j]) == -1)
+            return -1;
+    return 0;
+}
+
+struct connBuf *
+connBufAlloc(size_t size)
+{
+    struct connBuf *buf;
+    int cls;
+
+    for (cls = 0; cls < CONN_BUF_CLASSES; cls++)
+        if (size <= connBufClassSize[cls])
+            break;
+    if (cls == CONN_BUF_CLASSES) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    if ((buf = objPoolAlloc(&bufPools[cls])) == NULL)
+        return NULL;
+
+    buf->refcnt = 1;
+    buf->cls = cls;
+    buf->size = connBufClassSize[cls];
+    buf->len = 0;
+    return buf;
+}
+
+struct connBuf *
+connBufRef(struct connBuf *buf)
+{
+    __atomic_add_fetch(&buf->refcnt, 1, __ATOMIC_RELAXED);
+    return buf;
+}
+
+void
+connBufUnref(struct connBuf *buf)
+{
+    if (__atomic_sub_fetch(&buf->refcnt, 1, __ATOMIC_ACQ_REL) == 0)
+        objPoolFree(&bufPools[buf->cls], buf);
+}
+
+size_t
+connBufTrim(void)
+{
+    size_t freed = 0;
+    int j;
+
+    for (j = 0; j < CONN_BUF_CLASSES; j++)
+        freed += objPoolTrim(&bufPools[j]);
+    return freed;
+}
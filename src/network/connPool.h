@@ -0,0 +1,159 @@
+/**
+ * @file connPool.h
+ * @author Lock
+ * @date 16 Oct 2026
+ * @brief 连接对象与 I/O 缓冲区的对象池
+ *
+ * 服务器每 accept() 一个连接就要分配一个连接状态对象以及读写缓冲区,
+ * 连接关闭时再释放. 在连接频繁建立和断开的场景下, 这些 malloc()/free()
+ * 会成为热点, 并且多线程时会在分配器的锁上发生争用.
+ *
+ * 这里实现了一个 slab 风格的定长对象池:
+ *   - 对象从按 slab 大小对齐的 mmap() 内存块(slab)中切分, 不经过 malloc().
+ *   - 每个线程拥有自己的空闲链表缓存, 分配和释放通常不需要加锁.
+ *   线程缓存过多时把一批对象归还到全局仓库(depot), 缓存为空时再从仓库取一批.
+ *   - 调用 objPoolTrim() 时, 全部对象都已空闲的 slab 会被 munmap() 归还给系统,
+ *   服务器可以在空闲时调用它让对象池收缩.
+ *
+ * 缓冲区按大小分为若干档(@ref CONN_BUF_CLASSES), 每档使用一个对象池.
+ * 缓冲区带有引用计数, 最后一个引用释放时回到对应的对象池.
+ *
+ * @example connPoolBench.c
+ */
+#ifndef CONN_POOL_H
+#define CONN_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/socket.h>
+
+#define OBJ_POOL_MAX 32         //!< 进程中最多可以创建的对象池个数
+#define OBJ_POOL_BATCH 32       //!< 线程缓存与全局仓库之间一次移动的对象个数
+
+/**
+ * @brief 定长对象池
+ */
+struct objPool {
+    int id;                     //!< 线程缓存数组中的下标
+    size_t objSize;             //!< 对象大小(已按 16 字节对齐)
+    size_t slabSize;            //!< 每个 slab 的大小, 2 的幂, slab 按该大小对齐
+    unsigned objsPerSlab;
+    pthread_mutex_t lock;       //!< 保护下面的全局仓库与 slab 链表
+    void *depot;                //!< 全局空闲对象链表
+    size_t depotCount;
+    struct slab *slabs;         //!< 所有 slab 组成的双向链表
+    size_t nslabs;
+    uint64_t slabAllocs;        //!< 累计 mmap() 的 slab 个数
+    uint64_t slabFrees;         //!< 累计 munmap() 的 slab 个数
+};
+
+/**
+ * @brief 初始化对象池
+ *
+ * @param pool 对象池
+ * @param objSize 每个对象的大小
+ *
+ * @return 返回函数执行状态
+ * @retval 0 成功
+ * @retval -1 失败, 已经创建了 @ref OBJ_POOL_MAX 个对象池时 errno 为 `ENOSPC`
+ *
+ * @note 对象池的编号不会被复用, 对象池应当在程序启动时创建并一直存在.
+ */
+int
+objPoolInit(struct objPool *pool, size_t objSize);
+
+/**
+ * @brief 从对象池中分配一个对象
+ *
+ * @return 返回对象的地址, 内容未初始化
+ * @retval NULL 失败, 内存不足
+ */
+void *
+objPoolAlloc(struct objPool *pool);
+
+/**
+ * @brief 将对象归还对象池
+ *
+ * 对象会先放入调用线程的缓存中, 可以在与分配时不同的线程中释放.
+ */
+void
+objPoolFree(struct objPool *pool, void *obj);
+
+/**
+ * @brief 收缩对象池
+ *
+ * 把调用线程的缓存归还到全局仓库, 然后释放所有对象都空闲的 slab.
+ * 其他线程缓存中的对象不受影响, 每个线程应在自己空闲时调用.
+ *
+ * @return 返回释放的 slab 个数
+ */
+size_t
+objPoolTrim(struct objPool *pool);
+
+/**
+ * @brief 缓冲区大小档位
+ */
+#define CONN_BUF_CLASSES 4
+extern const size_t connBufClassSize[CONN_BUF_CLASSES];
+
+/**
+ * @brief 带引用计数的定长缓冲区
+ */
+struct connBuf {
+    uint32_t refcnt;            //!< 引用计数, 原子操作
+    uint16_t cls;               //!< 所属档位
+    uint32_t size;              //!< data 的容量
+    uint32_t len;               //!< 已使用的字节数
+    char data[];
+};
+
+/**
+ * @brief 初始化全部缓冲区档位的对象池, 只需调用一次
+ *
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+int
+connBufInit(void);
+
+/**
+ * @brief 分配一个容量不小于 @p size 的缓冲区, 初始引用计数为 1
+ *
+ * @retval NULL @p size 超过最大档位或内存不足
+ */
+struct connBuf *
+connBufAlloc(size_t size);
+
+/**
+ * @brief 增加引用计数
+ */
+struct connBuf *
+connBufRef(struct connBuf *buf);
+
+/**
+ * @brief 减少引用计数, 减到 0 时归还对象池
+ */
+void
+connBufUnref(struct connBuf *buf);
+
+/**
+ * @brief 收缩全部缓冲区对象池, 返回释放的 slab 个数
+ */
+size_t
+connBufTrim(void);
+
+/**
+ * @brief 连接状态对象
+ */
+struct conn {
+    int fd;
+    socklen_t addrlen;
+    struct sockaddr_storage addr;
+    struct connBuf *rbuf;       //!< 读缓冲区
+    struct connBuf *wbuf;       //!< 写缓冲区
+    uint64_t bytesIn;
+    uint64_t bytesOut;
+};
+
+#endif
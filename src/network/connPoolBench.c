@@ -0,0 +1,248 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "connPool.h"
+
+/*
+ * 对比 accept/close 循环中使用 malloc() 与使用 connPool 时,
+ * 每个连接产生的堆分配次数以及耗时.
+ *
+ * 通过覆盖 malloc 系列函数统计调用次数, 再转发给 glibc 的实现.
+ *
+ * 编译: gcc -pthread connPoolBench.c connPool.c -o connPoolBench
+ * 用法: connPoolBench [connections]
+ */
+
+extern void *__libc_malloc(size_t);
+extern void *__libc_calloc(size_t, size_t);
+extern void *__libc_realloc(void *, size_t);
+extern void __libc_free(void *);
+
+static unsigned long mallocCalls;
+
+void *malloc(size_t n)
+{
+    __atomic_add_fetch(&mallocCalls, 1, __ATOMIC_RELAXED);
+    return __libc_malloc(n);
+}
+
+void *calloc(size_t n, size_t m)
+{
+    __atomic_add_fetch(&mallocCalls, 1, __ATOMIC_RELAXED);
+    return __libc_calloc(n, m);
+}
+
+void *realloc(void *p, size_t n)
+{
+    __atomic_add_fetch(&mallocCalls, 1, __ATOMIC_RELAXED);
+    return __libc_realloc(p, n);
+}
+
+void free(void *p)
+{
+    __libc_free(p);
+}
+
+#define READ_BUF_SIZE 2048
+#define WRITE_BUF_SIZE 512
+
+struct clientArg {
+    struct sockaddr_in addr;
+    long nconn;
+};
+
+void errExit(char *msg)
+{
+    extern int errno;
+    perror(msg);
+    exit(errno);
+}
+
+static double
+nowSec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *
+clientMain(void *arg)
+{
+    struct clientArg *ca = arg;
+    long j;
+    int cfd;
+
+    for (j = 0; j < ca->nconn; j++) {
+        cfd = socket(AF_INET, SOCK_STREAM, 0);
+        if (cfd == -1)
+            errExit("socket");
+        if (connect(cfd, (struct sockaddr *)&ca->addr, sizeof(ca->addr)) == -1)
+            errExit("connect");
+        if (write(cfd, "1\n", 2) != 2)
+            errExit("write");
+        close(cfd);
+    }
+    return NULL;
+}
+
+/* 使用 malloc() 的连接生命周期 */
+static struct conn *
+connNewMalloc(int fd)
+{
+    struct conn *c = malloc(sizeof(struct conn));
+
+    c->fd = fd;
+    c->rbuf = malloc(sizeof(struct connBuf) + READ_BUF_SIZE);
+    c->wbuf = malloc(sizeof(struct connBuf) + WRITE_BUF_SIZE);
+    return c;
+}
+
+static void
+connFreeMalloc(struct conn *c)
+{
+    free(c->rbuf);
+    free(c->wbuf);
+    free(c);
+}
+
+/* 使用对象池的连接生命周期 */
+static struct objPool connObjPool;
+
+static struct conn *
+connNewPool(int fd)
+{
+    struct conn *c = objPoolAlloc(&connObjPool);
+
+    c->fd = fd;
+    c->rbuf = connBufAlloc(READ_BUF_SIZE);
+    c->wbuf = connBufAlloc(WRITE_BUF_SIZE);
+    return c;
+}
+
+static void
+connFreePool(struct conn *c)
+{
+    connBufUnref(c->rbuf);
+    connBufUnref(c->wbuf);
+    objPoolFree(&connObjPool, c);
+}
+
+static void
+runSockets(const char *name, long nconn, int usePool)
+{
+    struct sockaddr_in addr;
+    struct clientArg ca;
+    pthread_t tid;
+    socklen_t len;
+    struct conn *c;
+    unsigned long before;
+    double start, elapsed;
+    long j;
+    int lfd, cfd, optval = 1;
+
+    lfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (lfd == -1)
+        errExit("socket");
+    setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval));
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    if (bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+        errExit("bind");
+    if (listen(lfd, SOMAXCONN) == -1)
+        errExit("listen");
+    len = sizeof(addr);
+    if (getsockname(lfd, (struct sockaddr *)&addr, &len) == -1)
+        errExit("getsockname");
+
+    ca.addr = addr;
+    ca.nconn = nconn;
+    errno = pthread_create(&tid, NULL, clientMain, &ca);
+    if (errno != 0)
+        errExit("pthread_create");
+
+    before = mallocCalls;
+    start = nowSec();
+    for (j = 0; j < nconn; j++) {
+        cfd = accept(lfd, NULL, NULL);
+        if (cfd == -1)
+            errExit("accept");
+
+        c = usePool ? connNewPool(cfd) : connNewMalloc(cfd);
+        c->rbuf->len = read(cfd, c->rbuf->data, READ_BUF_SIZE);
+        close(c->fd);
+        if (usePool)
+            connFreePool(c);
+        else
+            connFreeMalloc(c);
+    }
+    elapsed = nowSec() - start;
+
+    pthread_join(tid, NULL);
+    close(lfd);
+
+    printf("%-16s %10ld conns %8.3f mallocs/conn %8.2f us/conn\n", name, nconn,
+            (double)(mallocCalls - before) / nconn, elapsed * 1e6 / nconn);
+}
+
+/* 不经过 socket, 只测量分配和释放本身 */
+static void
+runChurn(const char *name, long n, int usePool)
+{
+    struct conn *c;
+    unsigned long before;
+    double start, elapsed;
+    long j;
+
+    before = mallocCalls;
+    start = nowSec();
+    for (j = 0; j < n; j++) {
+        c = usePool ? connNewPool((int)j) : connNewMalloc((int)j);
+        __asm__ __volatile__("" : : "r"(c) : "memory");
+        if (usePool)
+            connFreePool(c);
+        else
+            connFreeMalloc(c);
+    }
+    elapsed = nowSec() - start;
+
+    printf("%-16s %10ld iters %8.3f mallocs/iter %8.2f ns/iter\n", name, n,
+            (double)(mallocCalls - before) / n, elapsed * 1e9 / n);
+}
+
+int
+main(int argc, char *argv[])
+{
+    long nconn;
+
+    nconn = (argc > 1) ? atol(argv[1]) : 20000;
+
+    if (objPoolInit(&connObjPool, sizeof(struct conn)) == -1)
+        errExit("objPoolInit");
+    if (connBufInit() == -1)
+        errExit("connBufInit");
+
+    // 预热: 让对象池先分配好 slab
+    runChurn("pool warm-up", 1000, 1);
+
+    runChurn("malloc churn", nconn * 100, 0);
+    runChurn("pool churn", nconn * 100, 1);
+    runSockets("malloc accept", nconn, 0);
+    runSockets("pool accept", nconn, 1);
+
+    printf("slabs released by trim: %zu\n",
+            objPoolTrim(&connObjPool) + connBufTrim());
+
+    exit(EXIT_SUCCESS);
+}
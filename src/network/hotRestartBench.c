@@ -0,0 +1,231 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+
+#define PORT_NUM "59999"
+#define INT_LEN 30
+#define PID_FILE "/tmp/seqnum_server.pid"
+#define RESTART_TIMEOUT 5.0     // 等待新进程接手的秒数
+
+/*
+ * 热重启压测: 启动若干个客户端进程不断向 test.c 发起请求,
+ * 主进程按固定间隔向服务器发送 SIGUSR2 触发热重启.
+ * 统计失败的连接数以及每个客户端看到的序列号是否单调递增.
+ * 只有 PID 文件中的进程号改变并且新进程回复了请求才算一次重启,
+ * RESTART_TIMEOUT 秒内没有完成交接时整个运行失败.
+ *
+ * 用法: hotRestartBench host [clients] [requests-per-client] [restart-interval-ms]
+ */
+
+void errExit(char *msg)
+{
+    extern int errno;
+    perror(msg);
+    exit(errno);
+}
+
+static double
+nowSec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * 发起一次请求, 成功时返回服务器回复的序列号, 失败返回 -1
+ */
+static long
+oneRequest(struct addrinfo *result)
+{
+    struct addrinfo *rp;
+    char buf[INT_LEN];
+    ssize_t numRead;
+    size_t totRead = 0;
+    int cfd = -1;
+
+    for (rp = result; rp != NULL; rp = rp->ai_next) {
+        cfd = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
+        if (cfd == -1)
+            continue;
+        if (connect(cfd, rp->ai_addr, rp->ai_addrlen) != -1)
+            break;
+        close(cfd);
+        cfd = -1;
+    }
+    if (cfd == -1)
+        return -1;
+
+    if (write(cfd, "1\n", 2) != 2) {
+        close(cfd);
+        return -1;
+    }
+
+    while (totRead < INT_LEN - 1) {
+        numRead = read(cfd, buf + totRead, INT_LEN - 1 - totRead);
+        if (numRead == -1 && errno == EINTR)
+            continue;
+        if (numRead <= 0)
+            break;
+        totRead += numRead;
+        if (buf[totRead - 1] == '\n')
+            break;
+    }
+    close(cfd);
+
+    if (totRead == 0 || buf[totRead - 1] != '\n')
+        return -1;
+    buf[totRead] = '\0';
+    return atol(buf);
+}
+
+/*
+ * 客户端进程: 退出码的低 7 位为失败的请求数, 第 8 位表示序列号出现回退
+ */
+static void
+client(struct addrinfo *result, long nreq)
+{
+    long j, seq, last = -1, failed = 0;
+    int regressed = 0;
+
+    for (j = 0; j < nreq; j++) {
+        seq = oneRequest(result);
+        if (seq == -1) {
+            failed++;
+            continue;
+        }
+        if (seq <= last)
+            regressed = 1;
+        last = seq;
+    }
+
+    _exit((failed > 127 ? 127 : failed) | (regressed << 7));
+}
+
+static pid_t
+readServerPid(void)
+{
+    FILE *fp;
+    long pid = -1;
+
+    if ((fp = fopen(PID_FILE, "r")) == NULL)
+        return -1;
+    if (fscanf(fp, "%ld", &pid) != 1)
+        pid = -1;
+    fclose(fp);
+    return (pid_t)pid;
+}
+
+/*
+ * 等待 oldPid 把监听 socket 交给新进程: PID 文件中的进程号改变并且新进程回复请求.
+ * 成功返回 0, 超时返回 -1
+ */
+static int
+waitHandOver(struct addrinfo *result, pid_t oldPid)
+{
+    struct timespec pause = { 0, 10000000 };
+    double deadline = nowSec() + RESTART_TIMEOUT;
+    pid_t pid;
+
+    while (nowSec() < deadline) {
+        pid = readServerPid();
+        if (pid > 0 && pid != oldPid && oneRequest(result) != -1)
+            return 0;
+        nanosleep(&pause, NULL);
+    }
+    return -1;
+}
+
+int main(int argc, char **argv)
+{
+    struct addrinfo hints, *result;
+    struct timespec interval;
+    int nclients, j, status, running, restarts = 0;
+    long nreq, failed = 0, intervalMs;
+    int regressed = 0, timedOut = 0;
+    pid_t pid, serverPid;
+    double start, elapsed;
+
+    if (argc < 2 || strcmp(argv[1], "--help") == 0) {
+        printf("%s host [clients] [requests-per-client] [restart-interval-ms]\n",
+                argv[0]);
+        exit(0);
+    }
+
+    nclients = (argc > 2) ? atoi(argv[2]) : 8;
+    nreq = (argc > 3) ? atol(argv[3]) : 20000;
+    intervalMs = (argc > 4) ? atol(argv[4]) : 200;
+
+    memset(&hints, 0, sizeof(struct addrinfo));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_NUMERICSERV;
+
+    if (getaddrinfo(argv[1], PORT_NUM, &hints, &result) != 0)
+        errExit("getaddrinfo wrong");
+
+    start = nowSec();
+    for (j = 0; j < nclients; j++) {
+        switch (fork()) {
+        case -1:
+            errExit("fork");
+            break;
+        case 0:
+            client(result, nreq);
+            break;
+        default:
+            break;
+        }
+    }
+
+    // 客户端运行期间周期性地触发热重启
+    interval.tv_sec = intervalMs / 1000;
+    interval.tv_nsec = (intervalMs % 1000) * 1000000;
+    running = nclients;
+    while (running > 0) {
+        nanosleep(&interval, NULL);
+
+        while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+            running--;
+            if (WIFEXITED(status)) {
+                failed += WEXITSTATUS(status) & 0x7f;
+                regressed |= WEXITSTATUS(status) >> 7;
+            } else {
+                failed += nreq;
+            }
+        }
+
+        if (running > 0 && !timedOut && (serverPid = readServerPid()) > 0 &&
+                kill(serverPid, SIGUSR2) == 0) {
+            if (waitHandOver(result, serverPid) == 0) {
+                restarts++;
+            } else {
+                // 不再触发重启, 等客户端结束后报告失败
+                fprintf(stderr, "server %ld did not hand over within %.0f s\n",
+                        (long)serverPid, RESTART_TIMEOUT);
+                timedOut = 1;
+            }
+        }
+    }
+    elapsed = nowSec() - start;
+
+    printf("clients:        %d\n", nclients);
+    printf("requests:       %ld\n", nclients * nreq);
+    printf("restarts:       %d%s\n", restarts, timedOut ? " (timed out)" : "");
+    printf("failed:         %ld\n", failed);
+    printf("seq regressed:  %s\n", regressed ? "yes" : "no");
+    printf("elapsed:        %.3f s (%.0f req/s)\n", elapsed,
+            nclients * nreq / elapsed);
+
+    freeaddrinfo(result);
+    exit(failed == 0 && !regressed && !timedOut ? EXIT_SUCCESS : EXIT_FAILURE);
+}
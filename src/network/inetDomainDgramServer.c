@@ -1,9 +1,12 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 #include <unistd.h>
 #include <ctype.h>
+#include <time.h>
+#include <stdint.h>
 #include <sys/socket.h>
 #include <netdb.h>
 #include <sys/un.h>
@@ -11,6 +14,19 @@
 
 #define BUF_SIZE 10
 #define PORT_NUM 50002
+#define BATCH 32
+#define HIST_BUCKETS 40         /* 第 i 个桶统计 [2^i, 2^(i+1)) 纳秒 */
+#define REPORT_INTERVAL 5       /* 直方图输出间隔(秒) */
+
+/*
+ * 以 2 的幂为桶宽的延迟直方图, 记录一次只需要一条 clz 指令和一次加法
+ */
+struct latencyHist {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+    uint64_t bucket[HIST_BUCKETS];
+};
 
 void errExit(char *msg)
 {
@@ -19,16 +35,102 @@ void errExit(char *msg)
     exit(errno);
 }
 
+static inline uint64_t
+tsToNs(const struct timespec *ts)
+{
+    return (uint64_t)ts->tv_sec * 1000000000ULL + ts->tv_nsec;
+}
+
+static inline void
+histRecord(struct latencyHist *h, int64_t ns)
+{
+    int b;
+
+    if (ns < 1)
+        ns = 1;
+    b = 63 - __builtin_clzll((uint64_t)ns);
+    if (b >= HIST_BUCKETS)
+        b = HIST_BUCKETS - 1;
+    h->bucket[b]++;
+    h->count++;
+    h->sum += ns;
+    if ((uint64_t)ns > h->max)
+        h->max = ns;
+}
+
+/*
+ * 返回第 p 百分位所在桶的上界(纳秒)
+ */
+static uint64_t
+histPercentile(const struct latencyHist *h, double p)
+{
+    uint64_t target, seen = 0;
+    int b;
+
+    target = (uint64_t)(h->count * p / 100.0);
+    for (b = 0; b < HIST_BUCKETS; b++) {
+        seen += h->bucket[b];
+        if (seen > target)
+            return 2ULL << b;
+    }
+    return h->max;
+}
+
+static void
+histReport(const char *name, const struct latencyHist *h)
+{
+    if (h->count == 0)
+        return;
+    printf("%-8s n=%-10llu avg=%-8llu p50<%-8llu p99<%-8llu p99.9<%-8llu max=%llu (ns)\n",
+            name, (unsigned long long) h->count,
+            (unsigned long long) (h->sum / h->count),
+            (unsigned long long) histPercentile(h, 50),
+            (unsigned long long) histPercentile(h, 99),
+            (unsigned long long) histPercentile(h, 99.9),
+            (unsigned long long) h->max);
+}
+
+/*
+ * 从辅助数据中取出 SO_TIMESTAMPNS 记录的内核接收时间
+ */
+static int
+getRxTimestamp(struct msghdr *msg, struct timespec *ts)
+{
+    struct cmsghdr *cmsg;
+
+    for (cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+            memcpy(ts, CMSG_DATA(cmsg), sizeof(struct timespec));
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/*
+ * 用法: inetDomainDgramServer [-t]
+ *
+ * -t 打开 SO_TIMESTAMPNS, 统计每个数据报在 socket 接收队列中等待的时间
+ * (内核时间戳到 recvmmsg() 返回) 和应用处理时间(recvmmsg() 返回到回复发送完成),
+ * 每 REPORT_INTERVAL 秒输出一次直方图. 此模式下不再逐个打印客户端地址.
+ */
 int
 main(int argc, char *argv[])
 {
-    struct sockaddr_in6 svaddr, claddr;
-    int sfd, j;
-    ssize_t numBytes;
-    socklen_t len;
-    char buf[BUF_SIZE];
+    struct sockaddr_in6 svaddr, claddr[BATCH];
+    struct mmsghdr msgs[BATCH];
+    struct iovec iovs[BATCH];
+    struct timespec rxTs, now, done;
+    struct timeval tv;
+    struct latencyHist queueHist, procHist;
+    int sfd, j, k, n, optval, timestamps;
+    uint64_t userNs = 0, lastReport;
+    char buf[BATCH][BUF_SIZE];
+    char control[BATCH][CMSG_SPACE(sizeof(struct timespec))];
     char claddrStr[INET6_ADDRSTRLEN];
 
+    timestamps = (argc > 1 && strcmp(argv[1], "-t") == 0);
+
     /* Create a datagram socket bound to an address in the IPv6 domain */
 
     sfd = socket(AF_INET6, SOCK_DGRAM, 0);
@@ -44,29 +146,97 @@ main(int argc, char *argv[])
                 sizeof(struct sockaddr_in6)) == -1)
         errExit("bind");
 
+    if (timestamps) {
+        optval = 1;
+        if (setsockopt(sfd, SOL_SOCKET, SO_TIMESTAMPNS, &optval,
+                    sizeof(optval)) == -1)
+            errExit("setsockopt SO_TIMESTAMPNS");
+
+        // 没有数据时也需要定期醒来输出直方图
+        tv.tv_sec = 1;
+        tv.tv_usec = 0;
+        if (setsockopt(sfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) == -1)
+            errExit("setsockopt SO_RCVTIMEO");
+    }
+
+    memset(msgs, 0, sizeof(msgs));
+    for (j = 0; j < BATCH; j++) {
+        iovs[j].iov_base = buf[j];
+        msgs[j].msg_hdr.msg_iov = &iovs[j];
+        msgs[j].msg_hdr.msg_iovlen = 1;
+        msgs[j].msg_hdr.msg_name = &claddr[j];
+    }
+
+    memset(&queueHist, 0, sizeof(queueHist));
+    memset(&procHist, 0, sizeof(procHist));
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    lastReport = tsToNs(&now);
+
     /* Receive messages, convert to uppercase, and return to client */
 
     for (;;) {
-        len = sizeof(struct sockaddr_in6);
-        numBytes = recvfrom(sfd, buf, BUF_SIZE, 0,
-                            (struct sockaddr *) &claddr, &len);
-        if (numBytes == -1)
-            errExit("recvfrom");
-
-        /* Display address of client that sent the message */
-
-        if (inet_ntop(AF_INET6, &claddr.sin6_addr, claddrStr,
-                    INET6_ADDRSTRLEN) == NULL)
-            printf("Couldn't convert client address to string\n");
-        else
-            printf("Server received %ld bytes from (%s, %u)\n",
-                    (long) numBytes, claddrStr, ntohs(claddr.sin6_port));
-
-        for (j = 0; j < numBytes; j++)
-            buf[j] = toupper((unsigned char) buf[j]);
-
-        if (sendto(sfd, buf, numBytes, 0, (struct sockaddr *) &claddr, len) !=
-                numBytes)
-            errExit("sendto");
+        for (j = 0; j < BATCH; j++) {
+            iovs[j].iov_len = BUF_SIZE;
+            msgs[j].msg_hdr.msg_namelen = sizeof(struct sockaddr_in6);
+            msgs[j].msg_hdr.msg_control = timestamps ? control[j] : NULL;
+            msgs[j].msg_hdr.msg_controllen = timestamps ? sizeof(control[j]) : 0;
+        }
+
+        n = recvmmsg(sfd, msgs, BATCH, MSG_WAITFORONE, NULL);
+        if (n == -1) {
+            if (errno != EAGAIN && errno != EINTR)
+                errExit("recvmmsg");
+            n = 0;
+        }
+
+        if (timestamps) {
+            // SO_TIMESTAMPNS 的时间戳基于 CLOCK_REALTIME
+            clock_gettime(CLOCK_REALTIME, &now);
+            userNs = tsToNs(&now);
+            for (j = 0; j < n; j++)
+                if (getRxTimestamp(&msgs[j].msg_hdr, &rxTs) == 0)
+                    histRecord(&queueHist, (int64_t)(userNs - tsToNs(&rxTs)));
+        }
+
+        for (j = 0; j < n; j++) {
+            /* Display address of client that sent the message */
+
+            if (!timestamps) {
+                if (inet_ntop(AF_INET6, &claddr[j].sin6_addr, claddrStr,
+                            INET6_ADDRSTRLEN) == NULL)
+                    printf("Couldn't convert client address to string\n");
+                else
+                    printf("Server received %ld bytes from (%s, %u)\n",
+                            (long) msgs[j].msg_len, claddrStr,
+                            ntohs(claddr[j].sin6_port));
+            }
+
+            for (k = 0; k < (int)msgs[j].msg_len; k++)
+                buf[j][k] = toupper((unsigned char) buf[j][k]);
+
+            if (sendto(sfd, buf[j], msgs[j].msg_len, 0,
+                        (struct sockaddr *) &claddr[j],
+                        msgs[j].msg_hdr.msg_namelen) != (ssize_t)msgs[j].msg_len)
+                errExit("sendto");
+
+            // 每个数据报从 recvmmsg() 返回到它的回复发送完成, 包括在批内排在它前面的数据报
+            if (timestamps) {
+                clock_gettime(CLOCK_REALTIME, &done);
+                histRecord(&procHist, (int64_t)(tsToNs(&done) - userNs));
+            }
+        }
+
+        if (!timestamps)
+            continue;
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (tsToNs(&now) - lastReport >= REPORT_INTERVAL * 1000000000ULL) {
+            histReport("queue", &queueHist);
+            histReport("process", &procHist);
+            fflush(stdout);
+            memset(&queueHist, 0, sizeof(queueHist));
+            memset(&procHist, 0, sizeof(procHist));
+            lastReport = tsToNs(&now);
+        }
     }
 }
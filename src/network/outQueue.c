@@ -0,0 +1,264 @@
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <linux/errqueue.h>
+#include "outQueue.h"
+
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+static struct objPool fragPool;
+static pthread_once_t fragPoolOnce = PTHREAD_ONCE_INIT;
+static int fragPoolErr;
+
+static void
+fragPoolInit(void)
+{
+    fragPoolErr = objPoolInit(&fragPool, sizeof(struct oqFrag));
+}
+
+/* 序号是 32 位循环计数, a 不晚于 b 时返回真 */
+static inline int
+seqBeforeEq(uint32_t a, uint32_t b)
+{
+    return (int32_t)(a - b) <= 0;
+}
+
+static void
+fragRelease(struct oqFrag *f)
+{
+    if (f->buf != NULL)
+        connBufUnref(f->buf);
+    objPoolFree(&fragPool, f);
+}
+
+int
+oqInit(struct outQueue *q, int fd, size_t zcThreshold)
+{
+    int optval = 1;
+
+    pthread_once(&fragPoolOnce, fragPoolInit);
+    if (fragPoolErr == -1)
+        return -1;
+
+    memset(q, 0, sizeof(struct outQueue));
+    q->fd = fd;
+    q->highWater = OQ_HIGH_WATER;
+    q->lowWater = OQ_LOW_WATER;
+
+    if (zcThreshold > 0 &&
+            setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &optval, sizeof(optval)) == 0)
+        q->zcThreshold = zcThreshold;
+
+    return 0;
+}
+
+int
+oqPush(struct outQueue *q, const void *base, size_t len, struct connBuf *buf)
+{
+    struct oqFrag *f;
+
+    if (len == 0)
+        return 0;
+
+    if ((f = objPoolAlloc(&fragPool)) == NULL)
+        return -1;
+
+    f->next = NULL;
+    f->base = base;
+    f->len = len;
+    f->off = 0;
+    f->buf = (buf != NULL) ? connBufRef(buf) : NULL;
+    f->zerocopy = 0;
+    f->zcLast = 0;
+
+    if (q->tail != NULL)
+        q->tail->next = f;
+    else
+        q->head = f;
+    q->tail = f;
+    q->queued += len;
+
+    return 0;
+}
+
+/* 片段全部发送后: 零拷贝片段移入等待完成的链表, 其他片段立即释放 */
+static void
+fragSent(struct outQueue *q, struct oqFrag *f)
+{
+    if (!f->zerocopy) {
+        fragRelease(f);
+        return;
+    }
+
+    f->next = NULL;
+    if (q->zcTail != NULL)
+        q->zcTail->next = f;
+    else
+        q->zcHead = f;
+    q->zcTail = f;
+    q->inflight += f->len;
+}
+
+int
+oqFlush(struct outQueue *q)
+{
+    struct iovec iov[IOV_MAX];
+    struct msghdr msg;
+    struct oqFrag *f;
+    ssize_t n;
+    size_t left, total;
+    int niov, flags;
+
+    while (q->head != NULL) {
+        // 收集连续的片段, 只要其中有一个大片段, 整次调用就使用零拷贝
+        flags = MSG_NOSIGNAL;
+        niov = 0;
+        total = 0;
+        for (f = q->head; f != NULL && niov < IOV_MAX; f = f->next) {
+            iov[niov].iov_base = (char *)f->base + f->off;
+            iov[niov].iov_len = f->len - f->off;
+            total += iov[niov].iov_len;
+            niov++;
+            if (q->zcThreshold > 0 && f->len >= q->zcThreshold)
+                flags |= MSG_ZEROCOPY;
+        }
+
+        memset(&msg, 0, sizeof(struct msghdr));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = niov;
+
+        n = sendmsg(q->fd, &msg, flags);
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return 1;
+            // 锁定页面超过 RLIMIT_MEMLOCK 等情况下零拷贝会失败, 改用普通发送
+            if (errno == ENOBUFS && (flags & MSG_ZEROCOPY)) {
+                q->zcThreshold = 0;
+                continue;
+            }
+            return -1;
+        }
+
+        q->sendCalls++;
+        q->queued -= n;
+
+        left = n;
+        for (f = q->head; f != NULL && niov > 0; niov--) {
+            if (flags & MSG_ZEROCOPY) {
+                f->zerocopy = 1;
+                f->zcLast = q->zcNext;
+            }
+            if (left < f->len - f->off) {
+                f->off += left;
+                break;
+            }
+            left -= f->len - f->off;
+            q->head = f->next;
+            if (q->head == NULL)
+                q->tail = NULL;
+            fragSent(q, f);
+            f = q->head;
+        }
+
+        if (flags & MSG_ZEROCOPY) {
+            q->zcNext++;
+            q->zcCalls++;
+        }
+
+        if ((size_t)n < total)
+            return 1;       // 发生了部分写, 发送缓冲区已满
+    }
+
+    return 0;
+}
+
+int
+oqReapZerocopy(struct outQueue *q)
+{
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+    struct sock_extended_err serr;
+    struct oqFrag *f;
+    char control[CMSG_SPACE(sizeof(struct sock_extended_err) + 64)];
+    int released = 0;
+
+    for (;;) {
+        memset(&msg, 0, sizeof(struct msghdr));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        if (recvmsg(q->fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+
+        for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            memcpy(&serr, CMSG_DATA(cmsg), sizeof(serr));
+            if (serr.ee_errno != 0 || serr.ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+                continue;
+
+            // [ee_info, ee_data] 范围内的零拷贝调用都已完成
+            if (serr.ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+                q->zcCopied += serr.ee_data - serr.ee_info + 1;
+
+            while ((f = q->zcHead) != NULL && seqBeforeEq(f->zcLast, serr.ee_data)) {
+                q->zcHead = f->next;
+                if (q->zcHead == NULL)
+                    q->zcTail = NULL;
+                q->inflight -= f->len;
+                fragRelease(f);
+                released++;
+            }
+        }
+    }
+
+    return released;
+}
+
+int
+oqShouldPauseRead(struct outQueue *q)
+{
+    size_t pending = q->queued + q->inflight;
+
+    if (!q->paused && pending > q->highWater)
+        q->paused = 1;
+    else if (q->paused && pending < q->lowWater)
+        q->paused = 0;
+
+    return q->paused;
+}
+
+void
+oqDestroy(struct outQueue *q)
+{
+    struct oqFrag *f;
+
+    while ((f = q->head) != NULL) {
+        q->head = f->next;
+        fragRelease(f);
+    }
+    while ((f = q->zcHead) != NULL) {
+        q->zcHead = f->next;
+        fragRelease(f);
+    }
+    q->tail = q->zcTail = NULL;
+    q->queued = q->inflight = 0;
+}
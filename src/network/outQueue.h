@@ -0,0 +1,141 @@
+/**
+ * @file outQueue.h
+ * @author Lock
+ * @date 16 Oct 2026
+ * @brief 每个连接的输出队列: 分散/聚集写与 MSG_ZEROCOPY
+ *
+ * 一个回复通常由头部和正文等多个片段组成. 如果每个片段调用一次 write(),
+ * 系统调用次数成倍增加, 而先把片段复制到一个连续缓冲区里又多了一次内存复制.
+ * 输出队列只记录片段的地址和长度, 刷新时把尽可能多的片段(最多 `IOV_MAX` 个)
+ * 通过一次 sendmsg() 发送出去.
+ *
+ * 对于超过阈值的大片段, 使用 `MSG_ZEROCOPY` 发送: 内核直接引用用户空间的页面,
+ * 不再复制数据. 代价是在内核通过 socket 的错误队列通知发送完成之前,
+ * 这些片段的内存不能被修改或释放. 每次带 `MSG_ZEROCOPY` 的 sendmsg() 调用
+ * 都有一个从 0 开始递增的序号, 完成通知给出的是一个序号区间.
+ * 调用 oqReapZerocopy() 读取错误队列, 释放已经完成的片段.
+ *
+ * 当已排队但尚未发送(或尚未完成零拷贝)的字节数超过高水位时,
+ * oqShouldPauseRead() 返回真, 服务器应当停止读取该连接的请求,
+ * 直到字节数降到低水位以下, 以免慢速客户端耗尽服务器内存.
+ *
+ * 片段描述符从 connPool.h 中的对象池分配, 可以引用带引用计数的 connBuf,
+ * 片段发送(或零拷贝完成)后自动释放引用.
+ *
+ * @note 零拷贝完成通知按照 TCP 的发送顺序到达, 这里假设序号区间是按顺序完成的.
+ * @note 在回环接口上内核总是退化为复制(完成通知中带有 `SO_EE_CODE_ZEROCOPY_COPIED`),
+ * 零拷贝只有在真实网卡上发送大块数据时才有收益.
+ *
+ * @example outQueueBench.c
+ */
+#ifndef OUT_QUEUE_H
+#define OUT_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "connPool.h"
+
+#define OQ_HIGH_WATER (4 * 1024 * 1024)     //!< 默认高水位
+#define OQ_LOW_WATER  (1 * 1024 * 1024)     //!< 默认低水位
+
+/**
+ * @brief 输出片段
+ */
+struct oqFrag {
+    struct oqFrag *next;
+    const char *base;
+    size_t len;
+    size_t off;                 //!< 已经发送的字节数
+    struct connBuf *buf;        //!< 非 NULL 时片段完成后释放该引用
+    int zerocopy;               //!< 是否有部分内容经由 MSG_ZEROCOPY 发送
+    uint32_t zcLast;            //!< 最后一次覆盖该片段的零拷贝调用序号
+};
+
+/**
+ * @brief 每个连接的输出队列
+ */
+struct outQueue {
+    int fd;                     //!< 非阻塞的流 socket
+    struct oqFrag *head, *tail;         //!< 等待发送的片段
+    struct oqFrag *zcHead, *zcTail;     //!< 已发送但零拷贝尚未完成的片段
+    size_t queued;              //!< 等待发送的字节数
+    size_t inflight;            //!< 零拷贝尚未完成的字节数
+    size_t zcThreshold;         //!< 大于等于该长度的片段使用零拷贝, 0 表示不使用
+    size_t highWater, lowWater;
+    int paused;
+    uint32_t zcNext;            //!< 下一次零拷贝调用的序号
+    uint64_t sendCalls;         //!< 统计: sendmsg() 次数
+    uint64_t zcCalls;           //!< 统计: 零拷贝 sendmsg() 次数
+    uint64_t zcCopied;          //!< 统计: 内核退化为复制的零拷贝调用次数
+};
+
+/**
+ * @brief 初始化输出队列
+ *
+ * @param q 输出队列
+ * @param fd 已连接的非阻塞流 socket
+ * @param zcThreshold 零拷贝阈值, 为 0 时不使用 `MSG_ZEROCOPY`.
+ * 如果内核不支持 `SO_ZEROCOPY`, 自动关闭零拷贝.
+ *
+ * @retval 0 成功
+ * @retval -1 失败
+ */
+int
+oqInit(struct outQueue *q, int fd, size_t zcThreshold);
+
+/**
+ * @brief 追加一个片段
+ *
+ * 不复制数据, 在片段发送完成之前 @p base 指向的内存必须保持有效且不被修改.
+ *
+ * @param q 输出队列
+ * @param base 数据地址
+ * @param len 数据长度
+ * @param buf 为非 NULL 时, 队列持有它的一个引用直到片段完成
+ *
+ * @retval 0 成功
+ * @retval -1 分配片段失败
+ */
+int
+oqPush(struct outQueue *q, const void *base, size_t len, struct connBuf *buf);
+
+/**
+ * @brief 尽可能多地发送排队的片段
+ *
+ * @return 返回函数执行状态
+ * @retval 0 全部发送完毕
+ * @retval 1 socket 发送缓冲区已满, 需要等待 POLLOUT 后再次调用
+ * @retval -1 发送失败
+ */
+int
+oqFlush(struct outQueue *q);
+
+/**
+ * @brief 读取 socket 错误队列中的零拷贝完成通知, 释放完成的片段
+ *
+ * 当 poll() 报告 POLLERR 时调用.
+ *
+ * @return 返回释放的片段个数
+ * @retval -1 读取错误队列失败
+ */
+int
+oqReapZerocopy(struct outQueue *q);
+
+/**
+ * @brief 是否应当暂停读取该连接
+ *
+ * 超过高水位时开始暂停, 低于低水位时恢复.
+ */
+int
+oqShouldPauseRead(struct outQueue *q);
+
+/**
+ * @brief 释放队列中剩余的全部片段
+ *
+ * 如果仍有零拷贝未完成的片段, 内核可能还在发送这些内存中的数据,
+ * 调用者应当先等待完成通知, 或者确认连接已被放弃后再调用.
+ */
+void
+oqDestroy(struct outQueue *q);
+
+#endif
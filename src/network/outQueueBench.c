@@ -0,0 +1,247 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "outQueue.h"
+
+/*
+ * 混合大小回复的发送测试
+ *
+ * 每个回复由一个小头部和一个正文组成, 大约每 LARGE_EVERY 个回复中有一个大正文.
+ * 分别测试:
+ *   - write:    每个片段一次 write()
+ *   - writev:   输出队列聚集发送, 不使用零拷贝
+ *   - zerocopy: 输出队列聚集发送, 大正文使用 MSG_ZEROCOPY
+ *
+ * 编译: gcc -pthread outQueueBench.c outQueue.c connPool.c -o outQueueBench
+ * 用法: outQueueBench [responses]
+ */
+
+#define SMALL_BODY 200
+#define LARGE_BODY (256 * 1024)
+#define LARGE_EVERY 10
+#define ZC_THRESHOLD (64 * 1024)
+#define HDR_SIZE 64
+
+struct readerArg {
+    int fd;
+    size_t expect;
+};
+
+static char smallBody[SMALL_BODY];
+static char largeBody[LARGE_BODY];
+
+void errExit(char *msg)
+{
+    extern int errno;
+    perror(msg);
+    exit(errno);
+}
+
+static double
+nowSec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static size_t
+bodyLen(long j)
+{
+    return (j % LARGE_EVERY == 0) ? LARGE_BODY : SMALL_BODY;
+}
+
+static void *
+readerMain(void *arg)
+{
+    struct readerArg *ra = arg;
+    static char buf[256 * 1024];
+    size_t got = 0;
+    ssize_t n;
+
+    while (got < ra->expect) {
+        n = read(ra->fd, buf, sizeof(buf));
+        if (n <= 0)
+            errExit("reader read");
+        got += n;
+    }
+    return NULL;
+}
+
+static void
+tcpPair(int *sv)
+{
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    int lfd;
+
+    lfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (lfd == -1)
+        errExit("socket");
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) == -1 ||
+            listen(lfd, 1) == -1 ||
+            getsockname(lfd, (struct sockaddr *)&addr, &len) == -1)
+        errExit("listen");
+
+    sv[1] = socket(AF_INET, SOCK_STREAM, 0);
+    if (connect(sv[1], (struct sockaddr *)&addr, sizeof(addr)) == -1)
+        errExit("connect");
+    sv[0] = accept(lfd, NULL, NULL);
+    if (sv[0] == -1)
+        errExit("accept");
+    close(lfd);
+}
+
+static void
+writeAll(int fd, const char *p, size_t len)
+{
+    ssize_t n;
+
+    while (len > 0) {
+        n = write(fd, p, len);
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+            errExit("write");
+        }
+        p += n;
+        len -= n;
+    }
+}
+
+static void
+runMode(const char *name, long nresp, int useQueue, size_t zcThreshold)
+{
+    struct readerArg ra;
+    struct outQueue q;
+    struct connBuf *hdr;
+    struct pollfd pfd;
+    pthread_t tid;
+    double start, elapsed;
+    size_t total = 0;
+    uint64_t calls;
+    long j, pauses = 0;
+    int sv[2], one = 1;
+
+    tcpPair(sv);
+    setsockopt(sv[0], IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    for (j = 0; j < nresp; j++)
+        total += HDR_SIZE + bodyLen(j);
+
+    ra.fd = sv[1];
+    ra.expect = total;
+    errno = pthread_create(&tid, NULL, readerMain, &ra);
+    if (errno != 0)
+        errExit("pthread_create");
+
+    start = nowSec();
+    if (!useQueue) {
+        char h[HDR_SIZE];
+
+        for (j = 0; j < nresp; j++) {
+            memset(h, 'h', HDR_SIZE);
+            snprintf(h, HDR_SIZE, "LEN %zu\r\n", bodyLen(j));
+            writeAll(sv[0], h, HDR_SIZE);
+            writeAll(sv[0], bodyLen(j) == LARGE_BODY ? largeBody : smallBody,
+                    bodyLen(j));
+        }
+        calls = nresp * 2;
+    } else {
+        if (fcntl(sv[0], F_SETFL, O_NONBLOCK) == -1)
+            errExit("fcntl");
+        if (oqInit(&q, sv[0], zcThreshold) == -1)
+            errExit("oqInit");
+
+        pfd.fd = sv[0];
+        for (j = 0; j < nresp; ) {
+            // 模拟读取请求: 只有在未暂停时才生成新的回复
+            while (j < nresp && !oqShouldPauseRead(&q)) {
+                hdr = connBufAlloc(HDR_SIZE);
+                memset(hdr->data, 'h', HDR_SIZE);
+                snprintf(hdr->data, HDR_SIZE, "LEN %zu\r\n", bodyLen(j));
+                oqPush(&q, hdr->data, HDR_SIZE, hdr);
+                connBufUnref(hdr);      // 队列持有引用
+                oqPush(&q, bodyLen(j) == LARGE_BODY ? largeBody : smallBody,
+                        bodyLen(j), NULL);
+                j++;
+                // 每攒够 16 个回复刷新一次
+                if (j % 16 == 0)
+                    break;
+            }
+
+            if (oqFlush(&q) == -1)
+                errExit("oqFlush");
+            if (oqReapZerocopy(&q) == -1)
+                errExit("oqReapZerocopy");
+
+            if (oqShouldPauseRead(&q)) {
+                pauses++;
+                // 只差零拷贝完成时只等待 POLLERR
+                pfd.events = (q.head != NULL) ? POLLOUT : 0;
+                if (poll(&pfd, 1, 100) == -1 && errno != EINTR)
+                    errExit("poll");
+            }
+        }
+
+        // 发送剩余数据, 等待全部零拷贝完成
+        while (q.head != NULL || q.zcHead != NULL) {
+            pfd.events = (q.head != NULL) ? POLLOUT : 0;
+            poll(&pfd, 1, 100);
+            if (oqFlush(&q) == -1)
+                errExit("oqFlush");
+            if (oqReapZerocopy(&q) == -1)
+                errExit("oqReapZerocopy");
+        }
+        calls = q.sendCalls;
+    }
+    pthread_join(tid, NULL);
+    elapsed = nowSec() - start;
+
+    printf("%-9s %8ld resp %9.1f MB/s %9.0f resp/s %6.2f calls/resp",
+            name, nresp, total / elapsed / 1e6, nresp / elapsed,
+            (double)calls / nresp);
+    if (useQueue)
+        printf("  pauses %ld zc-calls %llu zc-copied %llu", pauses,
+                (unsigned long long)q.zcCalls, (unsigned long long)q.zcCopied);
+    printf("\n");
+
+    if (useQueue)
+        oqDestroy(&q);
+    close(sv[0]);
+    close(sv[1]);
+}
+
+int
+main(int argc, char *argv[])
+{
+    long nresp;
+
+    nresp = (argc > 1) ? atol(argv[1]) : 100000;
+
+    memset(smallBody, 's', SMALL_BODY);
+    memset(largeBody, 'L', LARGE_BODY);
+
+    if (connBufInit() == -1)
+        errExit("connBufInit");
+
+    runMode("write", nresp, 0, 0);
+    runMode("writev", nresp, 1, 0);
+    runMode("zerocopy", nresp, 1, ZC_THRESHOLD);
+
+    exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,210 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <sched.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+
+#define PORT_NUM 50003
+#define BATCH 32
+#define MSG "hello"
+
+/*
+ * reuseportDgramServer 的扩展性测试
+ *
+ * 对 1 到 N 个工作线程分别启动一次服务器, 用与工作线程数量相同的发送进程
+ * 持续发送数据报, 统计每秒收到的回复数(packets per second).
+ *
+ * -b 让服务器按 CPU 分发数据报. 服务器要求每个允许的 CPU 正好一个工作线程,
+ * 所以 n 个工作线程时先把服务器限制在允许的前 n 个 CPU 上再启动它, 最多测到 CPU 个数.
+ *
+ * 用法: reuseportDgramBench [-b] server-path [max-workers] [seconds]
+ */
+
+void errExit(char *msg)
+{
+    extern int errno;
+    perror(msg);
+    exit(errno);
+}
+
+static double
+nowSec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * 发送进程: 每次发送 BATCH 个数据报, 然后非阻塞地取走已到达的回复.
+ * 每个进程使用自己的 socket, 源端口不同, 因此会被散列到不同的 worker 上.
+ */
+static void
+sender(double seconds, long *replies)
+{
+    struct sockaddr_in6 svaddr;
+    struct mmsghdr out[BATCH], in[BATCH];
+    struct iovec outIov, inIov[BATCH];
+    char inBuf[BATCH][16];
+    double end;
+    long got = 0;
+    int sfd, j, n;
+
+    sfd = socket(AF_INET6, SOCK_DGRAM, 0);
+    if (sfd == -1)
+        errExit("socket");
+
+    memset(&svaddr, 0, sizeof(struct sockaddr_in6));
+    svaddr.sin6_family = AF_INET6;
+    svaddr.sin6_port = htons(PORT_NUM);
+    svaddr.sin6_addr = in6addr_loopback;
+
+    outIov.iov_base = MSG;
+    outIov.iov_len = strlen(MSG);
+    memset(out, 0, sizeof(out));
+    memset(in, 0, sizeof(in));
+    for (j = 0; j < BATCH; j++) {
+        out[j].msg_hdr.msg_name = &svaddr;
+        out[j].msg_hdr.msg_namelen = sizeof(svaddr);
+        out[j].msg_hdr.msg_iov = &outIov;
+        out[j].msg_hdr.msg_iovlen = 1;
+        inIov[j].iov_base = inBuf[j];
+        inIov[j].iov_len = sizeof(inBuf[j]);
+        in[j].msg_hdr.msg_iov = &inIov[j];
+        in[j].msg_hdr.msg_iovlen = 1;
+    }
+
+    end = nowSec() + seconds;
+    while (nowSec() < end) {
+        if (sendmmsg(sfd, out, BATCH, 0) == -1 && errno != ENOBUFS)
+            errExit("sendmmsg");
+        while ((n = recvmmsg(sfd, in, BATCH, MSG_DONTWAIT, NULL)) > 0)
+            got += n;
+    }
+
+    *replies = got;
+    _exit(EXIT_SUCCESS);
+}
+
+static int cpus[CPU_SETSIZE];  // 允许运行的 CPU
+static int ncpu;
+
+static long
+runOnce(const char *server, int nworkers, double seconds, int steer)
+{
+    cpu_set_t set;
+    char nStr[16];
+    long *replies, total = 0;
+    pid_t spid;
+    int j;
+
+    replies = mmap(NULL, sizeof(long) * nworkers, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (replies == MAP_FAILED)
+        errExit("mmap");
+
+    snprintf(nStr, sizeof(nStr), "%d", nworkers);
+    switch (spid = fork()) {
+    case -1:
+        errExit("fork");
+        break;
+    case 0:
+        if (steer) {
+            CPU_ZERO(&set);
+            for (j = 0; j < nworkers; j++)
+                CPU_SET(cpus[j], &set);
+            if (sched_setaffinity(0, sizeof(set), &set) == -1)
+                errExit("sched_setaffinity");
+            execl(server, server, "-n", nStr, "-b", (char *)NULL);
+        } else {
+            execl(server, server, "-n", nStr, (char *)NULL);
+        }
+        _exit(127);
+    default:
+        break;
+    }
+
+    usleep(200000);     // 等待服务器完成 bind()
+
+    for (j = 0; j < nworkers; j++) {
+        switch (fork()) {
+        case -1:
+            errExit("fork");
+            break;
+        case 0:
+            sender(seconds, &replies[j]);
+            break;
+        default:
+            break;
+        }
+    }
+    for (j = 0; j < nworkers; j++)
+        wait(NULL);
+
+    kill(spid, SIGTERM);
+    waitpid(spid, NULL, 0);
+
+    for (j = 0; j < nworkers; j++)
+        total += replies[j];
+    munmap(replies, sizeof(long) * nworkers);
+
+    return total;
+}
+
+int
+main(int argc, char *argv[])
+{
+    cpu_set_t allowed;
+    int maxWorkers, steer = 0, opt, n, j;
+    double seconds;
+    long replies, base = 0;
+
+    while ((opt = getopt(argc, argv, "b")) != -1) {
+        switch (opt) {
+        case 'b': steer = 1; break;
+        default:
+            fprintf(stderr, "%s [-b] server-path [max-workers] [seconds]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (optind >= argc || strcmp(argv[optind], "--help") == 0) {
+        printf("%s [-b] server-path [max-workers] [seconds]\n", argv[0]);
+        exit(0);
+    }
+
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == -1)
+        errExit("sched_getaffinity");
+    for (j = 0; j < CPU_SETSIZE; j++)
+        if (CPU_ISSET(j, &allowed))
+            cpus[ncpu++] = j;
+
+    maxWorkers = (argc > optind + 1) ? atoi(argv[optind + 1]) : ncpu;
+    seconds = (argc > optind + 2) ? atof(argv[optind + 2]) : 2.0;
+    if (steer && maxWorkers > ncpu) {
+        fprintf(stderr, "-b: only %d allowed CPUs, testing up to %d workers\n", ncpu, ncpu);
+        maxWorkers = ncpu;
+    }
+
+    printf("%-8s %14s %8s\n", "workers", "pps", "scaling");
+    fflush(stdout);
+    for (n = 1; n <= maxWorkers; n++) {
+        replies = runOnce(argv[optind], n, seconds, steer);
+        if (n == 1)
+            base = replies;
+        printf("%-8d %14.0f %7.2fx\n", n, replies / seconds,
+                base > 0 ? (double)replies / base : 0.0);
+        fflush(stdout);
+    }
+
+    exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,232 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <ctype.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <linux/filter.h>
+
+#define PORT_NUM 50003
+#define BUF_SIZE 10
+#define BATCH 32
+
+#ifndef SO_ATTACH_REUSEPORT_CBPF
+#define SO_ATTACH_REUSEPORT_CBPF 51
+#endif
+
+/*
+ * 多线程 UDP 大写转换服务器
+ *
+ * 进程允许运行的每个 CPU(sched_getaffinity(), 考虑了 cpuset 和离线的 CPU)
+ * 启动一个工作线程, 每个线程拥有自己的 SO_REUSEPORT socket,
+ * 并通过 pthread_setaffinity_np() 固定在对应的 CPU 上.
+ * 可选地(-b)为 reuseport 组加载一段 classic BPF 程序, 按照接收数据包的 CPU
+ * 查表选择固定在该 CPU 上的线程的 socket, 使数据包从软中断到回复都在同一个 CPU 上完成.
+ * 这要求每个允许的 CPU 正好有一个工作线程, 否则拒绝 -b.
+ *
+ * 用法: reuseportDgramServer [-n workers] [-p port] [-b]
+ */
+
+struct worker {
+    pthread_t tid;
+    int sfd;
+    int cpu;
+};
+
+void errExit(char *msg)
+{
+    extern int errno;
+    perror(msg);
+    exit(errno);
+}
+
+/*
+ * 创建一个绑定在 port 上的 SO_REUSEPORT 数据报 socket
+ */
+static int
+reuseportSocket(int port)
+{
+    struct sockaddr_in6 svaddr;
+    int sfd, optval = 1;
+
+    sfd = socket(AF_INET6, SOCK_DGRAM, 0);
+    if (sfd == -1)
+        errExit("socket");
+
+    if (setsockopt(sfd, SOL_SOCKET, SO_REUSEPORT, &optval, sizeof(optval)) == -1)
+        errExit("setsockopt SO_REUSEPORT");
+
+    memset(&svaddr, 0, sizeof(struct sockaddr_in6));
+    svaddr.sin6_family = AF_INET6;
+    svaddr.sin6_addr = in6addr_any;
+    svaddr.sin6_port = htons(port);
+
+    if (bind(sfd, (struct sockaddr *) &svaddr,
+                sizeof(struct sockaddr_in6)) == -1)
+        errExit("bind");
+
+    return sfd;
+}
+
+/*
+ * 加载 reuseport 选择程序: 按 CPU -> socket 下标的表查找接收数据包的 CPU,
+ * 内核用返回值作为组内 socket 的下标. 组内 socket 的下标按照 bind() 的先后顺序排列,
+ * 所以第 j 个创建的 socket 属于固定在 workers[j].cpu 上的线程.
+ * 不在表中的 CPU 返回一个越界的下标, 内核退回到按四元组哈希选择.
+ */
+static void
+attachCpuSteering(int sfd, const struct worker *workers, int nsock)
+{
+    struct sock_filter *code;
+    struct sock_fprog prog;
+    int j, len = 0;
+
+    code = calloc(2 * nsock + 2, sizeof(struct sock_filter));
+    if (code == NULL)
+        errExit("calloc");
+
+    code[len++] = (struct sock_filter) BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_AD_OFF + SKF_AD_CPU);
+    for (j = 0; j < nsock; j++) {
+        code[len++] = (struct sock_filter) BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, workers[j].cpu, 0, 1);
+        code[len++] = (struct sock_filter) BPF_STMT(BPF_RET | BPF_K, j);
+    }
+    code[len++] = (struct sock_filter) BPF_STMT(BPF_RET | BPF_K, 0xffffffff);
+
+    prog.len = len;
+    prog.filter = code;
+    if (setsockopt(sfd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF,
+                &prog, sizeof(prog)) == -1)
+        errExit("setsockopt SO_ATTACH_REUSEPORT_CBPF");
+    free(code);
+}
+
+static void *
+workerMain(void *arg)
+{
+    struct worker *w = arg;
+    struct mmsghdr msgs[BATCH];
+    struct iovec iovs[BATCH];
+    struct sockaddr_in6 addrs[BATCH];
+    char bufs[BATCH][BUF_SIZE];
+    cpu_set_t set;
+    int j, k, n, sent;
+
+    CPU_ZERO(&set);
+    CPU_SET(w->cpu, &set);
+    errno = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &set);
+    if (errno != 0)
+        errExit("pthread_setaffinity_np");
+
+    memset(msgs, 0, sizeof(msgs));
+    for (j = 0; j < BATCH; j++) {
+        iovs[j].iov_base = bufs[j];
+        iovs[j].iov_len = BUF_SIZE;
+        msgs[j].msg_hdr.msg_iov = &iovs[j];
+        msgs[j].msg_hdr.msg_iovlen = 1;
+        msgs[j].msg_hdr.msg_name = &addrs[j];
+    }
+
+    for (;;) {
+        for (j = 0; j < BATCH; j++)
+            msgs[j].msg_hdr.msg_namelen = sizeof(struct sockaddr_in6);
+
+        // 阻塞等待第一个数据报, 之后把已经到达的数据报一次性取走
+        n = recvmmsg(w->sfd, msgs, BATCH, MSG_WAITFORONE, NULL);
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+            errExit("recvmmsg");
+        }
+
+        for (j = 0; j < n; j++) {
+            for (k = 0; k < (int)msgs[j].msg_len; k++)
+                bufs[j][k] = toupper((unsigned char) bufs[j][k]);
+            iovs[j].iov_len = msgs[j].msg_len;
+        }
+
+        for (sent = 0; sent < n; ) {
+            k = sendmmsg(w->sfd, msgs + sent, n - sent, 0);
+            if (k == -1) {
+                if (errno == EINTR)
+                    continue;
+                perror("sendmmsg");
+                break;
+            }
+            sent += k;
+        }
+
+        for (j = 0; j < n; j++)
+            iovs[j].iov_len = BUF_SIZE;
+    }
+
+    return NULL;
+}
+
+int
+main(int argc, char *argv[])
+{
+    struct worker *workers;
+    cpu_set_t allowed;
+    int cpus[CPU_SETSIZE];
+    int nworkers, ncpu = 0, port = PORT_NUM, steer = 0, opt, j;
+
+    // 只使用允许运行的 CPU, 它们的编号不一定从 0 开始连续
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == -1)
+        errExit("sched_getaffinity");
+    for (j = 0; j < CPU_SETSIZE; j++)
+        if (CPU_ISSET(j, &allowed))
+            cpus[ncpu++] = j;
+    nworkers = ncpu;
+
+    while ((opt = getopt(argc, argv, "n:p:b")) != -1) {
+        switch (opt) {
+        case 'n': nworkers = atoi(optarg); break;
+        case 'p': port = atoi(optarg); break;
+        case 'b': steer = 1; break;
+        default:
+            fprintf(stderr, "%s [-n workers] [-p port] [-b]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (nworkers <= 0)
+        nworkers = 1;
+    if (steer && nworkers != ncpu) {
+        fprintf(stderr, "-b needs exactly one worker per allowed CPU (%d)\n", ncpu);
+        exit(EXIT_FAILURE);
+    }
+
+    workers = calloc(nworkers, sizeof(struct worker));
+    if (workers == NULL)
+        errExit("calloc");
+
+    // socket 的创建顺序就是它在组内的下标, BPF 程序的表按同样的顺序生成
+    for (j = 0; j < nworkers; j++) {
+        workers[j].cpu = cpus[j % ncpu];
+        workers[j].sfd = reuseportSocket(port);
+    }
+
+    if (steer)
+        attachCpuSteering(workers[0].sfd, workers, nworkers);
+
+    for (j = 0; j < nworkers; j++) {
+        errno = pthread_create(&workers[j].tid, NULL, workerMain, &workers[j]);
+        if (errno != 0)
+            errExit("pthread_create");
+    }
+
+    printf("Serving on port %d with %d workers%s\n", port, nworkers,
+            steer ? ", CPU steering" : "");
+    fflush(stdout);
+
+    for (j = 0; j < nworkers; j++)
+        pthread_join(workers[j].tid, NULL);
+
+    exit(EXIT_SUCCESS);
+}
@@ -18,6 +18,9 @@
  * @example getIpAddress.c
  * @example test.c
  * @example test_client.c
+ * @example hotRestartBench.c
+ * @example reuseportDgramServer.c
+ * @example reuseportDgramBench.c
  *
  * UNIX domain 中的流 socket
  */
@@ -668,6 +671,58 @@ recvfrom(int sockfd,
         struct sockaddr *src_addr,
         socklen_t *addrlen);
 
+/**
+ * @brief 一次系统调用接收多个数据报
+ *
+ * Linux 特有. 相当于对 @p vmessages 中的每个元素调用一次 recvmsg(),
+ * 每个数据报实际接收到的字节数保存在对应元素的 `msg_len` 字段中.
+ * 在数据报很小而包速率很高时, 系统调用本身的开销往往超过数据复制的开销,
+ * 批量接收可以明显降低每个数据报的 CPU 消耗.
+ *
+ * 如果在 socket 上设置了 `SO_TIMESTAMPNS` 选项, 每个数据报的辅助数据中都会带上一个
+ * `SCM_TIMESTAMPNS` 消息, 其中的 `struct timespec` 为内核接收该数据报的时间(CLOCK_REALTIME).
+ * 用 recvmmsg() 返回时的时间减去它, 即可得到数据报在 socket 接收队列中等待的时间,
+ * 从而把内核排队延迟与应用处理耗时区分开.
+ *
+ * @param sockfd 通过调用 socket() 函数获得的 socket 文件描述符
+ * @param vmessages mmsghdr 结构数组
+ * @param vlen 数组元素个数
+ * @param flags 除了 recvmsg() 的标志外, 还可以指定 `MSG_WAITFORONE`:
+ * 收到第一个数据报之后, 后续的接收都以非阻塞方式进行.
+ * @param timeout 超时时间, 为 NULL 时一直阻塞
+ *
+ * @return 返回接收到的数据报个数
+ * @retval -1 函数执行失败
+ *
+ * @see inetDomainDgramServer.c
+ * @see http://man7.org/linux/man-pages/man2/recvmmsg.2.html
+ */
+int
+recvmmsg(int sockfd, struct mmsghdr *vmessages, unsigned int vlen,
+        int flags, struct timespec *timeout);
+
+/**
+ * @brief 接收消息, 同时可以接收辅助数据
+ *
+ * 参数与 sendmsg() 相同. 接收 `SCM_RIGHTS` 时, 内核会在接收进程中为每个传递过来的
+ * 文件描述符分配一个新的描述符编号, 通过 `CMSG_DATA()` 取出.
+ *
+ * @param sockfd 通过调用 socket() 函数获得的 socket 文件描述符
+ * @param msg 用于接收数据和辅助数据的 msghdr 结构. 如果 `msg_controllen`
+ * 太小, 辅助数据会被截断, 并在 `msg_flags` 中设置 `MSG_CTRUNC`,
+ * 被截断的文件描述符将会丢失.
+ * @param flags 除了 recv() 中的标志外, 还可以指定 `MSG_CMSG_CLOEXEC`,
+ * 为接收到的文件描述符设置 close-on-exec 标志.
+ *
+ * @return 返回接收到的字节数
+ * @retval -1 函数执行失败
+ *
+ * @see sendmsg()
+ * @see http://man7.org/linux/man-pages/man2/recvmsg.2.html
+ */
+ssize_t
+recvmsg(int sockfd, struct msghdr *msg, int flags);
+
 /**
  * @brief 专用于套接字的系统调用
  *
@@ -695,6 +750,49 @@ recvfrom(int sockfd,
 ssize_t
 send(int sockfd, const void *buffer, size_t length, int flags);
 
+/**
+ * @brief 发送消息, 同时可以发送辅助数据(ancillary data)
+ *
+ * 通过 UNIX domain socket 可以使用辅助数据 `SCM_RIGHTS` 将打开的文件描述符传递给另一个进程,
+ * 接收进程得到的描述符与发送进程的描述符指向同一个打开文件句柄.
+ *
+ * 利用这一点可以实现服务器的热重启: 旧进程 fork() 并 exec() 新的程序,
+ * 通过 socketpair() 把监听 socket 传递给新进程. 因为监听 socket 自始至终都没有被关闭,
+ * 内核中的未决连接队列不会被清空, 客户端也不会因为重启而被拒绝连接.
+ * 新进程确认接管后, 旧进程处理完正在进行的连接再退出.
+ *
+ * @code{.c}
+ * union {
+ *     char buf[CMSG_SPACE(sizeof(int))];
+ *     struct cmsghdr align;
+ * } control;
+ * struct cmsghdr *cmsg;
+ *
+ * msg.msg_control = control.buf;
+ * msg.msg_controllen = sizeof(control.buf);
+ * cmsg = CMSG_FIRSTHDR(&msg);
+ * cmsg->cmsg_level = SOL_SOCKET;
+ * cmsg->cmsg_type = SCM_RIGHTS;
+ * cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+ * memcpy(CMSG_DATA(cmsg), &lfd, sizeof(int));
+ * sendmsg(sockfd, &msg, 0);
+ * @endcode
+ *
+ * @param sockfd 通过调用 socket() 函数获得的 socket 文件描述符
+ * @param msg 描述要发送的数据(`msg_iov`)以及辅助数据(`msg_control`).
+ * 传递辅助数据时, 至少需要发送 1 个字节的普通数据.
+ * @param flags 与 send() 的 @p flags 相同
+ *
+ * @return 返回发送出去的字节数
+ * @retval -1 函数执行失败
+ *
+ * @see recvmsg()
+ * @see test.c
+ * @see http://man7.org/linux/man-pages/man2/sendmsg.2.html
+ */
+ssize_t
+sendmsg(int sockfd, const struct msghdr *msg, int flags);
+
 /**
  * @brief 通过零拷贝的方式在网络中传输文件
  *
@@ -749,6 +847,35 @@ sendto(int sockfd,
         const struct sockaddr *dest_addr,
         socklen_t addrlen);
 
+/**
+ * @brief 设置 socket 选项
+ *
+ * @param sockfd 通过调用 socket() 函数获得的 socket 文件描述符
+ * @param level 选项所在的协议层, socket 层的选项使用 `SOL_SOCKET`
+ * @param optname 选项名称, 常用的 `SOL_SOCKET` 层选项:
+ *   - `SO_REUSEADDR`: 允许服务器在之前的连接仍处于 TIME_WAIT 状态时重新绑定到同一端口.
+ *   - `SO_REUSEPORT`: 允许多个 socket 绑定到完全相同的地址和端口上,
+ *   前提是每个 socket 在 bind() 之前都设置了该选项, 并且属于同一个有效用户.
+ *   内核根据数据包的四元组散列, 把数据报(或新连接)分发到组内的某一个 socket 上,
+ *   所以每个线程可以拥有自己的 socket, 避免多个线程争用同一个接收队列.
+ *   - `SO_ATTACH_REUSEPORT_CBPF`: 为 reuseport 组加载一段 classic BPF 程序,
+ *   程序的返回值作为组内 socket 的下标(按照 bind() 的先后顺序),
+ *   返回值越界时内核退回到散列选择. 例如返回 `SKF_AD_CPU` 可以让数据包
+ *   始终交给接收它的 CPU 上的线程处理.
+ * @param optval 指向选项值的指针
+ * @param optlen @p optval 的大小
+ *
+ * @return 返回函数执行状态
+ * @retval 0 成功
+ * @retval -1 失败
+ *
+ * @see reuseportDgramServer.c
+ * @see http://man7.org/linux/man-pages/man7/socket.7.html
+ */
+int
+setsockopt(int sockfd, int level, int optname,
+        const void *optval, socklen_t optlen);
+
 /**
  * @brief 关闭 socket 连接
  *
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -5,14 +6,33 @@
 #include <unistd.h>
 #include <ctype.h>
 #include <signal.h>
+#include <poll.h>
+#include <stdint.h>
 #include <sys/socket.h>
 #include <netdb.h>
 #include <sys/un.h>
 #include <arpa/inet.h>
+#include <fcntl.h>
+#include "../lib/fmt_num.h"
+#include "../lib/get_num.h"
 
 #define PORT_NUM "59999"
 #define BACKLOG 50
 #define INT_LEN 30
+#define PID_FILE "/tmp/seqnum_server.pid"
+#define INHERIT_OPT "--inherit"
+#define MAX_HANDOVER_FDS 16
+
+/*
+ * 热重启时通过 UNIX domain socket 传递给新进程的状态
+ * 监听 socket 本身通过 SCM_RIGHTS 辅助数据传递
+ */
+struct handoverState {
+    uint32_t seqNum;
+    uint32_t nfds;
+};
+
+static volatile sig_atomic_t gotRestart = 0;
 
 void errExit(char *msg)
 {
@@ -65,6 +85,189 @@ readLine(int fd, void *buffer, size_t n)
     return totRead;
 }
 
+static void
+restartHandler(int sig)
+{
+    (void)sig;
+    gotRestart = 1;
+}
+
+/*
+ * 通过 SCM_RIGHTS 发送 nfds 个文件描述符, 同时携带 len 字节的普通数据
+ */
+static int
+sendFds(int sockfd, const int *fds, int nfds, const void *data, size_t len)
+{
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+    union {
+        char buf[CMSG_SPACE(sizeof(int) * MAX_HANDOVER_FDS)];
+        struct cmsghdr align;
+    } control;
+
+    if (nfds <= 0 || nfds > MAX_HANDOVER_FDS) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    memset(&msg, 0, sizeof(struct msghdr));
+    iov.iov_base = (void *)data;
+    iov.iov_len = len;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * nfds);
+
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * nfds);
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * nfds);
+
+    return (sendmsg(sockfd, &msg, 0) == (ssize_t)len) ? 0 : -1;
+}
+
+/*
+ * 接收 sendFds() 发送的文件描述符, 返回接收到的描述符个数
+ */
+static int
+recvFds(int sockfd, int *fds, int maxfds, void *data, size_t len)
+{
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+    union {
+        char buf[CMSG_SPACE(sizeof(int) * MAX_HANDOVER_FDS)];
+        struct cmsghdr align;
+    } control;
+    int nfds = 0;
+
+    memset(&msg, 0, sizeof(struct msghdr));
+    iov.iov_base = data;
+    iov.iov_len = len;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    // MSG_CMSG_CLOEXEC: 之后再次热重启时只传递需要的描述符
+    if (recvmsg(sockfd, &msg, MSG_CMSG_CLOEXEC) != (ssize_t)len)
+        return -1;
+
+    for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+            continue;
+        nfds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        if (nfds > maxfds)
+            nfds = maxfds;
+        memcpy(fds, CMSG_DATA(cmsg), sizeof(int) * nfds);
+    }
+
+    if ((msg.msg_flags & MSG_CTRUNC) || nfds == 0) {
+        errno = EBADMSG;
+        return -1;
+    }
+
+    return nfds;
+}
+
+static void
+writePidFile(void)
+{
+    FILE *fp;
+
+    if ((fp = fopen(PID_FILE, "w")) == NULL) {
+        perror("fopen pid file");
+        return;
+    }
+    fprintf(fp, "%ld\n", (long)getpid());
+    fclose(fp);
+}
+
+/*
+ * 热重启: fork() 并 exec() 一个新的自身, 通过 socketpair 将监听 socket
+ * 与当前的序列号交给新进程. 在新进程确认接管之前, 监听 socket
+ * 一直保持打开, 所以未决连接(包括队列中的 SYN)不会丢失.
+ *
+ * 成功时返回 0, 调用者在排空进行中的连接后退出; 失败时返回 -1,
+ * 调用者继续提供服务.
+ */
+static int
+handOver(int lfd, uint32_t seqNum)
+{
+    int sv[2];
+    char fdStr[INT_LEN], ack;
+    struct handoverState st;
+    pid_t pid;
+
+    // 父进程一端带 close-on-exec, 子进程一端需要在 exec() 后继续保持打开
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == -1)
+        return -1;
+    if (fcntl(sv[0], F_SETFD, FD_CLOEXEC) == -1)
+        goto fail;
+
+    switch (pid = fork()) {
+    case -1:
+        goto fail;
+    case 0:
+        close(sv[0]);
+        snprintf(fdStr, INT_LEN, "%d", sv[1]);
+        execl("/proc/self/exe", "test", INHERIT_OPT, fdStr, (char *)NULL);
+        _exit(127);
+    default:
+        break;
+    }
+
+    close(sv[1]);
+    sv[1] = -1;
+
+    st.seqNum = seqNum;
+    st.nfds = 1;
+    if (sendFds(sv[0], &lfd, 1, &st, sizeof(st)) == -1)
+        goto fail;
+
+    // 新进程在成功接收描述符后回复一个字节, 之后旧进程才可以停止 accept()
+    if (read(sv[0], &ack, 1) != 1)
+        goto fail;
+
+    close(sv[0]);
+    printf("Handed listener over to pid %ld (seqNum %u)\n", (long)pid, seqNum);
+    return 0;
+
+fail:
+    close(sv[0]);
+    if (sv[1] != -1)
+        close(sv[1]);
+    return -1;
+}
+
+/*
+ * 作为热重启的新进程启动: 从 chanFd 中取回监听 socket 和序列号
+ */
+static int
+takeOver(int chanFd, uint32_t *seqNum)
+{
+    struct handoverState st;
+    int fds[MAX_HANDOVER_FDS];
+    int nfds, j;
+
+    nfds = recvFds(chanFd, fds, MAX_HANDOVER_FDS, &st, sizeof(st));
+    if (nfds == -1)
+        errExit("recvFds wrong");
+
+    // test.c 只监听一个 socket, 多余的描述符直接关闭
+    for (j = 1; j < nfds; j++)
+        close(fds[j]);
+
+    *seqNum = st.seqNum;
+    if (write(chanFd, "k", 1) != 1)
+        errExit("write ack wrong");
+    close(chanFd);
+
+    return fds[0];
+}
+
 int main(int argc, char **argv)
 {
     uint32_t seqNum;
@@ -75,9 +278,15 @@ int main(int argc, char **argv)
 #define ADDRSTRLEN (NI_MAXHOST + NI_MAXSERV + 10)
     char reqLenStr[INT_LEN];
     char seqNumStr[INT_LEN];
+    size_t seqNumLen;
+    ssize_t reqLineLen;
+    struct gnBulk gn;
     char addrStr[ADDRSTRLEN];
     char host[NI_MAXHOST];
     char service[NI_MAXSERV];
+    struct sigaction sa;
+    sigset_t blockMask, origMask, waitMask;
+    struct pollfd pfd;
 
     /*seqNum = (argc > 1) ? getInt(argv[1], 0, "init-seq-num") : 0;*/
     seqNum = 0;
@@ -86,6 +295,29 @@ int main(int argc, char **argv)
     if (signal(SIGPIPE, SIG_IGN) == SIG_ERR)
         errExit("signal");
 
+    /*
+     * SIGUSR2 触发热重启. 平时阻塞该信号, 只在 ppoll() 等待连接时解除阻塞,
+     * 这样检查 gotRestart 与进入等待之间不存在竞争
+     */
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = 0;
+    sa.sa_handler = restartHandler;
+    if (sigaction(SIGUSR2, &sa, NULL) == -1)
+        errExit("sigaction");
+
+    sigemptyset(&blockMask);
+    sigaddset(&blockMask, SIGUSR2);
+    if (sigprocmask(SIG_BLOCK, &blockMask, &origMask) == -1)
+        errExit("sigprocmask");
+    // 通过 handOver() 启动的进程继承了阻塞 SIGUSR2 的掩码, 不能直接用 origMask 等待
+    waitMask = origMask;
+    sigdelset(&waitMask, SIGUSR2);
+
+    if (argc > 2 && strcmp(argv[1], INHERIT_OPT) == 0) {
+        lfd = takeOver(atoi(argv[2]), &seqNum);
+        goto serve;
+    }
+
     memset(&hints, 0, sizeof(struct addrinfo));
     hints.ai_family = AF_INET; // 使用 IPv4
     hints.ai_socktype = SOCK_STREAM; // 流 socket
@@ -126,7 +358,30 @@ int main(int argc, char **argv)
     // 释放 result
     freeaddrinfo(result);
 
+    if (fcntl(lfd, F_SETFD, FD_CLOEXEC) == -1)
+        errExit("fcntl");
+
+serve:
+    writePidFile();
+
+    pfd.fd = lfd;
+    pfd.events = POLLIN;
+
     while (1) {
+        if (gotRestart) {
+            gotRestart = 0;
+            // 此时没有正在处理的连接, 交接成功后旧进程即可退出
+            if (handOver(lfd, seqNum) == 0)
+                exit(EXIT_SUCCESS);
+            perror("handOver wrong");
+        }
+
+        if (ppoll(&pfd, 1, NULL, &waitMask) == -1) {
+            if (errno != EINTR)
+                perror("ppoll wrong");
+            continue;
+        }
+
         addrlen = sizeof(struct sockaddr_storage);
         cfd = accept(lfd, (struct sockaddr *)&claddr, &addrlen);
         if (cfd == -1) {
@@ -140,19 +395,29 @@ int main(int argc, char **argv)
             snprintf(addrStr, ADDRSTRLEN, "(?NUKNOWN?)");
         printf("Connection from %s\n", addrStr);
 
-        if (readLine(cfd, reqLenStr, INT_LEN) <= 0) {
+        if ((reqLineLen = readLine(cfd, reqLenStr, INT_LEN)) <= 0) {
             close(cfd);
             continue;
         }
 
-        reqLen = atoi(reqLenStr);
-        if (reqLen <= 0) {
-             close(cfd);
-             continue;
+        // atoi() 把非数字当作 0, 也不检查溢出
+        // out 填满后 getInts() 不再看后面的内容, "5 junk" 要靠 gn.pos 检查出来
+        if (getInts(reqLenStr, reqLineLen, GN_GT_0, &reqLen, 1, &gn) == -1) {
+            fprintf(stderr, "Bad request length %s: %s\n", addrStr, gnErrStr(gn.err));
+            close(cfd);
+            continue;
+        }
+        if (gn.count == 0 || gn.pos != (size_t)reqLineLen) {
+            fprintf(stderr, "Bad request length %s: %s\n", addrStr,
+                    (gn.count == 0) ? "Empty request" : "Trailing characters after length");
+            close(cfd);
+            continue;
         }
 
-        snprintf(seqNumStr, INT_LEN, "%d\n", seqNum);
-        if (write(cfd, &seqNumStr, strlen(seqNumStr)) != strlen(seqNumStr))
+        // 每个请求都要格式化一次, 不使用 snprintf()
+        seqNumLen = fmtU64(seqNumStr, seqNum);
+        seqNumStr[seqNumLen++] = '\n';
+        if (write(cfd, seqNumStr, seqNumLen) != (ssize_t)seqNumLen)
             fprintf(stderr, "Error on write");
         seqNum += reqLen;
 